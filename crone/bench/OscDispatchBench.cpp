@@ -0,0 +1,181 @@
+/*
+ * OscDispatchBench: cost of routing one OSC message to its handler,
+ * through liblo's own method list vs. crone's OscDispatch table.
+ *
+ * both paths run inside a real lo_server, fed serialized messages with lo_server_dispatch_data()
+ * (no sockets), so message parsing is included on both sides:
+ * - liblo: every crone method registered with lo_server_add_method(), as crone did before OscDispatch.
+ * - table: one catch-all method that looks the path up in OscDispatch, as crone does now.
+ *
+ * methods are read from a list in the format crone prints at startup (see crone/osc-methods.txt):
+ *   osc_dispatch_bench [methods file] [iterations]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <lo/lo.h>
+
+#include "OscDispatch.h"
+
+using namespace crone;
+
+namespace {
+    struct Method {
+        std::string path;
+        std::string types;
+    };
+
+    struct Packet {
+        std::vector<char> data;
+    };
+
+    // handlers only count, so the measurement is the routing
+    volatile unsigned long handled = 0;
+
+    int loHandler(const char *, const char *, lo_arg **, int, lo_message, void *) {
+        handled = handled + 1;
+        return 0;
+    }
+
+    void tableHandler(lo_arg **, int) {
+        handled = handled + 1;
+    }
+
+    OscDispatch dispatch;
+
+    int catchAll(const char *path, const char *types, lo_arg **argv, int argc, lo_message, void *) {
+        dispatch.dispatch(path, types, argv, argc);
+        return 0;
+    }
+
+    void loError(int num, const char *msg, const char *path) {
+        std::cerr << "liblo error " << num << ": " << msg << " (" << (path ? path : "") << ")" << std::endl;
+    }
+
+    // lines look like " /set/level/cut [if]"
+    std::vector<Method> readMethods(const char *file) {
+        std::vector<Method> methods;
+        std::ifstream in(file);
+        std::string line;
+        while (std::getline(in, line)) {
+            const size_t p = line.find('/');
+            const size_t a = line.find('[');
+            const size_t b = line.find(']');
+            if (p == std::string::npos || a == std::string::npos || b == std::string::npos || a < p) { continue; }
+            std::string path = line.substr(p, line.find(' ', p) - p);
+            methods.push_back({path, line.substr(a + 1, b - a - 1)});
+        }
+        return methods;
+    }
+
+    Packet serialise(const Method &m) {
+        lo_message msg = lo_message_new();
+        for (char t : m.types) {
+            switch (t) {
+                case 'i': lo_message_add_int32(msg, 1); break;
+                case 'f': lo_message_add_float(msg, 0.5f); break;
+                case 's': lo_message_add_string(msg, "/tmp/bench.wav"); break;
+                default: break;
+            }
+        }
+        Packet pkt;
+        size_t size = 0;
+        void *data = lo_message_serialise(msg, m.path.c_str(), nullptr, &size);
+        pkt.data.assign(static_cast<char *>(data), static_cast<char *>(data) + size);
+        free(data);
+        lo_message_free(msg);
+        return pkt;
+    }
+
+    // ns per message, dispatching every packet in turn
+    double run(lo_server server, const std::vector<Packet> &packets, long iterations) {
+        std::vector<char> scratch;
+        const auto start = std::chrono::steady_clock::now();
+        for (long n = 0; n < iterations; ++n) {
+            for (const Packet &p : packets) {
+                // liblo may convert the buffer in place; give it a fresh copy each time
+                scratch = p.data;
+                lo_server_dispatch_data(server, scratch.data(), scratch.size());
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        return ns / (static_cast<double>(iterations) * packets.size());
+    }
+
+    // the scratch copy alone, to subtract from both
+    double runCopy(const std::vector<Packet> &packets, long iterations) {
+        std::vector<char> scratch;
+        unsigned long sum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (long n = 0; n < iterations; ++n) {
+            for (const Packet &p : packets) {
+                scratch = p.data;
+                sum += static_cast<unsigned char>(scratch[0]);
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+        handled = handled + (sum & 1);
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        return ns / (static_cast<double>(iterations) * packets.size());
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *file = argc > 1 ? argv[1] : "osc-methods.txt";
+    const long iterations = argc > 2 ? atol(argv[2]) : 20000;
+
+    const std::vector<Method> methods = readMethods(file);
+    if (methods.empty()) {
+        std::cerr << "no methods read from " << file << std::endl;
+        return 1;
+    }
+
+    lo_server walk = lo_server_new(nullptr, loError);
+    lo_server table = lo_server_new(nullptr, loError);
+    if (walk == nullptr || table == nullptr) {
+        std::cerr << "can't create lo_server" << std::endl;
+        return 1;
+    }
+    for (const Method &m : methods) {
+        lo_server_add_method(walk, m.path.c_str(), m.types.c_str(), loHandler, nullptr);
+        dispatch.add(m.path.c_str(), m.types.c_str(), tableHandler);
+    }
+    dispatch.build();
+    lo_server_add_method(table, nullptr, nullptr, catchAll, nullptr);
+
+    std::vector<Packet> packets;
+    for (const Method &m : methods) {
+        packets.push_back(serialise(m));
+    }
+
+    // warm up, and check both paths handle every message
+    handled = 0;
+    run(walk, packets, 1);
+    const unsigned long walkHandled = handled;
+    handled = 0;
+    run(table, packets, 1);
+    const unsigned long tableHandled = handled;
+    if (walkHandled != packets.size() || tableHandled != packets.size()) {
+        std::cerr << "warning: handled " << walkHandled << " (liblo) / " << tableHandled
+                  << " (table) of " << packets.size() << " messages" << std::endl;
+    }
+
+    const double copy = runCopy(packets, iterations);
+    const double walkNs = run(walk, packets, iterations);
+    const double tableNs = run(table, packets, iterations);
+
+    std::cout << methods.size() << " methods, " << iterations << " passes" << std::endl;
+    std::cout << "liblo method list: " << walkNs - copy << " ns / message" << std::endl;
+    std::cout << "OscDispatch table: " << tableNs - copy << " ns / message" << std::endl;
+
+    lo_server_free(walk);
+    lo_server_free(table);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/* ------------------------------------------------------------
+Faust architecture file for crone effects.
+generate.sh substitutes @NAME@ and @GUARD@.
+------------------------------------------------------------ */
+
+#ifndef  @GUARD@
+#define  @GUARD@
+
+#include <string.h>
+
+#include "faust/gui/APIUI.h"
+#include "faust/gui/meta.h"
+#include "faust/dsp/dsp.h"
+
+#ifndef FAUSTFLOAT
+#define FAUSTFLOAT float
+#endif
+
+<<includeIntrinsic>>
+
+<<includeclass>>
+
+class @NAME@
+{
+  private:
+
+    @NAME@_dsp _dsp;
+    APIUI ui;
+
+  public:
+    @NAME@() {
+        _dsp.buildUserInterface(&ui);
+    }
+
+    void init(double sampleRate)
+    {
+        @NAME@_dsp::classInit(int(sampleRate));
+        _dsp.instanceConstants(int(sampleRate));
+        _dsp.instanceClear();
+    }
+
+    void processBlock(float** in, float** out, int numSamples)
+    {
+      _dsp.compute(numSamples, in, out);
+    }
+
+    int getNumInputs() { return _dsp.getNumInputs(); }
+    int getNumOutputs() { return _dsp.getNumOutputs(); }
+
+    APIUI& getUi() { return ui; }
+};
+
+#endif
@@ -0,0 +1,21 @@
+#!/bin/sh
+# regenerate crone's Faust effects (scalar code) in src/effects/.
+#
+# usage: dsp/generate.sh     (run from crone/)
+
+set -e
+
+ARCH=dsp/crone-arch.cpp
+EFFECTS="StereoCompressor ZitaReverb EqSection"
+
+guard() {
+    # StereoCompressor -> _STEREO_COMPRESSOR_H_
+    echo "_$(echo "$1" | sed 's/\([a-z]\)\([A-Z]\)/\1_\2/g' | tr '[:lower:]' '[:upper:]')_H_"
+}
+
+for e in $EFFECTS; do
+    out="src/effects/${e}.h"
+    faust -a "$ARCH" -cn "${e}_dsp" -scal -ftz 0 "dsp/${e}.dsp" \
+        | sed -e "s/@NAME@/${e}/g" -e "s/@GUARD@/$(guard "$e")/g" > "$out"
+    echo "$out"
+done
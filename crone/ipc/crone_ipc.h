@@ -0,0 +1,113 @@
+/*
+ * crone_ipc.h: shared-memory transport between matron and crone.
+ *
+ * crone creates a POSIX shared memory object holding two single-producer / single-consumer rings:
+ * - commands (matron -> crone): fixed-size binary records, each naming a crone OSC method by index,
+ *   with up to CRONE_IPC_MAX_ARGS int / float arguments. crone runs the same handler as for OSC.
+ * - polls (crone -> matron): VU levels, meters, softcut phase and voice events.
+ *
+ * crone publishes a directory of the methods that can be called this way (those taking only int / float
+ * arguments), so matron can resolve paths to indices. methods with string arguments, and external clients,
+ * keep using OSC over UDP. ordering is only guaranteed within each transport.
+ *
+ * each ring has a futex word; a consumer about to sleep sets its `sleeping` flag and waits on the futex,
+ * and a producer issues a wake only if that flag was set. so a busy consumer costs the producer no syscalls.
+ *
+ * counters are 64-bit and only ever increase; they are accessed with GCC __atomic builtins from both sides,
+ * so the layout is plain C.
+ */
+
+#ifndef CRONE_IPC_H
+#define CRONE_IPC_H
+
+#include <stdint.h>
+
+#define CRONE_IPC_SHM_NAME "/crone-ipc"
+#define CRONE_IPC_MAGIC 0x43524e49u /* 'CRNI' */
+#define CRONE_IPC_VERSION 1u
+
+#define CRONE_IPC_MAX_METHODS 256
+#define CRONE_IPC_PATH_LEN 48
+#define CRONE_IPC_TYPES_LEN 8
+#define CRONE_IPC_MAX_ARGS 4
+/* ring sizes, in records; must be powers of two */
+#define CRONE_IPC_CMD_RING 4096
+#define CRONE_IPC_POLL_RING 1024
+#define CRONE_IPC_POLL_DATA 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    char path[CRONE_IPC_PATH_LEN];
+    /* OSC type tags, 'i' and 'f' only */
+    char types[CRONE_IPC_TYPES_LEN];
+} crone_ipc_method_t;
+
+typedef union {
+    int32_t i;
+    float f;
+} crone_ipc_arg_t;
+
+typedef struct {
+    uint16_t method;
+    uint16_t argc;
+    crone_ipc_arg_t argv[CRONE_IPC_MAX_ARGS];
+} crone_ipc_cmd_t;
+
+typedef enum {
+    /* data: 4 bytes, as the /poll/vu blob */
+    CRONE_IPC_POLL_VU = 0,
+    /* data: (peak, rms) pairs, as the /poll/meters blob */
+    CRONE_IPC_POLL_METERS = 1,
+    /* idx: voice; value: quantized phase */
+    CRONE_IPC_POLL_CUT_PHASE = 2,
+    /* idx: voice; kind in data[0] (as /softcut/event); value: position */
+    CRONE_IPC_POLL_CUT_EVENT = 3,
+} crone_ipc_poll_kind_t;
+
+typedef struct {
+    uint16_t kind;
+    uint16_t size;
+    int32_t idx;
+    float value;
+    uint32_t pad;
+    /* event time, unix seconds; 0 if the record isn't timestamped */
+    double time;
+    uint8_t data[CRONE_IPC_POLL_DATA];
+} crone_ipc_poll_t;
+
+typedef struct {
+    /* written by the producer */
+    uint64_t head;
+    uint8_t pad0[56];
+    /* written by the consumer */
+    uint64_t tail;
+    /* consumer is (about to be) waiting on `futex` */
+    uint32_t sleeping;
+    uint32_t futex;
+    uint8_t pad1[48];
+} crone_ipc_ring_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    /* cleared by crone when it shuts down */
+    uint32_t alive;
+    /* set by matron while it is consuming polls */
+    uint32_t client_attached;
+    uint32_t num_methods;
+    uint32_t pad[11];
+    crone_ipc_method_t methods[CRONE_IPC_MAX_METHODS];
+    crone_ipc_ring_t cmd_ring;
+    crone_ipc_cmd_t cmd[CRONE_IPC_CMD_RING];
+    crone_ipc_ring_t poll_ring;
+    crone_ipc_poll_t poll[CRONE_IPC_POLL_RING];
+} crone_ipc_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRONE_IPC_H */
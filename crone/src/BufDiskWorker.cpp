@@ -11,21 +11,34 @@
 //--------------
 
 #include <sndfile.hh>
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <cstring>
 #include <utility>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "BufDiskWorker.h"
+#include "RawAudioFile.h"
 
 using namespace crone;
 
 std::unique_ptr<std::thread> BufDiskWorker::worker = nullptr;
 std::queue<BufDiskWorker::Job> BufDiskWorker::jobQ;
 std::mutex BufDiskWorker::qMut;
+std::condition_variable BufDiskWorker::qCv;
 
 std::array<BufDiskWorker::BufDesc, BufDiskWorker::maxBufs> BufDiskWorker::bufs;
 int BufDiskWorker::numBufs = 0;
 bool BufDiskWorker::shouldQuit = false;
 int BufDiskWorker::sampleRate = 48000;
+BufDiskWorker::JobCallback BufDiskWorker::jobCallback;
+int BufDiskWorker::currentJobId = -1;
+std::chrono::steady_clock::time_point BufDiskWorker::lastProgressTime;
+WorkerPool BufDiskWorker::ioPool;
+std::thread::id BufDiskWorker::workerThreadId;
 
 // clamp unsigned int to upper bound, inclusive
 static inline void clamp(size_t &x, const size_t a) {
@@ -36,89 +49,131 @@ int BufDiskWorker::registerBuffer(float *data, size_t frames) {
     int n = numBufs++;
     bufs[n].data = data;
     bufs[n].frames = frames;
+    bufs[n].owner = nullptr;
+    return n;
+}
+
+int BufDiskWorker::registerBuffer(SampleBuffer &buf) {
+    int n = registerBuffer(buf.data(), buf.frames());
+    bufs[n].owner = &buf;
     return n;
 }
 
 void BufDiskWorker::requestJob(BufDiskWorker::Job &job) {
-    qMut.lock();
-    jobQ.push(job);
-    qMut.unlock();
-    // FIXME: use condvar to signal worker
+    {
+        std::lock_guard<std::mutex> lock(qMut);
+        jobQ.push(job);
+    }
+    qCv.notify_one();
 }
 
-void BufDiskWorker::requestClear(size_t idx, float start, float dur) {
-    BufDiskWorker::Job job{BufDiskWorker::JobType::Clear, {idx, 0}, "", 0, start, dur, 0};
+void BufDiskWorker::requestClear(size_t idx, float start, float dur, int jobId) {
+    BufDiskWorker::Job job{BufDiskWorker::JobType::Clear, {idx, 0}, "", 0, start, dur, 0, jobId};
     requestJob(job);
 }
 
 void
-BufDiskWorker::requestReadMono(size_t idx, std::string path, float startSrc, float startDst, float dur, int chanSrc) {
+BufDiskWorker::requestReadMono(size_t idx, std::string path, float startSrc, float startDst, float dur, int chanSrc,
+                               int jobId) {
     BufDiskWorker::Job job{BufDiskWorker::JobType::ReadMono, {idx, 0}, std::move(path), startSrc, startDst, dur,
-                           chanSrc};
+                           chanSrc, jobId};
     requestJob(job);
 }
 
 void BufDiskWorker::requestReadStereo(size_t idx0, size_t idx1, std::string path,
-                                      float startSrc, float startDst, float dur) {
+                                      float startSrc, float startDst, float dur, int jobId) {
     BufDiskWorker::Job job{BufDiskWorker::JobType::ReadStereo, {idx0, idx1}, std::move(path), startSrc, startDst, dur,
-                           0};
+                           0, jobId};
     requestJob(job);
 }
 
-void BufDiskWorker::requestWriteMono(size_t idx, std::string path, float start, float dur) {
-    BufDiskWorker::Job job{BufDiskWorker::JobType::WriteMono, {idx, 0}, std::move(path), start, start, dur, 0};
+void BufDiskWorker::requestWriteMono(size_t idx, std::string path, float start, float dur, int jobId) {
+    BufDiskWorker::Job job{BufDiskWorker::JobType::WriteMono, {idx, 0}, std::move(path), start, start, dur, 0, jobId};
     requestJob(job);
 }
 
 void BufDiskWorker::requestWriteStereo(size_t idx0, size_t idx1, std::string path,
-                                       float start, float dur) {
-    BufDiskWorker::Job job{BufDiskWorker::JobType::WriteStereo, {idx0, idx1}, std::move(path), start, start, dur, 0};
+                                       float start, float dur, int jobId) {
+    BufDiskWorker::Job job{BufDiskWorker::JobType::WriteStereo, {idx0, idx1}, std::move(path), start, start, dur, 0,
+                           jobId};
     requestJob(job);
 }
 
+void BufDiskWorker::requestSync(size_t idx, int jobId) {
+    BufDiskWorker::Job job{BufDiskWorker::JobType::Sync, {idx, 0}, "", 0, 0, 0, 0, jobId};
+    requestJob(job);
+}
+
+void BufDiskWorker::setJobCallback(JobCallback cb) {
+    jobCallback = std::move(cb);
+}
+
+void BufDiskWorker::reportJob(int id, JobState state, float progress) {
+    if (id < 0 || !jobCallback) { return; }
+    jobCallback(id, state, progress);
+}
+
+void BufDiskWorker::reportProgress(size_t framesDone, size_t framesTotal) {
+    if (currentJobId < 0 || framesTotal == 0) { return; }
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastProgressTime < std::chrono::milliseconds(progressPeriodMs)) { return; }
+    lastProgressTime = now;
+    reportJob(currentJobId, JobState::Progress, static_cast<float>(framesDone) / static_cast<float>(framesTotal));
+}
+
 void BufDiskWorker::workLoop() {
-    while (!shouldQuit) {
-        // FIXME: use condvar to wait here instead of sleeping...
-        qMut.lock();
-        if (!jobQ.empty()) {
-            Job job = jobQ.front();
+    workerThreadId = std::this_thread::get_id();
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(qMut);
+            qCv.wait(lock, [] { return shouldQuit || !jobQ.empty(); });
+            if (shouldQuit) { break; }
+            job = jobQ.front();
             jobQ.pop();
-            qMut.unlock();
-
-            switch (job.type) {
-                case JobType::Clear:
-                    clearBuffer(bufs[job.bufIdx[0]], job.startDst, job.dur);
-                    break;
-                case JobType::ReadMono:
-                    readBufferMono(job.path, bufs[job.bufIdx[0]], job.startSrc, job.startDst, job.dur, job.chan);
-                    break;
-                case JobType::ReadStereo:
-                    readBufferStereo(job.path, bufs[job.bufIdx[0]], bufs[job.bufIdx[1]], job.startSrc, job.startDst,
-                                     job.dur);
-                    break;
-                case JobType::WriteMono:
-                    writeBufferMono(job.path, bufs[job.bufIdx[0]], job.startSrc, job.dur);
-                    break;
-                case JobType::WriteStereo:
-                    writeBufferStereo(job.path, bufs[job.bufIdx[0]], bufs[job.bufIdx[1]], job.startSrc, job.dur);
-                    break;
-            }
+        }
 #if 0 // debug, timing
-            auto ms_now = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-            auto ms_dur = ms_now - ms_start;
-            std::cout << "job finished; elapsed time = " << ms_dur << " ms" << std::endl;
+        auto ms_start = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
 #endif
-
-        } else {
-            qMut.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(sleepPeriodMs));
+        currentJobId = job.id;
+        lastProgressTime = std::chrono::steady_clock::now();
+        bool ok = false;
+        switch (job.type) {
+            case JobType::Clear:
+                ok = clearBuffer(bufs[job.bufIdx[0]], job.startDst, job.dur);
+                break;
+            case JobType::ReadMono:
+                ok = readBufferMono(job.path, bufs[job.bufIdx[0]], job.startSrc, job.startDst, job.dur, job.chan);
+                break;
+            case JobType::ReadStereo:
+                ok = readBufferStereo(job.path, bufs[job.bufIdx[0]], bufs[job.bufIdx[1]], job.startSrc,
+                                      job.startDst, job.dur);
+                break;
+            case JobType::WriteMono:
+                ok = writeBufferMono(job.path, bufs[job.bufIdx[0]], job.startSrc, job.dur);
+                break;
+            case JobType::WriteStereo:
+                ok = writeBufferStereo(job.path, bufs[job.bufIdx[0]], bufs[job.bufIdx[1]], job.startSrc, job.dur);
+                break;
+            case JobType::Sync:
+                ok = syncBuffer(bufs[job.bufIdx[0]]);
+                break;
         }
+        currentJobId = -1;
+        reportJob(job.id, ok ? JobState::Done : JobState::Failed, ok ? 1.f : 0.f);
+#if 0 // debug, timing
+        auto ms_now = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        auto ms_dur = ms_now - ms_start;
+        std::cout << "job finished; elapsed time = " << ms_dur << " ms" << std::endl;
+#endif
     }
 }
 
 void BufDiskWorker::init(int sr) {
     sampleRate = sr;
     if (worker == nullptr) {
+        // normal priority: disk I/O must not compete with the audio workers
+        ioPool.start(numIoThreads, 0);
         worker = std::make_unique<std::thread>(std::thread(BufDiskWorker::workLoop));
         worker->detach();
     }
@@ -131,7 +186,7 @@ int BufDiskWorker::secToFrame(float seconds) {
 //------------------------
 //---- private buffer routines
 
-void BufDiskWorker::clearBuffer(BufDesc &buf, float start, float dur) {
+bool BufDiskWorker::clearBuffer(BufDesc &buf, float start, float dur) {
     size_t frA = secToFrame(start);
     clamp(frA, buf.frames - 1);
     size_t frB;
@@ -141,254 +196,293 @@ void BufDiskWorker::clearBuffer(BufDesc &buf, float start, float dur) {
         frB = frA + secToFrame(dur);
     }
     clamp(frB, buf.frames);
-    for (size_t i = frA; i < frB; ++i) {
-        buf.data[i] = 0.f;
+    if (frB <= frA) { return true; }
+    if (buf.owner != nullptr) {
+        buf.owner->clear(frA, frB - frA);
+    } else {
+        for (size_t i = frA; i < frB; ++i) {
+            buf.data[i] = 0.f;
+        }
     }
+    return true;
 }
 
-void BufDiskWorker::readBufferMono(const std::string &path, BufDesc &buf,
-                                   float startSrc, float startDst, float dur, int chanSrc)
-noexcept {
-    SndfileHandle file(path);
+bool BufDiskWorker::syncBuffer(BufDesc &buf) {
+    if (buf.owner == nullptr || !buf.owner->isFileBacked()) { return true; }
+    size_t bytes;
+    return buf.owner->sync(bytes);
+}
 
-    if (file.frames() < 1) {
-        std::cerr << "readBufferMono(): empty / missing file: " << path << std::endl;
-        return;
+struct BufDiskWorker::IoJob {
+    std::string path;
+    // raw file descriptor; for reads, -1 means go through libsndfile
+    int fd;
+    // offset of sample data, for raw access
+    off_t dataOffset;
+    int fileChannels;
+    // per buffer channel: first frame in buffer, and matching file channel
+    float *data[2];
+    int chan[2];
+    int numChannels;
+    // first frame in file, and total frames
+    size_t fileStart;
+    size_t frames;
+    int numTasks;
+    std::atomic<size_t> framesDone;
+    std::atomic<bool> failed;
+};
+
+void BufDiskWorker::taskProgress(IoJob &job, size_t frames) {
+    size_t done = job.framesDone.fetch_add(frames) + frames;
+    // progress reports stay on the disk worker thread, which also processes tasks
+    if (std::this_thread::get_id() == workerThreadId) {
+        reportProgress(done, job.frames);
     }
+}
 
-    size_t bufFrames = buf.frames;
-
-    size_t frSrc = secToFrame(startSrc);
-    clamp(frSrc, bufFrames - 1);
-
-    size_t frDst = secToFrame(startDst);
-    clamp(frDst, bufFrames - 1);
-
-    size_t frDur;
-    if (dur < 0.f) {
-        auto maxDurSrc = file.frames() - frSrc;
-        auto maxDurDst = bufFrames - frDst;
-        frDur = maxDurSrc > maxDurDst ? maxDurDst : maxDurSrc;
-    } else {
-        frDur = secToFrame(dur);
+void BufDiskWorker::readTask(void *ctx, int taskIdx) {
+    auto &job = *static_cast<IoJob *>(ctx);
+    size_t fr = job.frames * taskIdx / job.numTasks;
+    const size_t end = job.frames * (taskIdx + 1) / job.numTasks;
+    if (fr >= end) { return; }
+    const int nc = job.fileChannels;
+    std::unique_ptr<float[]> ioBuf(new float[nc * ioBufFrames]);
+
+    SndfileHandle file;
+    if (job.fd < 0) {
+        file = SndfileHandle(job.path);
+        if (file.seek(job.fileStart + fr, SF_SEEK_SET) == -1) {
+            std::cerr << "error seeking to frame: " << job.fileStart + fr << "; aborting read" << std::endl;
+            job.failed = true;
+            return;
+        }
     }
 
-    auto numSrcChan = file.channels();
-    chanSrc = std::min(numSrcChan - 1, std::max(0, chanSrc));
-
-    auto *ioBuf = new float[numSrcChan * ioBufFrames];
-    size_t numBlocks = frDur / ioBufFrames;
-    size_t rem = frDur - (numBlocks * ioBufFrames);
-    std::cout << "file contains " << file.frames() << " frames" << std::endl;
-    std::cout << "reading " << numBlocks << " blocks and " << rem << " remainder frames..." << std::endl;
-    for (size_t block = 0; block < numBlocks; ++block) {
-        int res = file.seek(frSrc, SF_SEEK_SET);
-        if (res == -1) {
-            std::cerr << "error seeking to frame: " << frSrc << "; aborting read" << std::endl;
-            goto cleanup;
+    while (fr < end && !job.failed.load(std::memory_order_relaxed)) {
+        const size_t n = std::min(ioBufFrames, end - fr);
+        bool ok;
+        if (job.fd >= 0) {
+            const size_t frameBytes = nc * sizeof(float);
+            ok = RawAudioFile::readAt(job.fd, ioBuf.get(), n * frameBytes,
+                                      job.dataOffset + static_cast<off_t>((job.fileStart + fr) * frameBytes));
+        } else {
+            ok = file.readf(ioBuf.get(), n) == static_cast<sf_count_t>(n);
+        }
+        if (!ok) {
+            std::cerr << "error reading frame: " << job.fileStart + fr << "; aborting read" << std::endl;
+            job.failed = true;
+            return;
         }
-        file.readf(ioBuf, ioBufFrames);
-        for (int fr = 0; fr < ioBufFrames; ++fr) {
-            buf.data[frDst] = ioBuf[fr * numSrcChan + chanSrc];
-            frDst++;
+        for (int ch = 0; ch < job.numChannels; ++ch) {
+            float *dst = job.data[ch] + fr;
+            const float *src = ioBuf.get() + job.chan[ch];
+            for (size_t i = 0; i < n; ++i) {
+                dst[i] = src[i * nc];
+            }
         }
-        frSrc += ioBufFrames;
+        fr += n;
+        taskProgress(job, n);
     }
-    for (size_t i = 0; i < rem; ++i) {
-        int res = file.seek(frSrc, SF_SEEK_SET);
+}
 
-        if (res == -1) {
-            std::cerr << "error seeking to frame: " << frSrc << "; aborting read" << std::endl;
-            goto cleanup;
+void BufDiskWorker::writeTask(void *ctx, int taskIdx) {
+    auto &job = *static_cast<IoJob *>(ctx);
+    size_t fr = job.frames * taskIdx / job.numTasks;
+    const size_t end = job.frames * (taskIdx + 1) / job.numTasks;
+    if (fr >= end) { return; }
+    const int nc = job.numChannels;
+    const size_t frameBytes = static_cast<size_t>(nc) * 3;
+    std::unique_ptr<unsigned char[]> ioBuf(new unsigned char[frameBytes * ioBufFrames]);
+
+    while (fr < end && !job.failed.load(std::memory_order_relaxed)) {
+        const size_t n = std::min(ioBufFrames, end - fr);
+        unsigned char *p = ioBuf.get();
+        for (size_t i = 0; i < n; ++i) {
+            for (int ch = 0; ch < nc; ++ch) {
+                RawAudioFile::packPcm24(job.data[ch][fr + i], p);
+                p += 3;
+            }
         }
-        file.read(ioBuf, numSrcChan);
-        buf.data[frDst] = ioBuf[chanSrc];
-        frDst++;
-        frSrc++;
+        if (!RawAudioFile::writeAt(job.fd, ioBuf.get(), n * frameBytes,
+                                   job.dataOffset + static_cast<off_t>(fr * frameBytes))) {
+            std::cerr << "BufDiskWorker: write aborted at frame " << fr << " (" << strerror(errno) << ")"
+                      << std::endl;
+            job.failed = true;
+            return;
+        }
+        fr += n;
+        taskProgress(job, n);
     }
-    cleanup:
-    delete[] ioBuf;
 }
 
-void BufDiskWorker::readBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1,
-                                     float startTimeSrc, float startTimeDst, float dur)
-noexcept {
+bool BufDiskWorker::readBuffer(const std::string &path, BufDesc *dst[], int chanSrc[], int numDst,
+                               float startSrc, float startDst, float dur) noexcept {
     SndfileHandle file(path);
 
     if (file.frames() < 1) {
-        std::cerr << "SoftCutClient::readBufferStereo(): empty / missing file: " << path << std::endl;
-        return;
+        std::cerr << "BufDiskWorker::readBuffer(): empty / missing file: " << path << std::endl;
+        return false;
     }
 
-    size_t bufFrames = buf0.frames < buf1.frames ? buf0.frames : buf1.frames;
-
-    size_t frSrc = secToFrame(startTimeSrc);
-    clamp(frSrc, bufFrames - 1);
-
-    size_t frDst = secToFrame(startTimeDst);
-    clamp(frDst, bufFrames - 1);
-
-    size_t frDur;
-    if (dur < 0.f) {
-        auto maxDurSrc = file.frames() - frSrc;
-        auto maxDurDst = bufFrames - frDst;
-        frDur = maxDurSrc > maxDurDst ? maxDurDst : maxDurSrc;
-    } else {
-        frDur = secToFrame(dur);
+    auto numSrcChan = file.channels();
+    if (numSrcChan < numDst) {
+        std::cerr << "BufDiskWorker::readBuffer(): not enough channels in source; aborting" << std::endl;
+        return false;
     }
 
-    auto numSrcChan = file.channels();
-    if (numSrcChan < 2) {
-        std::cerr << "SoftCutClient::readBufferStereo(): not enough channels in source; aborting" << std::endl;
-        return;
+    size_t bufFrames = dst[0]->frames;
+    for (int i = 1; i < numDst; ++i) {
+        clamp(bufFrames, dst[i]->frames);
     }
+    const auto fileFrames = static_cast<size_t>(file.frames());
 
-    auto *ioBuf = new float[numSrcChan * ioBufFrames];
+    size_t frSrc = secToFrame(startSrc);
+    clamp(frSrc, fileFrames - 1);
 
-    size_t numBlocks = frDur / ioBufFrames;
-    size_t rem = frDur - (numBlocks * ioBufFrames);
+    size_t frDst = secToFrame(startDst);
+    clamp(frDst, bufFrames - 1);
 
-    for (size_t block = 0; block < numBlocks; ++block) {
-        int res = file.seek(frSrc, SF_SEEK_SET);
-        if (res == -1) {
-            std::cerr << "error seeking to frame: " << frSrc << "; aborting read" << std::endl;
-            goto cleanup;
-        }
-        file.readf(ioBuf, ioBufFrames);
-        for (int fr = 0; fr < ioBufFrames; ++fr) {
-            buf0.data[frDst] = ioBuf[fr * numSrcChan];
-            buf1.data[frDst] = ioBuf[fr * numSrcChan + 1];
-            frDst++;
-        }
-        frSrc += ioBufFrames;
+    auto maxDurSrc = fileFrames - frSrc;
+    auto maxDurDst = bufFrames - frDst;
+    size_t frDur = maxDurSrc > maxDurDst ? maxDurDst : maxDurSrc;
+    if (dur >= 0.f) {
+        clamp(frDur, static_cast<size_t>(secToFrame(dur)));
+    }
+
+    IoJob job;
+    job.path = path;
+    job.fd = -1;
+    job.dataOffset = 0;
+    job.fileChannels = numSrcChan;
+    job.numChannels = numDst;
+    for (int i = 0; i < numDst; ++i) {
+        job.data[i] = dst[i]->data + frDst;
+        job.chan[i] = std::min(numSrcChan - 1, std::max(0, chanSrc[i]));
     }
-    for (size_t i = 0; i < rem; ++i) {
-        int res = file.seek(frSrc, SF_SEEK_SET);
-        if (res == -1) {
-            std::cerr << "error seeking to frame: " << frSrc << "; aborting read" << std::endl;
-            goto cleanup;
+    job.fileStart = frSrc;
+    job.frames = frDur;
+    job.numTasks = frDur < parallelMinFrames ? 1 : numIoTasks;
+    job.framesDone = 0;
+    job.failed = false;
+
+    // float samples that libsndfile would hand back unchanged: skip it
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        RawAudioFile::Layout layout{};
+        if (RawAudioFile::probeFloat(fd, layout)
+            && layout.channels == numSrcChan && layout.frames == fileFrames) {
+            job.fd = fd;
+            job.dataOffset = layout.dataOffset;
+        } else {
+            close(fd);
         }
-        file.read(ioBuf, numSrcChan);
-        buf0.data[frDst] = ioBuf[0];
-        buf1.data[frDst] = ioBuf[1];
-        frDst++;
-        frSrc++;
     }
-    cleanup:
-    delete[] ioBuf;
-}
 
-void BufDiskWorker::writeBufferMono(const std::string &path, BufDesc &buf, float start, float dur) noexcept {
-    const int sr = 48000;
-    const int channels = 1;
-    const int format = SF_FORMAT_WAV | SF_FORMAT_PCM_24;
+    std::cout << "reading " << frDur << " frames in " << job.numTasks << " range(s)"
+              << (job.fd >= 0 ? " (raw float)" : "") << std::endl;
+    ioPool.run(readTask, &job, job.numTasks);
+    for (int i = 0; i < numDst; ++i) {
+        if (dst[i]->owner != nullptr) { dst[i]->owner->markDirty(frDst, frDst + frDur); }
+    }
 
-    SndfileHandle file(path, SFM_WRITE, format, channels, sr);
+    if (job.fd >= 0) { close(job.fd); }
+    return !job.failed;
+}
 
-    if (not file) {
-        std::cerr << "BufDiskWorker::writeBufferMono(): cannot open sndfile" << path << " for writing" << std::endl;
-        return;
+bool BufDiskWorker::writeBuffer(const std::string &path, BufDesc *src[], int numSrc, float start, float dur)
+noexcept {
+    size_t bufFrames = src[0]->frames;
+    for (int i = 1; i < numSrc; ++i) {
+        clamp(bufFrames, src[i]->frames);
     }
 
-    file.command(SFC_SET_CLIPPING, NULL, SF_TRUE);
-
     size_t frSrc = secToFrame(start);
-    size_t bufFrames = buf.frames;
     clamp(frSrc, bufFrames - 1);
 
-    size_t frDur;
-    if (dur < 0.f) {
-        // FIXME: should check available disk space?
-        frDur = bufFrames - frSrc;
-    } else {
-        frDur = secToFrame(dur);
+    size_t frDur = bufFrames - frSrc;
+    if (dur >= 0.f) {
+        clamp(frDur, static_cast<size_t>(secToFrame(dur)));
     }
 
-    size_t numBlocks = frDur / ioBufFrames;
-    size_t rem = frDur - (numBlocks * ioBufFrames);
-    size_t nf = 0;
-    float *pbuf = buf.data + frSrc;
-    for (size_t block = 0; block < numBlocks; ++block) {
-        size_t n = file.writef(pbuf, ioBufFrames);
-        pbuf += ioBufFrames;
-        nf += n;
-        if (n != ioBufFrames) {
-            std::cerr << "BufDiskWorker::writeBufferMono(): write aborted (disk space?) after " << nf << " frames"
-                      << std::endl;
-            return;
-        }
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "BufDiskWorker::writeBuffer(): cannot open " << path << " for writing ("
+                  << strerror(errno) << ")" << std::endl;
+        return false;
     }
 
-    for (size_t i = 0; i < rem; ++i) {
-        if (file.writef(pbuf++, 1) != 1) {
-            std::cerr << "BufDiskWorker::writeBufferMono(): write aborted (disk space?) after " << nf << " frames"
-                      << std::endl;
-            return;
-        }
-        ++nf;
+    off_t dataOffset = RawAudioFile::writeWavHeader24(fd, numSrc, sampleRate, frDur);
+    if (dataOffset < 0) {
+        std::cerr << "BufDiskWorker::writeBuffer(): cannot write header to " << path << std::endl;
+        close(fd);
+        return false;
     }
-}
 
-void BufDiskWorker::writeBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1, float start, float dur)
-noexcept {
-    const int sr = 48000;
-    const int channels = 2;
-    const int format = SF_FORMAT_WAV | SF_FORMAT_PCM_24;
-    SndfileHandle file(path, SFM_WRITE, format, channels, sr);
-
-    if (not file) {
-        std::cerr << "ERROR: cannot open sndfile" << path << " for writing" << std::endl;
-        return;
+    // reserve the whole file up front: running out of disk space fails here rather than mid-write,
+    // and the I/O tasks never race to extend the file
+    const off_t fileSize = RawAudioFile::wavFileSize24(dataOffset, numSrc, frDur);
+    int res = posix_fallocate(fd, 0, fileSize);
+    if (res == ENOSPC) {
+        std::cerr << "BufDiskWorker::writeBuffer(): not enough disk space for " << path << std::endl;
+        close(fd);
+        return false;
+    }
+    if (res != 0 && ftruncate(fd, fileSize) != 0) {
+        std::cerr << "BufDiskWorker::writeBuffer(): cannot size " << path << " (" << strerror(errno) << ")"
+                  << std::endl;
+        close(fd);
+        return false;
     }
 
-    file.command(SFC_SET_CLIPPING, NULL, SF_TRUE);
+    IoJob job;
+    job.path = path;
+    job.fd = fd;
+    job.dataOffset = dataOffset;
+    job.fileChannels = numSrc;
+    job.numChannels = numSrc;
+    for (int i = 0; i < numSrc; ++i) {
+        job.data[i] = src[i]->data + frSrc;
+        job.chan[i] = i;
+    }
+    job.fileStart = 0;
+    job.frames = frDur;
+    job.numTasks = frDur < parallelMinFrames ? 1 : numIoTasks;
+    job.framesDone = 0;
+    job.failed = false;
+
+    ioPool.run(writeTask, &job, job.numTasks);
+
+    if (close(fd) != 0) {
+        std::cerr << "BufDiskWorker::writeBuffer(): error closing " << path << " (" << strerror(errno) << ")"
+                  << std::endl;
+        return false;
+    }
+    return !job.failed;
+}
 
-    size_t frSrc = secToFrame(start);
-    size_t bufFrames = buf0.frames < buf1.frames ? buf0.frames : buf1.frames;
-    clamp(frSrc, bufFrames - 1);
+bool BufDiskWorker::readBufferMono(const std::string &path, BufDesc &buf,
+                                   float startSrc, float startDst, float dur, int chanSrc)
+noexcept {
+    BufDesc *dst[] = {&buf};
+    int chan[] = {chanSrc};
+    return readBuffer(path, dst, chan, 1, startSrc, startDst, dur);
+}
 
-    size_t frDur;
-    if (dur < 0.f) {
-        // FIXME: should check available disk space?
-        frDur = bufFrames - frSrc;
-    } else {
-        frDur = secToFrame(dur);
-    }
+bool BufDiskWorker::readBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1,
+                                     float startTimeSrc, float startTimeDst, float dur)
+noexcept {
+    BufDesc *dst[] = {&buf0, &buf1};
+    int chan[] = {0, 1};
+    return readBuffer(path, dst, chan, 2, startTimeSrc, startTimeDst, dur);
+}
 
-    size_t numBlocks = frDur / ioBufFrames;
-    size_t rem = frDur - (numBlocks * ioBufFrames);
-    size_t nf = 0;
-
-    auto *ioBuf = new float[ioBufFrames * 2];
-    float *pbuf0 = buf0.data + frSrc;
-    float *pbuf1 = buf1.data + frSrc;
-    for (size_t block = 0; block < numBlocks; ++block) {
-        float *pio = ioBuf;
-        for (size_t fr = 0; fr < ioBufFrames; ++fr) {
-            *pio++ = *pbuf0++;
-            *pio++ = *pbuf1++;
-        }
-        size_t n = file.writef(ioBuf, ioBufFrames);
-        nf += n;
-        if (n != ioBufFrames) {
-            std::cerr << "BufDiskWorker::writeBufferStereo(): write aborted (disk space?) after " << nf << " frames"
-                      << std::endl;
-            goto cleanup;
-        }
-        frSrc += ioBufFrames;
-    }
+bool BufDiskWorker::writeBufferMono(const std::string &path, BufDesc &buf, float start, float dur) noexcept {
+    BufDesc *src[] = {&buf};
+    return writeBuffer(path, src, 1, start, dur);
+}
 
-    for (size_t i = 0; i < rem; ++i) {
-        ioBuf[0] = *(buf0.data + frSrc);
-        ioBuf[1] = *(buf1.data + frSrc);
-        if (file.writef(ioBuf, 1) != 1) {
-            std::cerr << "BufDiskWorker::writeBufferStereo(): write aborted (disk space?) after " << nf << " frames"
-                      << std::endl;
-            goto cleanup;
-        }
-        ++frSrc;
-        ++nf;
-    }
-    cleanup:
-    delete[] ioBuf;
+bool BufDiskWorker::writeBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1, float start, float dur)
+noexcept {
+    BufDesc *src[] = {&buf0, &buf1};
+    return writeBuffer(path, src, 2, start, dur);
 }
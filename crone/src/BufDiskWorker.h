@@ -7,29 +7,51 @@
  * it requires users to _register_ buffers (returns numerical index for registered buf)
  * disk read/write work can be requested for registered buffers, executed in background thread
  *
- * TODO: 
- *  - callback for request completion?
- *  - use condvar for signaling, instead of sleep+poll
+ * large reads and writes are split into frame ranges, which are processed in parallel on a small pool of I/O threads.
+ * each range goes through its own file handle, so no seeking is shared between threads.
+ * 32-bit float WAV / CAF files are read directly, without format conversion;
+ * files are written as 24-bit WAV directly, with samples packed on the I/O threads.
+ *
+ * each request can carry a job ID (chosen by the requester).
+ * for jobs with an ID >= 0, the job callback is called from the worker thread
+ * with periodic progress, and once more when the job finishes or fails.
  */
 
 #ifndef CRONE_BUFMANAGER_H
 #define CRONE_BUFMANAGER_H
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <string>
 #include <thread>
 #include <mutex>
 #include <queue>
 #include <memory>
 
+#include "SampleBuffer.h"
+#include "WorkerPool.h"
+
 namespace crone {
 
     // class for asynchronous management of mono audio buffers
     class BufDiskWorker {
+    public:
+        enum class JobState {
+            Progress = 0, Done = 1, Failed = 2
+        };
+        // called from the worker thread with (job ID, state, progress in [0, 1])
+        typedef std::function<void(int, JobState, float)> JobCallback;
+
+    private:
 
         enum class JobType {
             Clear,
             ReadMono, ReadStereo,
-            WriteMono, WriteStereo
+            WriteMono, WriteStereo,
+            Sync
         };
         struct Job {
             JobType type;
@@ -39,21 +61,39 @@ namespace crone {
             float startDst;
             float dur;
             int chan;
+            int id;
         };
         struct BufDesc {
             float *data;
             size_t frames;
+            // owning SampleBuffer, if any: used for clearing and dirty tracking
+            SampleBuffer *owner;
         };
         static std::queue<Job> jobQ;
         static std::mutex qMut;
+        static std::condition_variable qCv;
         static std::unique_ptr<std::thread> worker;
         static constexpr size_t maxBufs = 16;
         static std::array<BufDesc, maxBufs> bufs;
         static int numBufs;
         static bool shouldQuit;
-        static constexpr int sleepPeriodMs = 100;
         static int sampleRate;
-        static constexpr int ioBufFrames = 1024;
+        // frames per block read or written by one I/O task
+        static constexpr size_t ioBufFrames = 65536;
+        // jobs shorter than this are done on the worker thread alone
+        static constexpr size_t parallelMinFrames = 1 << 18;
+        static constexpr int numIoThreads = 3;
+        static constexpr int numIoTasks = 8;
+        static WorkerPool ioPool;
+        static std::thread::id workerThreadId;
+        // one read or write, shared by the I/O tasks working on it
+        struct IoJob;
+
+        static JobCallback jobCallback;
+        // job in progress on the worker thread, and time of its last progress report
+        static int currentJobId;
+        static std::chrono::steady_clock::time_point lastProgressTime;
+        static constexpr int progressPeriodMs = 100;
 
         static int secToFrame(float seconds);
 
@@ -64,44 +104,76 @@ namespace crone {
         // initialize with sample rate
         static void init(int sr);
 
+        // set function to receive job progress and completion.
+        // call before requesting any jobs with IDs
+        static void setJobCallback(JobCallback cb);
+
         // register a buffer to manage.
         // returns index to be used in work requests
         static int registerBuffer(float *data, size_t frames);
+        static int registerBuffer(SampleBuffer &buf);
+
+        //-- for each request, jobId < 0 means no progress / completion reports
 
         // clear a portion of a mono buffer
-        static void requestClear(size_t idx, float start = 0, float dur = -1);
+        static void requestClear(size_t idx, float start = 0, float dur = -1, int jobId = -1);
 
         // read mono soundfile to mono buffer
         static void
         requestReadMono(size_t idx, std::string path, float startSrc = 0, float startDst = 0, float dur = -1,
-                        int chanSrc = 0);
+                        int chanSrc = 0, int jobId = -1);
 
         // read and de-interleave stereo soundfile to 2x mono buffers
         static void
         requestReadStereo(size_t idx0, size_t idx1, std::string path, float startSrc = 0, float startDst = 0,
-                          float dur = -1);
+                          float dur = -1, int jobId = -1);
 
         // write mono buf to mono soundfile
-        static void requestWriteMono(size_t idx, std::string path, float start = 0, float dur = -1);
+        static void requestWriteMono(size_t idx, std::string path, float start = 0, float dur = -1, int jobId = -1);
 
         // write and interleave two mono buffers to one stereo file
-        static void requestWriteStereo(size_t idx0, size_t idx1, std::string path, float start = 0, float dur = -1);
+        static void requestWriteStereo(size_t idx0, size_t idx1, std::string path, float start = 0, float dur = -1,
+                                       int jobId = -1);
+
+        // flush the written parts of a file-backed buffer to its file (no-op for other buffers)
+        static void requestSync(size_t idx, int jobId = -1);
 
     private:
         static void workLoop();
 
-        static void clearBuffer(BufDesc &buf, float start = 0, float dur = -1);
+        // report progress of the current job, at most once per progressPeriodMs
+        static void reportProgress(size_t framesDone, size_t framesTotal);
+        static void reportJob(int id, JobState state, float progress);
+
+        //-- each routine returns false on failure
+
+        static bool clearBuffer(BufDesc &buf, float start = 0, float dur = -1);
+
+        static bool syncBuffer(BufDesc &buf);
+
+        // read file channels chanSrc[i] into dst[i], for i in [0, numDst)
+        static bool readBuffer(const std::string &path, BufDesc *dst[], int chanSrc[], int numDst,
+                               float startSrc, float startDst, float dur) noexcept;
+
+        // write and interleave numSrc buffers to one 24-bit WAV file
+        static bool writeBuffer(const std::string &path, BufDesc *src[], int numSrc,
+                                float start, float dur) noexcept;
+
+        // I/O task functions, each processing one range of an IoJob
+        static void readTask(void *ctx, int taskIdx);
+        static void writeTask(void *ctx, int taskIdx);
+        static void taskProgress(IoJob &job, size_t frames);
 
-        static void readBufferMono(const std::string &path, BufDesc &buf,
+        static bool readBufferMono(const std::string &path, BufDesc &buf,
                                    float startSrc = 0, float startDst = 0, float dur = -1, int chanSrc = 0) noexcept;
 
-        static void readBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1,
+        static bool readBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1,
                                      float startSrc = 0, float startDst = 0, float dur = -1) noexcept;
 
-        static void writeBufferMono(const std::string &path, BufDesc &buf,
+        static bool writeBufferMono(const std::string &path, BufDesc &buf,
                                     float start = 0, float dur = -1) noexcept;
 
-        static void writeBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1,
+        static bool writeBufferStereo(const std::string &path, BufDesc &buf0, BufDesc &buf1,
                                       float start = 0, float dur = -1) noexcept;
 
     };
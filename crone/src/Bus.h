@@ -6,23 +6,75 @@
 #define CRONE_BUS_H
 
 #include <boost/assert.hpp>
+#include "Simd.h"
 #include "Utilities.h"
 
 namespace  crone {
 
+    template<size_t NumChannels, size_t BlockSize>
+    class Bus;
+
+    // non-owning view of N channels of audio.
+    // can wrap a Bus, a JACK port buffer array, or any other array of channel pointers,
+    // so that all of them can be mixed without copying or building temporary pointer arrays.
+    // holds only the channel pointers; the frame count is supplied by each operation.
+    template<size_t NumChannels, typename Sample = float>
+    class BusView {
+    private:
+        Sample *ch[NumChannels];
+    public:
+        // from pointer array (e.g. JACK port buffers, faust I/O)
+        BusView(Sample *const src[NumChannels]) {
+            for (size_t i = 0; i < NumChannels; ++i) { ch[i] = src[i]; }
+        }
+
+        // from owning bus
+        template<size_t BlockSize>
+        BusView(Bus<NumChannels, BlockSize> &b) {
+            for (size_t i = 0; i < NumChannels; ++i) { ch[i] = b.buf[i]; }
+        }
+
+        // from const owning bus (read-only views only)
+        template<size_t BlockSize>
+        BusView(const Bus<NumChannels, BlockSize> &b) {
+            for (size_t i = 0; i < NumChannels; ++i) { ch[i] = b.buf[i]; }
+        }
+
+        // from mutable view (read-only views only)
+        template<typename S>
+        BusView(const BusView<NumChannels, S> &v) {
+            for (size_t i = 0; i < NumChannels; ++i) { ch[i] = v[i]; }
+        }
+
+        Sample *operator[](size_t i) const { return ch[i]; }
+
+        // pointer array, for APIs that want one (e.g. faust compute())
+        Sample *const *data() const { return ch; }
+        Sample **data() { return ch; }
+    };
+
+    template<size_t NumChannels>
+    using ConstBusView = BusView<NumChannels, const float>;
+
+    // multichannel audio bus.
+    // methods taking a LogRamp compute the whole block of gains in one vector pass,
+    // and fall back to constant-gain kernels once the ramp has settled.
     template<size_t NumChannels, size_t BlockSize>
     class Bus {
     private:
         typedef Bus<NumChannels, BlockSize> BusT;
+        typedef BusView<NumChannels> View;
+        typedef ConstBusView<NumChannels> Src;
     public:
-        float buf[NumChannels][BlockSize];
+        alignas(32) float buf[NumChannels][BlockSize];
+
+        View view() { return View(*this); }
+        Src view() const { return Src(*this); }
 
         // clear the entire bus
          void clear() {
             for(size_t ch=0; ch<NumChannels; ++ch) {
-                for(size_t fr=0; fr<BlockSize; ++fr) {
-                    buf[ch][fr] = 0.f;
-                }
+                simd::clear(buf[ch], BlockSize);
             }
         }
 
@@ -30,197 +82,216 @@ namespace  crone {
          void clear(size_t numFrames) {
             BOOST_ASSERT(numFrames < BlockSize);
             for(size_t ch=0; ch<NumChannels; ++ch) {
-                for(size_t fr=0; fr<numFrames; ++fr) {
-                    buf[ch][fr] = 0.f;
-                }
+                simd::clear(buf[ch], numFrames);
             }
         }
 
         // copy from bus, with no scaling (overwrites previous contents)
-        void copyFrom(Bus &b, size_t numFrames) {
+        void copyFrom(Src b, size_t numFrames) {
             BOOST_ASSERT(numFrames < BlockSize);
             for(size_t ch=0; ch<NumChannels; ++ch) {
-                for(size_t fr=0; fr<numFrames; ++fr) {
-                    buf[ch][fr] = b.buf[ch][fr];
-                }
+                simd::copy(buf[ch], b[ch], numFrames);
             }
          }
 
-        // copy from bus to pointer array, with no scaling (overwrites previous contents)
-        void copyTo(float *dst[NumChannels], size_t numFrames) {
+        // copy to bus or pointer array, with no scaling (overwrites previous contents)
+        void copyTo(View dst, size_t numFrames) {
             BOOST_ASSERT(numFrames < BlockSize);
             for(size_t ch=0; ch<NumChannels; ++ch) {
-                for(size_t fr=0; fr<numFrames; ++fr) {
-                    dst[ch][fr] = buf[ch][fr];
-                }
+                simd::copy(dst[ch], buf[ch], numFrames);
             }
         }
 
 
         // sum from bus, without amplitude scaling
-         void addFrom(BusT &b, size_t numFrames) {
+         void addFrom(Src b, size_t numFrames) {
             BOOST_ASSERT(numFrames < BlockSize);
             for(size_t ch=0; ch<NumChannels; ++ch) {
-                for(size_t fr=0; fr<numFrames; ++fr) {
-                    buf[ch][fr] += b.buf[ch][fr];
-                }
+                simd::add(buf[ch], b[ch], numFrames);
             }
         }
 
         // mix from bus, with fixed amplitude
-         void mixFrom(BusT &b, size_t numFrames, float level) {
+         void mixFrom(Src b, size_t numFrames, float level) {
             BOOST_ASSERT(numFrames < BlockSize);
             for(size_t ch=0; ch<NumChannels; ++ch) {
-                for(size_t fr=0; fr<numFrames; ++fr) {
-                    buf[ch][fr] += b.buf[ch][fr] * level;
-                }
+                simd::mix(buf[ch], b[ch], level, numFrames);
             }
         }
 
 
-        // mix from bus, with smoothed amplitude
-        void mixFrom(BusT &b, size_t numFrames, LogRamp &level) {
+        // mix from bus or pointer array, with smoothed amplitude
+        void mixFrom(Src b, size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
-            float l;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                l = level.update();
-                for(size_t ch=0; ch<NumChannels; ++ch) {
-                    buf[ch][fr] += b.buf[ch][fr] * l;
-                }
+            if (level.isSettled()) {
+                mixFrom(b, numFrames, level.getValue());
+                return;
+            }
+            float l[BlockSize];
+            level.updateBlock(l, numFrames);
+            for(size_t ch=0; ch<NumChannels; ++ch) {
+                simd::mix(buf[ch], b[ch], l, numFrames);
             }
         }
 
         // apply smoothed amplitude
         void applyGain(size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
-            float l;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                l = level.update();
+            if (level.isSettled()) {
+                const float l = level.getValue();
                 for(size_t ch=0; ch<NumChannels; ++ch) {
-                    buf[ch][fr] *= l;
+                    simd::scale(buf[ch], l, numFrames);
                 }
+                return;
+            }
+            float l[BlockSize];
+            level.updateBlock(l, numFrames);
+            for(size_t ch=0; ch<NumChannels; ++ch) {
+                simd::scale(buf[ch], l, numFrames);
             }
          }
 
-        // mix from pointer array, with smoothed amplitude
-        void mixFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
+        // set from bus or pointer array, with smoothed amplitude
+        void setFrom(Src src, size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
-            float l;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                l = level.update();
+            if (level.isSettled()) {
+                const float l = level.getValue();
                 for(size_t ch=0; ch<NumChannels; ++ch) {
-                    buf[ch][fr] += src[ch][fr] * l;
+                    simd::copyScaled(buf[ch], src[ch], l, numFrames);
                 }
+                return;
             }
-        }
-
-        // set from pointer array, with smoothed amplitude
-        void setFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
-            BOOST_ASSERT(numFrames < BlockSize);
-            float l;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                l = level.update();
-                for(size_t ch=0; ch<NumChannels; ++ch) {
-                    buf[ch][fr] = src[ch][fr] * l;
-                }
+            float l[BlockSize];
+            level.updateBlock(l, numFrames);
+            for(size_t ch=0; ch<NumChannels; ++ch) {
+                simd::copyScaled(buf[ch], src[ch], l, numFrames);
             }
         }
 
-        // set from pointer array, without scaling
-        void setFrom(const float *src[NumChannels], size_t numFrames) {
+        // set from bus or pointer array, without scaling
+        void setFrom(Src src, size_t numFrames) {
             BOOST_ASSERT(numFrames < BlockSize);
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                for(size_t ch=0; ch<NumChannels; ++ch) {
-                    buf[ch][fr] = src[ch][fr];
-                }
+            for(size_t ch=0; ch<NumChannels; ++ch) {
+                simd::copy(buf[ch], src[ch], numFrames);
             }
         }
 
-        // mix to pointer array, with smoothed amplitude
-        void mixTo(float *dst[NumChannels], size_t numFrames, LogRamp &level) {
+        // mix to bus or pointer array, with smoothed amplitude
+        void mixTo(View dst, size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
-            float l;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                l = level.update();
+            if (level.isSettled()) {
+                const float l = level.getValue();
                 for(size_t ch=0; ch<NumChannels; ++ch) {
-                    dst[ch][fr] = buf[ch][fr] * l;
+                    simd::copyScaled(dst[ch], buf[ch], l, numFrames);
                 }
+                return;
+            }
+            float l[BlockSize];
+            level.updateBlock(l, numFrames);
+            for(size_t ch=0; ch<NumChannels; ++ch) {
+                simd::copyScaled(dst[ch], buf[ch], l, numFrames);
             }
         }
 
         // mix from stereo bus with 2x2 level matrix
-        void stereoMixFrom(BusT &b, size_t numFrames, const float level[4]) {
+        void stereoMixFrom(Src b, size_t numFrames, const float level[4]) {
             BOOST_ASSERT(numFrames < BlockSize);
-            for (size_t fr = 0; fr < numFrames; ++fr) {
-                buf[0][fr] += b.buf[0][fr] * level[0] + b.buf[1][fr] * level[2];
-                buf[1][fr] += b.buf[0][fr] * level[1] + b.buf[1][fr] * level[3];
-            }
+            simd::mixAdd2(buf[0], b[0], level[0], b[1], level[2], numFrames);
+            simd::mixAdd2(buf[1], b[0], level[1], b[1], level[3], numFrames);
         }
 
         // mix from two busses with balance coefficient (linear)
-        void xfade(BusT &a, BusT &b, size_t numFrames, LogRamp &level) {
+        void xfade(Src a, Src b, size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
-            float x, y, c;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                c = level.update();
+            if (level.isSettled()) {
+                const float c = level.getValue();
                 for(size_t ch=0; ch<NumChannels; ++ch) {
-                    x = a.buf[ch][fr];
-                    y = b.buf[ch][fr];
-                    buf[ch][fr] = x + (y-x) * c;
+                    simd::xfade(buf[ch], a[ch], b[ch], c, numFrames);
                 }
+                return;
+            }
+            float c[BlockSize];
+            level.updateBlock(c, numFrames);
+            for(size_t ch=0; ch<NumChannels; ++ch) {
+                simd::xfade(buf[ch], a[ch], b[ch], c, numFrames);
             }
         }
 
         // mix from two busses with balance coefficient (equal power)
-        void xfadeEp(BusT &a, BusT &b, size_t numFrames, LogRamp &level) {
+        void xfadeEp(Src a, Src b, size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
-            float x, y, l, c, d;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                l = level.update() * (float)M_PI_2;
-                c = sinf(l);
-                d = cosf(l);
+            if (level.isSettled()) {
+                const float l = level.getValue() * (float)M_PI_2;
+                const float c = sinf(l);
+                const float d = cosf(l);
                 for(size_t ch=0; ch<NumChannels; ++ch) {
-                    x = a.buf[ch][fr];
-                    y = b.buf[ch][fr];
-                    buf[ch][fr] = x * c + y * d;
+                    simd::mix2(buf[ch], a[ch], c, b[ch], d, numFrames);
                 }
+                return;
+            }
+            float l[BlockSize];
+            float c[BlockSize];
+            float d[BlockSize];
+            level.updateBlock(l, numFrames);
+            simd::equalPower(d, c, l, numFrames);
+            for(size_t ch=0; ch<NumChannels; ++ch) {
+                simd::copyScaled(buf[ch], a[ch], c, numFrames);
+                simd::mix(buf[ch], b[ch], d, numFrames);
             }
         }
 
         // mix from mono->stereo bus, with level and pan (linear)
-        void panMixFrom(Bus<1, BlockSize> a, size_t numFrames, LogRamp &level, LogRamp& pan) {
+        void panMixFrom(ConstBusView<1> a, size_t numFrames, LogRamp &level, LogRamp& pan) {
             BOOST_ASSERT(numFrames < BlockSize);
             static_assert(NumChannels > 1, "using panMixFrom() on mono bus");
-            float l, c, x;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                x = a.buf[0][fr];
-                l = level.update();
-                c = pan.update();
-                buf[0][fr] += x*l*(1.f-c);
-                buf[1][fr] += x*l*c;
+            if (level.isSettled() && pan.isSettled()) {
+                const float l = level.getValue();
+                const float c = pan.getValue();
+                simd::mix(buf[0], a[0], l * (1.f - c), numFrames);
+                simd::mix(buf[1], a[0], l * c, numFrames);
+                return;
             }
+            float l[BlockSize];
+            float c[BlockSize];
+            float g[BlockSize];
+            level.updateBlock(l, numFrames);
+            pan.updateBlock(c, numFrames);
+            // right gain
+            simd::copyScaled(g, l, c, numFrames);
+            simd::mix(buf[1], a[0], g, numFrames);
+            // left gain = l * (1-c)
+            simd::sub(g, l, g, numFrames);
+            simd::mix(buf[0], a[0], g, numFrames);
         }
 
 
         // mix from mono->stereo bus, with level and pan (equal power)
-        void panMixEpFrom(Bus<1, BlockSize> a, size_t numFrames, LogRamp &level, LogRamp& pan) {
+        void panMixEpFrom(ConstBusView<1> a, size_t numFrames, LogRamp &level, LogRamp& pan) {
             BOOST_ASSERT(numFrames < BlockSize);
             static_assert(NumChannels > 1, "using panMixFrom() on mono bus");
-            float l, c, x;
-            for(size_t fr=0; fr<numFrames; ++fr) {
-                x = a.buf[0][fr];
-                l = level.update();
-                c = pan.update();
-                c *= (float)M_PI_2;
-                buf[0][fr] += x*l * cosf(c);
-                buf[1][fr] += x*l * sinf(c);
+            if (level.isSettled() && pan.isSettled()) {
+                const float l = level.getValue();
+                const float c = pan.getValue() * (float)M_PI_2;
+                simd::mix(buf[0], a[0], l * cosf(c), numFrames);
+                simd::mix(buf[1], a[0], l * sinf(c), numFrames);
+                return;
             }
+            float l[BlockSize];
+            float c[BlockSize];
+            float gl[BlockSize];
+            float gr[BlockSize];
+            level.updateBlock(l, numFrames);
+            pan.updateBlock(c, numFrames);
+            simd::equalPower(gl, gr, c, numFrames);
+            simd::scale(gl, l, numFrames);
+            simd::scale(gr, l, numFrames);
+            simd::mix(buf[0], a[0], gl, numFrames);
+            simd::mix(buf[1], a[0], gr, numFrames);
         }
 
 
     };
 
-
 }
 
 #endif //CRONE_BUS_H
@@ -3,7 +3,10 @@
 //
 
 
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <thread>
 
 #include "Commands.h"
 #include "MixerClient.h"
@@ -14,39 +17,176 @@ using namespace crone;
 Commands Commands::mixerCommands;
 Commands Commands::softcutCommands;
 
-Commands::Commands() = default;
+static inline uint64_t packValue(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static inline float unpackValue(uint64_t payload) {
+    auto bits = static_cast<uint32_t>(payload);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline uint64_t coalesceKey(Commands::Id id, int i0, int i1) {
+    return (static_cast<uint64_t>(id) << 40)
+           | (static_cast<uint64_t>(static_cast<uint32_t>(i0) & 0xfffff) << 20)
+           | (static_cast<uint64_t>(static_cast<uint32_t>(i1) & 0xfffff));
+}
+
+Commands::Commands() :
+        writeIdx(0), readIdx(0), barrierPos(0),
+        numPosted(0), numCoalesced(0), numApplied(0), numOverflows(0), numDropped(0),
+        maxLatencyNs(0), totalLatencyNs(0) {
+    for (auto &e : ring) {
+        e.payload.store(0);
+    }
+}
 
 void Commands::post(Commands::Id id, float f) {
-    CommandPacket p(id, -1, f);
-    q.push(p);
+    push(id, -1, -1, f);
 }
 
 void Commands::post(Commands::Id id, int i, float f) {
-    CommandPacket p(id, i, f);
-    q.push(p);
+    push(id, i, -1, f);
 }
 
 void Commands::post(Commands::Id id, int i, int j) {
-    CommandPacket p(id, i, j);
-    q.push(p);
+    push(id, i, j, 0.f);
 }
 
 void Commands::post(Commands::Id id, int i, int j, float f) {
-    CommandPacket p(id, i, j, f);
-    q.push(p);
+    push(id, i, j, f);
 }
 
+bool Commands::isCoalescible(Commands::Id id) {
+    switch (id) {
+        case SET_CUT_LOOP_START:
+        case SET_CUT_LOOP_END:
+            return true;
+        default:
+            return false;
+    }
+}
 
-void Commands::handlePending(MixerClient *client) {
-    CommandPacket p;
-    while (q.pop(p)) {
-        client->handleCommand(&p);
+uint64_t Commands::now() {
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+void Commands::push(Commands::Id id, int i0, int i1, float f) {
+    numPosted.fetch_add(1, std::memory_order_relaxed);
+    const bool coalesce = isCoalescible(id);
+    uint64_t w = writeIdx.load(std::memory_order_relaxed);
+    uint64_t key = 0;
+
+    if (coalesce) {
+        key = coalesceKey(id, i0, i1);
+        auto it = lastPos.find(key);
+        // the entry is still ours if nothing was pushed over it, and no barrier was posted since
+        if (it != lastPos.end() && it->second >= barrierPos && w - it->second < RingSize) {
+            Entry &e = ring[it->second & (RingSize - 1)];
+            uint64_t old = e.payload.load(std::memory_order_relaxed);
+            // fails once the consumer has taken the entry
+            while (old & LiveBit) {
+                if (e.payload.compare_exchange_weak(old, packValue(f) | LiveBit, std::memory_order_acq_rel)) {
+                    numCoalesced.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+    }
+
+    if (w - readIdx.load(std::memory_order_acquire) >= RingSize) {
+        // full; the audio thread drains the queue every period, so wait a little
+        numOverflows.fetch_add(1, std::memory_order_relaxed);
+        // (a copy: the chrono constructor takes a reference, which would odr-use the member)
+        const int pollUs = overflowPollUs;
+        int us = 0;
+        while (w - readIdx.load(std::memory_order_acquire) >= RingSize) {
+            if (us >= overflowTimeoutUs) {
+                numDropped.fetch_add(1, std::memory_order_relaxed);
+                std::cerr << "Commands: queue full, dropping command " << id << std::endl;
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(pollUs));
+            us += pollUs;
+        }
+    }
+
+    Entry &e = ring[w & (RingSize - 1)];
+    e.id = id;
+    e.idx_0 = i0;
+    e.idx_1 = i1;
+    e.postTime = now();
+    e.payload.store(packValue(f) | LiveBit, std::memory_order_relaxed);
+    writeIdx.store(w + 1, std::memory_order_release);
+
+    if (coalesce) {
+        lastPos[key] = w;
+    } else {
+        barrierPos = w + 1;
     }
 }
 
-void Commands::handlePending(SoftcutClient *client) {
-    CommandPacket p;
-    while (q.pop(p)) {
+template<class C>
+void Commands::drain(C *client) {
+    uint64_t r = readIdx.load(std::memory_order_relaxed);
+    const uint64_t w = writeIdx.load(std::memory_order_acquire);
+    if (r == w) { return; }
+    const uint64_t t = now();
+    uint64_t maxLatency = 0;
+    uint64_t totalLatency = 0;
+    for (; r != w; ++r) {
+        Entry &e = ring[r & (RingSize - 1)];
+        // take the latest value and stop the producer from changing it
+        const uint64_t payload = e.payload.exchange(0, std::memory_order_acq_rel);
+        CommandPacket p(e.id, e.idx_0, e.idx_1, unpackValue(payload));
         client->handleCommand(&p);
+        const uint64_t latency = t > e.postTime ? t - e.postTime : 0;
+        if (latency > maxLatency) { maxLatency = latency; }
+        totalLatency += latency;
     }
+    const uint64_t n = w - readIdx.load(std::memory_order_relaxed);
+    readIdx.store(w, std::memory_order_release);
+
+    numApplied.fetch_add(n, std::memory_order_relaxed);
+    totalLatencyNs.fetch_add(totalLatency, std::memory_order_relaxed);
+    if (maxLatency > maxLatencyNs.load(std::memory_order_relaxed)) {
+        maxLatencyNs.store(maxLatency, std::memory_order_relaxed);
+    }
+}
+
+void Commands::handlePending(MixerClient *client) {
+    drain(client);
+}
+
+void Commands::handlePending(SoftcutClient *client) {
+    drain(client);
+}
+
+Commands::Stats Commands::getStats() const {
+    Stats s{};
+    s.posted = numPosted.load();
+    s.coalesced = numCoalesced.load();
+    s.applied = numApplied.load();
+    s.overflows = numOverflows.load();
+    s.dropped = numDropped.load();
+    s.maxLatencyUs = static_cast<float>(maxLatencyNs.load()) * 1e-3f;
+    s.meanLatencyUs = s.applied > 0
+                      ? static_cast<float>(totalLatencyNs.load()) * 1e-3f / static_cast<float>(s.applied)
+                      : 0.f;
+    return s;
+}
+
+void Commands::resetStats() {
+    numPosted.store(0);
+    numCoalesced.store(0);
+    numApplied.store(0);
+    numOverflows.store(0);
+    numDropped.store(0);
+    maxLatencyNs.store(0);
+    totalLatencyNs.store(0);
 }
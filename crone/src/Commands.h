@@ -2,10 +2,27 @@
 // Created by ezra on 11/3/18.
 //
 
+/*
+ * Commands: queue of parameter changes from the OSC thread to an audio thread.
+ *
+ * single producer, single consumer, lock-free.
+ *
+ * this carries discrete events; continuous parameters live in each client's ParamStore.
+ *
+ * loop points are coalesced: if a packet for the same (id, idx_0, idx_1) is still waiting in the queue,
+ * a new post just replaces its value (last writer wins).
+ *
+ * other commands (flags, positions, buffer assignment, sync, reset) are never coalesced,
+ * and act as barriers: a loop point posted after one of them is never applied before it.
+ */
+
 #ifndef CRONE_COMMANDS_H
 #define CRONE_COMMANDS_H
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
 
 
 namespace crone {
@@ -15,83 +32,26 @@ namespace crone {
 
     class Commands {
     public:
+        // continuous parameters (levels, pans, rates, filters...) don't go through here;
+        // they are set on each client's parameter store.
         typedef enum {
-            //-- level commands
-            SET_LEVEL_ADC,
-            SET_LEVEL_DAC,
-            SET_LEVEL_EXT,
-            SET_LEVEL_EXT_AUX,
-	        SET_LEVEL_CUT_MASTER,
-            SET_LEVEL_AUX_DAC,
-            SET_LEVEL_MONITOR,
-            SET_LEVEL_MONITOR_MIX,
-            SET_LEVEL_MONITOR_AUX,
-            SET_LEVEL_INS_MIX,
-
-            SET_PARAM_REVERB,
-            SET_PARAM_COMPRESSOR,
-
+            //-- mixer commands
             SET_ENABLED_REVERB,
             SET_ENABLED_COMPRESSOR,
-
-            // level of stereo ext out -> stereo cut in
-            SET_LEVEL_EXT_CUT,
-            // level of stereo ADC out -> stereo cut in
-            SET_LEVEL_ADC_CUT,
+            SET_ENABLED_EQ,
+            SET_INSERT_SLOT,
 
             //-- softcut commands
-
-            // mix
             SET_ENABLED_CUT,
-            SET_LEVEL_CUT,
-            SET_PAN_CUT,
-            SET_LEVEL_CUT_AUX,
-            // level of individual input channel -> cut voice
-            // (separate commands just to avoid a 3rd parameter)
-            SET_LEVEL_IN_CUT,
-            SET_LEVEL_CUT_CUT,
-            SET_LEVEL_TAPE,
-            SET_LEVEL_TAPE_AUX,
-            SET_LEVEL_TAPE_CUT,
-
-            // params
             SET_CUT_REC_FLAG,
             SET_CUT_PLAY_FLAG,
-
-            SET_CUT_RATE,
             SET_CUT_LOOP_START,
             SET_CUT_LOOP_END,
             SET_CUT_LOOP_FLAG,
             SET_CUT_POSITION,
-
-            SET_CUT_FADE_TIME,
-            SET_CUT_REC_LEVEL,
-            SET_CUT_PRE_LEVEL,
-            SET_CUT_REC_OFFSET,
-
-            SET_CUT_PRE_FILTER_FC,
-            SET_CUT_PRE_FILTER_FC_MOD,
-            SET_CUT_PRE_FILTER_RQ,
-            SET_CUT_PRE_FILTER_LP,
-            SET_CUT_PRE_FILTER_HP,
-            SET_CUT_PRE_FILTER_BP,
-            SET_CUT_PRE_FILTER_BR,
-            SET_CUT_PRE_FILTER_DRY,
-
-	        SET_CUT_POST_FILTER_FC,
-	        SET_CUT_POST_FILTER_RQ,
-            SET_CUT_POST_FILTER_LP,
-            SET_CUT_POST_FILTER_HP,
-            SET_CUT_POST_FILTER_BP,
-            SET_CUT_POST_FILTER_BR,
-            SET_CUT_POST_FILTER_DRY,
-
-            SET_CUT_LEVEL_SLEW_TIME,
-            SET_CUT_PAN_SLEW_TIME,
-            SET_CUT_RECPRE_SLEW_TIME,
-            SET_CUT_RATE_SLEW_TIME,
             SET_CUT_VOICE_SYNC,
             SET_CUT_BUFFER,
+            RESET_CUT,
             NUM_COMMANDS,
         } Id;
 
@@ -117,12 +77,74 @@ namespace crone {
             float value;
         };
 
+        struct Stats {
+            // packets posted
+            uint64_t posted;
+            // posts merged into a packet that was already queued
+            uint64_t coalesced;
+            // packets applied by the audio thread
+            uint64_t applied;
+            // posts that found the queue full and had to wait
+            uint64_t overflows;
+            // posts discarded after waiting too long for space
+            uint64_t dropped;
+            // time from (first) post to application, in microseconds
+            float maxLatencyUs;
+            float meanLatencyUs;
+        };
+
+        Stats getStats() const;
+        void resetStats();
+
+        // whether repeated posts of the command may be coalesced
+        static bool isCoalescible(Id id);
+
         static Commands mixerCommands;
         static Commands softcutCommands;
 
     private:
-        boost::lockfree::spsc_queue <CommandPacket,
-                boost::lockfree::capacity<200> > q;
+        void push(Id id, int i0, int i1, float f);
+        template<class C>
+        void drain(C *client);
+
+        static uint64_t now();
+
+        static constexpr size_t RingSize = 1024;
+        static constexpr uint64_t LiveBit = 1ull << 32;
+        // producer waits this long for space before dropping a packet.
+        // it holds the OSC dispatch lock meanwhile, so this is kept to a couple of audio periods
+        static constexpr int overflowTimeoutUs = 6000;
+        static constexpr int overflowPollUs = 100;
+
+        struct Entry {
+            Id id;
+            int idx_0;
+            int idx_1;
+            // time of first post, in ns
+            uint64_t postTime;
+            // float bits, with LiveBit set until consumed.
+            // the producer may CAS a new value into a live entry
+            std::atomic<uint64_t> payload;
+        };
+
+        Entry ring[RingSize];
+        alignas(64) std::atomic<uint64_t> writeIdx;
+        alignas(64) std::atomic<uint64_t> readIdx;
+
+        //-- producer-only state
+        // ring position of the latest queued packet for each coalescing key
+        std::unordered_map<uint64_t, uint64_t> lastPos;
+        // ring position following the latest discrete command
+        uint64_t barrierPos;
+
+        //-- counters
+        std::atomic<uint64_t> numPosted;
+        std::atomic<uint64_t> numCoalesced;
+        std::atomic<uint64_t> numApplied;
+        std::atomic<uint64_t> numOverflows;
+        std::atomic<uint64_t> numDropped;
+        std::atomic<uint64_t> maxLatencyNs;
+        std::atomic<uint64_t> totalLatencyNs;
     };
 
 }
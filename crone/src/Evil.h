@@ -74,10 +74,10 @@ public:
 
                 ofs << R"evil(", "f", [](lo_arg **argv, int argc) {
         if(argc<1) { return; }
-        Commands::post(Commands::Id::SET_PARAM_)evil";
-                ofs << upname;
+        mixerClient->set)evil";
+                ofs << name << "Param(";
                 boost::to_upper(lab);
-                ofs << ", "<< name << "Param::" << lab;
+                ofs << name << "Param::" << lab;
                 ofs << ", argv[0]->f);" << endl << "});" << endl << endl;
             }
             ofs.close();
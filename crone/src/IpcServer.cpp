@@ -0,0 +1,166 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "IpcServer.h"
+
+using namespace crone;
+
+crone_ipc_t *IpcServer::shm = nullptr;
+IpcServer::Dispatch IpcServer::dispatch = nullptr;
+std::unique_ptr<std::thread> IpcServer::th = nullptr;
+std::atomic<bool> IpcServer::shouldQuit(false);
+std::mutex IpcServer::pollMut;
+uint16_t IpcServer::directory[CRONE_IPC_MAX_METHODS];
+
+// futex words are shared with matron, so these can't use the private variants
+static void futexWait(uint32_t *word, uint32_t val) {
+    syscall(SYS_futex, word, FUTEX_WAIT, val, nullptr, nullptr, 0);
+}
+
+static void futexWake(uint32_t *word) {
+    __atomic_add_fetch(word, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+bool IpcServer::init() {
+    // a previous crone may have died without cleaning up
+    shm_unlink(CRONE_IPC_SHM_NAME);
+    int fd = shm_open(CRONE_IPC_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        std::cerr << "ipc: shm_open failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, sizeof(crone_ipc_t)) != 0) {
+        std::cerr << "ipc: ftruncate failed: " << strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(CRONE_IPC_SHM_NAME);
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(crone_ipc_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "ipc: mmap failed: " << strerror(errno) << std::endl;
+        shm_unlink(CRONE_IPC_SHM_NAME);
+        return false;
+    }
+    // fresh object, so already zeroed
+    shm = static_cast<crone_ipc_t *>(p);
+    shm->magic = CRONE_IPC_MAGIC;
+    shm->version = CRONE_IPC_VERSION;
+    return true;
+}
+
+void IpcServer::addMethod(unsigned int idx, const char *path, const char *types) {
+    if (shm == nullptr) { return; }
+    const size_t argc = strlen(types);
+    if (argc > CRONE_IPC_MAX_ARGS || strlen(path) >= CRONE_IPC_PATH_LEN) { return; }
+    if (strspn(types, "if") != argc) { return; }
+    // matron addresses methods by their position in the directory
+    if (shm->num_methods >= CRONE_IPC_MAX_METHODS) { return; }
+    crone_ipc_method_t &m = shm->methods[shm->num_methods];
+    strncpy(m.path, path, CRONE_IPC_PATH_LEN - 1);
+    strncpy(m.types, types, CRONE_IPC_TYPES_LEN - 1);
+    directory[shm->num_methods] = static_cast<uint16_t>(idx);
+    shm->num_methods++;
+}
+
+void IpcServer::start(Dispatch d, lo_address matronAddress) {
+    if (shm == nullptr || th != nullptr) { return; }
+    dispatch = d;
+    shouldQuit = false;
+    __atomic_store_n(&shm->alive, 1, __ATOMIC_RELEASE);
+    th = std::make_unique<std::thread>(&IpcServer::loop);
+    lo_send(matronAddress, "/crone/ipc/ready", "");
+}
+
+void IpcServer::deinit() {
+    if (shm == nullptr) { return; }
+    __atomic_store_n(&shm->alive, 0, __ATOMIC_RELEASE);
+    // wake matron's reader, so it notices
+    futexWake(&shm->poll_ring.futex);
+    if (th != nullptr) {
+        shouldQuit = true;
+        futexWake(&shm->cmd_ring.futex);
+        th->join();
+        th.reset();
+    }
+    std::lock_guard<std::mutex> lock(pollMut);
+    munmap(shm, sizeof(crone_ipc_t));
+    shm = nullptr;
+    shm_unlink(CRONE_IPC_SHM_NAME);
+}
+
+bool IpcServer::postPoll(crone_ipc_poll_kind_t kind, int idx, float value,
+                         const void *data, size_t size, double time) {
+    std::lock_guard<std::mutex> lock(pollMut);
+    if (shm == nullptr || !__atomic_load_n(&shm->client_attached, __ATOMIC_ACQUIRE)) { return false; }
+    if (size > CRONE_IPC_POLL_DATA) { return false; }
+    crone_ipc_ring_t &ring = shm->poll_ring;
+    const uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+    const uint64_t tail = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= CRONE_IPC_POLL_RING) { return false; }
+
+    crone_ipc_poll_t &p = shm->poll[head & (CRONE_IPC_POLL_RING - 1)];
+    p.kind = static_cast<uint16_t>(kind);
+    p.size = static_cast<uint16_t>(size);
+    p.idx = idx;
+    p.value = value;
+    p.time = time;
+    if (size > 0) { memcpy(p.data, data, size); }
+
+    __atomic_store_n(&ring.head, head + 1, __ATOMIC_RELEASE);
+    // pairs with the fence in the consumer between setting `sleeping` and re-reading `head`
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring.sleeping, __ATOMIC_RELAXED)) { futexWake(&ring.futex); }
+    return true;
+}
+
+void IpcServer::waitForCommands() {
+    crone_ipc_ring_t &ring = shm->cmd_ring;
+    const uint64_t tail = __atomic_load_n(&ring.tail, __ATOMIC_RELAXED);
+    const uint32_t val = __atomic_load_n(&ring.futex, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&ring.sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring.head, __ATOMIC_RELAXED) == tail && !shouldQuit) {
+        futexWait(&ring.futex, val);
+    }
+    __atomic_store_n(&ring.sleeping, 0, __ATOMIC_RELAXED);
+}
+
+void IpcServer::loop() {
+    crone_ipc_ring_t &ring = shm->cmd_ring;
+    lo_arg args[CRONE_IPC_MAX_ARGS];
+    lo_arg *argv[CRONE_IPC_MAX_ARGS];
+    for (int i = 0; i < CRONE_IPC_MAX_ARGS; ++i) { argv[i] = &args[i]; }
+
+    while (!shouldQuit) {
+        uint64_t tail = __atomic_load_n(&ring.tail, __ATOMIC_RELAXED);
+        const uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+        if (tail == head) {
+            waitForCommands();
+            continue;
+        }
+        for (; tail != head; ++tail) {
+            const crone_ipc_cmd_t &cmd = shm->cmd[tail & (CRONE_IPC_CMD_RING - 1)];
+            if (cmd.method >= shm->num_methods || cmd.argc > CRONE_IPC_MAX_ARGS) { continue; }
+            const char *types = shm->methods[cmd.method].types;
+            if (strlen(types) != cmd.argc) { continue; }
+            for (int i = 0; i < cmd.argc; ++i) {
+                if (types[i] == 'i') {
+                    args[i].i = cmd.argv[i].i;
+                } else {
+                    args[i].f = cmd.argv[i].f;
+                }
+            }
+            dispatch(directory[cmd.method], argv, cmd.argc);
+        }
+        __atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+    }
+}
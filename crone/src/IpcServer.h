@@ -0,0 +1,62 @@
+/*
+ * IpcServer: crone's end of the shared-memory transport to matron (see ipc/crone_ipc.h).
+ *
+ * crone owns the shared memory: it creates it at startup, publishes the directory of methods
+ * that can be called through it, and removes it at shutdown.
+ *
+ * a drain thread reads command records and dispatches them to the same handlers as the OSC methods,
+ * so they go through the same command queue / parameter path as their OSC versions.
+ *
+ * polls are posted from non-realtime threads (poll scheduler, softcut event sender);
+ * postPoll() returns false if matron isn't attached or the ring is full, and the caller then sends OSC.
+ */
+
+#ifndef CRONE_IPCSERVER_H
+#define CRONE_IPCSERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <lo/lo.h>
+
+#include "crone_ipc.h"
+
+namespace crone {
+
+    class IpcServer {
+    public:
+        // called with a method index, and arguments converted to liblo form
+        typedef void(*Dispatch)(unsigned int method, lo_arg **argv, int argc);
+
+        // create the shared memory. returns false (and crone stays on OSC only) on failure
+        static bool init();
+        // publish a method; ignored unless its arguments are all int / float
+        static void addMethod(unsigned int idx, const char *path, const char *types);
+        // start draining commands, and tell matron it can attach
+        static void start(Dispatch dispatch, lo_address matronAddress);
+        // stop draining, mark the shared memory dead and remove it
+        static void deinit();
+
+        static bool postPoll(crone_ipc_poll_kind_t kind, int idx, float value,
+                             const void *data, size_t size, double time);
+
+    private:
+        static void loop();
+        static void waitForCommands();
+
+        static crone_ipc_t *shm;
+        static Dispatch dispatch;
+        static std::unique_ptr<std::thread> th;
+        static std::atomic<bool> shouldQuit;
+        // the poll ring has one producer; serialize the threads posting to it
+        static std::mutex pollMut;
+        // method index for each directory entry
+        static uint16_t directory[CRONE_IPC_MAX_METHODS];
+    };
+
+}
+
+#endif //CRONE_IPCSERVER_H
@@ -0,0 +1,160 @@
+/*
+ * block-level peak / RMS metering.
+ *
+ * MeterBank holds N channels of meters, updated by the audio thread once per block,
+ * and read from any thread (e.g. a poll) through a seqlock:
+ * - the audio thread updates each channel's ballistics with update(), then publishes all of them at once.
+ *   publishing makes the sequence odd, stores the values, and makes it even again.
+ * - a reader copies the values, and retries if the sequence was odd or changed meanwhile.
+ * the writer never waits, and a reader always gets values from a single block.
+ *
+ * ballistics are computed per block: coefficients are derived from the sample rate and the actual block size,
+ * and recomputed when the block size changes.
+ * - peak: instant attack, exponential release
+ * - RMS: exponentially weighted mean square
+ */
+
+#ifndef CRONE_METER_H
+#define CRONE_METER_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "Simd.h"
+#include "Taper.h"
+#include "Utilities.h"
+
+namespace crone {
+
+    // ballistics for one channel; audio thread only.
+    // channels may be updated from different worker threads, so each gets its own cache line
+    class alignas(64) MeterChannel {
+    public:
+        MeterChannel() : peak(0.f), meanSq(0.f) {}
+
+        // block-rate coefficients for the given block size
+        struct Coeffs {
+            float peakFall;
+            float rmsPole;
+            void set(float sr, float releaseTime, float rmsTime, size_t numFrames) {
+                const float blockRate = sr / static_cast<float>(numFrames);
+                peakFall = tau2pole(releaseTime, blockRate);
+                // mean square settles to 1/e in rmsTime
+                rmsPole = tau2pole(rmsTime, blockRate, -1.f);
+            }
+        };
+
+        void update(const Coeffs &k, const float *src, size_t numFrames) {
+            float pk, sumSq;
+            simd::peakSumSq(src, numFrames, pk, sumSq);
+            apply(k, pk, sumSq / static_cast<float>(numFrames));
+        }
+
+        // a block of silence
+        void decay(const Coeffs &k) { apply(k, 0.f, 0.f); }
+
+        float getPeak() const { return peak; }
+        float getRms() const { return std::sqrt(meanSq); }
+
+    private:
+        void apply(const Coeffs &k, float pk, float ms) {
+            peak = pk >= peak ? pk : pk + (peak - pk) * k.peakFall;
+            meanSq = ms + (meanSq - ms) * k.rmsPole;
+            // avoid denormals in long silences
+            if (meanSq < 1e-12f) { meanSq = 0.f; }
+            if (peak < 1e-6f) { peak = 0.f; }
+        }
+
+        float peak;
+        float meanSq;
+    };
+
+    template<int N>
+    class MeterBank {
+    public:
+        static constexpr float DefaultReleaseTime = 0.3f;
+        static constexpr float DefaultRmsTime = 0.3f;
+
+        struct Snapshot {
+            float peak[N];
+            float rms[N];
+        };
+
+        MeterBank() : sampleRate(48000.f), releaseTime(DefaultReleaseTime), rmsTime(DefaultRmsTime),
+                      blockFrames(0), seq(0) {
+            for (int i = 0; i < N; ++i) {
+                outPeak[i].store(0.f, std::memory_order_relaxed);
+                outRms[i].store(0.f, std::memory_order_relaxed);
+            }
+        }
+
+        //-- from audio thread
+
+        void setSampleRate(float sr) {
+            sampleRate = sr;
+            blockFrames = 0;
+        }
+
+        // call once per block, before updating channels
+        void setBlockSize(size_t numFrames) {
+            if (numFrames != blockFrames && numFrames > 0) {
+                blockFrames = numFrames;
+                coeffs.set(sampleRate, releaseTime, rmsTime, numFrames);
+            }
+        }
+
+        void update(int ch, const float *src, size_t numFrames) {
+            chan[ch].update(coeffs, src, numFrames);
+        }
+
+        void decay(int ch) { chan[ch].decay(coeffs); }
+
+        // make this block's values visible to readers
+        void publish() {
+            const uint32_t s = seq.load(std::memory_order_relaxed);
+            seq.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (int i = 0; i < N; ++i) {
+                outPeak[i].store(chan[i].getPeak(), std::memory_order_relaxed);
+                outRms[i].store(chan[i].getRms(), std::memory_order_relaxed);
+            }
+            seq.store(s + 2, std::memory_order_release);
+        }
+
+        //-- from any thread
+
+        void read(Snapshot &snap) const {
+            while (true) {
+                const uint32_t s0 = seq.load(std::memory_order_acquire);
+                if (s0 & 1u) { continue; }
+                for (int i = 0; i < N; ++i) {
+                    snap.peak[i] = outPeak[i].load(std::memory_order_relaxed);
+                    snap.rms[i] = outRms[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq.load(std::memory_order_relaxed) == s0) { return; }
+            }
+        }
+
+        // position on the VU taper, in [0, 1]
+        static float getPos(float amp) { return Taper::Vu::getPos(amp); }
+
+    private:
+        float sampleRate;
+        float releaseTime;
+        float rmsTime;
+        size_t blockFrames;
+        MeterChannel::Coeffs coeffs{};
+        MeterChannel chan[N];
+        std::atomic<uint32_t> seq;
+        std::atomic<float> outPeak[N];
+        std::atomic<float> outRms[N];
+    };
+
+    template<int N> constexpr float MeterBank<N>::DefaultReleaseTime;
+    template<int N> constexpr float MeterBank<N>::DefaultRmsTime;
+}
+
+#endif //CRONE_METER_H
@@ -2,20 +2,75 @@
 // Created by emb on 11/28/18.
 //
 
+#include <iostream>
+#include <string>
+
 #include "MixerClient.h"
 #include "Commands.h"
 
 #include "effects/CompressorParams.h"
+#include "effects/EqParams.h"
 #include "effects/ReverbParams.h"
 
 #include "Tape.h"
 
 using namespace crone;
 
-MixerClient::MixerClient() : Client<6, 6>("crone") {}
+MixerClient::MixerClient() : Client<6, 6>("crone") {
+    // EQ ahead of the compressor
+    insertOrder[0] = InsertEq;
+    insertOrder[1] = InsertCompressor;
+    tapeSources[0] = &bus.dac_sink;
+    numTapeSources = 1;
+}
+
+bool MixerClient::openTapeStems(const char *path, int stems, bool split) {
+    static const char *stemNames[NumTapeStems] = {"dac", "adc", "cut", "ext", "aux"};
+    const StereoBus *stemBusses[NumTapeStems] = {
+            &bus.dac_sink, &bus.adc_source, &bus.cut_source, &bus.ext_source, &bus.aux_out
+    };
+    const StereoBus *sources[NumTapeStems];
+    std::string paths[NumTapeStems];
+    int n = 0;
+    for (int i = 0; i < NumTapeStems; ++i) {
+        if ((stems & (1 << i)) == 0) { continue; }
+        sources[n] = stemBusses[i];
+        paths[n] = stemNames[i];
+        n++;
+    }
+    if (n == 0) {
+        std::cerr << "MixerClient: no tape stems selected" << std::endl;
+        return false;
+    }
+
+    bool ok;
+    if (split) {
+        std::string base(path);
+        std::string ext(".wav");
+        const size_t dot = base.rfind('.');
+        const size_t slash = base.rfind('/');
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+            ext = base.substr(dot);
+            base.erase(dot);
+        }
+        for (int i = 0; i < n; ++i) {
+            paths[i] = base + "-" + paths[i] + ext;
+        }
+        ok = tape.writer.openFiles(paths, n, 2);
+    } else {
+        paths[0] = path;
+        ok = tape.writer.openFiles(paths, 1, 2 * n);
+    }
+    if (ok) {
+        for (int i = 0; i < n; ++i) { tapeSources[i] = sources[i]; }
+        numTapeSources = n;
+    }
+    return ok;
+}
 
 void MixerClient::process(jack_nframes_t numFrames) {
     Commands::mixerCommands.handlePending(this);
+    params.applyDirty([this](size_t idx, float value) { applyParam(idx, value); });
 
     // copy inputs
     bus.adc_source.setFrom(source[SourceAdc], numFrames, smoothLevels.adc);
@@ -40,9 +95,7 @@ void MixerClient::process(jack_nframes_t numFrames) {
     // process tape playback
     if (tape.isReading()) {
         bus.tape.clear();
-        // FIXME: another stupid pointer array.
-        float *dst[2] = {static_cast<float*>(bus.tape.buf[0]), static_cast<float*>(bus.tape.buf[1])};
-        tape.reader.process(dst, numFrames);
+        tape.reader.process(bus.tape.view().data(), numFrames);
         bus.tape.applyGain(numFrames, smoothLevels.tape);
         bus.ins_in.addFrom(bus.tape, numFrames);
     }
@@ -56,28 +109,56 @@ void MixerClient::process(jack_nframes_t numFrames) {
 
     // process tape record
     if (tape.isWriting()) {
-        const float *src[2] = {(const float *) bus.dac_sink.buf[0], (const float *) bus.dac_sink.buf[1]};
+        const float *src[2 * NumTapeStems];
+        for (int i = 0; i < numTapeSources; ++i) {
+            src[2 * i] = tapeSources[i]->buf[0];
+            src[2 * i + 1] = tapeSources[i]->buf[1];
+        }
         tape.writer.process(src, numFrames);
     }
 
-    // update peak meters
-    inPeak[0].update(bus.adc_source.buf[0], numFrames);
-    inPeak[1].update(bus.adc_source.buf[1], numFrames);
-    outPeak[0].update(sink[SinkId::SinkDac][0], numFrames);
-    outPeak[1].update(sink[SinkId::SinkDac][1] , numFrames);
+    updateMeters(numFrames);
+}
+
+void MixerClient::meterBus(int id, const StereoBus &b, size_t numFrames) {
+    meters.update(id, b.buf[0], numFrames);
+    meters.update(id + 1, b.buf[1], numFrames);
+}
+
+void MixerClient::updateMeters(size_t numFrames) {
+    meters.setBlockSize(numFrames);
+    meterBus(MeterIn, bus.adc_source, numFrames);
+    meters.update(MeterOut, sink[SinkId::SinkDac][0], numFrames);
+    meters.update(MeterOut + 1, sink[SinkId::SinkDac][1], numFrames);
+    meterBus(MeterExt, bus.ext_source, numFrames);
+    meterBus(MeterCut, bus.cut_source, numFrames);
+    // idle busses hold stale data; let their meters fall
+    if (enabled.reverb) {
+        meterBus(MeterAux, bus.aux_out, numFrames);
+    } else {
+        meters.decay(MeterAux);
+        meters.decay(MeterAux + 1);
+    }
+    if (tape.isReading()) {
+        meterBus(MeterTape, bus.tape, numFrames);
+    } else {
+        meters.decay(MeterTape);
+        meters.decay(MeterTape + 1);
+    }
+    meters.publish();
 }
 
 void MixerClient::setSampleRate(jack_nframes_t sr) {
     smoothLevels.setSampleRate(sr);
+    meters.setSampleRate(sr);
     comp.init(sr);
     reverb.init(sr);
+    eq.init(sr);
     setFxDefaults();
+    tape.setSampleRate(static_cast<int>(sr));
 }
 
 void MixerClient::processFx(size_t numFrames) {
-    // FIXME: current faust architecture needs stupid pointer arrays.
-    float* pin[2];
-    float* pout[2];
     if (!enabled.reverb) { // bypass aux
         bus.aux_out.clear(numFrames);
         bus.aux_out.addFrom(bus.aux_in, numFrames);
@@ -87,11 +168,9 @@ void MixerClient::processFx(size_t numFrames) {
         bus.aux_in.mixFrom(bus.cut_source, numFrames, smoothLevels.cut_aux);
         bus.aux_in.mixFrom(bus.ext_source, numFrames, smoothLevels.ext_aux);
         bus.aux_in.mixFrom(bus.tape, numFrames, smoothLevels.tape_aux);
-        pin[0] = bus.aux_in.buf[0];
-        pin[1] = bus.aux_in.buf[1];
-        pout[0] = bus.aux_out.buf[0];
-        pout[1] = bus.aux_out.buf[1];
-        reverb.processBlock(pin, pout, static_cast<int>(numFrames));
+        auto in = bus.aux_in.view();
+        auto out = bus.aux_out.view();
+        reverb.processBlock(in.data(), out.data(), static_cast<int>(numFrames));
         bus.ins_in.mixFrom(bus.aux_out, numFrames, smoothLevels.aux);
     }
 
@@ -100,85 +179,75 @@ void MixerClient::processFx(size_t numFrames) {
     bus.ins_in.addFrom(bus.cut_source, numFrames);
     bus.ins_in.addFrom(bus.ext_source, numFrames);
 
+    processInserts(numFrames);
+}
+
+void MixerClient::processInserts(size_t numFrames) {
+    // run enabled processors in slot order, ping-ponging between ins_out and ins_tmp
+    StereoBus *src = &bus.ins_in;
+    StereoBus *dst = &bus.ins_out;
+    for (auto id : insertOrder) {
+        if (id == InsertNone || !enabled.insert[id]) { continue; }
+        auto in = src->view();
+        auto out = dst->view();
+        switch (id) {
+            case InsertCompressor:
+                comp.processBlock(in.data(), out.data(), static_cast<int>(numFrames));
+                // compressor wet/dry
+                dst->xfade(*src, *dst, numFrames, smoothLevels.ins_mix);
+                break;
+            case InsertEq:
+                eq.processBlock(in.data(), out.data(), static_cast<int>(numFrames));
+                break;
+            default:
+                continue;
+        }
+        src = dst;
+        dst = (dst == &bus.ins_out) ? &bus.ins_tmp : &bus.ins_out;
+    }
     bus.dac_sink.clear(numFrames);
-    if(!enabled.comp) { // bypass_insert
-        bus.dac_sink.addFrom(bus.ins_in, numFrames);
+    bus.dac_sink.addFrom(*src, numFrames);
+}
+
+void MixerClient::applyParam(size_t idx, float value) {
+    if (idx >= EqParamOffset) {
+        eq.getUi().setParamValue(static_cast<int>(idx - EqParamOffset), value);
+    } else if (idx >= CompressorParamOffset) {
+        comp.getUi().setParamValue(static_cast<int>(idx - CompressorParamOffset), value);
+    } else if (idx >= ReverbParamOffset) {
+        reverb.getUi().setParamValue(static_cast<int>(idx - ReverbParamOffset), value);
+    } else if (idx >= MonitorMixParamOffset) {
+        staticLevels.monitor_mix[idx - MonitorMixParamOffset] = value;
     } else {
-        pin[0] = bus.ins_in.buf[0];
-        pin[1] = bus.ins_in.buf[1];
-        pout[0] = bus.ins_out.buf[0];
-        pout[1] = bus.ins_out.buf[1];
-        comp.processBlock(pin, pout, static_cast<int>(numFrames));
-        // apply insert wet/dry
-        bus.dac_sink.xfade(bus.ins_in, bus.ins_out, numFrames, smoothLevels.ins_mix);
+        smoothLevels.get(static_cast<SmoothLevelId>(idx)).setTarget(value);
     }
 }
 
 void MixerClient::handleCommand(Commands::CommandPacket *p) {
     switch(p->id) {
-        case Commands::Id::SET_LEVEL_ADC:
-            smoothLevels.adc.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_DAC:
-            smoothLevels.dac.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_EXT:
-            smoothLevels.ext.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_EXT_AUX:
-            smoothLevels.ext_aux.setTarget(p->value);
-            break;
-	case Commands::Id::SET_LEVEL_CUT_MASTER:
-            smoothLevels.cut.setTarget(p->value);
-            break;	
-        case Commands::Id::SET_LEVEL_AUX_DAC:
-            smoothLevels.aux.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_MONITOR:
-            smoothLevels.monitor.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_MONITOR_AUX:
-            smoothLevels.monitor_aux.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_INS_MIX:
-            smoothLevels.ins_mix.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_MONITOR_MIX:
-            if(p->idx_0 < 0 || p->idx_0 > 3) { return; }
-            staticLevels.monitor_mix[p->idx_0] = p->value;
-            break;
-        case Commands::Id::SET_LEVEL_TAPE:
-            smoothLevels.tape.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_TAPE_AUX:
-            smoothLevels.tape_aux.setTarget(p->value);
-            break;
-        case Commands::Id::SET_PARAM_REVERB:
-            reverb.getUi().setParamValue(p->idx_0, p->value);
-            break;
-        case Commands::Id::SET_PARAM_COMPRESSOR:
-            comp.getUi().setParamValue(p->idx_0, p->value);
-            break;
         case Commands::Id::SET_ENABLED_REVERB:
             enabled.reverb = p->value > 0.f;
             break;
         case Commands::Id::SET_ENABLED_COMPRESSOR:
-            enabled.comp = p->value > 0.f;
-            break;
-
-            //-- softcut routing
-        case Commands::Id::SET_LEVEL_ADC_CUT:
-            smoothLevels.adc_cut.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_EXT_CUT:
-            smoothLevels.ext_cut.setTarget(p->value);
+            enabled.insert[InsertCompressor] = p->value > 0.f;
             break;
-        case Commands::Id::SET_LEVEL_TAPE_CUT:
-            smoothLevels.tape_cut.setTarget(p->value);
+        case Commands::Id::SET_ENABLED_EQ:
+            enabled.insert[InsertEq] = p->value > 0.f;
             break;
-        case Commands::Id::SET_LEVEL_CUT_AUX:
-            smoothLevels.cut_aux.setTarget(p->value);
+        case Commands::Id::SET_INSERT_SLOT: {
+            // idx_0: slot; idx_1: processor, or -1 to empty the slot.
+            // a processor is in at most one slot, so moving it empties its old one
+            const int slot = p->idx_0;
+            const int id = p->idx_1;
+            if (slot < 0 || slot >= NumInserts || id < InsertNone || id >= NumInserts) { break; }
+            if (id != InsertNone) {
+                for (auto &s : insertOrder) {
+                    if (s == id) { s = InsertNone; }
+                }
+            }
+            insertOrder[slot] = static_cast<InsertId>(id);
             break;
+        }
         default:
             ;;
     }
@@ -195,6 +264,7 @@ MixerClient::BusList::BusList() {
     dac_sink.clear();
     ins_in.clear();
     ins_out.clear();
+    ins_tmp.clear();
     aux_in.clear();
     aux_out.clear();
     adc_monitor.clear();
@@ -238,6 +308,21 @@ void MixerClient::SmoothLevelList::setSampleRate(float sr) {
     ins_mix.setSampleRate(sr);
 }
 
+LogRamp &MixerClient::SmoothLevelList::get(SmoothLevelId id) {
+    // in SmoothLevelId order
+    static LogRamp SmoothLevelList::*const members[] = {
+            &SmoothLevelList::adc, &SmoothLevelList::dac, &SmoothLevelList::ext,
+            &SmoothLevelList::cut, &SmoothLevelList::monitor, &SmoothLevelList::tape,
+            &SmoothLevelList::adc_cut, &SmoothLevelList::ext_cut, &SmoothLevelList::tape_cut,
+            &SmoothLevelList::monitor_aux, &SmoothLevelList::cut_aux,
+            &SmoothLevelList::ext_aux, &SmoothLevelList::tape_aux,
+            &SmoothLevelList::aux, &SmoothLevelList::ins_mix
+    };
+    static_assert(sizeof(members) / sizeof(members[0]) == NumSmoothLevels,
+                  "SmoothLevelList::get() must cover every level");
+    return this->*members[id];
+}
+
 MixerClient::StaticLevelList::StaticLevelList() {
     for (auto &f : monitor_mix) {
         f = 0.5f;
@@ -245,8 +330,10 @@ MixerClient::StaticLevelList::StaticLevelList() {
 }
 
 MixerClient::EnabledList::EnabledList() {
-    comp = false;
     reverb = false;
+    for (auto &b : insert) {
+        b = false;
+    }
 }
 
 
@@ -262,4 +349,15 @@ void MixerClient::setFxDefaults() {
   reverb.getUi().setParamValue(ReverbParam::LOW_RT60, 4.7);
   reverb.getUi().setParamValue(ReverbParam::MID_RT60, 2.3);
   reverb.getUi().setParamValue(ReverbParam::HF_DAMP, 6666);
+  // EqSection.dsp defaults, except a flat tilt (the .dsp has -1/2)
+  eq.getUi().setParamValue(EQ_TILT_SLOPE, 0.0);
+  eq.getUi().setParamValue(EQ_TILT_FC, 100);
+  eq.getUi().setParamValue(EQ_TILT_BW, 5000);
+  eq.getUi().setParamValue(EQ_LF_GAIN, 0.0);
+  eq.getUi().setParamValue(EQ_LF_FC, 200);
+  eq.getUi().setParamValue(EQ_PEAK_GAIN, 0.0);
+  eq.getUi().setParamValue(EQ_PEAK_FREQ, 49);
+  eq.getUi().setParamValue(EQ_PEAK_Q, 40);
+  eq.getUi().setParamValue(EQ_HF_GAIN, 0.0);
+  eq.getUi().setParamValue(EQ_HF_FC, 8000);
 }
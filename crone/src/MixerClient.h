@@ -9,12 +9,15 @@
 
 #include "Bus.h"
 #include "Client.h"
+#include "ParamStore.h"
 #include "Tape.h"
+#include "Meter.h"
 #include "Utilities.h"
-#include "PeakMeter.h"
 
 #include "effects/StereoCompressor.h"
 #include "effects/ZitaReverb.h"
+#include "effects/EqSection.h"
+#include "effects/EqParams.h"
 
 
 namespace  crone {
@@ -26,23 +29,93 @@ namespace  crone {
         typedef enum { SinkDac=0, SinkCut=1, SinkExt=2 } SinkId;
         typedef Bus<2, MaxBufFrames> StereoBus;
 
+        // smoothed levels, set through the parameter store
+        typedef enum {
+            LevelAdc, LevelDac, LevelExt, LevelCut, LevelMonitor, LevelTape,
+            LevelAdcCut, LevelExtCut, LevelTapeCut,
+            LevelMonitorAux, LevelCutAux, LevelExtAux, LevelTapeAux,
+            LevelAux, LevelInsMix,
+            NumSmoothLevels
+        } SmoothLevelId;
+
+        enum { MaxFxParams = 16 };
+        // default length of the tape rings: time the disk may stall without losing audio
+        enum { DefaultTapeRingSeconds = 8 };
+
+        // busses tape can record, as stereo stems; the bit for each in a stem mask is (1 << id)
+        typedef enum {
+            TapeStemDac = 0, TapeStemAdc, TapeStemCut, TapeStemExt, TapeStemAux, NumTapeStems
+        } TapeStemId;
+        typedef Tape<2, 2 * NumTapeStems> MixerTape;
+
+        // processors that can go in the insert chain
+        typedef enum { InsertNone = -1, InsertCompressor = 0, InsertEq = 1, NumInserts } InsertId;
+
+        // metered stereo busses, two channels each
+        typedef enum {
+            MeterIn = 0, MeterOut = 2, MeterExt = 4, MeterCut = 6, MeterAux = 8, MeterTape = 10,
+            NumMeters = 12
+        } MeterId;
+        typedef MeterBank<NumMeters> Meters;
+
+    private:
+        // parameter store layout
+        enum {
+            MonitorMixParamOffset = NumSmoothLevels,
+            ReverbParamOffset = MonitorMixParamOffset + 4,
+            CompressorParamOffset = ReverbParamOffset + MaxFxParams,
+            EqParamOffset = CompressorParamOffset + MaxFxParams,
+            NumParams = EqParamOffset + MaxFxParams
+        };
+
     public:
         MixerClient();
-        /// FIXME: the "commands" structure shouldn't really be necessary.
-        /// should be able to refactor most/all parameters for atomic access.
-        // called from audio thread
+        // called from audio thread, for discrete events (fx enable flags, insert order)
         void handleCommand(Commands::CommandPacket *p) override;
+
+        // continuous parameters: called from the OSC thread, applied at the start of the next block
+        void setLevel(SmoothLevelId id, float value) {
+            params.set(id, value);
+        }
+
+        // 2x2 ADC monitor mix matrix
+        void setMonitorMix(int idx, float value) {
+            if (idx < 0 || idx > 3) { return; }
+            params.set(MonitorMixParamOffset + idx, value);
+        }
+
+        void setReverbParam(int idx, float value) {
+            if (idx < 0 || idx >= MaxFxParams) { return; }
+            params.set(ReverbParamOffset + idx, value);
+        }
+
+        void setCompressorParam(int idx, float value) {
+            if (idx < 0 || idx >= MaxFxParams) { return; }
+            params.set(CompressorParamOffset + idx, value);
+        }
+
+        void setEqParam(int idx, float value) {
+            if (idx < 0 || idx >= EQ_NUM_PARAMS) { return; }
+            params.set(EqParamOffset + idx, value);
+        }
+
     private:
         void process(jack_nframes_t numFrames) override;
         void setSampleRate(jack_nframes_t) override;
+        void applyParam(size_t idx, float value);
     private:
         void processFx(size_t numFrames);
+        void processInserts(size_t numFrames);
         void setFxDefaults();
     private:
         // processors
         StereoCompressor comp;
         ZitaReverb reverb;
-        Tape<2> tape;
+        EqSection eq;
+        MixerTape tape;
+        // busses being recorded, in channel order. only changed while tape isn't recording
+        const StereoBus *tapeSources[NumTapeStems];
+        int numTapeSources;
 
         // busses
         struct BusList {
@@ -57,6 +130,7 @@ namespace  crone {
             // fx I/O
             StereoBus ins_in;
             StereoBus ins_out;
+            StereoBus ins_tmp;
             StereoBus aux_in;
             StereoBus aux_out;
             // monitor mix
@@ -92,6 +166,7 @@ namespace  crone {
 
             SmoothLevelList();
             void setSampleRate(float sr);
+            LogRamp &get(SmoothLevelId id);
         };
 
         SmoothLevelList smoothLevels;
@@ -106,28 +181,41 @@ namespace  crone {
         // other state
         struct EnabledList {
             bool reverb;
-            bool comp;
+            bool insert[NumInserts];
             EnabledList();
         };
         EnabledList enabled;
 
+        // insert chain: processor in each slot, in signal order (InsertNone for an empty slot).
+        // disabled and empty slots are skipped entirely, so cost nothing
+        InsertId insertOrder[NumInserts];
 
-        PeakMeter inPeak[2];
-        PeakMeter outPeak[2];
+        ParamStore<NumParams> params;
 
-    public:
-        float getInputPeakPos(int ch) {
-            return inPeak[ch].getPos();
-        }
 
-        float getOutputPeakPos(int ch) {
-            return outPeak[ch].getPos();
+        Meters meters;
+
+        void updateMeters(size_t numFrames);
+        void meterBus(int id, const StereoBus &b, size_t numFrames);
+
+    public:
+        // consistent snapshot of all meters, from any thread
+        void readMeters(Meters::Snapshot &snap) const {
+            meters.read(snap);
         }
 
         void openTapeRecord(const char* path) {
-            tape.writer.open(path);
+            if (tape.writer.open(path)) {
+                tapeSources[0] = &bus.dac_sink;
+                numTapeSources = 1;
+            }
         }
 
+        // record several busses in one pass: `stems` is a mask of TapeStemIds.
+        // with `split`, each goes to its own stereo file, named from `path` with the stem name added
+        // (take.wav -> take-dac.wav, take-adc.wav ...), otherwise all go to one multichannel file at `path`
+        bool openTapeStems(const char *path, int stems, bool split);
+
         void startTapeRecord() {
             tape.writer.start();
         }
@@ -140,6 +228,11 @@ namespace  crone {
             tape.reader.open(path);
         }
 
+        // resampling quality for files at another sample rate; applies from the next open
+        void setTapePlaybackQuality(int quality) {
+            tape.reader.setQuality(static_cast<Resampler::Quality>(quality));
+        }
+
         void startTapePlayback() {
             tape.reader.start();
         }
@@ -148,6 +241,16 @@ namespace  crone {
             tape.reader.stop();
         }
 
+        // length of the tape record / playback rings; only while neither is running
+        bool setTapeRingFrames(size_t frames) {
+            return tape.setRingFrames(frames);
+        }
+
+        // called from the tape disk threads
+        void setTapeStatsCallback(const MixerTape::StatsCallback &cb) {
+            tape.setStatsCallback(cb);
+        }
+
     };
 }
 
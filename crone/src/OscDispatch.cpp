@@ -0,0 +1,111 @@
+#include <cstring>
+#include <iostream>
+
+#include "OscDispatch.h"
+
+using namespace crone;
+
+OscDispatch::OscDispatch() : entries{}, numEntries(0), heads{}, headHashes{}, numHeads(0),
+                             seed(0), slotBits(MinSlotBits), slots{} {}
+
+bool OscDispatch::add(const char *path, const char *types, Handler handler) {
+    if (numEntries >= MaxMethods) { return false; }
+    const int idx = numEntries++;
+    entries[idx] = {path, types, handler, -1};
+    // append to the chain for this path, if there is one
+    for (int h = 0; h < numHeads; ++h) {
+        if (strcmp(entries[heads[h]].path, path) == 0) {
+            int e = heads[h];
+            while (entries[e].next >= 0) { e = entries[e].next; }
+            entries[e].next = static_cast<int16_t>(idx);
+            return true;
+        }
+    }
+    heads[numHeads++] = static_cast<int16_t>(idx);
+    return true;
+}
+
+bool OscDispatch::tryBuild(uint32_t s, unsigned int bits) {
+    seed = s;
+    slotBits = bits;
+    memset(slots, 0, sizeof(slots));
+    for (int h = 0; h < numHeads; ++h) {
+        const uint32_t hash = oscPathHash(entries[heads[h]].path, seed);
+        const uint32_t slot = slotOf(hash);
+        if (slots[slot] != 0) { return false; }
+        slots[slot] = static_cast<uint16_t>(h + 1);
+        headHashes[h] = hash;
+    }
+    return true;
+}
+
+void OscDispatch::build() {
+    // with the table at least 4x the number of paths, a few seeds usually suffice
+    for (unsigned int bits = MinSlotBits; bits <= MaxSlotBits; ++bits) {
+        for (uint32_t s = 0; s < MaxSeeds; ++s) {
+            if (tryBuild(s * 0x61c88647u, bits)) { return; }
+        }
+    }
+    // can't happen with MaxMethods paths and the largest table, short of a broken hash
+    std::cerr << "OscDispatch: failed to build path table" << std::endl;
+}
+
+int OscDispatch::find(const char *path) const {
+    const uint32_t hash = oscPathHash(path, seed);
+    const int h = slots[slotOf(hash)] - 1;
+    if (h < 0 || headHashes[h] != hash) { return -1; }
+    const int e = heads[h];
+    return strcmp(entries[e].path, path) == 0 ? e : -1;
+}
+
+bool OscDispatch::coerce(const char *want, const char *got, lo_arg **argv, int argc,
+                         lo_arg *buf, lo_arg **out) {
+    if (argc > MaxArgs || static_cast<int>(strlen(want)) != argc) { return false; }
+    for (int i = 0; i < argc; ++i) {
+        const char w = want[i];
+        const char g = got[i];
+        out[i] = &buf[i];
+        double v;
+        switch (g) {
+            case 'i': v = argv[i]->i; break;
+            case 'h': v = static_cast<double>(argv[i]->h); break;
+            case 'f': v = argv[i]->f; break;
+            case 'd': v = argv[i]->d; break;
+            default:
+                // non-numeric arguments must match (strings and symbols share a representation)
+                if (w == g || (w == 's' && g == 'S') || (w == 'S' && g == 's')) {
+                    out[i] = argv[i];
+                    continue;
+                }
+                return false;
+        }
+        switch (w) {
+            case 'i': buf[i].i = static_cast<int32_t>(v); break;
+            case 'h': buf[i].h = static_cast<int64_t>(v); break;
+            case 'f': buf[i].f = static_cast<float>(v); break;
+            case 'd': buf[i].d = v; break;
+            default: return false;
+        }
+    }
+    return true;
+}
+
+bool OscDispatch::dispatch(const char *path, const char *types, lo_arg **argv, int argc) const {
+    const int first = find(path);
+    if (first < 0) { return false; }
+    for (int e = first; e >= 0; e = entries[e].next) {
+        if (strcmp(entries[e].types, types) == 0) {
+            entries[e].handler(argv, argc);
+            return true;
+        }
+    }
+    lo_arg buf[MaxArgs];
+    lo_arg *args[MaxArgs];
+    for (int e = first; e >= 0; e = entries[e].next) {
+        if (coerce(entries[e].types, types, argv, argc, buf, args)) {
+            entries[e].handler(args, argc);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,147 @@
+/*
+ * OscDispatch: path lookup and argument decoding for crone's OSC methods.
+ *
+ * liblo matches each incoming message by walking its whole method list, comparing path strings.
+ * instead, crone registers a single catch-all liblo method, and looks paths up here:
+ * a perfect hash over all method paths (the seed is chosen once, when the table is built,
+ * so that no two paths share a slot), then one string compare to reject unknown paths.
+ *
+ * typed handlers: OscArgs<...> generates, at compile time, both the OSC type tags for a handler's
+ * parameter types and the code that unpacks lo_arg values into them.
+ *
+ * numeric arguments are coerced (i / h / f / d) when the sender's types don't match exactly,
+ * as liblo does for methods registered with a typespec.
+ */
+
+#ifndef CRONE_OSCDISPATCH_H
+#define CRONE_OSCDISPATCH_H
+
+#include <cstdint>
+#include <utility>
+
+#include <lo/lo.h>
+
+namespace crone {
+
+    // FNV-1a, with the seed folded into the offset basis
+    constexpr uint32_t oscPathHash(const char *path, uint32_t seed = 0) {
+        uint32_t h = 2166136261u ^ seed;
+        while (*path != '\0') {
+            h ^= static_cast<uint8_t>(*path++);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    //--- compile-time argument decoding
+
+    template<typename T>
+    struct OscArg;
+
+    template<>
+    struct OscArg<int> {
+        static constexpr char tag = 'i';
+        static int get(const lo_arg *a) { return a->i; }
+    };
+
+    template<>
+    struct OscArg<float> {
+        static constexpr char tag = 'f';
+        static float get(const lo_arg *a) { return a->f; }
+    };
+
+    template<>
+    struct OscArg<const char *> {
+        static constexpr char tag = 's';
+        static const char *get(const lo_arg *a) { return &a->s; }
+    };
+
+    template<typename... Args>
+    struct OscArgs {
+        typedef void(*Fn)(Args...);
+        static constexpr char types[] = {OscArg<Args>::tag..., '\0'};
+
+        static void call(Fn fn, lo_arg **argv) {
+            call(fn, argv, std::index_sequence_for<Args...>());
+        }
+
+    private:
+        template<size_t... I>
+        static void call(Fn fn, lo_arg **argv, std::index_sequence<I...>) {
+            (void) argv;
+            fn(OscArg<Args>::get(argv[I])...);
+        }
+    };
+
+    template<typename... Args>
+    constexpr char OscArgs<Args...>::types[];
+
+    // OscArgs for the parameters of a captureless lambda
+    template<typename F>
+    struct OscLambdaArgs : OscLambdaArgs<decltype(&F::operator())> {};
+
+    template<typename C, typename... Args>
+    struct OscLambdaArgs<void (C::*)(Args...) const> : OscArgs<Args...> {};
+
+    // plain handler for a typed lambda; the dispatcher has already checked the argument count and types
+    template<typename F>
+    struct OscTypedHandler {
+        static typename OscLambdaArgs<F>::Fn fn;
+        static void call(lo_arg **argv, int argc) {
+            (void) argc;
+            OscLambdaArgs<F>::call(fn, argv);
+        }
+    };
+
+    template<typename F>
+    typename OscLambdaArgs<F>::Fn OscTypedHandler<F>::fn = nullptr;
+
+    //--- path table
+
+    class OscDispatch {
+    public:
+        typedef void(*Handler)(lo_arg **argv, int argc);
+        enum { MaxMethods = 256, MaxArgs = 8 };
+
+        OscDispatch();
+
+        // path and types must outlive the table; several methods may share a path, with different types.
+        // returns false if the table is full
+        bool add(const char *path, const char *types, Handler handler);
+        // choose a collision-free hash seed for the current set of paths. call after adding methods
+        void build();
+        // run the handler for a message. returns false if no method matches its path and types
+        bool dispatch(const char *path, const char *types, lo_arg **argv, int argc) const;
+
+    private:
+        enum { MinSlotBits = 9, MaxSlotBits = 14, MaxSeeds = 256 };
+
+        struct Entry {
+            const char *path;
+            const char *types;
+            Handler handler;
+            // next method with the same path, or -1
+            int16_t next;
+        };
+
+        int find(const char *path) const;
+        bool tryBuild(uint32_t seed, unsigned int bits);
+        uint32_t slotOf(uint32_t hash) const { return (hash * 0x9e3779b1u) >> (32 - slotBits); }
+        static bool coerce(const char *want, const char *got, lo_arg **argv, int argc, lo_arg *buf, lo_arg **out);
+
+        Entry entries[MaxMethods];
+        int numEntries;
+        // first entry for each distinct path
+        int16_t heads[MaxMethods];
+        uint32_t headHashes[MaxMethods];
+        int numHeads;
+
+        uint32_t seed;
+        unsigned int slotBits;
+        // head index + 1 for each slot, 0 if empty
+        uint16_t slots[1 << MaxSlotBits];
+    };
+
+}
+
+#endif //CRONE_OSCDISPATCH_H
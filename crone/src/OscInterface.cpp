@@ -9,10 +9,12 @@
 #include <boost/format.hpp>
 
 #include "effects/CompressorParams.h"
+#include "effects/EqParams.h"
 #include "effects/ReverbParams.h"
 
 #include "BufDiskWorker.h"
 #include "Commands.h"
+#include "IpcServer.h"
 #include "OscInterface.h"
 
 using namespace crone;
@@ -25,9 +27,11 @@ lo_address OscInterface::matronAddress;
 
 std::array<OscInterface::OscMethod, OscInterface::MaxNumMethods> OscInterface::methods;
 unsigned int OscInterface::numMethods = 0;
+std::mutex OscInterface::handlerMut;
+OscDispatch OscInterface::oscDispatch;
 
 std::unique_ptr<Poll> OscInterface::vuPoll;
-std::unique_ptr<Poll> OscInterface::phasePoll;
+std::unique_ptr<Poll> OscInterface::meterPoll;
 MixerClient *OscInterface::mixerClient;
 SoftcutClient *OscInterface::softCutClient;
 
@@ -47,6 +51,31 @@ void OscInterface::init(MixerClient *m, SoftcutClient *sc) {
 
     st = lo_server_thread_new(port.c_str(), handleLoError);
     addServerMethods();
+    oscDispatch.build();
+    // liblo would walk every method, comparing paths; instead, take everything here and look it up
+    lo_server_thread_add_method(st, nullptr, nullptr,
+                                [](const char *path,
+                                   const char *types,
+                                   lo_arg **argv,
+                                   int argc,
+                                   lo_message msg,
+                                   void *data)
+                                        -> int {
+                                    (void) msg;
+                                    (void) data;
+                                    //std::cerr << "osc rx: " << path << std::endl;
+                                    std::lock_guard<std::mutex> lock(handlerMut);
+                                    oscDispatch.dispatch(path, types, argv, argc);
+                                    return 0;
+                                }, nullptr);
+
+    //--- shared-memory command / poll transport for matron
+    bool ipc = IpcServer::init();
+    if (ipc) {
+        for (unsigned int i = 0; i < numMethods; ++i) {
+            IpcServer::addMethod(i, methods[i].path.c_str(), methods[i].format.c_str());
+        }
+    }
 
     mixerClient = m;
     softCutClient = sc;
@@ -54,61 +83,99 @@ void OscInterface::init(MixerClient *m, SoftcutClient *sc) {
     // FIXME: polls should really live somewhere else (client classes?)
     //--- VU poll
     vuPoll = std::make_unique<Poll>("vu");
-    vuPoll->setCallback([](const char *path) {
+    vuPoll->setCallback([](const char *path, lo_bundle bundle) {
         char l[4];
+        MixerClient::Meters::Snapshot m{};
+        mixerClient->readMeters(m);
 
-        l[0] = (uint8_t) (64 * mixerClient->getInputPeakPos(0));
-        l[1] = (uint8_t) (64 * mixerClient->getInputPeakPos(1));
-        l[2] = (uint8_t) (64 * mixerClient->getOutputPeakPos(0));
-        l[3] = (uint8_t) (64 * mixerClient->getOutputPeakPos(1));
+        l[0] = (uint8_t) (64 * MixerClient::Meters::getPos(m.peak[MixerClient::MeterIn]));
+        l[1] = (uint8_t) (64 * MixerClient::Meters::getPos(m.peak[MixerClient::MeterIn + 1]));
+        l[2] = (uint8_t) (64 * MixerClient::Meters::getPos(m.peak[MixerClient::MeterOut]));
+        l[3] = (uint8_t) (64 * MixerClient::Meters::getPos(m.peak[MixerClient::MeterOut + 1]));
 
-        lo_blob bl = lo_blob_new(sizeof(l), l);
-        lo_send(matronAddress, path, "b", bl);
+        if (!IpcServer::postPoll(CRONE_IPC_POLL_VU, 0, 0.f, l, sizeof(l), 0.0)) {
+            addBlobMessage(bundle, path, l, sizeof(l));
+        }
     });
     vuPoll->setPeriod(50);
 
-    //--- softcut phase poll
-    phasePoll = std::make_unique<Poll>("softcut/phase");
-    phasePoll->setCallback([](const char *path) {
+    //--- meters poll
+    // blob of (peak, rms) pairs, as VU taper positions in [0, 64]:
+    // in 1/2, out 1/2, ext 1/2, cut 1/2, aux 1/2, tape 1/2, then each softcut voice
+    meterPoll = std::make_unique<Poll>("meters");
+    meterPoll->setCallback([](const char *path, lo_bundle bundle) {
+        uint8_t l[2 * (MixerClient::NumMeters + SoftcutClient::MaxVoices)];
+        MixerClient::Meters::Snapshot m{};
+        MeterBank<SoftcutClient::MaxVoices>::Snapshot v{};
+        mixerClient->readMeters(m);
+        softCutClient->readMeters(v);
+        auto pos = [](float amp) { return (uint8_t) (64 * MixerClient::Meters::getPos(amp)); };
+        int n = 0;
+        for (int i = 0; i < MixerClient::NumMeters; ++i) {
+            l[n++] = pos(m.peak[i]);
+            l[n++] = pos(m.rms[i]);
+        }
         for (int i = 0; i < softCutClient->getNumVoices(); ++i) {
-            if (softCutClient->checkVoiceQuantPhase(i)) {
-                lo_send(matronAddress, path, "if", i, softCutClient->getQuantPhase(i));
-            }
+            l[n++] = pos(v.peak[i]);
+            l[n++] = pos(v.rms[i]);
         }
+        if (!IpcServer::postPoll(CRONE_IPC_POLL_METERS, 0, 0.f, l, n, 0.0)) {
+            addBlobMessage(bundle, path, l, n);
+        }
+    });
+    meterPoll->setPeriod(50);
+
+    PollScheduler::start(matronAddress);
+
+    //--- softcut phase and voice events, timestamped by the audio thread
+    softCutClient->startEvents(matronAddress);
+
+    //--- buffer job reports
+    // /softcut/buffer/job <id> <state> <progress>; state: 0 = progress, 1 = done, 2 = failed
+    BufDiskWorker::setJobCallback([](int id, BufDiskWorker::JobState state, float progress) {
+        lo_send(matronAddress, "/softcut/buffer/job", "iif", id, static_cast<int>(state), progress);
     });
-    phasePoll->setPeriod(1);
 
 
     //--- TODO: softcut trigger poll?
 
-    //--- TODO: tape poll?
+    //--- tape stats, from the tape disk threads
+    // /tape/stats <stream> <running> <seconds> <fill> <dropped>; stream: 0 = record, 1 = play
+    mixerClient->setTapeStatsCallback([](MixerClient::MixerTape::StreamId stream,
+                                         const MixerClient::MixerTape::Stats &stats) {
+        lo_send(matronAddress, "/tape/stats", "iiffi", static_cast<int>(stream), stats.running ? 1 : 0,
+                static_cast<float>(stats.seconds), stats.fill, static_cast<int>(stats.dropped));
+    });
 
     lo_server_thread_start(st);
+
+    // matron may already be running; otherwise it asks with /softcut/info once it starts
+    sendSoftcutInfo();
+
+    if (ipc) {
+        IpcServer::start(&dispatch, matronAddress);
+    }
 }
 
 
+void OscInterface::sendSoftcutInfo() {
+    lo_send(matronAddress, "/softcut/info", "ii", softCutClient->getNumVoices(),
+            static_cast<int>(softCutClient->getBufferFrames()));
+}
+
 void OscInterface::addServerMethod(const char *path, const char *format, Handler handler) {
     OscMethod m(path, format, handler);
     methods[numMethods] = m;
-    lo_server_thread_add_method(st, path, format,
-                                [](const char *path,
-                                   const char *types,
-                                   lo_arg **argv,
-                                   int argc,
-                                   lo_message msg,
-                                   void *data)
-                                        -> int {
-                                    (void) path;
-                                    (void) types;
-                                    (void) msg;
-                                    auto pm = static_cast<OscMethod *>(data);
-                                    //std::cerr << "osc rx: " << path << std::endl;
-                                    pm->handler(argv, argc);
-                                    return 0;
-                                }, &(methods[numMethods]));
+    oscDispatch.add(methods[numMethods].path.c_str(), methods[numMethods].format.c_str(), handler);
     numMethods++;
 }
 
+void OscInterface::dispatch(unsigned int idx, lo_arg **argv, int argc) {
+    if (idx >= numMethods) { return; }
+    std::lock_guard<std::mutex> lock(handlerMut);
+    methods[idx].handler(argv, argc);
+}
+
 
 void OscInterface::addServerMethods() {
     addServerMethod("/hello", "", [](lo_arg **argv, int argc) {
@@ -130,6 +197,23 @@ void OscInterface::addServerMethods() {
         OscInterface::quitFlag = true;
     });
 
+    // report command queue counters for each client, and reset them.
+    // reply: /crone/stats/commands <name> <posted> <coalesced> <applied> <overflows> <dropped> <max us> <mean us>
+    addServerMethod("/crone/stats/commands", "", [](lo_arg **argv, int argc) {
+        (void) argv;
+        (void) argc;
+        auto report = [](const char *name, Commands &cmds) {
+            auto st = cmds.getStats();
+            cmds.resetStats();
+            lo_send(matronAddress, "/crone/stats/commands", "siiiiiff", name,
+                    (int) st.posted, (int) st.coalesced, (int) st.applied,
+                    (int) st.overflows, (int) st.dropped,
+                    st.maxLatencyUs, st.meanLatencyUs);
+        };
+        report("mixer", Commands::mixerCommands);
+        report("softcut", Commands::softcutCommands);
+    });
+
 
     //---------------------------
     //--- mixer polls
@@ -146,194 +230,226 @@ void OscInterface::addServerMethods() {
         vuPoll->stop();
     });
 
+    addServerMethod("/poll/start/meters", "", [](lo_arg **argv, int argc) {
+        (void) argv;
+        (void) argc;
+        meterPoll->start();
+    });
+
+    addServerMethod("/poll/stop/meters", "", [](lo_arg **argv, int argc) {
+        (void) argv;
+        (void) argc;
+        meterPoll->stop();
+    });
+
 
     ////////////////////////////////
-    /// FIXME: many of these methods are trivial setters;
-    // they could simply be structured around atomic fields instead of requiring the Command queue.
-    // would require some refactoring e.g. to expose level ramp targets as atomics
+    // continuous parameters are written straight to the clients' parameter stores;
+    // the command queues carry only discrete events (flags, positions, buffer assignment).
 
     //--------------------------
     //--- levels
-    addServerMethod("/set/level/adc", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_ADC, argv[0]->f);
+    addServerMethod("/set/level/adc", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelAdc, value);
     });
 
-    addServerMethod("/set/level/dac", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_DAC, argv[0]->f);
+    addServerMethod("/set/level/dac", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelDac, value);
     });
 
-    addServerMethod("/set/level/ext", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_EXT, argv[0]->f);
+    addServerMethod("/set/level/ext", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelExt, value);
     });
 
-    addServerMethod("/set/level/cut_master", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_CUT_MASTER, argv[0]->f);
+    addServerMethod("/set/level/cut_master", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelCut, value);
     });
 
 
-    addServerMethod("/set/level/ext_rev", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_EXT_AUX, argv[0]->f);
+    addServerMethod("/set/level/ext_rev", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelExtAux, value);
     });
 
-    addServerMethod("/set/level/rev_dac", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_AUX_DAC, argv[0]->f);
+    addServerMethod("/set/level/rev_dac", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelAux, value);
     });
 
-    addServerMethod("/set/level/monitor", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_MONITOR, argv[0]->f);
+    addServerMethod("/set/level/monitor", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelMonitor, value);
     });
 
-    addServerMethod("/set/level/monitor_mix", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_MONITOR_MIX, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/level/monitor_mix", [](int idx, float value) {
+        mixerClient->setMonitorMix(idx, value);
     });
 
-    addServerMethod("/set/level/monitor_rev", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_MONITOR_AUX, argv[0]->f);
+    addServerMethod("/set/level/monitor_rev", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelMonitorAux, value);
     });
 
-    addServerMethod("/set/level/compressor_mix", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_INS_MIX, argv[0]->f);
+    addServerMethod("/set/level/compressor_mix", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelInsMix, value);
     });
 
 
     // toggle enabled
-    addServerMethod("/set/enabled/compressor", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_ENABLED_COMPRESSOR, argv[0]->f);
+    addServerMethod("/set/enabled/compressor", [](float value) {
+        Commands::mixerCommands.post(Commands::Id::SET_ENABLED_COMPRESSOR, value);
     });
 
-    addServerMethod("/set/enabled/reverb", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_ENABLED_REVERB, argv[0]->f);
+    addServerMethod("/set/enabled/reverb", [](float value) {
+        Commands::mixerCommands.post(Commands::Id::SET_ENABLED_REVERB, value);
+    });
+
+    addServerMethod("/set/enabled/eq", [](float value) {
+        Commands::mixerCommands.post(Commands::Id::SET_ENABLED_EQ, value);
+    });
+
+    // insert chain order: put a processor in a slot (0 = first), or empty the slot with -1.
+    // processors: 0 = compressor, 1 = EQ
+    addServerMethod("/set/insert/slot", [](int slot, int id) {
+        Commands::mixerCommands.post(Commands::Id::SET_INSERT_SLOT, slot, id);
     });
 
     //-------------------------
     //-- compressor params
 
-    addServerMethod("/set/param/compressor/ratio", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_COMPRESSOR, CompressorParam::RATIO, argv[0]->f);
+    addServerMethod("/set/param/compressor/ratio", [](float value) {
+        mixerClient->setCompressorParam(CompressorParam::RATIO, value);
     });
 
-    addServerMethod("/set/param/compressor/threshold", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_COMPRESSOR, CompressorParam::THRESHOLD, argv[0]->f);
+    addServerMethod("/set/param/compressor/threshold", [](float value) {
+        mixerClient->setCompressorParam(CompressorParam::THRESHOLD, value);
     });
 
-    addServerMethod("/set/param/compressor/attack", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_COMPRESSOR, CompressorParam::ATTACK, argv[0]->f);
+    addServerMethod("/set/param/compressor/attack", [](float value) {
+        mixerClient->setCompressorParam(CompressorParam::ATTACK, value);
     });
 
-    addServerMethod("/set/param/compressor/release", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_COMPRESSOR, CompressorParam::RELEASE, argv[0]->f);
+    addServerMethod("/set/param/compressor/release", [](float value) {
+        mixerClient->setCompressorParam(CompressorParam::RELEASE, value);
     });
 
-    addServerMethod("/set/param/compressor/gain_pre", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_COMPRESSOR, CompressorParam::GAIN_PRE, argv[0]->f);
+    addServerMethod("/set/param/compressor/gain_pre", [](float value) {
+        mixerClient->setCompressorParam(CompressorParam::GAIN_PRE, value);
     });
 
-    addServerMethod("/set/param/compressor/gain_post", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_COMPRESSOR, CompressorParam::GAIN_POST, argv[0]->f);
+    addServerMethod("/set/param/compressor/gain_post", [](float value) {
+        mixerClient->setCompressorParam(CompressorParam::GAIN_POST, value);
     });
 
 
     //--------------------------
     //-- reverb params
 
-    addServerMethod("/set/param/reverb/pre_del", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_REVERB, ReverbParam::PRE_DEL, argv[0]->f);
+    addServerMethod("/set/param/reverb/pre_del", [](float value) {
+        mixerClient->setReverbParam(ReverbParam::PRE_DEL, value);
     });
 
-    addServerMethod("/set/param/reverb/lf_fc", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_REVERB, ReverbParam::LF_FC, argv[0]->f);
+    addServerMethod("/set/param/reverb/lf_fc", [](float value) {
+        mixerClient->setReverbParam(ReverbParam::LF_FC, value);
     });
 
-    addServerMethod("/set/param/reverb/low_rt60", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_REVERB, ReverbParam::LOW_RT60, argv[0]->f);
+    addServerMethod("/set/param/reverb/low_rt60", [](float value) {
+        mixerClient->setReverbParam(ReverbParam::LOW_RT60, value);
     });
 
-    addServerMethod("/set/param/reverb/mid_rt60", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_REVERB, ReverbParam::MID_RT60, argv[0]->f);
+    addServerMethod("/set/param/reverb/mid_rt60", [](float value) {
+        mixerClient->setReverbParam(ReverbParam::MID_RT60, value);
     });
 
-    addServerMethod("/set/param/reverb/hf_damp", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_PARAM_REVERB, ReverbParam::HF_DAMP, argv[0]->f);
+    addServerMethod("/set/param/reverb/hf_damp", [](float value) {
+        mixerClient->setReverbParam(ReverbParam::HF_DAMP, value);
+    });
+
+    //--------------------------
+    //-- EQ params
+
+    addServerMethod("/set/param/eq/tilt_slope", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_TILT_SLOPE, value);
+    });
+
+    addServerMethod("/set/param/eq/tilt_fc", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_TILT_FC, value);
+    });
+
+    addServerMethod("/set/param/eq/tilt_bw", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_TILT_BW, value);
+    });
+
+    addServerMethod("/set/param/eq/lf_gain", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_LF_GAIN, value);
+    });
+
+    addServerMethod("/set/param/eq/lf_fc", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_LF_FC, value);
+    });
+
+    addServerMethod("/set/param/eq/peak_gain", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_PEAK_GAIN, value);
+    });
+
+    addServerMethod("/set/param/eq/peak_freq", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_PEAK_FREQ, value);
+    });
+
+    addServerMethod("/set/param/eq/peak_q", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_PEAK_Q, value);
+    });
+
+    addServerMethod("/set/param/eq/hf_gain", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_HF_GAIN, value);
+    });
+
+    addServerMethod("/set/param/eq/hf_fc", [](float value) {
+        mixerClient->setEqParam(EqParam::EQ_HF_FC, value);
     });
 
 
     //--------------------------------
     //-- softcut routing
 
-    addServerMethod("/set/enabled/cut", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_ENABLED_CUT, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/enabled/cut", [](int voice, float value) {
+        Commands::softcutCommands.post(Commands::Id::SET_ENABLED_CUT, voice, value);
     });
 
-    addServerMethod("/set/level/cut", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_LEVEL_CUT, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/level/cut", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamLevel, voice, value);
     });
 
-    addServerMethod("/set/pan/cut", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_PAN_CUT, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/pan/cut", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPan, voice, value);
     });
 
 
-    addServerMethod("/set/level/adc_cut", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_ADC_CUT, argv[0]->f);
+    addServerMethod("/set/level/adc_cut", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelAdcCut, value);
     });
 
-    addServerMethod("/set/level/ext_cut", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_EXT_CUT, argv[0]->f);
+    addServerMethod("/set/level/ext_cut", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelExtCut, value);
     });
 
-    addServerMethod("/set/level/tape_cut", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_TAPE_CUT, argv[0]->f);
+    addServerMethod("/set/level/tape_cut", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelTapeCut, value);
     });
 
-    addServerMethod("/set/level/cut_rev", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_CUT_AUX, argv[0]->f);
+    addServerMethod("/set/level/cut_rev", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelCutAux, value);
     });
 
 
-    //--- NB: these are handled by the softcut command queue,
-    // because their corresponding mix points are processed by the softcut client.
+    //--- NB: these are handled by the softcut client,
+    // because their corresponding mix points are processed there.
 
     // input channel -> voice levels
-    addServerMethod("/set/level/in_cut", "iif", [](lo_arg **argv, int argc) {
-        if (argc < 3) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_LEVEL_IN_CUT, argv[0]->i, argv[1]->i, argv[2]->f);
+    addServerMethod("/set/level/in_cut", [](int ch, int voice, float level) {
+        softCutClient->setInLevel(ch, voice, level);
     });
 
 
     // voice ->  voice levels
-    addServerMethod("/set/level/cut_cut", "iif", [](lo_arg **argv, int argc) {
-        if (argc < 3) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_LEVEL_CUT_CUT, argv[0]->i, argv[1]->i, argv[2]->f);
+    addServerMethod("/set/level/cut_cut", [](int src, int dst, float level) {
+        softCutClient->setFeedbackLevel(src, dst, level);
     });
 
 
@@ -341,143 +457,115 @@ void OscInterface::addServerMethods() {
     //-- softcut params
 
 
-    addServerMethod("/set/param/cut/rate", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_RATE, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/rate", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamRate, voice, value);
     });
 
-    addServerMethod("/set/param/cut/loop_start", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_LOOP_START, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/loop_start", [](int voice, float value) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_LOOP_START, voice, value);
     });
 
-    addServerMethod("/set/param/cut/loop_end", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_LOOP_END, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/loop_end", [](int voice, float value) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_LOOP_END, voice, value);
     });
 
-    addServerMethod("/set/param/cut/loop_flag", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_LOOP_FLAG, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/loop_flag", [](int voice, float value) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_LOOP_FLAG, voice, value);
     });
 
-    addServerMethod("/set/param/cut/fade_time", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_FADE_TIME, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/fade_time", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamFadeTime, voice, value);
     });
 
-    addServerMethod("/set/param/cut/rec_level", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_REC_LEVEL, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/rec_level", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamRecLevel, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_level", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_LEVEL, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_level", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreLevel, voice, value);
     });
 
-    addServerMethod("/set/param/cut/rec_flag", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_REC_FLAG, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/rec_flag", [](int voice, float value) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_REC_FLAG, voice, value);
     });
 
-    addServerMethod("/set/param/cut/play_flag", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PLAY_FLAG, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/play_flag", [](int voice, float value) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_PLAY_FLAG, voice, value);
     });
 
-    addServerMethod("/set/param/cut/rec_offset", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_REC_OFFSET, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/rec_offset", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamRecOffset, voice, value);
     });
 
-    addServerMethod("/set/param/cut/position", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POSITION, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/position", [](int voice, float value) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_POSITION, voice, value);
     });
 
     // --- input filter
-    addServerMethod("/set/param/cut/pre_filter_fc", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_FC, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_fc", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterFc, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_filter_fc_mod", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_FC_MOD, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_fc_mod", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterFcMod, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_filter_rq", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_RQ, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_rq", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterRq, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_filter_lp", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_LP, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_lp", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterLp, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_filter_hp", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_HP, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_hp", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterHp, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_filter_bp", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_BP, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_bp", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterBp, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_filter_br", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_BR, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_br", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterBr, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pre_filter_dry", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PRE_FILTER_DRY, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pre_filter_dry", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPreFilterDry, voice, value);
     });
 
 
     // --- output filter
-    addServerMethod("/set/param/cut/post_filter_fc", "if", [
-    ](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POST_FILTER_FC, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/post_filter_fc", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPostFilterFc, voice, value);
     });
 
-    addServerMethod("/set/param/cut/post_filter_rq", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POST_FILTER_RQ, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/post_filter_rq", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPostFilterRq, voice, value);
     });
 
-    addServerMethod("/set/param/cut/post_filter_lp", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POST_FILTER_LP, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/post_filter_lp", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPostFilterLp, voice, value);
     });
 
-    addServerMethod("/set/param/cut/post_filter_hp", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POST_FILTER_HP, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/post_filter_hp", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPostFilterHp, voice, value);
     });
 
-    addServerMethod("/set/param/cut/post_filter_bp", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POST_FILTER_BP, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/post_filter_bp", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPostFilterBp, voice, value);
     });
 
-    addServerMethod("/set/param/cut/post_filter_br", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POST_FILTER_BR, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/post_filter_br", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPostFilterBr, voice, value);
     });
 
-    addServerMethod("/set/param/cut/post_filter_dry", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POST_FILTER_DRY, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/post_filter_dry", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPostFilterDry, voice, value);
     });
 
-    addServerMethod("/set/param/cut/voice_sync", "iif", [](lo_arg **argv, int argc) {
-        if (argc < 3) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_VOICE_SYNC, argv[0]->i, argv[1]->i, argv[2]->f);
+    addServerMethod("/set/param/cut/voice_sync", [](int src, int dst, float level) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_VOICE_SYNC, src, dst, level);
     });
 
 
@@ -525,30 +613,25 @@ void OscInterface::addServerMethods() {
 #endif
     //////////////////
 
-    addServerMethod("/set/param/cut/level_slew_time", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_LEVEL_SLEW_TIME, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/level_slew_time", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamLevelSlewTime, voice, value);
     });
 
-    addServerMethod("/set/param/cut/pan_slew_time", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PAN_SLEW_TIME, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/pan_slew_time", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamPanSlewTime, voice, value);
     });
 
-    addServerMethod("/set/param/cut/recpre_slew_time", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_RECPRE_SLEW_TIME, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/recpre_slew_time", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamRecPreSlewTime, voice, value);
     });
 
-    addServerMethod("/set/param/cut/rate_slew_time", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_RATE_SLEW_TIME, argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/rate_slew_time", [](int voice, float value) {
+        softCutClient->setVoiceParam(SoftcutClient::ParamRateSlewTime, voice, value);
     });
 
 
-    addServerMethod("/set/param/cut/buffer", "ii", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_BUFFER, argv[0]->i, argv[1]->i);
+    addServerMethod("/set/param/cut/buffer", [](int voice, int value) {
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_BUFFER, voice, value);
     });
 
 
@@ -556,13 +639,17 @@ void OscInterface::addServerMethods() {
     //--- softcut buffer manipulation
 
 
+    // each buffer method is also registered with a trailing int argument: a job ID chosen by the sender.
+    // for those, progress and completion are reported with /softcut/buffer/job (see init()).
+
     // FIXME: hrm, our system doesn't allow variable argument count. maybe need to make multiple methods
-    addServerMethod("/softcut/buffer/read_mono", "sfffii", [](lo_arg **argv, int argc) {
+    auto readMono = [](lo_arg **argv, int argc) {
         float startSrc = 0.f;
         float startDst = 0.f;
         float dur = -1.f;
         int chanSrc = 0;
         int chanDst = 0;
+        int jobId = -1;
         if (argc < 1) {
             std::cerr << "/softcut/buffer/read_mono requires at least one argument (file path)" << std::endl;
             return;
@@ -582,16 +669,22 @@ void OscInterface::addServerMethods() {
         if (argc > 5) {
             chanDst = argv[5]->i;
         }
+        if (argc > 6) {
+            jobId = argv[6]->i;
+        }
         const char *str = &argv[0]->s;
-        softCutClient->readBufferMono(str, startSrc, startDst, dur, chanSrc, chanDst);
+        softCutClient->readBufferMono(str, startSrc, startDst, dur, chanSrc, chanDst, jobId);
 
-    });
+    };
+    addServerMethod("/softcut/buffer/read_mono", "sfffii", readMono);
+    addServerMethod("/softcut/buffer/read_mono", "sfffiii", readMono);
 
     // FIXME: hrm, our system doesn't allow variable argument count. maybe need to make multiple methods
-    addServerMethod("/softcut/buffer/read_stereo", "sfff", [](lo_arg **argv, int argc) {
+    auto readStereo = [](lo_arg **argv, int argc) {
         float startSrc = 0.f;
         float startDst = 0.f;
         float dur = -1.f;
+        int jobId = -1;
         if (argc < 1) {
             std::cerr << "/softcut/buffer/read_stereo requires at least one argument (file path)" << std::endl;
             return;
@@ -605,16 +698,22 @@ void OscInterface::addServerMethods() {
         if (argc > 3) {
             dur = argv[3]->f;
         }
+        if (argc > 4) {
+            jobId = argv[4]->i;
+        }
         const char *str = &argv[0]->s;
-        softCutClient->readBufferStereo(str, startSrc, startDst, dur);
-    });
+        softCutClient->readBufferStereo(str, startSrc, startDst, dur, jobId);
+    };
+    addServerMethod("/softcut/buffer/read_stereo", "sfff", readStereo);
+    addServerMethod("/softcut/buffer/read_stereo", "sfffi", readStereo);
 
 
     // FIXME: hrm, our system doesn't allow variable argument count. maybe need to make multiple methods
-    addServerMethod("/softcut/buffer/write_mono", "sffi", [](lo_arg **argv, int argc) {
+    auto writeMono = [](lo_arg **argv, int argc) {
         float start = 0.f;
         float dur = -1.f;
         int chan = 0;
+        int jobId = -1;
         if (argc < 1) {
             std::cerr << "/softcut/buffer/write_mono requires at least one argument (file path)" << std::endl;
             return;
@@ -628,14 +727,20 @@ void OscInterface::addServerMethods() {
         if (argc > 3) {
             chan = argv[3]->i;
         }
+        if (argc > 4) {
+            jobId = argv[4]->i;
+        }
         const char *str = &argv[0]->s;
-        softCutClient->writeBufferMono(str, start, dur, chan);
-    });
+        softCutClient->writeBufferMono(str, start, dur, chan, jobId);
+    };
+    addServerMethod("/softcut/buffer/write_mono", "sffi", writeMono);
+    addServerMethod("/softcut/buffer/write_mono", "sffii", writeMono);
 
     // FIXME: hrm, our system doesn't allow variable argument count. maybe need to make multiple methods
-    addServerMethod("/softcut/buffer/write_stereo", "sff", [](lo_arg **argv, int argc) {
+    auto writeStereo = [](lo_arg **argv, int argc) {
         float start = 0.f;
         float dur = -1.f;
+        int jobId = -1;
         if (argc < 1) {
             std::cerr << "/softcut/buffer/write_stereo requires at least one argument (file path)" << std::endl;
             return;
@@ -646,40 +751,63 @@ void OscInterface::addServerMethods() {
         if (argc > 2) {
             dur = argv[2]->f;
         }
+        if (argc > 3) {
+            jobId = argv[3]->i;
+        }
         const char *str = &argv[0]->s;
-        softCutClient->writeBufferStereo(str, start, dur);
-    });
-
-
-    addServerMethod("/softcut/buffer/clear", "", [](lo_arg **argv, int argc) {
-        (void) argc;
-        (void) argv;
+        softCutClient->writeBufferStereo(str, start, dur, jobId);
+    };
+    addServerMethod("/softcut/buffer/write_stereo", "sff", writeStereo);
+    addServerMethod("/softcut/buffer/write_stereo", "sffi", writeStereo);
+
+    // NB: when clearing both channels, only the second job is tracked;
+    // jobs run in order, so its completion implies the first has completed too.
+    auto clear = [](lo_arg **argv, int argc) {
+        int jobId = argc > 0 ? argv[0]->i : -1;
         softCutClient->clearBuffer(0);
-        softCutClient->clearBuffer(1);
-    });
-
-
-    addServerMethod("/softcut/buffer/clear_channel", "i", [](lo_arg **argv, int argc) {
+        softCutClient->clearBuffer(1, 0.f, -1.f, jobId);
+    };
+    addServerMethod("/softcut/buffer/clear", "", clear);
+    addServerMethod("/softcut/buffer/clear", "i", clear);
+
+    // flush recorded regions to the buffer files; completes immediately if buffers aren't persistent
+    auto sync = [](lo_arg **argv, int argc) {
+        int jobId = argc > 0 ? argv[0]->i : -1;
+        softCutClient->syncBuffers(jobId);
+    };
+    addServerMethod("/softcut/buffer/sync", "", sync);
+    addServerMethod("/softcut/buffer/sync", "i", sync);
+
+    auto clearChannel = [](lo_arg **argv, int argc) {
         if (argc < 1) {
             return;
         }
-        softCutClient->clearBuffer(argv[0]->i);
-    });
+        int jobId = argc > 1 ? argv[1]->i : -1;
+        softCutClient->clearBuffer(argv[0]->i, 0.f, -1.f, jobId);
+    };
+    addServerMethod("/softcut/buffer/clear_channel", "i", clearChannel);
+    addServerMethod("/softcut/buffer/clear_channel", "ii", clearChannel);
 
-    addServerMethod("/softcut/buffer/clear_region", "ff", [](lo_arg **argv, int argc) {
+    auto clearRegion = [](lo_arg **argv, int argc) {
         if (argc < 2) {
             return;
         }
+        int jobId = argc > 2 ? argv[2]->i : -1;
         softCutClient->clearBuffer(0, argv[0]->f, argv[1]->f);
-        softCutClient->clearBuffer(1, argv[0]->f, argv[1]->f);
-    });
+        softCutClient->clearBuffer(1, argv[0]->f, argv[1]->f, jobId);
+    };
+    addServerMethod("/softcut/buffer/clear_region", "ff", clearRegion);
+    addServerMethod("/softcut/buffer/clear_region", "ffi", clearRegion);
 
-    addServerMethod("/softcut/buffer/clear_region_channel", "iff", [](lo_arg **argv, int argc) {
+    auto clearRegionChannel = [](lo_arg **argv, int argc) {
         if (argc < 3) {
             return;
         }
-        softCutClient->clearBuffer(argv[0]->i, argv[1]->f, argv[2]->f);
-    });
+        int jobId = argc > 3 ? argv[3]->i : -1;
+        softCutClient->clearBuffer(argv[0]->i, argv[1]->f, argv[2]->f, jobId);
+    };
+    addServerMethod("/softcut/buffer/clear_region_channel", "iff", clearRegionChannel);
+    addServerMethod("/softcut/buffer/clear_region_channel", "iffi", clearRegionChannel);
 
     addServerMethod("/softcut/reset", "", [](lo_arg **argv, int argc) {
         (void) argv;
@@ -689,43 +817,86 @@ void OscInterface::addServerMethods() {
         softCutClient->clearBuffer(1, 0, -1);
 
         softCutClient->reset();
-        for (int i = 0; i < SoftcutClient::NumVoices; ++i) {
-            phasePoll->stop();
+        for (int i = 0; i < softCutClient->getNumVoices(); ++i) {
+            softCutClient->closeStream(i);
         }
+        softCutClient->setPhaseEvents(false);
+        softCutClient->setVoiceEvents(false);
+    });
+
+    addServerMethod("/softcut/info", "", [](lo_arg **argv, int argc) {
+        (void) argv;
+        (void) argc;
+        sendSoftcutInfo();
+    });
+
+    //---------------------
+    //--- softcut streaming voices
+
+    // voice, path, [minimum duration in seconds]
+    auto streamOpen = [](lo_arg **argv, int argc) {
+        float minDur = argc > 2 ? argv[2]->f : 0.f;
+        if (!softCutClient->openStream(argv[0]->i, &argv[1]->s, minDur)) {
+            std::cerr << "/softcut/stream/open: failed for voice " << argv[0]->i << std::endl;
+        }
+    };
+    addServerMethod("/softcut/stream/open", "is", streamOpen);
+    addServerMethod("/softcut/stream/open", "isf", streamOpen);
+
+    addServerMethod("/softcut/stream/close", "i", [](lo_arg **argv, int argc) {
+        (void) argc;
+        softCutClient->closeStream(argv[0]->i);
     });
 
     //---------------------
     //--- softcut polls
 
-    addServerMethod("/set/param/cut/phase_quant", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        softCutClient->setPhaseQuant(argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/phase_quant", [](int voice, float value) {
+        softCutClient->setPhaseQuant(voice, value);
     });
 
-    addServerMethod("/set/param/cut/phase_offset", "if", [](lo_arg **argv, int argc) {
-        if (argc < 2) { return; }
-        softCutClient->setPhaseOffset(argv[0]->i, argv[1]->f);
+    addServerMethod("/set/param/cut/phase_offset", [](int voice, float value) {
+        softCutClient->setPhaseOffset(voice, value);
     });
 
+    // phase changes are reported from the audio thread, as they happen
     addServerMethod("/poll/start/cut/phase", "", [](lo_arg **argv, int argc) {
         (void) argv;
         (void) argc;
-        phasePoll->start();
+        softCutClient->setPhaseEvents(true);
     });
 
     addServerMethod("/poll/stop/cut/phase", "", [](lo_arg **argv, int argc) {
         (void) argv;
         (void) argc;
-        phasePoll->stop();
+        softCutClient->setPhaseEvents(false);
+    });
+
+    // loop wraps and record start / stop
+    addServerMethod("/poll/start/cut/events", "", [](lo_arg **argv, int argc) {
+        (void) argv;
+        (void) argc;
+        softCutClient->setVoiceEvents(true);
+    });
+
+    addServerMethod("/poll/stop/cut/events", "", [](lo_arg **argv, int argc) {
+        (void) argv;
+        (void) argc;
+        softCutClient->setVoiceEvents(false);
     });
 
 
     //------------------------
     //--- tape control
 
-    addServerMethod("/tape/record/open", "s", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        mixerClient->openTapeRecord(&argv[0]->s);
+    addServerMethod("/tape/record/open", [](const char *path) {
+        mixerClient->openTapeRecord(path);
+    });
+
+    // record several busses at once: <path> <stem mask> <split>
+    // mask bits: 1 = dac, 2 = adc, 4 = cut, 8 = ext, 16 = aux. split: 1 = a stereo file per stem, 0 = one file
+    addServerMethod("/tape/record/open_stems", [](const char *path, int stems, int split) {
+        mixerClient->openTapeStems(path, stems, split != 0);
     });
 
     addServerMethod("/tape/record/start", "", [](lo_arg **argv, int argc) {
@@ -740,9 +911,13 @@ void OscInterface::addServerMethods() {
         mixerClient->stopTapeRecord();
     });
 
-    addServerMethod("/tape/play/open", "s", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        mixerClient->openTapePlayback(&argv[0]->s);
+    addServerMethod("/tape/play/open", [](const char *path) {
+        mixerClient->openTapePlayback(path);
+    });
+
+    // resampling quality for files not at the engine rate: 0 = fast, 1 = medium, 2 = best
+    addServerMethod("/tape/play/quality", [](int quality) {
+        mixerClient->setTapePlaybackQuality(quality);
     });
 
     addServerMethod("/tape/play/start", "", [](lo_arg **argv, int argc) {
@@ -757,14 +932,12 @@ void OscInterface::addServerMethods() {
         mixerClient->stopTapePlayback();
     });
 
-    addServerMethod("/set/level/tape", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_TAPE, argv[0]->f);
+    addServerMethod("/set/level/tape", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelTape, value);
     });
 
-    addServerMethod("/set/level/tape_rev", "f", [](lo_arg **argv, int argc) {
-        if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_TAPE_AUX, argv[0]->f);
+    addServerMethod("/set/level/tape_rev", [](float value) {
+        mixerClient->setLevel(MixerClient::LevelTapeAux, value);
     });
 }
 
@@ -780,6 +953,20 @@ void OscInterface::printServerMethods() {
 }
 
 void OscInterface::deinit() {
+    IpcServer::deinit();
+    PollScheduler::stop();
+    softCutClient->stopEvents();
+    vuPoll.reset();
+    meterPoll.reset();
     lo_address_free(matronAddress);
 }
 
+void OscInterface::addBlobMessage(lo_bundle bundle, const char *path, const void *data, int size) {
+    lo_blob bl = lo_blob_new(size, data);
+    lo_message msg = lo_message_new();
+    // the message keeps its own copy of the blob data
+    lo_message_add_blob(msg, bl);
+    lo_blob_free(bl);
+    lo_bundle_add_message(bundle, path, msg);
+}
+
@@ -13,8 +13,10 @@
 
 #include <lo/lo.h>
 #include <array>
+#include <mutex>
 
 #include "MixerClient.h"
+#include "OscDispatch.h"
 #include "SoftcutClient.h"
 #include "Poll.h"
 
@@ -47,8 +49,12 @@ namespace crone {
         };
 
         static std::array<OscMethod, MaxNumMethods> methods;
+        static OscDispatch oscDispatch;
+        // handlers run on the OSC server thread and the IPC drain thread; only one at a time,
+        // so the command queues keep a single producer
+        static std::mutex handlerMut;
         static std::unique_ptr<Poll> vuPoll;
-        static std::unique_ptr<Poll> phasePoll;
+        static std::unique_ptr<Poll> meterPoll;
         static MixerClient *mixerClient;
         static SoftcutClient *softCutClient;
 
@@ -59,8 +65,20 @@ namespace crone {
         }
 
         static void addServerMethod(const char* path, const char* format, Handler handler);
+        // typed handler: the OSC format and argument unpacking come from the lambda's parameter types
+        template<typename F>
+        static void addServerMethod(const char *path, F fn) {
+            OscTypedHandler<F>::fn = fn;
+            addServerMethod(path, OscLambdaArgs<F>::types, &OscTypedHandler<F>::call);
+        }
 
         static void addServerMethods();
+        // run a method's handler by index (for commands arriving through shared memory)
+        static void dispatch(unsigned int idx, lo_arg **argv, int argc);
+        // add a single-blob message to a poll bundle
+        static void addBlobMessage(lo_bundle bundle, const char *path, const void *data, int size);
+        // tell matron the softcut voice count and buffer length: /softcut/info <voices> <frames>
+        static void sendSoftcutInfo();
 
 
     public:
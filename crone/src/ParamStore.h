@@ -0,0 +1,64 @@
+/*
+ * ParamStore: block of continuous parameter values shared between the OSC thread and an audio thread.
+ *
+ * the OSC thread writes values with relaxed atomic stores and marks them in a dirty bitmap.
+ * once per block, the audio thread takes the bitmap and re-applies only the changed values.
+ * many writes to the same parameter between blocks collapse to a single application of the latest value.
+ *
+ * parameters are applied in index order.
+ */
+
+#ifndef CRONE_PARAMSTORE_H
+#define CRONE_PARAMSTORE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace crone {
+
+    template<size_t NumParams>
+    class ParamStore {
+    public:
+        enum { NumWords = (NumParams + 63) / 64 };
+
+        ParamStore() {
+            for (auto &v : value) { v.store(0.f, std::memory_order_relaxed); }
+            for (auto &d : dirty) { d.store(0, std::memory_order_relaxed); }
+        }
+
+        // from any single writer thread
+        void set(size_t idx, float x) {
+            value[idx].store(x, std::memory_order_relaxed);
+            dirty[idx >> 6].fetch_or(1ull << (idx & 63), std::memory_order_release);
+        }
+
+        float get(size_t idx) const {
+            return value[idx].load(std::memory_order_relaxed);
+        }
+
+        // from audio thread: call f(idx, value) for each parameter written since the last call.
+        // a value written while this runs is either seen now, or on the next call.
+        template<class F>
+        void applyDirty(F &&f) {
+            for (size_t w = 0; w < NumWords; ++w) {
+                if (dirty[w].load(std::memory_order_relaxed) == 0) { continue; }
+                uint64_t bits = dirty[w].exchange(0, std::memory_order_acquire);
+                while (bits != 0) {
+                    const auto b = static_cast<size_t>(__builtin_ctzll(bits));
+                    bits &= bits - 1;
+                    const size_t idx = (w << 6) + b;
+                    f(idx, value[idx].load(std::memory_order_relaxed));
+                }
+            }
+        }
+
+    private:
+        static_assert(sizeof(std::atomic<float>) == sizeof(float), "atomic<float> must not carry a lock");
+        alignas(64) std::atomic<uint64_t> dirty[NumWords];
+        alignas(64) std::atomic<float> value[NumParams];
+    };
+
+}
+
+#endif //CRONE_PARAMSTORE_H
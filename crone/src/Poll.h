@@ -2,65 +2,76 @@
 // Created by emb on 11/30/18.
 //
 
+/*
+ * Poll: a named, periodic callback that reports values to matron.
+ *
+ * polls no longer own threads: all of them are driven by the PollScheduler thread.
+ * on each tick, the callbacks of all due polls add their messages to one OSC bundle,
+ * which the scheduler sends once they have all run.
+ */
+
 #ifndef CRONE_POLL_H
 #define CRONE_POLL_H
 
-#include <string>
-#include <thread>
-#include <functional>
 #include <atomic>
-
+#include <cstdint>
+#include <functional>
 #include <sstream>
-#include <chrono>
+#include <string>
 #include <utility>
 
 #include <lo/lo.h>
 
+#include "PollScheduler.h"
+
 class Poll {
 
 public:
-    typedef std::function<void(const char*)> Callback;
+    // add messages for `path` to `bundle`; the scheduler frees them after sending
+    typedef std::function<void(const char *path, lo_bundle bundle)> Callback;
 
-    explicit Poll(std::string name) {
+    explicit Poll(std::string name) : period(1), scheduled(false), due(0), prev(nullptr), next(nullptr) {
         std::ostringstream os;
         os << "/poll/" << name;
         path = os.str();
     }
 
+    ~Poll() {
+        stop();
+    }
+
+    Poll(const Poll &) = delete;
+    Poll &operator=(const Poll &) = delete;
+
+    // not while the poll is running
     void setCallback(Callback c) {
         cb = std::move(c);
     }
 
     void start() {
-        shouldStop = false;
-        th = std::make_unique<std::thread> (std::thread(
-                [this] {
-                    while (!shouldStop) {
-                        this->cb(path.c_str());
-                        std::this_thread::sleep_for(std::chrono::milliseconds(period));
-                    }
-                }));
-        th->detach();
+        crone::PollScheduler::add(this);
     }
 
+    // once this returns, the callback is not running and won't be called again
     void stop() {
-        // in c++ there's no way to safely and non-cooperatively interrupt a thread.
-        shouldStop = true;
-        // i am reasonably sure this won't leak...
-        th.reset();
+        crone::PollScheduler::remove(this);
     }
 
+    // takes effect from the next time the poll fires
     void setPeriod(int ms) {
-        period = ms;
+        period = ms < 1 ? 1 : ms;
     }
 
 private:
+    friend class crone::PollScheduler;
     Callback cb;
     std::atomic<int> period;
-    std::atomic<bool> shouldStop;
-    std::unique_ptr<std::thread> th;
     std::string path;
-    lo_address addr;
+    // scheduler state, guarded by the scheduler
+    bool scheduled;
+    uint64_t due;
+    Poll *prev;
+    Poll *next;
 };
 
 
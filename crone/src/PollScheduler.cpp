@@ -0,0 +1,136 @@
+#include <iostream>
+
+#include "Poll.h"
+#include "PollScheduler.h"
+
+using namespace crone;
+
+std::mutex PollScheduler::mut;
+std::condition_variable PollScheduler::cv;
+std::unique_ptr<std::thread> PollScheduler::th = nullptr;
+bool PollScheduler::shouldQuit = false;
+lo_address PollScheduler::address = nullptr;
+PollScheduler::Clock::time_point PollScheduler::startTime = PollScheduler::Clock::now();
+uint64_t PollScheduler::lastTick = 0;
+Poll *PollScheduler::wheel[WheelSize] = {nullptr};
+
+void PollScheduler::start(lo_address addr) {
+    std::lock_guard<std::mutex> lock(mut);
+    if (th != nullptr) { return; }
+    address = addr;
+    shouldQuit = false;
+    lastTick = currentTick();
+    th = std::make_unique<std::thread>(&PollScheduler::loop);
+}
+
+void PollScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        if (th == nullptr) { return; }
+        shouldQuit = true;
+    }
+    cv.notify_one();
+    th->join();
+    th.reset();
+}
+
+void PollScheduler::add(Poll *poll) {
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        if (poll->scheduled) { return; }
+        poll->due = currentTick() + poll->period.load();
+        insert(poll);
+    }
+    // the new poll may be due before the thread would otherwise wake
+    cv.notify_one();
+}
+
+void PollScheduler::remove(Poll *poll) {
+    std::lock_guard<std::mutex> lock(mut);
+    if (poll->scheduled) { unlink(poll); }
+}
+
+uint64_t PollScheduler::currentTick() {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - startTime);
+    return static_cast<uint64_t>(elapsed.count());
+}
+
+void PollScheduler::insert(Poll *poll) {
+    Poll *&head = wheel[poll->due & WheelMask];
+    poll->prev = nullptr;
+    poll->next = head;
+    if (head != nullptr) { head->prev = poll; }
+    head = poll;
+    poll->scheduled = true;
+}
+
+void PollScheduler::unlink(Poll *poll) {
+    if (poll->prev != nullptr) {
+        poll->prev->next = poll->next;
+    } else {
+        wheel[poll->due & WheelMask] = poll->next;
+    }
+    if (poll->next != nullptr) { poll->next->prev = poll->prev; }
+    poll->prev = poll->next = nullptr;
+    poll->scheduled = false;
+}
+
+void PollScheduler::advance(uint64_t tick, lo_bundle bundle) {
+    // after a stall, one revolution visits every slot
+    if (tick - lastTick > WheelSize) { lastTick = tick - WheelSize; }
+    for (uint64_t t = lastTick + 1; t <= tick; ++t) {
+        // detach the slot, so polls rescheduled into it aren't visited twice
+        Poll *p = wheel[t & WheelMask];
+        wheel[t & WheelMask] = nullptr;
+        while (p != nullptr) {
+            Poll *next = p->next;
+            if (p->due <= t) {
+                if (p->cb) { p->cb(p->path.c_str(), bundle); }
+                p->due += p->period.load();
+                // fell behind: skip missed periods rather than bursting
+                if (p->due <= tick) { p->due = tick + p->period.load(); }
+            }
+            insert(p);
+            p = next;
+        }
+    }
+    lastTick = tick;
+}
+
+uint64_t PollScheduler::nextWakeTick() {
+    uint64_t earliest = 0;
+    for (uint64_t t = lastTick + 1; t <= lastTick + WheelSize; ++t) {
+        for (Poll *p = wheel[t & WheelMask]; p != nullptr; p = p->next) {
+            if (p->due <= t) { return t; }
+            // due in a later revolution
+            if (earliest == 0 || p->due < earliest) { earliest = p->due; }
+        }
+    }
+    return earliest;
+}
+
+void PollScheduler::loop() {
+    std::unique_lock<std::mutex> lock(mut);
+    while (!shouldQuit) {
+        const uint64_t wake = nextWakeTick();
+        if (wake == 0) {
+            cv.wait(lock);
+        } else {
+            cv.wait_until(lock, startTime + std::chrono::milliseconds(wake));
+        }
+        if (shouldQuit) { break; }
+        const uint64_t now = currentTick();
+        if (now <= lastTick) { continue; }
+        lo_bundle bundle = lo_bundle_new(LO_TT_IMMEDIATE);
+        advance(now, bundle);
+        // send without holding the lock
+        lock.unlock();
+        if (lo_bundle_count(bundle) > 0) {
+            if (lo_send_bundle(address, bundle) < 0) {
+                std::cerr << "poll scheduler: failed to send bundle" << std::endl;
+            }
+        }
+        lo_bundle_free_recursive(bundle);
+        lock.lock();
+    }
+}
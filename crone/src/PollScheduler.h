@@ -0,0 +1,69 @@
+/*
+ * PollScheduler: a single thread driving all polls, from a timer wheel.
+ *
+ * the wheel has one slot per millisecond tick; a poll sits in the slot of its next due tick,
+ * and polls due more than one revolution ahead stay in their slot until their tick comes round.
+ * the thread sleeps until the next occupied slot (or until a poll is added),
+ * so it wakes only when some poll is actually due.
+ *
+ * all messages produced in one tick are sent to matron as a single OSC bundle.
+ *
+ * callbacks run with the scheduler lock held, so removing a poll waits for a running callback to finish.
+ * callbacks must not start or stop polls.
+ */
+
+#ifndef CRONE_POLLSCHEDULER_H
+#define CRONE_POLLSCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <lo/lo.h>
+
+class Poll;
+
+namespace crone {
+
+    class PollScheduler {
+    public:
+        // start the scheduler thread, sending bundles to the given address
+        static void start(lo_address addr);
+        // stop and join the scheduler thread. scheduled polls stay registered, but no longer fire
+        static void stop();
+
+        // schedule a poll, due one period from now. no effect if it is already scheduled
+        static void add(Poll *poll);
+        // unschedule a poll. waits for its callback if it is running
+        static void remove(Poll *poll);
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+        enum { WheelSize = 64, WheelMask = WheelSize - 1 };
+
+        static void loop();
+        static uint64_t currentTick();
+        static void insert(Poll *poll);
+        static void unlink(Poll *poll);
+        // run all polls due at ticks up to `tick`
+        static void advance(uint64_t tick, lo_bundle bundle);
+        // tick of the next occupied slot, or 0 if the wheel is empty
+        static uint64_t nextWakeTick();
+
+        static std::mutex mut;
+        static std::condition_variable cv;
+        static std::unique_ptr<std::thread> th;
+        static bool shouldQuit;
+        static lo_address address;
+        static Clock::time_point startTime;
+        // last tick processed
+        static uint64_t lastTick;
+        static Poll *wheel[WheelSize];
+    };
+
+}
+
+#endif //CRONE_POLLSCHEDULER_H
@@ -0,0 +1,195 @@
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RawAudioFile.h"
+
+using namespace crone;
+
+static inline uint32_t le16(const unsigned char *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8);
+}
+
+static inline uint32_t le32(const unsigned char *p) {
+    return le16(p) | (le16(p + 2) << 16);
+}
+
+static inline uint32_t be32(const unsigned char *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+           | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline uint64_t be64(const unsigned char *p) {
+    return (static_cast<uint64_t>(be32(p)) << 32) | be32(p + 4);
+}
+
+static inline void putLe16(unsigned char *p, uint32_t x) {
+    p[0] = static_cast<unsigned char>(x & 0xff);
+    p[1] = static_cast<unsigned char>((x >> 8) & 0xff);
+}
+
+static inline void putLe32(unsigned char *p, uint32_t x) {
+    putLe16(p, x & 0xffff);
+    putLe16(p + 2, x >> 16);
+}
+
+// give up looking for chunks after this many
+static constexpr int maxChunks = 64;
+
+static bool probeWav(int fd, off_t fileSize, RawAudioFile::Layout &layout) {
+    unsigned char hdr[40];
+    off_t pos = 12;
+    int channels = 0;
+    for (int i = 0; i < maxChunks && pos + 8 <= fileSize; ++i) {
+        if (!RawAudioFile::readAt(fd, hdr, 8, pos)) { return false; }
+        const off_t size = le32(hdr + 4);
+        const off_t body = pos + 8;
+        if (memcmp(hdr, "fmt ", 4) == 0) {
+            if (size < 16) { return false; }
+            const size_t n = size < 40 ? static_cast<size_t>(size) : 40;
+            if (!RawAudioFile::readAt(fd, hdr, n, body)) { return false; }
+            uint32_t tag = le16(hdr);
+            if (tag == 0xfffe) {
+                // WAVE_FORMAT_EXTENSIBLE: sub-format tag leads the GUID
+                if (n < 26) { return false; }
+                tag = le16(hdr + 24);
+            }
+            channels = static_cast<int>(le16(hdr + 2));
+            // IEEE float, 32 bits
+            if (tag != 3 || le16(hdr + 14) != 32 || channels < 1
+                || le16(hdr + 12) != static_cast<uint32_t>(channels) * 4) {
+                return false;
+            }
+        } else if (memcmp(hdr, "data", 4) == 0) {
+            if (channels == 0) { return false; }
+            off_t bytes = size;
+            // streamed or oversized headers: use what is actually there
+            if (bytes == 0 || body + bytes > fileSize) { bytes = fileSize - body; }
+            layout.dataOffset = body;
+            layout.channels = channels;
+            layout.frames = static_cast<size_t>(bytes) / (static_cast<size_t>(channels) * 4);
+            return true;
+        }
+        pos = body + size + (size & 1);
+    }
+    return false;
+}
+
+static bool probeCaf(int fd, off_t fileSize, RawAudioFile::Layout &layout) {
+    unsigned char hdr[32];
+    off_t pos = 8;
+    int channels = 0;
+    for (int i = 0; i < maxChunks && pos + 12 <= fileSize; ++i) {
+        if (!RawAudioFile::readAt(fd, hdr, 12, pos)) { return false; }
+        const auto size = static_cast<int64_t>(be64(hdr + 4));
+        const off_t body = pos + 12;
+        if (memcmp(hdr, "desc", 4) == 0) {
+            if (size < 32 || !RawAudioFile::readAt(fd, hdr, 32, body)) { return false; }
+            // linear PCM; flags: bit 0 = float, bit 1 = little-endian
+            const uint32_t flags = be32(hdr + 12);
+            channels = static_cast<int>(be32(hdr + 24));
+            if (memcmp(hdr + 8, "lpcm", 4) != 0 || (flags & 3) != 3 || be32(hdr + 28) != 32
+                || channels < 1 || be32(hdr + 20) != 1
+                || be32(hdr + 16) != static_cast<uint32_t>(channels) * 4) {
+                return false;
+            }
+        } else if (memcmp(hdr, "data", 4) == 0) {
+            if (channels == 0) { return false; }
+            // data is preceded by a 4-byte edit count; size of -1 means "to end of file"
+            const off_t start = body + 4;
+            off_t bytes = size - 4;
+            if (size < 4 || start + bytes > fileSize) { bytes = fileSize - start; }
+            if (bytes < 0) { return false; }
+            layout.dataOffset = start;
+            layout.channels = channels;
+            layout.frames = static_cast<size_t>(bytes) / (static_cast<size_t>(channels) * 4);
+            return true;
+        }
+        if (size < 0) { return false; }
+        pos = body + size;
+    }
+    return false;
+}
+
+bool RawAudioFile::probeFloat(int fd, Layout &layout) {
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    (void) fd;
+    (void) layout;
+    return false;
+#else
+    struct stat st{};
+    if (fstat(fd, &st) != 0) { return false; }
+    unsigned char hdr[12];
+    if (!readAt(fd, hdr, 12, 0)) { return false; }
+    if (memcmp(hdr, "RIFF", 4) == 0 && memcmp(hdr + 8, "WAVE", 4) == 0) {
+        return probeWav(fd, st.st_size, layout);
+    }
+    if (memcmp(hdr, "caff", 4) == 0) {
+        return probeCaf(fd, st.st_size, layout);
+    }
+    return false;
+#endif
+}
+
+size_t RawAudioFile::maxWavFrames24(int channels) {
+    return (0xffffffffu - 36 - 1) / (static_cast<size_t>(channels) * 3);
+}
+
+bool RawAudioFile::makeWavHeader24(unsigned char *hdr, int channels, int sampleRate, size_t frames) {
+    const uint64_t dataBytes = static_cast<uint64_t>(frames) * channels * 3;
+    const uint64_t riffBytes = 36 + dataBytes + (dataBytes & 1);
+    if (riffBytes > 0xffffffffu) { return false; }
+    memcpy(hdr, "RIFF", 4);
+    putLe32(hdr + 4, static_cast<uint32_t>(riffBytes));
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    putLe32(hdr + 16, 16);
+    putLe16(hdr + 20, 1); // PCM
+    putLe16(hdr + 22, static_cast<uint32_t>(channels));
+    putLe32(hdr + 24, static_cast<uint32_t>(sampleRate));
+    putLe32(hdr + 28, static_cast<uint32_t>(sampleRate * channels * 3));
+    putLe16(hdr + 32, static_cast<uint32_t>(channels * 3));
+    putLe16(hdr + 34, 24);
+    memcpy(hdr + 36, "data", 4);
+    putLe32(hdr + 40, static_cast<uint32_t>(dataBytes));
+    return true;
+}
+
+off_t RawAudioFile::writeWavHeader24(int fd, int channels, int sampleRate, size_t frames) {
+    unsigned char hdr[wavHeaderSize24];
+    if (!makeWavHeader24(hdr, channels, sampleRate, frames)) { return -1; }
+    if (!writeAt(fd, hdr, sizeof(hdr), 0)) { return -1; }
+    return sizeof(hdr);
+}
+
+off_t RawAudioFile::wavFileSize24(off_t dataOffset, int channels, size_t frames) {
+    const auto dataBytes = static_cast<off_t>(frames * channels * 3);
+    return dataOffset + dataBytes + (dataBytes & 1);
+}
+
+bool RawAudioFile::readAt(int fd, void *dst, size_t bytes, off_t offset) {
+    auto *p = static_cast<char *>(dst);
+    while (bytes > 0) {
+        ssize_t n = pread(fd, p, bytes, offset);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { return false; }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool RawAudioFile::writeAt(int fd, const void *src, size_t bytes, off_t offset) {
+    auto *p = static_cast<const char *>(src);
+    while (bytes > 0) {
+        ssize_t n = pwrite(fd, p, bytes, offset);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { return false; }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return true;
+}
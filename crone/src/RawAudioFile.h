@@ -0,0 +1,71 @@
+/*
+ * RawAudioFile: direct access to the sample data of simple soundfiles, without libsndfile.
+ *
+ * used by BufDiskWorker for large-block I/O, where several threads work on one file at once:
+ * - probeFloat() locates the interleaved samples of a little-endian 32-bit float WAV or CAF file,
+ *   so that ranges of it can be read with pread() and no format conversion
+ * - writeWavHeader24() writes a 24-bit PCM WAV header for a known number of frames,
+ *   so that ranges of the data chunk can be filled with pwrite()
+ * - makeWavHeader24() builds the same header in memory, for writers that only do block-aligned I/O (TapeFile)
+ */
+
+#ifndef CRONE_RAWAUDIOFILE_H
+#define CRONE_RAWAUDIOFILE_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/types.h>
+
+namespace crone {
+
+    class RawAudioFile {
+    public:
+        struct Layout {
+            off_t dataOffset;
+            size_t frames;
+            int channels;
+        };
+
+        // returns true if the open file holds interleaved, native-endian 32-bit float samples,
+        // and fills in the location of the sample data
+        static bool probeFloat(int fd, Layout &layout);
+
+        // size of the header written by makeWavHeader24() / writeWavHeader24()
+        static constexpr size_t wavHeaderSize24 = 44;
+
+        // most frames a 24-bit WAV can hold (the RIFF size is 32 bits)
+        static size_t maxWavFrames24(int channels);
+
+        // fill in a 24-bit PCM WAV header (wavHeaderSize24 bytes) for a known number of frames.
+        // returns false if the data would be too large for WAV
+        static bool makeWavHeader24(unsigned char *hdr, int channels, int sampleRate, size_t frames);
+
+        // write a 24-bit PCM WAV header at the start of the file.
+        // returns the offset of the sample data, or -1 on failure (including data too large for WAV)
+        static off_t writeWavHeader24(int fd, int channels, int sampleRate, size_t frames);
+
+        // total file size for a 24-bit WAV written by writeWavHeader24(), including any pad byte
+        static off_t wavFileSize24(off_t dataOffset, int channels, size_t frames);
+
+        // pack one sample as 24-bit little-endian, clipping to [-1, 1]
+        static inline void packPcm24(float x, unsigned char *dst) {
+            float y = x * 8388607.f;
+            if (y > 8388607.f) { y = 8388607.f; }
+            if (y < -8388608.f) { y = -8388608.f; }
+            auto i = static_cast<int32_t>(std::lrint(y));
+            dst[0] = static_cast<unsigned char>(i & 0xff);
+            dst[1] = static_cast<unsigned char>((i >> 8) & 0xff);
+            dst[2] = static_cast<unsigned char>((i >> 16) & 0xff);
+        }
+
+        // positional read / write of exactly `bytes`, retrying short transfers.
+        // safe to call from several threads on the same descriptor
+        static bool readAt(int fd, void *dst, size_t bytes, off_t offset);
+        static bool writeAt(int fd, const void *src, size_t bytes, off_t offset);
+    };
+
+}
+
+#endif //CRONE_RAWAUDIOFILE_H
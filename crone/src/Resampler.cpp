@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Resampler.h"
+#include "Simd.h"
+
+using namespace crone;
+
+// zeroth-order modified Bessel function, for the Kaiser window
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    const double q = x * x / 4.0;
+    for (int k = 1; k < 64; ++k) {
+        term *= q / (static_cast<double>(k) * k);
+        sum += term;
+        if (term < sum * 1e-12) { break; }
+    }
+    return sum;
+}
+
+namespace {
+    struct QualitySpec {
+        int taps;
+        // Kaiser beta, and passband edge as a fraction of the (lower) Nyquist
+        double beta;
+        double rolloff;
+    };
+
+    const QualitySpec qualitySpecs[Resampler::NumQualities] = {
+            {16, 6.0, 0.85},
+            {32, 8.5, 0.91},
+            {64, 10.5, 0.95},
+    };
+}
+
+Resampler::Resampler() : channels(0), taps(0), step(1.0), capacity(0), fill(0), pos(0.0) {}
+
+void Resampler::setup(int numChannels, double inRate, double outRate, Quality quality, size_t maxInput) {
+    const QualitySpec &spec = qualitySpecs[quality < 0 || quality >= NumQualities ? QualityMedium : quality];
+    channels = std::min(std::max(numChannels, 1), static_cast<int>(MaxChannels));
+    step = inRate / outRate;
+
+    // when downsampling, cut off at the output Nyquist, with proportionally more taps
+    const double scale = std::min(1.0, outRate / inRate);
+    const double fc = scale * spec.rolloff;
+    int n = static_cast<int>(std::ceil(spec.taps / scale));
+    // keep rows a whole number of vectors
+    n = static_cast<int>((n + simd::VecSize - 1) / simd::VecSize * simd::VecSize);
+    taps = n;
+
+    // row p, tap k is the filter at distance (k - taps/2 + 1 - p/PhaseCount) from the output time
+    const double half = taps / 2.0;
+    const double i0Beta = besselI0(spec.beta);
+    coefs.assign(static_cast<size_t>(PhaseCount + 1) * taps, 0.f);
+    for (int p = 0; p <= PhaseCount; ++p) {
+        const double d = static_cast<double>(p) / PhaseCount;
+        for (int k = 0; k < taps; ++k) {
+            const double x = k - half + 1.0 - d;
+            const double r = x / half;
+            if (r <= -1.0 || r >= 1.0) { continue; }
+            const double w = besselI0(spec.beta * std::sqrt(1.0 - r * r)) / i0Beta;
+            const double t = M_PI * fc * x;
+            const double sinc = std::fabs(t) < 1e-9 ? 1.0 : std::sin(t) / t;
+            coefs[static_cast<size_t>(p) * taps + k] = static_cast<float>(fc * sinc * w);
+        }
+    }
+
+    capacity = maxInput + taps;
+    for (int ch = 0; ch < channels; ++ch) {
+        hist[ch].assign(capacity, 0.f);
+    }
+    reset();
+}
+
+void Resampler::reset() {
+    // lead with zeros, so the first output is centered on the first input frame
+    fill = static_cast<size_t>(taps / 2 - 1);
+    for (int ch = 0; ch < channels; ++ch) {
+        std::fill(hist[ch].begin(), hist[ch].begin() + fill, 0.f);
+    }
+    pos = static_cast<double>(fill);
+}
+
+void Resampler::push(const float *src, size_t frames) {
+    frames = std::min(frames, inputSpace());
+    for (int ch = 0; ch < channels; ++ch) {
+        float *dst = hist[ch].data() + fill;
+        const float *s = src + ch;
+        for (size_t i = 0; i < frames; ++i) {
+            dst[i] = *s;
+            s += channels;
+        }
+    }
+    fill += frames;
+}
+
+void Resampler::pushSilence(size_t frames) {
+    frames = std::min(frames, inputSpace());
+    for (int ch = 0; ch < channels; ++ch) {
+        std::fill(hist[ch].begin() + fill, hist[ch].begin() + fill + frames, 0.f);
+    }
+    fill += frames;
+}
+
+size_t Resampler::pull(float *dst, size_t maxFrames) {
+    const size_t before = static_cast<size_t>(taps / 2 - 1);
+    const size_t after = static_cast<size_t>(taps / 2);
+    size_t n = 0;
+    while (n < maxFrames) {
+        const auto i = static_cast<size_t>(pos);
+        if (i + after >= fill) { break; }
+        const double phase = (pos - i) * PhaseCount;
+        const auto p = static_cast<int>(phase);
+        const auto a = static_cast<float>(phase - p);
+        const float *row = coefs.data() + static_cast<size_t>(p) * taps;
+        for (int ch = 0; ch < channels; ++ch) {
+            float y0, y1;
+            simd::dot2(hist[ch].data() + i - before, row, row + taps, static_cast<size_t>(taps), y0, y1);
+            dst[n * channels + ch] = y0 + (y1 - y0) * a;
+        }
+        pos += step;
+        ++n;
+    }
+    if (n < maxFrames) { compact(); }
+    return n;
+}
+
+// drop history that no future output will use
+void Resampler::compact() {
+    const auto keepFrom = static_cast<size_t>(pos) - static_cast<size_t>(taps / 2 - 1);
+    if (keepFrom == 0) { return; }
+    const size_t shift = std::min(keepFrom, fill);
+    for (int ch = 0; ch < channels; ++ch) {
+        memmove(hist[ch].data(), hist[ch].data() + shift, (fill - shift) * sizeof(float));
+    }
+    fill -= shift;
+    pos -= static_cast<double>(shift);
+}
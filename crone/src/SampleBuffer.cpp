@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SampleBuffer.h"
+
+using namespace crone;
+
+SampleBuffer::~SampleBuffer() {
+    release();
+}
+
+void SampleBuffer::allocate(size_t frames, bool lock) {
+    release();
+    numBytes = frames * sizeof(float);
+    void *p = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        numBytes = 0;
+        throw std::runtime_error(std::string("SampleBuffer: mmap failed: ") + strerror(errno));
+    }
+    buf = static_cast<float *>(p);
+    numFrames = frames;
+    if (lock) {
+        if (mlock(buf, numBytes) == 0) {
+            locked = true;
+        } else {
+            std::cerr << "SampleBuffer: mlock failed (" << strerror(errno)
+                      << "); buffer memory will be paged in on demand" << std::endl;
+        }
+    }
+}
+
+void SampleBuffer::allocateFile(const std::string &path, size_t frames) {
+    release();
+    const size_t bytes = frames * sizeof(float);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("SampleBuffer: can't open " + path + ": " + strerror(errno));
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) != bytes && ftruncate(fd, bytes) != 0)) {
+        std::string err = strerror(errno);
+        close(fd);
+        throw std::runtime_error("SampleBuffer: can't size " + path + ": " + err);
+    }
+    if (st.st_size > 0) {
+        std::cout << "SampleBuffer: restored " << path << " ("
+                  << static_cast<size_t>(st.st_size) / sizeof(float) << " frames)" << std::endl;
+    }
+    // read the whole file in now, rather than on first touch from the audio thread
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    // the mapping holds its own reference to the file
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("SampleBuffer: can't map " + path + ": " + strerror(errno));
+    }
+    buf = static_cast<float *>(p);
+    numFrames = frames;
+    numBytes = bytes;
+    fileBacked = true;
+    numDirtyWords = ((frames + DirtyChunkFrames - 1) / DirtyChunkFrames + 63) / 64;
+    dirty.reset(new std::atomic<uint64_t>[numDirtyWords]);
+    for (size_t i = 0; i < numDirtyWords; ++i) {
+        dirty[i].store(0, std::memory_order_relaxed);
+    }
+    // keep it resident: evicted pages of a shared file mapping are read back from disk
+    if (mlock(buf, numBytes) == 0) {
+        locked = true;
+    } else {
+        std::cerr << "SampleBuffer: mlock failed (" << strerror(errno)
+                  << "); " << path << " may be paged out, stalling the audio thread" << std::endl;
+    }
+}
+
+void SampleBuffer::release() {
+    if (buf == nullptr) { return; }
+    if (fileBacked) {
+        size_t bytes;
+        sync(bytes);
+    }
+    if (locked) {
+        munlock(buf, numBytes);
+        locked = false;
+    }
+    munmap(buf, numBytes);
+    buf = nullptr;
+    numFrames = 0;
+    numBytes = 0;
+    fileBacked = false;
+    dirty.reset();
+    numDirtyWords = 0;
+}
+
+void SampleBuffer::clear(size_t start, size_t frames) {
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (start >= numFrames) { return; }
+    if (frames > numFrames - start) { frames = numFrames - start; }
+    float *data = buf + start;
+    if (locked || fileBacked) {
+        // pages must stay resident / the file must see the zeros
+        memset(data, 0, frames * sizeof(float));
+        markDirty(start, start + frames);
+        return;
+    }
+    auto a = reinterpret_cast<uintptr_t>(data);
+    auto b = a + frames * sizeof(float);
+    // page-aligned interior of the range
+    uintptr_t pa = (a + pageSize - 1) & ~(pageSize - 1);
+    uintptr_t pb = b & ~(pageSize - 1);
+    if (pb > pa && madvise(reinterpret_cast<void *>(pa), pb - pa, MADV_DONTNEED) == 0) {
+        // anonymous private pages read back as zero after MADV_DONTNEED;
+        // zero only the partial pages at either end
+        memset(data, 0, pa - a);
+        memset(reinterpret_cast<void *>(pb), 0, b - pb);
+    } else {
+        memset(data, 0, frames * sizeof(float));
+    }
+}
+
+void SampleBuffer::markDirty(size_t start, size_t end) {
+    if (!fileBacked || end <= start) { return; }
+    if (end > numFrames) { end = numFrames; }
+    size_t c = start / DirtyChunkFrames;
+    const size_t cEnd = (end + DirtyChunkFrames - 1) / DirtyChunkFrames;
+    while (c < cEnd) {
+        const size_t w = c >> 6;
+        const size_t b = c & 63;
+        const size_t n = std::min<size_t>(64 - b, cEnd - c);
+        const uint64_t bits = (n == 64 ? ~0ull : ((1ull << n) - 1)) << b;
+        // test first: a chunk being recorded into is usually marked already
+        if ((dirty[w].load(std::memory_order_relaxed) & bits) != bits) {
+            dirty[w].fetch_or(bits, std::memory_order_relaxed);
+        }
+        c += n;
+    }
+}
+
+bool SampleBuffer::sync(size_t &bytesSynced) {
+    bytesSynced = 0;
+    if (!fileBacked) { return true; }
+    const size_t chunkBytes = DirtyChunkFrames * sizeof(float);
+    const size_t numChunks = (numFrames + DirtyChunkFrames - 1) / DirtyChunkFrames;
+    bool ok = true;
+    // coalesce runs of dirty chunks into single msync calls
+    size_t runStart = 0;
+    size_t runLength = 0;
+    auto flush = [&]() {
+        if (runLength == 0) { return; }
+        const size_t offset = runStart * chunkBytes;
+        const size_t len = std::min(runLength * chunkBytes, numBytes - offset);
+        if (msync(reinterpret_cast<char *>(buf) + offset, len, MS_SYNC) != 0) {
+            std::cerr << "SampleBuffer: msync failed (" << strerror(errno) << ")" << std::endl;
+            // keep the chunks dirty, to retry next time
+            markDirty(runStart * DirtyChunkFrames, (runStart + runLength) * DirtyChunkFrames);
+            ok = false;
+        } else {
+            bytesSynced += len;
+        }
+        runLength = 0;
+    };
+    for (size_t w = 0; w < numDirtyWords; ++w) {
+        uint64_t bits = dirty[w].load(std::memory_order_relaxed) != 0 ? dirty[w].exchange(0) : 0;
+        for (size_t b = 0; b < 64; ++b) {
+            const size_t c = (w << 6) + b;
+            if (c >= numChunks) { break; }
+            if (bits & (1ull << b)) {
+                if (runLength == 0) { runStart = c; }
+                ++runLength;
+            } else {
+                flush();
+            }
+        }
+    }
+    flush();
+    return ok;
+}
@@ -0,0 +1,80 @@
+/*
+ * SampleBuffer: large mono float buffer backed by an anonymous memory mapping.
+ *
+ * pages are committed lazily by the kernel on first touch, so an unused buffer costs no RAM.
+ * optionally, the whole mapping can be locked (and so committed) up front,
+ * which avoids page faults on the audio thread at the cost of resident memory.
+ *
+ * alternatively, a buffer can be a shared mapping of a raw float32 file, so that its contents persist.
+ * file mappings are always populated and locked.
+ * writes to a file-backed buffer are tracked in coarse chunks (marked by whoever writes),
+ * and sync() flushes only the chunks written since the last sync.
+ */
+
+#ifndef CRONE_SAMPLEBUFFER_H
+#define CRONE_SAMPLEBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace crone {
+
+    class SampleBuffer {
+    public:
+        SampleBuffer() = default;
+        ~SampleBuffer();
+        SampleBuffer(const SampleBuffer &) = delete;
+        SampleBuffer &operator=(const SampleBuffer &) = delete;
+
+        // map memory for the given number of frames.
+        // if lock is set, try to mlock the mapping; failure to lock is reported but not fatal.
+        // throws std::runtime_error if the mapping fails.
+        void allocate(size_t numFrames, bool lock = false);
+        // map a raw float32 file, creating it or resizing it to the given number of frames.
+        // existing contents (up to the new size) are kept.
+        // the mapping is always read in and locked: a page fault here would read from disk on the audio thread.
+        // throws std::runtime_error if the file can't be opened or mapped.
+        void allocateFile(const std::string &path, size_t numFrames);
+        // file-backed buffers are synced before unmapping
+        void release();
+
+        float *data() const { return buf; }
+        size_t frames() const { return numFrames; }
+        bool isLocked() const { return locked; }
+        bool isFileBacked() const { return fileBacked; }
+
+        // zero a range of frames.
+        // for anonymous, unlocked buffers, whole pages inside the range are returned to the kernel,
+        // so clearing doesn't commit memory.
+        void clear(size_t start, size_t frames);
+
+        //-- dirty tracking, for file-backed buffers only (no-ops otherwise)
+
+        enum { DirtyChunkFrames = 16384 };
+
+        // mark frames [start, end) as written. lock-free; safe from the audio thread
+        void markDirty(size_t start, size_t end);
+        void markAllDirty() { markDirty(0, numFrames); }
+
+        // write dirty chunks back to the file, and wait for completion.
+        // chunks marked while this runs are synced either now or next time.
+        // returns false on error; bytesSynced is the amount of buffer flushed
+        bool sync(size_t &bytesSynced);
+
+    private:
+        float *buf = nullptr;
+        size_t numFrames = 0;
+        size_t numBytes = 0;
+        bool locked = false;
+        bool fileBacked = false;
+        // one bit per chunk
+        std::unique_ptr<std::atomic<uint64_t>[]> dirty;
+        size_t numDirtyWords = 0;
+    };
+
+}
+
+#endif //CRONE_SAMPLEBUFFER_H
@@ -0,0 +1,321 @@
+/*
+ * vectorized block kernels for bus mixing.
+ *
+ * these are thin wrappers around nova-simd (vendored under sc/external_libraries),
+ * which selects SSE / AVX / NEON / generic vector types at compile time.
+ *
+ * all kernels use unaligned loads and stores,
+ * since JACK port buffers carry no alignment guarantee.
+ * trailing frames that don't fill a whole vector are handled with scalar code.
+ */
+
+#ifndef CRONE_SIMD_H
+#define CRONE_SIMD_H
+
+#include <cstddef>
+
+#include "vec.hpp"
+
+namespace crone {
+    namespace simd {
+
+        typedef nova::vec<float> Vec;
+        static constexpr size_t VecSize = static_cast<size_t>(Vec::size);
+
+        // number of frames that can be processed in whole vectors
+        static inline size_t vecFrames(size_t numFrames) {
+            return numFrames - (numFrames % VecSize);
+        }
+
+        // dst = 0
+        static inline void clear(float *dst, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec z(0.f);
+            size_t i = 0;
+            for (; i < nv; i += VecSize) { z.store(dst + i); }
+            for (; i < numFrames; ++i) { dst[i] = 0.f; }
+        }
+
+        // dst = src
+        static inline void copy(float *dst, const float *src, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            Vec x;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(src + i);
+                x.store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] = src[i]; }
+        }
+
+        // dst += src
+        static inline void add(float *dst, const float *src, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            Vec x, y;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(src + i);
+                y.load(dst + i);
+                (y + x).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] += src[i]; }
+        }
+
+        // dst = a - b
+        static inline void sub(float *dst, const float *a, const float *b, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            Vec x, y;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(a + i);
+                y.load(b + i);
+                (x - y).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] = a[i] - b[i]; }
+        }
+
+        // dst = src * k
+        static inline void copyScaled(float *dst, const float *src, float k, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec vk(k);
+            Vec x;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(src + i);
+                (x * vk).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] = src[i] * k; }
+        }
+
+        // dst = src * gain[i]
+        static inline void copyScaled(float *dst, const float *src, const float *gain, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            Vec x, g;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(src + i);
+                g.load(gain + i);
+                (x * g).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] = src[i] * gain[i]; }
+        }
+
+        // dst += src * k
+        static inline void mix(float *dst, const float *src, float k, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec vk(k);
+            Vec x, y;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(src + i);
+                y.load(dst + i);
+                (y + x * vk).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] += src[i] * k; }
+        }
+
+        // dst += src * gain[i]
+        static inline void mix(float *dst, const float *src, const float *gain, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            Vec x, y, g;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(src + i);
+                y.load(dst + i);
+                g.load(gain + i);
+                (y + x * g).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] += src[i] * gain[i]; }
+        }
+
+        // dst *= k
+        static inline void scale(float *dst, float k, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec vk(k);
+            Vec y;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                y.load(dst + i);
+                (y * vk).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] *= k; }
+        }
+
+        // dst *= gain[i]
+        static inline void scale(float *dst, const float *gain, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            Vec y, g;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                y.load(dst + i);
+                g.load(gain + i);
+                (y * g).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] *= gain[i]; }
+        }
+
+        // dst = a + (b - a) * c
+        static inline void xfade(float *dst, const float *a, const float *b, float c, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec vc(c);
+            Vec x, y;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(a + i);
+                y.load(b + i);
+                (x + (y - x) * vc).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] = a[i] + (b[i] - a[i]) * c; }
+        }
+
+        // dst = a + (b - a) * c[i]
+        static inline void xfade(float *dst, const float *a, const float *b, const float *c, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            Vec x, y, vc;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(a + i);
+                y.load(b + i);
+                vc.load(c + i);
+                (x + (y - x) * vc).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] = a[i] + (b[i] - a[i]) * c[i]; }
+        }
+
+        // dst = a * ka + b * kb
+        static inline void mix2(float *dst, const float *a, float ka, const float *b, float kb, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec vka(ka);
+            const Vec vkb(kb);
+            Vec x, y;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(a + i);
+                y.load(b + i);
+                (x * vka + y * vkb).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] = a[i] * ka + b[i] * kb; }
+        }
+
+        // dst += a * ka + b * kb
+        static inline void mixAdd2(float *dst, const float *a, float ka, const float *b, float kb, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec vka(ka);
+            const Vec vkb(kb);
+            Vec x, y, z;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(a + i);
+                y.load(b + i);
+                z.load(dst + i);
+                (z + x * vka + y * vkb).store(dst + i);
+            }
+            for (; i < numFrames; ++i) { dst[i] += a[i] * ka + b[i] * kb; }
+        }
+
+        // convert normalized position [0, 1] to equal-power gain pair:
+        // cosGain = cos(x * pi/2), sinGain = sin(x * pi/2)
+        static inline void equalPower(float *cosGain, float *sinGain, const float *x, size_t numFrames) {
+            const size_t nv = vecFrames(numFrames);
+            const Vec halfPi(static_cast<float>(M_PI_2));
+            Vec vx;
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                vx.load(x + i);
+                const Vec arg(vx * halfPi);
+                cos(arg).store(cosGain + i);
+                sin(arg).store(sinGain + i);
+            }
+            for (; i < numFrames; ++i) {
+                const float c = x[i] * static_cast<float>(M_PI_2);
+                cosGain[i] = cosf(c);
+                sinGain[i] = sinf(c);
+            }
+        }
+
+        // peak absolute value and sum of squares of a block, in one pass
+        static inline void peakSumSq(const float *src, size_t numFrames, float &peak, float &sumSq) {
+            const size_t nv = vecFrames(numFrames);
+            Vec x;
+            Vec vpk(0.f);
+            Vec vsq(0.f);
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                x.load(src + i);
+                vpk = max_(vpk, abs(x));
+                vsq = vsq + x * x;
+            }
+            float pk = nv > 0 ? vpk.horizontal_max() : 0.f;
+            float sq = nv > 0 ? vsq.horizontal_sum() : 0.f;
+            for (; i < numFrames; ++i) {
+                const float a = fabsf(src[i]);
+                if (a > pk) { pk = a; }
+                sq += src[i] * src[i];
+            }
+            peak = pk;
+            sumSq = sq;
+        }
+
+        // dot products of x with two coefficient rows, in one pass over x
+        static inline void dot2(const float *x, const float *a, const float *b, size_t n,
+                                float &sumA, float &sumB) {
+            const size_t nv = vecFrames(n);
+            Vec vx, va, vb;
+            Vec accA(0.f);
+            Vec accB(0.f);
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                vx.load(x + i);
+                va.load(a + i);
+                vb.load(b + i);
+                accA = accA + vx * va;
+                accB = accB + vx * vb;
+            }
+            float sa = nv > 0 ? accA.horizontal_sum() : 0.f;
+            float sb = nv > 0 ? accB.horizontal_sum() : 0.f;
+            for (; i < n; ++i) {
+                sa += x[i] * a[i];
+                sb += x[i] * b[i];
+            }
+            sumA = sa;
+            sumB = sb;
+        }
+
+        // block ramp for a 1-pole smoother y[n] = x + (y[n-1] - x) * b.
+        // writes y[1..numFrames] to dst, and returns the final output value.
+        //
+        // closed form is y[n] = x + (y0 - x) * b^n,
+        // so each vector lane holds a run of successive powers of b,
+        // and the whole vector advances by b^VecSize per step.
+        static inline float logRamp(float *dst, float y0, float x, float b, size_t numFrames) {
+            if (numFrames == 0) { return y0; }
+            const size_t nv = vecFrames(numFrames);
+            const float d = y0 - x;
+            float powers[VecSize];
+            float p = 1.f;
+            for (size_t j = 0; j < VecSize; ++j) {
+                p *= b;
+                powers[j] = p;
+            }
+            // p == b^VecSize
+            const Vec step(p);
+            const Vec vx(x);
+            const Vec vd(d);
+            Vec vp;
+            vp.load(powers);
+            size_t i = 0;
+            for (; i < nv; i += VecSize) {
+                (vx + vd * vp).store(dst + i);
+                vp = vp * step;
+            }
+            float y = i > 0 ? dst[i - 1] : y0;
+            for (; i < numFrames; ++i) {
+                y = x + (y - x) * b;
+                dst[i] = y;
+            }
+            return y;
+        }
+    }
+}
+
+#endif //CRONE_SIMD_H
@@ -2,6 +2,9 @@
 // Created by emb on 11/28/18.
 //
 
+#include <algorithm>
+#include <cmath>
+
 #include <sndfile.hh>
 
 #include "BufDiskWorker.h"
@@ -14,31 +17,278 @@ static inline void clamp(size_t &x, const size_t a) {
     if (x > a) { x = a; }
 }
 
-crone::SoftcutClient::SoftcutClient() : Client<2, 2>("softcut") {
-    for (unsigned int i = 0; i < NumVoices; ++i) {
-        cut.setVoiceBuffer(i, buf[i & 1], BufFrames);
+static inline int clampVoiceCount(int n) {
+    if (n < 1) { return 1; }
+    if (n > crone::SoftcutClient::MaxVoices) { return crone::SoftcutClient::MaxVoices; }
+    return n;
+}
+
+crone::SoftcutClient::SoftcutClient(int nv, size_t nf, bool lockBuffers, const std::string &persistDir) :
+        Client<2, 2>("softcut"),
+        numVoices(clampVoiceCount(nv)), bufFrames(nf), cut(numVoices),
+        numInRoutes(0), numFbRoutes(0), routesDirty(true),
+        phaseEventsOn(false), voiceEventsOn(false), reportPhase(false), reportVoice(false),
+        blockStartFrame(0), blockStartUsecs(0), usecsPerFrame(0.f),
+        numTasks(0), blockFrames(0), sampleRate(48000.f) {
+    std::cout << "softcut: " << numVoices << " voices, " << bufFrames << " frames per buffer" << std::endl;
+    for (int i = 0; i < 2; ++i) {
+        if (persistDir.empty()) {
+            buf[i].allocate(bufFrames, lockBuffers);
+        } else {
+            buf[i].allocateFile(persistDir + "/softcut_buf" + std::to_string(i) + ".f32", bufFrames);
+        }
     }
-    bufIdx[0] = BufDiskWorker::registerBuffer(buf[0], BufFrames);
-    bufIdx[1] = BufDiskWorker::registerBuffer(buf[1], BufFrames);
+    for (int i = 0; i < numVoices; ++i) {
+        cut.setVoiceBuffer(i, buf[i & 1].data(), bufFrames);
+        voiceBuf[i] = i & 1;
+        recTailFrames[i] = 0;
+    }
+    for (int i = 0; i < MaxVoices; ++i) {
+        numVoiceEvents[i] = 0;
+        lastRecFlag[i] = false;
+        lastQuantPhase[i] = 0;
+        cutPending[i] = false;
+        loopStart[i] = 0.f;
+        loopEnd[i] = 0.f;
+        loopFlag[i] = false;
+        phaseQuant[i] = 1.f;
+        phaseOffset[i] = 0.f;
+    }
+    bufIdx[0] = BufDiskWorker::registerBuffer(buf[0]);
+    bufIdx[1] = BufDiskWorker::registerBuffer(buf[1]);
 
 }
 
 void crone::SoftcutClient::process(jack_nframes_t numFrames) {
     Commands::softcutCommands.handlePending(this);
+    params.applyDirty([this](size_t idx, float value) { applyParam(idx, value); });
     clearBusses(numFrames);
     mixInput(numFrames);
     // process softcuts (overwrites output bus)
-    for (int v = 0; v < NumVoices; ++v) {
-        if (enabled[v]) {
-            cut.processBlock(v, input[v].buf[0], output[v].buf[0], static_cast<int>(numFrames));
-        }
+    blockFrames = static_cast<int>(numFrames);
+    // block timing, for event timestamps
+    jack_nframes_t cycleFrames;
+    jack_time_t cycleUsecs, nextUsecs;
+    float periodUsecs;
+    if (jack_get_cycle_times(Client::client, &cycleFrames, &cycleUsecs, &nextUsecs, &periodUsecs) == 0
+        && nextUsecs > cycleUsecs) {
+        blockStartUsecs = cycleUsecs;
+        usecsPerFrame = static_cast<float>(nextUsecs - cycleUsecs) / static_cast<float>(numFrames);
+    } else {
+        blockStartUsecs = jack_get_time();
+        usecsPerFrame = 1e6f / sampleRate;
+    }
+    reportPhase = phaseEventsOn.load(std::memory_order_relaxed);
+    reportVoice = voiceEventsOn.load(std::memory_order_relaxed);
+    buildVoiceTasks();
+    meters.setBlockSize(numFrames);
+    workers.run(&SoftcutClient::processVoiceTask, this, numTasks);
+    for (int v = 0; v < numVoices; ++v) {
+        if (!enabled[v]) { meters.decay(v); }
     }
+    meters.publish();
+    pushEvents();
+    blockStartFrame += numFrames;
     mixOutput(numFrames);
     mix.copyTo(sink[0], numFrames);
 }
 
+void crone::SoftcutClient::buildVoiceTasks() {
+    // a buffer with a recording voice must be accessed by one thread at a time
+    bool bufRecording[2] = {false, false};
+    for (int v = 0; v < numVoices; ++v) {
+        streaming[v] = stream[v].claim();
+        if (enabled[v] && !streaming[v] && cut.getRecFlag(v)) {
+            bufRecording[voiceBuf[v]] = true;
+        }
+    }
+    int bufTask[2] = {-1, -1};
+    numTasks = 0;
+    for (int v = 0; v < numVoices; ++v) {
+        if (!enabled[v]) { continue; }
+        const int b = voiceBuf[v];
+        int t;
+        if (bufRecording[b] && !streaming[v]) {
+            if (bufTask[b] < 0) {
+                bufTask[b] = numTasks++;
+                taskSize[bufTask[b]] = 0;
+            }
+            t = bufTask[b];
+        } else {
+            t = numTasks++;
+            taskSize[t] = 0;
+        }
+        taskVoices[t][taskSize[t]++] = v;
+    }
+}
+
+void crone::SoftcutClient::processVoiceTask(void *self, int taskIdx) {
+    auto *sc = static_cast<SoftcutClient *>(self);
+    for (int i = 0; i < sc->taskSize[taskIdx]; ++i) {
+        const int v = sc->taskVoices[taskIdx][i];
+        if (sc->streaming[v]) {
+            sc->stream[v].processBlock(sc->input[v].buf[0], sc->output[v].buf[0], sc->blockFrames);
+        } else {
+            const float pos0 = sc->cut.getPos(v);
+            sc->cut.processBlock(v, sc->input[v].buf[0], sc->output[v].buf[0], sc->blockFrames);
+            const float pos1 = sc->cut.getPos(v);
+            if (sc->buf[sc->voiceBuf[v]].isFileBacked()) {
+                sc->markRecorded(v, pos0, pos1);
+            }
+            sc->collectEvents(v, pos0, pos1);
+        }
+        // each voice is metered by the task that processed it
+        sc->meters.update(v, sc->output[v].buf[0], static_cast<size_t>(sc->blockFrames));
+    }
+}
+
+// NB: this is deliberately conservative; a region marked but not written costs only a redundant msync.
+// the voice can write around its position (record offset), and after a jump the old subhead keeps recording
+// through a crossfade, so a margin of one fade time plus one chunk is marked around each position.
+void crone::SoftcutClient::markRecorded(int v, float pos0, float pos1) {
+    const float fadeTime = params.get(ParamFadeTime * MaxVoices + v);
+    if (cut.getRecFlag(v)) {
+        const float slew = params.get(ParamRecPreSlewTime * MaxVoices + v);
+        recTailFrames[v] = static_cast<size_t>((fadeTime + slew) * sampleRate) + blockFrames;
+    } else if (recTailFrames[v] > 0) {
+        recTailFrames[v] = recTailFrames[v] > static_cast<size_t>(blockFrames) ? recTailFrames[v] - blockFrames : 0;
+    } else {
+        return;
+    }
+    auto &b = buf[voiceBuf[v]];
+    const float f0 = pos0 * sampleRate;
+    const float f1 = pos1 * sampleRate;
+    const float rate = std::max(1.f, std::fabs(params.get(ParamRate * MaxVoices + v)));
+    const auto margin = static_cast<float>(SampleBuffer::DirtyChunkFrames) + fadeTime * rate * sampleRate;
+    auto mark = [&b, margin](float a, float c) {
+        const float lo = std::max(0.f, a - margin);
+        const float hi = std::max(0.f, c + margin);
+        b.markDirty(static_cast<size_t>(lo), static_cast<size_t>(hi));
+    };
+    if (std::fabs(f1 - f0) <= static_cast<float>(SampleBuffer::DirtyChunkFrames)) {
+        // continuous motion
+        mark(std::min(f0, f1), std::max(f0, f1));
+    } else {
+        // loop wrap or cut
+        mark(f0, f0);
+        mark(f1, f1);
+    }
+}
+
+bool crone::SoftcutClient::addEvent(int v, SoftcutEvents::Type type, float frameOffset, float value) {
+    if (numVoiceEvents[v] >= MaxEventsPerVoice) { return false; }
+    const float maxOffset = static_cast<float>(blockFrames - 1);
+    const auto offset = static_cast<uint64_t>(std::lrint(std::min(std::max(frameOffset, 0.f), maxOffset)));
+    SoftcutEvents::Event &ev = voiceEvents[v][numVoiceEvents[v]++];
+    ev.frame = blockStartFrame + offset;
+    ev.usecs = blockStartUsecs + static_cast<jack_time_t>(static_cast<float>(offset) * usecsPerFrame);
+    ev.voice = v;
+    ev.type = type;
+    ev.value = value;
+    return true;
+}
+
+// the voice reports floor((pos + offset) / quant) * quant,
+// so a crossing happens where pos + offset passes a multiple of quant.
+// within a block, position is taken to move linearly.
+void crone::SoftcutClient::addPhaseCrossings(int v, float a, float b, float f0, float f1, float quant,
+                                             float offset, softcut::phase_t &reported) {
+    // more crossings than this in one segment are reduced to the last one
+    static constexpr int maxCrossings = 4;
+    const float pa = a + offset;
+    const float pb = b + offset;
+    if (pa == pb) { return; }
+    const auto ka = static_cast<long>(std::floor(pa / quant));
+    const auto kb = static_cast<long>(std::floor(pb / quant));
+    if (ka == kb) { return; }
+    const long dir = kb > ka ? 1 : -1;
+    // increasing: boundary k * quant is reached, and reported as k.
+    // decreasing: boundary k * quant is left, and (k - 1) is reported
+    long first = dir > 0 ? ka + 1 : ka;
+    const long last = dir > 0 ? kb : kb + 1;
+    if ((last - first) * dir >= maxCrossings) { first = last; }
+    for (long k = first; ; k += dir) {
+        const float x = static_cast<float>(k) * quant;
+        const float frame = f0 + (x - pa) / (pb - pa) * (f1 - f0);
+        const softcut::phase_t value = static_cast<float>(dir > 0 ? k : k - 1) * quant;
+        if (value != reported) {
+            addEvent(v, SoftcutEvents::PhaseCrossing, frame, value);
+            reported = value;
+        }
+        if (k == last) { break; }
+    }
+}
+
+void crone::SoftcutClient::collectEvents(int v, float pos0, float pos1) {
+    numVoiceEvents[v] = 0;
+    const bool rec = cut.getRecFlag(v);
+    const bool jumped = cutPending[v];
+    cutPending[v] = false;
+    // flags are applied at the start of the block
+    if (reportVoice && rec != lastRecFlag[v]) {
+        addEvent(v, rec ? SoftcutEvents::RecStart : SoftcutEvents::RecStop, 0.f, pos0);
+    }
+    lastRecFlag[v] = rec;
+
+    const auto n = static_cast<float>(blockFrames);
+    const float rate = params.get(ParamRate * MaxVoices + v);
+    const bool wrapped = !jumped && loopFlag[v] && loopEnd[v] > loopStart[v]
+                         && ((rate > 0.f && pos1 < pos0) || (rate < 0.f && pos1 > pos0));
+    float wrapFrame = 0.f;
+    if (wrapped) {
+        // distance travelled before and after the wrap
+        const float d0 = rate > 0.f ? loopEnd[v] - pos0 : pos0 - loopStart[v];
+        const float d1 = rate > 0.f ? pos1 - loopStart[v] : loopEnd[v] - pos1;
+        wrapFrame = d0 + d1 > 0.f ? n * std::max(d0, 0.f) / (d0 + d1) : 0.f;
+        if (reportVoice) {
+            addEvent(v, SoftcutEvents::LoopWrap, wrapFrame, rate > 0.f ? loopStart[v] : loopEnd[v]);
+        }
+    }
+
+    const softcut::phase_t q1 = cut.getQuantPhase(v);
+    if (reportPhase && q1 != lastQuantPhase[v]) {
+        const float quant = phaseQuant[v].load(std::memory_order_relaxed);
+        const float offset = phaseOffset[v].load(std::memory_order_relaxed);
+        softcut::phase_t reported = lastQuantPhase[v];
+        if (quant > 0.f && !jumped) {
+            if (wrapped) {
+                const float edge0 = rate > 0.f ? loopEnd[v] : loopStart[v];
+                const float edge1 = rate > 0.f ? loopStart[v] : loopEnd[v];
+                addPhaseCrossings(v, pos0, edge0, 0.f, wrapFrame, quant, offset, reported);
+                const softcut::phase_t atWrap = std::floor((edge1 + offset) / quant) * quant;
+                if (atWrap != reported) {
+                    addEvent(v, SoftcutEvents::PhaseCrossing, wrapFrame, atWrap);
+                    reported = atWrap;
+                }
+                addPhaseCrossings(v, edge1, pos1, wrapFrame, n, quant, offset, reported);
+            } else {
+                addPhaseCrossings(v, pos0, pos1, 0.f, n, quant, offset, reported);
+            }
+        }
+        // cuts, unquantized phase, and anything the estimate missed: report the final value
+        if (reported != q1) {
+            addEvent(v, SoftcutEvents::PhaseCrossing, jumped ? 0.f : n - 1.f, q1);
+        }
+    }
+    lastQuantPhase[v] = q1;
+}
+
+void crone::SoftcutClient::pushEvents() {
+    if (!reportPhase && !reportVoice) { return; }
+    for (int v = 0; v < numVoices; ++v) {
+        for (int i = 0; i < numVoiceEvents[v]; ++i) {
+            events.push(voiceEvents[v][i]);
+        }
+        numVoiceEvents[v] = 0;
+    }
+    events.notify();
+}
+
 void crone::SoftcutClient::setSampleRate(jack_nframes_t sr) {
+    sampleRate = static_cast<float>(sr);
     cut.setSampleRate(sr);
+    meters.setSampleRate(sampleRate);
+    for (auto &s : stream) { s.setSampleRate(sampleRate); }
 }
 
 
@@ -47,179 +297,253 @@ void crone::SoftcutClient::clearBusses(size_t numFrames) {
     for (auto &b : input) { b.clear(numFrames); }
 }
 
+// a route is silent if its level has settled at zero
+static inline bool isSilent(crone::LogRamp &level) {
+    return level.isSettled() && level.getValue() == 0.f;
+}
+
+// a route is unity if its level has settled at one
+static inline bool isUnity(crone::LogRamp &level) {
+    return level.isSettled() && level.getValue() == 1.f;
+}
+
+void crone::SoftcutClient::updateRoutes() {
+    numInRoutes = 0;
+    for (int ch = 0; ch < 2; ++ch) {
+        for (int dst = 0; dst < numVoices; ++dst) {
+            if (!isSilent(inLevel[ch][dst])) {
+                inRoutes[numInRoutes++] = {ch, dst};
+            }
+        }
+    }
+    numFbRoutes = 0;
+    for (int src = 0; src < numVoices; ++src) {
+        for (int dst = 0; dst < numVoices; ++dst) {
+            if (!isSilent(fbLevel[src][dst])) {
+                fbRoutes[numFbRoutes++] = {src, dst};
+            }
+        }
+    }
+    routesDirty = false;
+}
+
 void crone::SoftcutClient::mixInput(size_t numFrames) {
-    for (int dst = 0; dst < NumVoices; ++dst) {
-        if (cut.getRecFlag(dst)) {
-            for (int ch = 0; ch < 2; ++ch) {
-                input[dst].mixFrom(&source[SourceAdc][ch], numFrames, inLevel[ch][dst]);
+    if (routesDirty) {
+        updateRoutes();
+    }
+    // NB: routes into a voice that isn't recording are skipped without advancing their level ramps,
+    // and may be dropped from the list only after they settle.
+    int i = 0;
+    while (i < numInRoutes) {
+        const Route &r = inRoutes[i];
+        LogRamp &level = inLevel[r.src][r.dst];
+        if (isSilent(level)) {
+            inRoutes[i] = inRoutes[--numInRoutes];
+            continue;
+        }
+        if (cut.getRecFlag(r.dst)) {
+            if (isUnity(level)) {
+                input[r.dst].addFrom(&source[SourceAdc][r.src], numFrames);
+            } else {
+                input[r.dst].mixFrom(&source[SourceAdc][r.src], numFrames, level);
             }
-            for (int src = 0; src < NumVoices; ++src) {
-                if (cut.getPlayFlag(src)) {
-                    input[dst].mixFrom(output[src], numFrames, fbLevel[src][dst]);
-                }
+        }
+        ++i;
+    }
+    i = 0;
+    while (i < numFbRoutes) {
+        const Route &r = fbRoutes[i];
+        LogRamp &level = fbLevel[r.src][r.dst];
+        if (isSilent(level)) {
+            fbRoutes[i] = fbRoutes[--numFbRoutes];
+            continue;
+        }
+        if (cut.getRecFlag(r.dst) && cut.getPlayFlag(r.src)) {
+            if (isUnity(level)) {
+                input[r.dst].addFrom(output[r.src], numFrames);
+            } else {
+                input[r.dst].mixFrom(output[r.src], numFrames, level);
             }
         }
+        ++i;
     }
 }
 
 void crone::SoftcutClient::mixOutput(size_t numFrames) {
-    for (int v = 0; v < NumVoices; ++v) {
+    for (int v = 0; v < numVoices; ++v) {
         if (cut.getPlayFlag(v)) {
             mix.panMixEpFrom(output[v], numFrames, outLevel[v], outPan[v]);
         }
     }
 }
 
-void crone::SoftcutClient::handleCommand(Commands::CommandPacket *p) {
-    switch (p->id) {
-        //-- softcut routing
-    case Commands::Id::SET_ENABLED_CUT:
-	enabled[p->idx_0] = p->value > 0.f;
+// setters for VoiceParam values from ParamRecPreSlewTime onwards, in order
+static void (crone::SoftcutVoices::*const voiceSetters[])(int, float) = {
+        &crone::SoftcutVoices::setRecPreSlewTime,
+        &crone::SoftcutVoices::setRateSlewTime,
+        &crone::SoftcutVoices::setRate,
+        &crone::SoftcutVoices::setFadeTime,
+        &crone::SoftcutVoices::setRecLevel,
+        &crone::SoftcutVoices::setPreLevel,
+        &crone::SoftcutVoices::setRecOffset,
+        &crone::SoftcutVoices::setPreFilterFc,
+        &crone::SoftcutVoices::setPreFilterFcMod,
+        &crone::SoftcutVoices::setPreFilterRq,
+        &crone::SoftcutVoices::setPreFilterLp,
+        &crone::SoftcutVoices::setPreFilterHp,
+        &crone::SoftcutVoices::setPreFilterBp,
+        &crone::SoftcutVoices::setPreFilterBr,
+        &crone::SoftcutVoices::setPreFilterDry,
+        &crone::SoftcutVoices::setPostFilterFc,
+        &crone::SoftcutVoices::setPostFilterRq,
+        &crone::SoftcutVoices::setPostFilterLp,
+        &crone::SoftcutVoices::setPostFilterHp,
+        &crone::SoftcutVoices::setPostFilterBp,
+        &crone::SoftcutVoices::setPostFilterBr,
+        &crone::SoftcutVoices::setPostFilterDry,
+};
+static_assert(sizeof(voiceSetters) / sizeof(voiceSetters[0])
+              == crone::SoftcutClient::NumVoiceParams - crone::SoftcutClient::ParamRecPreSlewTime,
+              "voiceSetters must cover every voice parameter");
+
+void crone::SoftcutClient::applyParam(size_t idx, float value) {
+    if (idx >= FbLevelParamOffset) {
+        idx -= FbLevelParamOffset;
+        fbLevel[idx / MaxVoices][idx % MaxVoices].setTarget(value);
+        routesDirty = true;
+        return;
+    }
+    if (idx >= InLevelParamOffset) {
+        idx -= InLevelParamOffset;
+        inLevel[idx / MaxVoices][idx % MaxVoices].setTarget(value);
+        routesDirty = true;
+        return;
+    }
+    const auto param = static_cast<int>(idx / MaxVoices);
+    const auto v = static_cast<int>(idx % MaxVoices);
+    switch (param) {
+    case ParamLevelSlewTime:
+	outLevel[v].setTime(value);
 	break;
-    case Commands::Id::SET_LEVEL_CUT:
-	outLevel[p->idx_0].setTarget(p->value);
-	break;;
-    case Commands::Id::SET_PAN_CUT:
-	outPan[p->idx_0].setTarget((p->value/2)+0.5); // map -1,1 to 0,1
+    case ParamPanSlewTime:
+	outPan[v].setTime(value);
 	break;
-    case Commands::Id::SET_LEVEL_IN_CUT:
-	inLevel[p->idx_0][p->idx_1].setTarget(p->value);
+    case ParamLevel:
+	outLevel[v].setTarget(value);
 	break;
-    case Commands::Id::SET_LEVEL_CUT_CUT:
-	fbLevel[p->idx_0][p->idx_1].setTarget(p->value);
+    case ParamPan:
+	outPan[v].setTarget((value/2)+0.5); // map -1,1 to 0,1
 	break;
-	//-- softcut commands
-    case Commands::Id::SET_CUT_RATE:
-	cut.setRate(p->idx_0, p->value);
+    case ParamFadeTime:
+	cut.setFadeTime(v, value);
+	stream[v].setFadeTime(value);
+	break;
+    case ParamRecLevel:
+	cut.setRecLevel(v, value);
+	stream[v].setRecLevel(value);
+	break;
+    case ParamPreLevel:
+	cut.setPreLevel(v, value);
+	stream[v].setPreLevel(value);
+	break;
+    default:
+	(cut.*voiceSetters[param - ParamRecPreSlewTime])(v, value);
+    }
+}
+
+void crone::SoftcutClient::handleCommand(Commands::CommandPacket *p) {
+    // indices come unchecked from OSC / IPC; every command addresses a voice with idx_0
+    if (p->idx_0 < 0 || p->idx_0 >= numVoices) { return; }
+    switch (p->id) {
+    case Commands::Id::SET_ENABLED_CUT:
+	enabled[p->idx_0] = p->value > 0.f;
 	break;
     case Commands::Id::SET_CUT_LOOP_START:
 	cut.setLoopStart(p->idx_0, p->value);
+	stream[p->idx_0].setLoopStart(p->value);
+	loopStart[p->idx_0] = p->value;
 	break;
     case Commands::Id::SET_CUT_LOOP_END:
 	cut.setLoopEnd(p->idx_0, p->value);
+	stream[p->idx_0].setLoopEnd(p->value);
+	loopEnd[p->idx_0] = p->value;
 	break;
     case Commands::Id::SET_CUT_LOOP_FLAG:
 	cut.setLoopFlag(p->idx_0, p->value > 0.f);
-	break;
-    case Commands::Id::SET_CUT_FADE_TIME:
-	cut.setFadeTime(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_REC_LEVEL:
-	cut.setRecLevel(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_LEVEL:
-	cut.setPreLevel(p->idx_0, p->value);
+	stream[p->idx_0].setLoopFlag(p->value > 0.f);
+	loopFlag[p->idx_0] = p->value > 0.f;
 	break;
     case Commands::Id::SET_CUT_REC_FLAG:
 	cut.setRecFlag(p->idx_0, p->value > 0.f);
+	stream[p->idx_0].setRecFlag(p->value > 0.f);
 	break;
     case Commands::Id::SET_CUT_PLAY_FLAG:
 	cut.setPlayFlag(p->idx_0, p->value > 0.f);
-	break;
-    case Commands::Id::SET_CUT_REC_OFFSET:
-	cut.setRecOffset(p->idx_0, p->value);
+	stream[p->idx_0].setPlayFlag(p->value > 0.f);
 	break;
     case Commands::Id::SET_CUT_POSITION:
 	cut.cutToPos(p->idx_0, p->value);
-	break;
-	// input filter
-    case Commands::Id::SET_CUT_PRE_FILTER_FC:
-	cut.setPreFilterFc(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_FILTER_FC_MOD:
-	cut.setPreFilterFcMod(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_FILTER_RQ:
-	cut.setPreFilterRq(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_FILTER_LP:
-	cut.setPreFilterLp(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_FILTER_HP:
-	cut.setPreFilterHp(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_FILTER_BP:
-	cut.setPreFilterBp(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_FILTER_BR:
-	cut.setPreFilterBr(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_PRE_FILTER_DRY:
-	cut.setPreFilterDry(p->idx_0, p->value);
-	break;
-	// -- output filter
-    case Commands::Id::SET_CUT_POST_FILTER_FC:
-	cut.setPostFilterFc(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_POST_FILTER_RQ:
-	cut.setPostFilterRq(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_POST_FILTER_LP:
-	cut.setPostFilterLp(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_POST_FILTER_HP:
-	cut.setPostFilterHp(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_POST_FILTER_BP:
-	cut.setPostFilterBp(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_POST_FILTER_BR:
-	cut.setPostFilterBr(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_POST_FILTER_DRY:
-	cut.setPostFilterDry(p->idx_0, p->value);
-	break;
-
-    case Commands::Id::SET_CUT_LEVEL_SLEW_TIME:
-	outLevel[p->idx_0].setTime(p->value);
-	break;
-    case Commands::Id::SET_CUT_PAN_SLEW_TIME:
-	outPan[p->idx_0].setTime(p->value);
-	break;
-    case Commands::Id::SET_CUT_RECPRE_SLEW_TIME:
-	cut.setRecPreSlewTime(p->idx_0, p->value);
-	break;
-    case Commands::Id::SET_CUT_RATE_SLEW_TIME:
-	cut.setRateSlewTime(p->idx_0, p->value);
+	stream[p->idx_0].cutToPos(p->value);
+	cutPending[p->idx_0] = true;
 	break;
     case Commands::Id::SET_CUT_VOICE_SYNC:
+	if (p->idx_1 < 0 || p->idx_1 >= numVoices) { break; }
 	cut.syncVoice(p->idx_0, p->idx_1, p->value);
+	cutPending[p->idx_0] = true;
 	break;
     case Commands::Id::SET_CUT_BUFFER:
-	cut.setVoiceBuffer(p->idx_0, buf[p->idx_1], BufFrames);
+	if (p->idx_1 < 0 || p->idx_1 > 1) { break; }
+	cut.setVoiceBuffer(p->idx_0, buf[p->idx_1].data(), bufFrames);
+	voiceBuf[p->idx_0] = p->idx_1;
+	break;
+    case Commands::Id::RESET_CUT:
+	resetVoice(p->idx_0);
 	break;
     default:;;
     }
 }
 
 void crone::SoftcutClient::reset() {
-    for (int v = 0; v < NumVoices; ++v) {
-        cut.setVoiceBuffer(v, buf[v%2], BufFrames);
-        outLevel[v].setTarget(0.f);
-        outLevel->setTime(0.001);
-        outPan[v].setTarget(0.5f);
-        outPan->setTime(0.001);
-
-        enabled[v] = false;
-
-        setPhaseQuant(v, 1.f);
-        setPhaseOffset(v, 0.f);
-
+    for (int v = 0; v < numVoices; ++v) {
+        // levels go through the parameter store, so no stale pending value can override them
+        setVoiceParam(ParamLevel, v, 0.f);
+        setVoiceParam(ParamPan, v, 0.f);
         for (int i=0; i<2; ++i) {
-            inLevel[i][v].setTime(0.001);
-            inLevel[i][v].setTarget(0.0);
+            setInLevel(i, v, 0.f);
         }
-
-        for (int w=0; w<NumVoices; ++w) {
-            fbLevel[v][w].setTime(0.001);
-            fbLevel[v][w].setTarget(0.0);
+        for (int w=0; w<numVoices; ++w) {
+            setFeedbackLevel(v, w, 0.f);
         }
+        // the rest is voice state, which only the audio thread may touch
+        Commands::softcutCommands.post(Commands::Id::RESET_CUT, v, 0.f);
+    }
+}
+
+void crone::SoftcutClient::resetVoice(int v) {
+    cut.setVoiceBuffer(v, buf[v%2].data(), bufFrames);
+    voiceBuf[v] = v%2;
+    outLevel[v].setTime(0.001);
+    outPan[v].setTime(0.001);
+
+    enabled[v] = false;
 
-        cut.setLoopStart(v, v*2);
-        cut.setLoopEnd(v, v*2 + 1);
+    setPhaseQuant(v, 1.f);
+    setPhaseOffset(v, 0.f);
 
-        output[v].clear();
-        input[v].clear();
+    for (int i=0; i<2; ++i) {
+        inLevel[i][v].setTime(0.001);
     }
-    cut.reset();
+    for (int w=0; w<numVoices; ++w) {
+        fbLevel[v][w].setTime(0.001);
+    }
+
+    cut.setLoopStart(v, v*2);
+    cut.setLoopEnd(v, v*2 + 1);
+    loopStart[v] = v*2;
+    loopEnd[v] = v*2 + 1;
+
+    output[v].clear();
+    input[v].clear();
+    routesDirty = true;
+    cut.resetVoice(v);
 }
@@ -5,13 +5,20 @@
 #ifndef CRONE_CUTCLIENT_H
 #define CRONE_CUTCLIENT_H
 
+#include <atomic>
 #include <iostream>
 
 #include "BufDiskWorker.h"
 #include "Bus.h"
 #include "Client.h"
+#include "Meter.h"
+#include "ParamStore.h"
+#include "SampleBuffer.h"
+#include "SoftcutEvents.h"
+#include "SoftcutVoices.h"
+#include "StreamVoice.h"
 #include "Utilities.h"
-#include "softcut/Softcut.h"
+#include "WorkerPool.h"
 #include "softcut/Types.h"
 
 
@@ -19,102 +26,300 @@ namespace crone {
     class SoftcutClient: public Client<2, 2> {
     public:
         enum { MaxBlockFrames = 2048};
-        enum { BufFrames = 16777216 };
-        enum { NumVoices = 6 };
+        // voice count and buffer size are chosen at startup;
+        // per-voice state is statically sized for the maximum voice count.
+        enum { MaxVoices = 16 };
+        enum { DefaultVoices = 6 };
+        enum { DefaultBufFrames = 16777216 };
         typedef enum { SourceAdc=0 } SourceId;
         typedef Bus<2, MaxBlockFrames> StereoBus;
         typedef Bus<1, MaxBlockFrames> MonoBus;
+
+        // continuous per-voice parameters, set through the parameter store.
+        // within a block, changes are applied in this order,
+        // so slew times take effect before the values they slew.
+        typedef enum {
+            // mix (handled by the client)
+            ParamLevelSlewTime,
+            ParamPanSlewTime,
+            ParamLevel,
+            ParamPan,
+            // voice (handled by softcut)
+            ParamRecPreSlewTime,
+            ParamRateSlewTime,
+            ParamRate,
+            ParamFadeTime,
+            ParamRecLevel,
+            ParamPreLevel,
+            ParamRecOffset,
+            ParamPreFilterFc,
+            ParamPreFilterFcMod,
+            ParamPreFilterRq,
+            ParamPreFilterLp,
+            ParamPreFilterHp,
+            ParamPreFilterBp,
+            ParamPreFilterBr,
+            ParamPreFilterDry,
+            ParamPostFilterFc,
+            ParamPostFilterRq,
+            ParamPostFilterLp,
+            ParamPostFilterHp,
+            ParamPostFilterBp,
+            ParamPostFilterBr,
+            ParamPostFilterDry,
+            NumVoiceParams
+        } VoiceParam;
+
+    private:
+        // parameter store layout: [param][voice], then [channel][voice] input levels,
+        // then [src][dst] feedback levels
+        enum {
+            InLevelParamOffset = NumVoiceParams * MaxVoices,
+            FbLevelParamOffset = InLevelParamOffset + 2 * MaxVoices,
+            NumParams = FbLevelParamOffset + MaxVoices * MaxVoices
+        };
+
     public:
-        SoftcutClient();
+        // numVoices is clamped to [1, MaxVoices].
+        // if lockBuffers is set, buffer memory is committed and locked up front;
+        // otherwise it is paged in as it is first used.
+        // if persistDir is not empty, each buffer is mapped from a raw float32 file in that directory,
+        // so buffer contents survive a restart.
+        explicit SoftcutClient(int numVoices = DefaultVoices,
+                               size_t bufFrames = DefaultBufFrames,
+                               bool lockBuffers = false,
+                               const std::string &persistDir = "");
 
     private:
+        const int numVoices;
+        const size_t bufFrames;
         // processors
-        softcut::Softcut<NumVoices> cut;
+        SoftcutVoices cut;
         // main buffer
-        float buf[2][BufFrames];
+        SampleBuffer buf[2];
         // buffer index for use with BufDiskWorker
         int bufIdx[2];
+        // buffer used by each voice
+        int voiceBuf[MaxVoices];
         // busses
         StereoBus mix;
-        MonoBus input[NumVoices];
-        MonoBus output[NumVoices];
+        MonoBus input[MaxVoices];
+        MonoBus output[MaxVoices];
         // levels
-        LogRamp inLevel[2][NumVoices];
-        LogRamp outLevel[NumVoices];
-        LogRamp outPan[NumVoices];
-        LogRamp fbLevel[NumVoices][NumVoices];
+        LogRamp inLevel[2][MaxVoices];
+        LogRamp outLevel[MaxVoices];
+        LogRamp outPan[MaxVoices];
+        LogRamp fbLevel[MaxVoices][MaxVoices];
+        // sparse routing for input and feedback levels.
+        // only routes with a nonzero or still-moving level are mixed;
+        // lists are rebuilt when a level command arrives,
+        // and routes are dropped once their level settles at zero.
+        struct Route {
+            int src;
+            int dst;
+        };
+        Route inRoutes[2 * MaxVoices];
+        int numInRoutes;
+        Route fbRoutes[MaxVoices * MaxVoices];
+        int numFbRoutes;
+        bool routesDirty;
         // enabled flags
-        bool enabled[NumVoices];
-        softcut::phase_t quantPhase[NumVoices];
+        bool enabled[MaxVoices];
+        // voices playing / recording against a file instead of a buffer
+        StreamVoice stream[MaxVoices];
+        // stream state claimed for the current block
+        bool streaming[MaxVoices];
+        // event reporting.
+        // voice tasks collect each voice's events for the block; the audio thread then pushes them in voice order,
+        // so the event ring has a single producer
+        enum { MaxEventsPerVoice = 16 };
+        SoftcutEvents events;
+        std::atomic<bool> phaseEventsOn;
+        std::atomic<bool> voiceEventsOn;
+        // flags latched for the current block
+        bool reportPhase;
+        bool reportVoice;
+        SoftcutEvents::Event voiceEvents[MaxVoices][MaxEventsPerVoice];
+        int numVoiceEvents[MaxVoices];
+        // frame count and JACK time at the start of the current block
+        uint64_t blockStartFrame;
+        jack_time_t blockStartUsecs;
+        float usecsPerFrame;
+        // voice state at the end of the last block, and since the last block
+        bool lastRecFlag[MaxVoices];
+        softcut::phase_t lastQuantPhase[MaxVoices];
+        bool cutPending[MaxVoices];
+        // loop state, as last commanded (audio thread)
+        float loopStart[MaxVoices];
+        float loopEnd[MaxVoices];
+        bool loopFlag[MaxVoices];
+        // phase quantization, as last set (for locating crossings within a block)
+        std::atomic<float> phaseQuant[MaxVoices];
+        std::atomic<float> phaseOffset[MaxVoices];
+        // output level of each voice, before level and pan
+        MeterBank<MaxVoices> meters;
+
+        // parallel voice processing.
+        // each task is a list of voices to be processed in order;
+        // voices sharing a buffer with a recording voice go in the same task.
+        WorkerPool workers;
+        int taskVoices[MaxVoices][MaxVoices];
+        int taskSize[MaxVoices];
+        int numTasks;
+        int blockFrames;
+        float sampleRate;
+
+        // dirty tracking for file-backed buffers:
+        // frames left to mark after a voice stops recording (its record head fades out)
+        size_t recTailFrames[MaxVoices];
+
+        ParamStore<NumParams> params;
 
     private:
         void process(jack_nframes_t numFrames) override;
+        void buildVoiceTasks();
+        static void processVoiceTask(void *self, int taskIdx);
+        // mark buffer regions a voice may have written during the last block, given its positions before and after
+        void markRecorded(int voice, float pos0, float pos1);
+        // collect events for a voice, given its positions before and after the block
+        void collectEvents(int voice, float pos0, float pos1);
+        bool addEvent(int voice, SoftcutEvents::Type type, float frameOffset, float value);
+        // add phase crossings for monotonic motion from pos a to pos b, between the given frame offsets.
+        // `reported` is the last quantized phase reported, and is updated
+        void addPhaseCrossings(int voice, float a, float b, float f0, float f1, float quant, float offset,
+                               softcut::phase_t &reported);
+        void pushEvents();
         void setSampleRate(jack_nframes_t) override;
+        void applyParam(size_t idx, float value);
         inline size_t secToFrame(float sec) {
             return static_cast<size_t >(sec * jack_get_sample_rate(Client::client));
         }
 
     public:
-        /// FIXME: the "commands" structure shouldn't really be necessary.
-        /// should be able to refactor most/all parameters for atomic access.
-        // called from audio thread
+        // called from audio thread, for discrete events (flags, positions, buffer assignment)
         void handleCommand(Commands::CommandPacket *p) override;
 
+        // continuous parameters: called from the OSC thread, applied at the start of the next block
+        void setVoiceParam(VoiceParam param, int voice, float value) {
+            if (voice < 0 || voice >= numVoices) { return; }
+            params.set(param * MaxVoices + voice, value);
+        }
+
+        // level of input channel -> voice
+        void setInLevel(int ch, int voice, float value) {
+            if (ch < 0 || ch > 1 || voice < 0 || voice >= numVoices) { return; }
+            params.set(InLevelParamOffset + ch * MaxVoices + voice, value);
+        }
+
+        // level of voice -> voice
+        void setFeedbackLevel(int src, int dst, float value) {
+            if (src < 0 || src >= numVoices || dst < 0 || dst >= numVoices) { return; }
+            params.set(FbLevelParamOffset + src * MaxVoices + dst, value);
+        }
+
         // these accessors can be called from other threads, so don't need to go through the commands queue
         //-- buffer manipulation
         //-- time parameters are in seconds
         //-- negative 'dur' parameter reads/clears/writes as much as possible.
+        //-- if jobId >= 0, progress and completion are reported through the BufDiskWorker job callback.
         void readBufferMono(const std::string &path, float startTimeSrc = 0.f, float startTimeDst = 0.f,
-                            float dur = -1.f, int chanSrc = 0, int chanDst = 0) {
-            BufDiskWorker::requestReadMono(bufIdx[chanDst], path, startTimeSrc, startTimeDst, dur, chanSrc);
+                            float dur = -1.f, int chanSrc = 0, int chanDst = 0, int jobId = -1) {
+            if (chanDst < 0 || chanDst > 1) { return; }
+            BufDiskWorker::requestReadMono(bufIdx[chanDst], path, startTimeSrc, startTimeDst, dur, chanSrc, jobId);
         }
 
         void readBufferStereo(const std::string &path, float startTimeSrc = 0.f, float startTimeDst = 0.f,
-                              float dur = -1.f) {
-            BufDiskWorker::requestReadStereo(bufIdx[0], bufIdx[1], path, startTimeSrc, startTimeDst, dur);
+                              float dur = -1.f, int jobId = -1) {
+            BufDiskWorker::requestReadStereo(bufIdx[0], bufIdx[1], path, startTimeSrc, startTimeDst, dur, jobId);
         }
 
-        void writeBufferMono(const std::string &path, float start, float dur, int chan) {
-            BufDiskWorker::requestWriteMono(bufIdx[chan], path, start, dur);
+        void writeBufferMono(const std::string &path, float start, float dur, int chan, int jobId = -1) {
+            if (chan < 0 || chan > 1) { return; }
+            BufDiskWorker::requestWriteMono(bufIdx[chan], path, start, dur, jobId);
 
         }
 
-        void writeBufferStereo(const std::string &path, float start, float dur) {
-            BufDiskWorker::requestWriteStereo(bufIdx[0], bufIdx[1], path, start, dur);
+        void writeBufferStereo(const std::string &path, float start, float dur, int jobId = -1) {
+            BufDiskWorker::requestWriteStereo(bufIdx[0], bufIdx[1], path, start, dur, jobId);
         }
 
-        void clearBuffer(int chan, float start=0.f, float dur=-1) {
+        void clearBuffer(int chan, float start=0.f, float dur=-1, int jobId = -1) {
             if (chan < 0 || chan > 1) { return; }
-            BufDiskWorker::requestClear(bufIdx[chan], start, dur);
+            BufDiskWorker::requestClear(bufIdx[chan], start, dur, jobId);
         }
 
-        // check if quantized phase has changed for a given voice
-        // returns true
-        bool checkVoiceQuantPhase(int i) {
-            if (quantPhase[i] != cut.getQuantPhase(i)) {
-                quantPhase[i] = cut.getQuantPhase(i);
-                return true;
-            } else {
-                return false;
-            }
+        // flush regions written since the last sync to the buffer files (if buffers are persistent).
+        // only the final job reports completion
+        void syncBuffers(int jobId = -1) {
+            BufDiskWorker::requestSync(bufIdx[0]);
+            BufDiskWorker::requestSync(bufIdx[1], jobId);
         }
+
+        bool isPersistent() const { return buf[0].isFileBacked(); }
+
+        //-- streaming voices
+        //-- while a stream is open, the voice plays and records against the file instead of its buffer
+
+        bool openStream(int voice, const std::string &path, float minDur = 0.f) {
+            if (voice < 0 || voice >= numVoices) { return false; }
+            return stream[voice].open(path, minDur);
+        }
+
+        void closeStream(int voice) {
+            if (voice < 0 || voice >= numVoices) { return; }
+            stream[voice].close();
+        }
+
         softcut::phase_t getQuantPhase(int i) {
+            if (i < 0 || i >= numVoices) { return 0; }
             return cut.getQuantPhase(i);
         }
         void setPhaseQuant(int i, softcut::phase_t q) {
+            if (i < 0 || i >= numVoices) { return; }
+            phaseQuant[i] = static_cast<float>(q);
             cut.setPhaseQuant(i, q);
         }
         void setPhaseOffset(int i, float sec) {
+            if (i < 0 || i >= numVoices) { return; }
+            phaseOffset[i] = sec;
             cut.setPhaseOffset(i, sec);
         }
 
-        int getNumVoices() const { return NumVoices; }
+        //-- event reporting
+        // start / stop the sender thread
+        void startEvents(lo_address addr) { events.start(addr); }
+        void stopEvents() { events.stop(); }
+        // report quantized phase changes (replacing the phase poll)
+        void setPhaseEvents(bool on) { phaseEventsOn = on; }
+        // report loop wraps and record start / stop
+        void setVoiceEvents(bool on) { voiceEventsOn = on; }
+
+        int getNumVoices() const { return numVoices; }
+        // consistent snapshot of all voice meters, from any thread
+        void readMeters(MeterBank<MaxVoices>::Snapshot &snap) const {
+            meters.read(snap);
+        }
+        size_t getBufferFrames() const { return bufFrames; }
+
+        // start worker threads for parallel voice processing, at the JACK RT priority.
+        // call after setup()
+        void startWorkers(int numThreads) {
+            workers.start(numThreads, jack_client_real_time_priority(Client::client));
+        }
+
+        void stopWorkers() {
+            workers.stop();
+        }
 
+	// zero all levels, and queue a reset of each voice for the audio thread
 	void reset();
 
     private:
+        // called from audio thread: buffer, loop points, phase quantization and softcut state back to defaults
+        void resetVoice(int voice);
         void clearBusses(size_t numFrames);
         void mixInput(size_t numFrames);
+        void updateRoutes();
         void mixOutput(size_t numFrames);
     };
 }
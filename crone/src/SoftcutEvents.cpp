@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <vector>
+
+#include <sys/time.h>
+
+#include "IpcServer.h"
+#include "SoftcutEvents.h"
+
+using namespace crone;
+
+// seconds from the OSC / NTP epoch (1900) to the unix epoch (1970)
+static constexpr uint64_t ntpUnixOffset = 2208988800u;
+
+// convert a JACK clock time to an OSC timetag, given the current offset of the wall clock from the JACK clock
+static lo_timetag toTimetag(jack_time_t usecs, int64_t wallOffset) {
+    const auto wall = static_cast<uint64_t>(static_cast<int64_t>(usecs) + wallOffset);
+    lo_timetag tt;
+    tt.sec = static_cast<uint32_t>(wall / 1000000 + ntpUnixOffset);
+    tt.frac = static_cast<uint32_t>(((wall % 1000000) << 32) / 1000000);
+    return tt;
+}
+
+static int64_t wallClockOffset() {
+    struct timeval tv{};
+    gettimeofday(&tv, nullptr);
+    const int64_t wall = static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+    return wall - static_cast<int64_t>(jack_get_time());
+}
+
+SoftcutEvents::SoftcutEvents() :
+        ring(jack_ringbuffer_create(ringEvents * sizeof(Event))),
+        shouldQuit(false), dropped(0), pushed(false), address(nullptr) {
+    sem_init(&sem, 0, 0);
+}
+
+SoftcutEvents::~SoftcutEvents() {
+    stop();
+    sem_destroy(&sem);
+}
+
+bool SoftcutEvents::push(const Event &ev) {
+    if (jack_ringbuffer_write_space(ring.get()) < sizeof(Event)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    jack_ringbuffer_write(ring.get(), reinterpret_cast<const char *>(&ev), sizeof(Event));
+    pushed = true;
+    return true;
+}
+
+void SoftcutEvents::notify() {
+    if (pushed) {
+        // sem_post doesn't block, so is safe from the audio thread
+        sem_post(&sem);
+        pushed = false;
+    }
+}
+
+void SoftcutEvents::start(lo_address addr) {
+    if (th != nullptr) { return; }
+    address = addr;
+    shouldQuit = false;
+    th = std::make_unique<std::thread>([this] { loop(); });
+}
+
+void SoftcutEvents::stop() {
+    if (th == nullptr) { return; }
+    shouldQuit = true;
+    sem_post(&sem);
+    th->join();
+    th.reset();
+}
+
+void SoftcutEvents::loop() {
+    while (true) {
+        if (sem_wait(&sem) != 0 && errno == EINTR) { continue; }
+        if (shouldQuit) { break; }
+        drain();
+    }
+}
+
+void SoftcutEvents::drain() {
+    std::vector<Event> events;
+    Event ev{};
+    while (jack_ringbuffer_read_space(ring.get()) >= sizeof(Event)) {
+        jack_ringbuffer_read(ring.get(), reinterpret_cast<char *>(&ev), sizeof(Event));
+        events.push_back(ev);
+    }
+    if (events.empty()) { return; }
+    // voices are collected one after another within a block; put everything in time order
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event &a, const Event &b) { return a.frame < b.frame; });
+
+    const int64_t wallOffset = wallClockOffset();
+    size_t i = 0;
+    while (i < events.size()) {
+        const uint64_t frame = events[i].frame;
+        const double time = static_cast<double>(static_cast<int64_t>(events[i].usecs) + wallOffset) * 1e-6;
+        lo_bundle bundle = lo_bundle_new(toTimetag(events[i].usecs, wallOffset));
+        for (; i < events.size() && events[i].frame == frame; ++i) {
+            const Event &e = events[i];
+            if (e.type == PhaseCrossing) {
+                if (IpcServer::postPoll(CRONE_IPC_POLL_CUT_PHASE, e.voice, e.value, nullptr, 0, time)) { continue; }
+                lo_message msg = lo_message_new();
+                lo_message_add_int32(msg, e.voice);
+                lo_message_add_float(msg, e.value);
+                lo_bundle_add_message(bundle, "/poll/softcut/phase", msg);
+            } else {
+                const auto kind = static_cast<uint8_t>(e.type);
+                if (IpcServer::postPoll(CRONE_IPC_POLL_CUT_EVENT, e.voice, e.value, &kind, 1, time)) { continue; }
+                lo_message msg = lo_message_new();
+                lo_message_add_int32(msg, e.voice);
+                lo_message_add_int32(msg, e.type);
+                lo_message_add_float(msg, e.value);
+                lo_bundle_add_message(bundle, "/softcut/event", msg);
+            }
+        }
+        // everything may have gone through shared memory
+        if (lo_bundle_count(bundle) > 0 && lo_send_bundle(address, bundle) < 0) {
+            std::cerr << "softcut events: failed to send bundle" << std::endl;
+        }
+        lo_bundle_free_recursive(bundle);
+    }
+}
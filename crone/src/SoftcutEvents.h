@@ -0,0 +1,83 @@
+/*
+ * SoftcutEvents: timestamped softcut voice events, from the audio thread to matron.
+ *
+ * the audio thread pushes events (phase crossings, loop wraps, record start / stop)
+ * into a lock-free single-producer / single-consumer ring, each stamped with the frame it happened on,
+ * and posts a semaphore once per block that produced any.
+ * a sender thread drains the ring and sends the events to matron,
+ * one OSC bundle per distinct time, with the bundle timetag set to the event time.
+ * when matron is attached through shared memory, events go through the poll ring instead, with the same time.
+ *
+ * messages:
+ * - /poll/softcut/phase <voice> <phase>     (same as the old phase poll)
+ * - /softcut/event <voice> <type> <pos>     (type: 0 = loop wrap, 1 = record start, 2 = record stop)
+ */
+
+#ifndef CRONE_SOFTCUTEVENTS_H
+#define CRONE_SOFTCUTEVENTS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <jack/jack.h>
+#include <jack/ringbuffer.h>
+#include <lo/lo.h>
+#include <semaphore.h>
+
+namespace crone {
+
+    class SoftcutEvents {
+    public:
+        typedef enum {
+            LoopWrap = 0, RecStart = 1, RecStop = 2, PhaseCrossing = 3
+        } Type;
+
+        struct Event {
+            // frames since the client started, and the JACK clock time of that frame
+            uint64_t frame;
+            jack_time_t usecs;
+            int32_t voice;
+            int32_t type;
+            // quantized phase for phase crossings, position (in seconds) otherwise
+            float value;
+        };
+
+        SoftcutEvents();
+        ~SoftcutEvents();
+        SoftcutEvents(const SoftcutEvents &) = delete;
+        SoftcutEvents &operator=(const SoftcutEvents &) = delete;
+
+        //-- from audio thread
+        // returns false (and counts a drop) if the ring is full
+        bool push(const Event &ev);
+        // wake the sender, if anything was pushed since the last call
+        void notify();
+
+        //-- from other threads
+        void start(lo_address addr);
+        void stop();
+        uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr size_t ringEvents = 4096;
+
+        void loop();
+        void drain();
+
+        struct RingDeleter {
+            void operator()(jack_ringbuffer_t *rb) const { jack_ringbuffer_free(rb); }
+        };
+        std::unique_ptr<jack_ringbuffer_t, RingDeleter> ring;
+        sem_t sem;
+        std::unique_ptr<std::thread> th;
+        std::atomic<bool> shouldQuit;
+        std::atomic<uint32_t> dropped;
+        bool pushed;
+        lo_address address;
+    };
+
+}
+
+#endif //CRONE_SOFTCUTEVENTS_H
@@ -0,0 +1,128 @@
+/*
+ * SoftcutVoices: runtime-sized counterpart to softcut::Softcut<N>.
+ *
+ * same per-voice interface, but the voice count is chosen at construction.
+ */
+
+#ifndef CRONE_SOFTCUTVOICES_H
+#define CRONE_SOFTCUTVOICES_H
+
+#include <memory>
+
+#include "softcut/Types.h"
+#include "softcut/Voice.h"
+
+namespace crone {
+
+    class SoftcutVoices {
+    private:
+        std::unique_ptr<softcut::Voice[]> scv;
+        int numVoices;
+
+    public:
+        explicit SoftcutVoices(int n) : scv(new softcut::Voice[n]), numVoices(n) {
+            this->reset();
+        }
+
+        int getNumVoices() const { return numVoices; }
+
+        void reset() {
+            for (int v = 0; v < numVoices; ++v) {
+                scv[v].reset();
+            }
+        }
+
+        void resetVoice(int voice) { scv[voice].reset(); }
+
+        // assumption: v is in range
+        void processBlock(int v, const float *in, float *out, int numFrames) {
+            scv[v].processBlockMono(in, out, numFrames);
+        }
+
+        void setSampleRate(unsigned int hz) {
+            for (int v = 0; v < numVoices; ++v) {
+                scv[v].setSampleRate(hz);
+            }
+        }
+
+        void setRate(int voice, float rate) { scv[voice].setRate(rate); }
+
+        void setLoopStart(int voice, float sec) { scv[voice].setLoopStart(sec); }
+
+        void setLoopEnd(int voice, float sec) { scv[voice].setLoopEnd(sec); }
+
+        void setLoopFlag(int voice, bool val) { scv[voice].setLoopFlag(val); }
+
+        void setFadeTime(int voice, float sec) { scv[voice].setFadeTime(sec); }
+
+        void setRecLevel(int voice, float amp) { scv[voice].setRecLevel(amp); }
+
+        void setPreLevel(int voice, float amp) { scv[voice].setPreLevel(amp); }
+
+        void setRecFlag(int voice, bool val) { scv[voice].setRecFlag(val); }
+
+        void setPlayFlag(int voice, bool val) { scv[voice].setPlayFlag(val); }
+
+        void cutToPos(int voice, float sec) { scv[voice].cutToPos(sec); }
+
+        void setPreFilterFc(int voice, float x) { scv[voice].setPreFilterFc(x); }
+
+        void setPreFilterRq(int voice, float x) { scv[voice].setPreFilterRq(x); }
+
+        void setPreFilterLp(int voice, float x) { scv[voice].setPreFilterLp(x); }
+
+        void setPreFilterHp(int voice, float x) { scv[voice].setPreFilterHp(x); }
+
+        void setPreFilterBp(int voice, float x) { scv[voice].setPreFilterBp(x); }
+
+        void setPreFilterBr(int voice, float x) { scv[voice].setPreFilterBr(x); }
+
+        void setPreFilterDry(int voice, float x) { scv[voice].setPreFilterDry(x); }
+
+        void setPreFilterFcMod(int voice, float x) { scv[voice].setPreFilterFcMod(x); }
+
+        void setPostFilterFc(int voice, float x) { scv[voice].setPostFilterFc(x); }
+
+        void setPostFilterRq(int voice, float x) { scv[voice].setPostFilterRq(x); }
+
+        void setPostFilterLp(int voice, float x) { scv[voice].setPostFilterLp(x); }
+
+        void setPostFilterHp(int voice, float x) { scv[voice].setPostFilterHp(x); }
+
+        void setPostFilterBp(int voice, float x) { scv[voice].setPostFilterBp(x); }
+
+        void setPostFilterBr(int voice, float x) { scv[voice].setPostFilterBr(x); }
+
+        void setPostFilterDry(int voice, float x) { scv[voice].setPostFilterDry(x); }
+
+        void setRecOffset(int voice, float d) { scv[voice].setRecOffset(d); }
+
+        void setRecPreSlewTime(int voice, float d) { scv[voice].setRecPreSlewTime(d); }
+
+        void setRateSlewTime(int voice, float d) { scv[voice].setRateSlewTime(d); }
+
+        softcut::phase_t getQuantPhase(int voice) { return scv[voice].getQuantPhase(); }
+
+        void setPhaseQuant(int voice, softcut::phase_t q) { scv[voice].setPhaseQuant(q); }
+
+        void setPhaseOffset(int voice, float sec) { scv[voice].setPhaseOffset(sec); }
+
+        bool getRecFlag(int voice) { return scv[voice].getRecFlag(); }
+
+        // current position, in seconds
+        float getPos(int voice) { return scv[voice].getPos(); }
+
+        bool getPlayFlag(int voice) { return scv[voice].getPlayFlag(); }
+
+        void syncVoice(int follow, int lead, float offset) {
+            scv[follow].cutToPos(scv[lead].getPos() + offset);
+        }
+
+        void setVoiceBuffer(int voice, float *buf, size_t bufFrames) {
+            scv[voice].setBuffer(buf, bufFrames);
+        }
+    };
+
+}
+
+#endif //CRONE_SOFTCUTVOICES_H
@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RawAudioFile.h"
+#include "StreamVoice.h"
+#include "Window.h"
+
+using namespace crone;
+
+std::mutex StreamVoice::diskMut;
+std::condition_variable StreamVoice::diskCv;
+bool StreamVoice::diskPending = false;
+bool StreamVoice::diskShouldQuit = false;
+std::unique_ptr<std::thread> StreamVoice::diskThread = nullptr;
+StreamVoice *StreamVoice::voices[StreamVoice::maxVoices];
+int StreamVoice::numVoices = 0;
+
+std::mutex StreamVoice::listMut;
+
+StreamVoice::StreamVoice() :
+        state(State::Closed), audioReleased(false), fileFrames(0),
+        loopStart(0), loopEnd(0), loopFlag(true),
+        cutTarget(0), cutSeq(0), underruns(0), droppedWrites(0),
+        fd(-1), dataOffset(0), cutSeen(0),
+        audioOpen(false), activeRing(0), fading(false), cutPending(false),
+        fadePhase(0.f), fadeInc(1.f), recEnv(0.f),
+        recFlag(false), playFlag(false), recLevel(0.f), preLevel(0.f),
+        fadeTime(0.1f), sampleRate(48000.f) {
+    for (auto &r : rings) {
+        r.status = RingIdle;
+        r.fetched = 0;
+        r.consumed = 0;
+        r.primedSeq = 0;
+        r.nextPos = 0;
+        r.atEnd = false;
+    }
+    std::lock_guard<std::mutex> lock(listMut);
+    if (numVoices < maxVoices) {
+        voices[numVoices++] = this;
+    }
+}
+
+StreamVoice::~StreamVoice() {
+    {
+        std::lock_guard<std::mutex> lock(listMut);
+        for (int i = 0; i < numVoices; ++i) {
+            if (voices[i] == this) {
+                voices[i] = voices[--numVoices];
+                break;
+            }
+        }
+    }
+    // no disk thread can see us now; flush what the audio thread left behind
+    if (fd >= 0) {
+        finishClose();
+    }
+}
+
+//------------------------
+//---- opening and closing
+
+bool StreamVoice::open(const std::string &p, float minDur) {
+    if (state.load() != State::Closed) {
+        std::cerr << "StreamVoice: a file is already open; close it first" << std::endl;
+        return false;
+    }
+    int f = ::open(p.c_str(), O_RDWR | O_CREAT, 0644);
+    if (f < 0) {
+        std::cerr << "StreamVoice: can't open " << p << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    size_t frames;
+    RawAudioFile::Layout layout{};
+    unsigned char magic[4] = {0, 0, 0, 0};
+    struct stat st{};
+    fstat(f, &st);
+    if (RawAudioFile::probeFloat(f, layout)) {
+        if (layout.channels != 1) {
+            std::cerr << "StreamVoice: " << p << " has " << layout.channels << " channels; need mono" << std::endl;
+            ::close(f);
+            return false;
+        }
+        dataOffset = layout.dataOffset;
+        frames = layout.frames;
+    } else if (st.st_size >= 4 && RawAudioFile::readAt(f, magic, 4, 0)
+               && (memcmp(magic, "RIFF", 4) == 0 || memcmp(magic, "caff", 4) == 0)) {
+        std::cerr << "StreamVoice: " << p << " is not 32-bit float; convert it first" << std::endl;
+        ::close(f);
+        return false;
+    } else {
+        // headerless float32
+        dataOffset = 0;
+        frames = static_cast<size_t>(st.st_size) / sizeof(float);
+        const auto minFrames = static_cast<size_t>(std::max(0.f, minDur) * sampleRate);
+        if (minFrames > frames) {
+            if (ftruncate(f, static_cast<off_t>(minFrames * sizeof(float))) != 0) {
+                std::cerr << "StreamVoice: can't extend " << p << " (" << strerror(errno) << ")" << std::endl;
+                ::close(f);
+                return false;
+            }
+            frames = minFrames;
+        }
+    }
+    if (frames < 1 || frames > UINT32_MAX) {
+        std::cerr << "StreamVoice: unusable length (" << frames << " frames) for " << p << std::endl;
+        ::close(f);
+        return false;
+    }
+
+    // rings are allocated on first open, and kept
+    if (writeRing == nullptr) {
+        for (auto &r : rings) {
+            r.rb = RingPtr(jack_ringbuffer_create(ringFrames * sizeof(Frame)));
+            jack_ringbuffer_mlock(r.rb.get());
+        }
+        writeRing = RingPtr(jack_ringbuffer_create(ringFrames * sizeof(Frame)));
+        jack_ringbuffer_mlock(writeRing.get());
+    }
+
+    path = p;
+    fd = f;
+    fileFrames = frames;
+    loopStart = 0;
+    loopEnd = static_cast<uint32_t>(frames);
+    cutSeen = cutSeq.load();
+    audioReleased = false;
+    std::cout << "StreamVoice: opened " << p << " (" << frames << " frames)" << std::endl;
+    state.store(State::Opening, std::memory_order_release);
+    wakeDisk();
+    return true;
+}
+
+void StreamVoice::close() {
+    // an open in progress completes quickly; wait for it
+    for (int i = 0; i < 1000 && state.load() == State::Opening; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    State expected = State::Open;
+    if (state.compare_exchange_strong(expected, State::Closing)) {
+        wakeDisk();
+    }
+}
+
+void StreamVoice::finishClose() {
+    drainWrites();
+    if (fsync(fd) != 0 || ::close(fd) != 0) {
+        std::cerr << "StreamVoice: error closing " << path << " (" << strerror(errno) << ")" << std::endl;
+    }
+    fd = -1;
+    std::cout << "StreamVoice: closed " << path << "; " << underruns.exchange(0) << " underruns, "
+              << droppedWrites.exchange(0) << " dropped writes" << std::endl;
+}
+
+//------------------------
+//---- audio thread
+
+bool StreamVoice::claim() {
+    const State s = state.load(std::memory_order_acquire);
+    if (s == State::Open) {
+        if (!audioOpen) {
+            resetAudioState();
+            audioOpen = true;
+        }
+        return true;
+    }
+    if (audioOpen) {
+        audioOpen = false;
+    }
+    if (s == State::Closing && !audioReleased.load(std::memory_order_relaxed)) {
+        audioReleased.store(true, std::memory_order_release);
+        signalDisk();
+    }
+    return false;
+}
+
+void StreamVoice::resetAudioState() {
+    activeRing = 0;
+    fading = false;
+    cutPending = false;
+    fadePhase = 0.f;
+    recEnv = 0.f;
+}
+
+void StreamVoice::setLoopStart(float sec) {
+    loopStart.store(static_cast<uint32_t>(std::max(0.f, sec) * sampleRate), std::memory_order_relaxed);
+}
+
+void StreamVoice::setLoopEnd(float sec) {
+    loopEnd.store(static_cast<uint32_t>(std::max(0.f, sec) * sampleRate), std::memory_order_relaxed);
+}
+
+void StreamVoice::cutToPos(float sec) {
+    cutTarget.store(static_cast<uint32_t>(std::max(0.f, sec) * sampleRate), std::memory_order_relaxed);
+    cutSeq.fetch_add(1, std::memory_order_release);
+    cutPending = true;
+    signalDisk();
+}
+
+size_t StreamVoice::pull(int ring, Frame *dst, size_t n) {
+    ReadRing &r = rings[ring];
+    const size_t avail = jack_ringbuffer_read_space(r.rb.get()) / sizeof(Frame);
+    if (avail < n) {
+        if (!r.atEnd.load(std::memory_order_relaxed)) {
+            underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        n = avail;
+    }
+    jack_ringbuffer_read(r.rb.get(), reinterpret_cast<char *>(dst), n * sizeof(Frame));
+    r.consumed.fetch_add(n, std::memory_order_release);
+    return n;
+}
+
+void StreamVoice::processBlock(const float *in, float *out, int numFrames) {
+    while (numFrames > 0) {
+        const int n = std::min(numFrames, maxBlockFrames);
+        processChunk(in, out, n);
+        in += n;
+        out += n;
+        numFrames -= n;
+    }
+    signalDisk();
+}
+
+void StreamVoice::processChunk(const float *in, float *out, int numFrames) {
+    // start crossfading to a primed cut
+    const int alt = activeRing ^ 1;
+    if (cutPending && !fading && rings[alt].status.load(std::memory_order_acquire) == RingReady) {
+        rings[alt].status.store(RingPlaying, std::memory_order_relaxed);
+        cutPending = rings[alt].primedSeq.load(std::memory_order_relaxed)
+                     != cutSeq.load(std::memory_order_relaxed);
+        fading = true;
+        fadePhase = 0.f;
+        fadeInc = 1.f / std::max(1.f, fadeTime * sampleRate);
+    }
+
+    const size_t n = static_cast<size_t>(numFrames);
+    const int numHeads = fading ? 2 : 1;
+    size_t got[2] = {0, 0};
+    got[0] = pull(activeRing, pullBuf[0], n);
+    if (fading) {
+        got[1] = pull(alt, pullBuf[1], n);
+    }
+
+    const float recTarget = recFlag ? 1.f : 0.f;
+    const float recInc = 1.f / std::max(1.f, fadeTime * sampleRate);
+    const float play = playFlag ? 1.f : 0.f;
+
+    // envelopes: record level follows the rec flag over one fade time;
+    // during a cut, head 0 fades out while head 1 fades in
+    for (size_t i = 0; i < n; ++i) {
+        if (recEnv < recTarget) {
+            recEnv = std::min(recTarget, recEnv + recInc);
+        } else if (recEnv > recTarget) {
+            recEnv = std::max(recTarget, recEnv - recInc);
+        }
+        recBuf[i] = recEnv;
+        if (fading) {
+            const auto idx = static_cast<size_t>(std::min(fadePhase, 1.f) * (Window::raisedCosShortLen - 1));
+            fadeBuf[i] = Window::raisedCosShort[idx];
+            fadePhase += fadeInc;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) { out[i] = 0.f; }
+    // each head pushes its overdub as one contiguous run
+    size_t numPush = 0;
+    for (int h = 0; h < numHeads; ++h) {
+        for (size_t i = 0; i < got[h]; ++i) {
+            const Frame &fr = pullBuf[h][i];
+            const float g = fading ? (h == 0 ? 1.f - fadeBuf[i] : fadeBuf[i]) : 1.f;
+            out[i] += fr.x * g * play;
+            const float e = recBuf[i] * g;
+            if (e > 0.f) {
+                pushBuf[numPush++] = {fr.pos, fr.x * (1.f - e * (1.f - preLevel)) + in[i] * recLevel * e};
+            }
+        }
+    }
+
+    if (numPush > 0) {
+        const size_t space = jack_ringbuffer_write_space(writeRing.get()) / sizeof(Frame);
+        if (space < numPush) {
+            droppedWrites.fetch_add(static_cast<uint32_t>(numPush - space), std::memory_order_relaxed);
+            numPush = space;
+        }
+        jack_ringbuffer_write(writeRing.get(), reinterpret_cast<const char *>(pushBuf), numPush * sizeof(Frame));
+    }
+
+    if (fading && fadePhase >= 1.f) {
+        // the old head is done; hand its ring back to the disk thread
+        rings[activeRing].status.store(RingIdle, std::memory_order_release);
+        activeRing = alt;
+        fading = false;
+    }
+}
+
+//------------------------
+//---- disk thread
+
+void StreamVoice::signalDisk() {
+    // like Tape, only signal the disk thread if that can be done without blocking;
+    // otherwise it catches up on its next poll
+    if (diskMut.try_lock()) {
+        diskPending = true;
+        diskCv.notify_one();
+        diskMut.unlock();
+    }
+}
+
+void StreamVoice::wakeDisk() {
+    std::lock_guard<std::mutex> lock(diskMut);
+    diskPending = true;
+    diskCv.notify_one();
+}
+
+void StreamVoice::startDiskThread() {
+    if (diskThread != nullptr) { return; }
+    diskShouldQuit = false;
+    diskThread = std::make_unique<std::thread>(&StreamVoice::diskLoop);
+}
+
+void StreamVoice::stopDiskThread() {
+    if (diskThread == nullptr) { return; }
+    {
+        std::lock_guard<std::mutex> lock(diskMut);
+        diskShouldQuit = true;
+        diskCv.notify_one();
+    }
+    diskThread->join();
+    diskThread.reset();
+}
+
+void StreamVoice::diskLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(diskMut);
+            // the audio thread's wakeup is best-effort, so also poll
+            diskCv.wait_for(lock, std::chrono::milliseconds(5), [] { return diskPending || diskShouldQuit; });
+            if (diskShouldQuit) { break; }
+            diskPending = false;
+        }
+        std::lock_guard<std::mutex> lock(listMut);
+        for (int i = 0; i < numVoices; ++i) {
+            voices[i]->service();
+        }
+    }
+}
+
+void StreamVoice::service() {
+    const State s = state.load(std::memory_order_acquire);
+    if (s == State::Opening) {
+        rings[1].status.store(RingIdle, std::memory_order_relaxed);
+        jack_ringbuffer_reset(writeRing.get());
+        prime(0, loopStart.load(std::memory_order_relaxed), readAheadLimit(0, 0));
+        rings[0].status.store(RingPlaying, std::memory_order_relaxed);
+        state.store(State::Open, std::memory_order_release);
+        return;
+    }
+    if (s == State::Closing) {
+        if (audioReleased.load(std::memory_order_acquire)) {
+            finishClose();
+            rings[0].status = RingIdle;
+            rings[1].status = RingIdle;
+            state.store(State::Closed, std::memory_order_release);
+        }
+        return;
+    }
+    if (s != State::Open) { return; }
+
+    // snapshot consumption before draining writes:
+    // every frame consumed by now has had its overdub pushed, and will be written below
+    uint64_t consumed[2];
+    for (int r = 0; r < 2; ++r) {
+        consumed[r] = rings[r].consumed.load(std::memory_order_acquire);
+    }
+    drainWrites();
+
+    // prime an idle ring at the latest cut target
+    const uint32_t seq = cutSeq.load(std::memory_order_acquire);
+    if (seq != cutSeen) {
+        for (int r = 0; r < 2; ++r) {
+            if (rings[r].status.load(std::memory_order_acquire) == RingIdle) {
+                cutSeen = seq;
+                const size_t limit = readAheadLimit(0, 0);
+                prime(r, cutTarget.load(std::memory_order_relaxed), limit < cutPrimeFrames ? limit : cutPrimeFrames);
+                rings[r].primedSeq.store(seq, std::memory_order_relaxed);
+                rings[r].status.store(RingReady, std::memory_order_release);
+                consumed[r] = 0;
+                break;
+            }
+        }
+    }
+
+    // top up rings the audio thread is (or will be) reading
+    for (int r = 0; r < 2; ++r) {
+        if (rings[r].status.load(std::memory_order_acquire) == RingIdle) { continue; }
+        fill(r, readAheadLimit(consumed[r], rings[r].fetched.load(std::memory_order_relaxed)));
+    }
+}
+
+size_t StreamVoice::readAheadLimit(uint64_t consumed, uint64_t fetched) const {
+    const size_t ls = loopStart.load(std::memory_order_relaxed);
+    const size_t le = loopEnd.load(std::memory_order_relaxed);
+    const size_t loopLen = le > ls ? le - ls : 0;
+    if (!loopFlag.load(std::memory_order_relaxed) || loopLen == 0) {
+        return ringFrames;
+    }
+    // stay less than one loop ahead of what has been consumed (and so overdubbed, if recording);
+    // this applies before recording starts too, since the ring isn't flushed when it does
+    const uint64_t limit = consumed + loopLen - 1;
+    if (limit <= fetched) { return 0; }
+    return limit - fetched < ringFrames ? static_cast<size_t>(limit - fetched) : ringFrames;
+}
+
+void StreamVoice::prime(int ring, size_t pos, size_t frames) {
+    ReadRing &r = rings[ring];
+    // the audio thread doesn't read an idle ring, so it's safe to reset here
+    jack_ringbuffer_reset(r.rb.get());
+    r.fetched.store(0, std::memory_order_relaxed);
+    r.consumed.store(0, std::memory_order_relaxed);
+    r.nextPos = std::min(pos, fileFrames.load() - 1);
+    r.atEnd = false;
+    fill(ring, frames);
+}
+
+void StreamVoice::fill(int ring, size_t maxFrames) {
+    static Frame frames[diskIoFrames];
+    static float samples[diskIoFrames];
+    ReadRing &r = rings[ring];
+    const size_t numFileFrames = fileFrames.load(std::memory_order_relaxed);
+    size_t space = std::min(maxFrames, jack_ringbuffer_write_space(r.rb.get()) / sizeof(Frame));
+    while (space > 0) {
+        const bool loop = loopFlag.load(std::memory_order_relaxed);
+        size_t ls = std::min<size_t>(loopStart.load(std::memory_order_relaxed), numFileFrames - 1);
+        size_t le = std::min<size_t>(loopEnd.load(std::memory_order_relaxed), numFileFrames);
+        if (le <= ls) { le = numFileFrames; }
+        const size_t end = loop ? le : numFileFrames;
+        if (r.nextPos >= end) {
+            if (!loop) {
+                r.atEnd = true;
+                return;
+            }
+            r.nextPos = ls;
+        }
+        const size_t n = std::min(std::min(space, end - r.nextPos), diskIoFrames);
+        if (!RawAudioFile::readAt(fd, samples, n * sizeof(float),
+                                  dataOffset + static_cast<off_t>(r.nextPos * sizeof(float)))) {
+            std::cerr << "StreamVoice: read failed at frame " << r.nextPos << std::endl;
+            return;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            frames[i] = {static_cast<uint32_t>(r.nextPos + i), samples[i]};
+        }
+        jack_ringbuffer_write(r.rb.get(), reinterpret_cast<const char *>(frames), n * sizeof(Frame));
+        r.fetched.fetch_add(n, std::memory_order_relaxed);
+        r.nextPos += n;
+        space -= n;
+    }
+    // warm the page cache where the loop wraps to
+    if (loopFlag.load(std::memory_order_relaxed)) {
+        const size_t ls = loopStart.load(std::memory_order_relaxed);
+        posix_fadvise(fd, dataOffset + static_cast<off_t>(ls * sizeof(float)),
+                      static_cast<off_t>(ringFrames * sizeof(float)), POSIX_FADV_WILLNEED);
+    }
+}
+
+void StreamVoice::drainWrites() {
+    static Frame frames[diskIoFrames];
+    static float samples[diskIoFrames];
+    jack_ringbuffer_t *rb = writeRing.get();
+    size_t avail;
+    while ((avail = jack_ringbuffer_read_space(rb) / sizeof(Frame)) > 0) {
+        const size_t n = std::min(avail, diskIoFrames);
+        jack_ringbuffer_read(rb, reinterpret_cast<char *>(frames), n * sizeof(Frame));
+        // write runs of consecutive positions
+        size_t i = 0;
+        while (i < n) {
+            size_t j = i;
+            samples[0] = frames[i].x;
+            while (j + 1 < n && frames[j + 1].pos == frames[j].pos + 1) {
+                ++j;
+                samples[j - i] = frames[j].x;
+            }
+            const size_t runLength = j - i + 1;
+            if (!RawAudioFile::writeAt(fd, samples, runLength * sizeof(float),
+                                       dataOffset + static_cast<off_t>(frames[i].pos * sizeof(float)))) {
+                std::cerr << "StreamVoice: write failed at frame " << frames[i].pos
+                          << " (" << strerror(errno) << ")" << std::endl;
+                droppedWrites.fetch_add(static_cast<uint32_t>(runLength), std::memory_order_relaxed);
+            }
+            i = j + 1;
+        }
+    }
+}
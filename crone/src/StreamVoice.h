@@ -0,0 +1,190 @@
+/*
+ * StreamVoice: a softcut voice that plays and records directly against a sound file on disk,
+ * for material too long for the softcut buffers.
+ *
+ * modelled on Tape<N>::Reader / Writer: the audio thread never touches the file,
+ * only jack ringbuffers, which a disk thread keeps serviced.
+ * - read-ahead ring: frames in playback order, each tagged with its file position.
+ *   the disk thread follows the loop, so loop wraps are prefetched like any other frames.
+ * - write-behind ring: recorded frames (with overdub already mixed in), tagged with their position.
+ * - cuts: the disk thread primes a second read-ahead ring at the cut target,
+ *   and the audio thread crossfades to it once it is ready.
+ *
+ * while looping, read-ahead is limited to less than one loop length,
+ * so each frame is read back only after its previous overdub has been written.
+ * this holds whether or not the voice is recording yet: frames fetched before recording starts
+ * are still at most one loop ahead, so none of them can miss an overdub.
+ *
+ * files are mono 32-bit float WAV / CAF, or headerless float32 (which can be created or extended on open).
+ * playback and recording run at unity rate.
+ */
+
+#ifndef CRONE_STREAMVOICE_H
+#define CRONE_STREAMVOICE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <jack/ringbuffer.h>
+#include <sys/types.h>
+
+namespace crone {
+
+    class StreamVoice {
+    public:
+        StreamVoice();
+        ~StreamVoice();
+        StreamVoice(const StreamVoice &) = delete;
+        StreamVoice &operator=(const StreamVoice &) = delete;
+
+        //-- from a non-audio thread
+
+        // open a file for streaming. if minDur > 0 and the file is headerless (or new),
+        // it is extended to at least that many seconds.
+        // returns false if the file can't be used, or a file is already open
+        bool open(const std::string &path, float minDur = 0.f);
+        // stop streaming; pending writes are flushed and the file closed by the disk thread
+        void close();
+
+        // start / stop the disk thread shared by all stream voices
+        static void startDiskThread();
+        static void stopDiskThread();
+
+        //-- from audio thread
+
+        // returns true if the voice should be processed from its stream.
+        // call once per block, before processBlock()
+        bool claim();
+        void processBlock(const float *in, float *out, int numFrames);
+
+        void setSampleRate(float sr) { sampleRate = sr; }
+        void setLoopStart(float sec);
+        void setLoopEnd(float sec);
+        void setLoopFlag(bool val) { loopFlag.store(val, std::memory_order_relaxed); }
+        void setRecFlag(bool val) { recFlag = val; }
+        void setPlayFlag(bool val) { playFlag = val; }
+        void setRecLevel(float amp) { recLevel = amp; }
+        void setPreLevel(float amp) { preLevel = amp; }
+        void setFadeTime(float sec) { fadeTime = sec; }
+        void cutToPos(float sec);
+
+    private:
+        // one frame of a mono stream, tagged with its position in the file
+        struct Frame {
+            uint32_t pos;
+            float x;
+        };
+
+        enum class State {
+            Closed, Opening, Open, Closing
+        };
+
+        // read-ahead ring status
+        enum RingStatus {
+            RingIdle, RingReady, RingPlaying
+        };
+
+        struct RingDeleter {
+            void operator()(jack_ringbuffer_t *rb) const { jack_ringbuffer_free(rb); }
+        };
+        typedef std::unique_ptr<jack_ringbuffer_t, RingDeleter> RingPtr;
+
+        struct ReadRing {
+            RingPtr rb;
+            std::atomic<int> status;
+            // frames pushed by the disk thread / pulled by the audio thread, since the ring was primed
+            std::atomic<uint64_t> fetched;
+            std::atomic<uint64_t> consumed;
+            // cut request this ring was primed for
+            std::atomic<uint32_t> primedSeq;
+            // next file position to fetch, and whether a non-looped stream has hit the end (disk thread)
+            size_t nextPos;
+            std::atomic<bool> atEnd;
+        };
+
+        static constexpr size_t ringFrames = 1 << 17;
+        static constexpr size_t cutPrimeFrames = 16384;
+        static constexpr size_t diskIoFrames = 8192;
+        static constexpr int maxBlockFrames = 1024;
+        static constexpr int maxVoices = 16;
+
+        //-- shared
+        std::atomic<State> state;
+        std::atomic<bool> audioReleased;
+        std::atomic<size_t> fileFrames;
+        std::atomic<uint32_t> loopStart;
+        std::atomic<uint32_t> loopEnd;
+        std::atomic<bool> loopFlag;
+        std::atomic<uint32_t> cutTarget;
+        std::atomic<uint32_t> cutSeq;
+        ReadRing rings[2];
+        RingPtr writeRing;
+        std::atomic<uint32_t> underruns;
+        std::atomic<uint32_t> droppedWrites;
+
+        //-- set on open, then disk thread only
+        std::string path;
+        int fd;
+        off_t dataOffset;
+        uint32_t cutSeen;
+
+        //-- audio thread only
+        bool audioOpen;
+        int activeRing;
+        bool fading;
+        bool cutPending;
+        // crossfade position in [0, 1], and increment per frame
+        float fadePhase;
+        float fadeInc;
+        float recEnv;
+        bool recFlag;
+        bool playFlag;
+        float recLevel;
+        float preLevel;
+        float fadeTime;
+        float sampleRate;
+        Frame pullBuf[2][maxBlockFrames];
+        float recBuf[maxBlockFrames];
+        float fadeBuf[maxBlockFrames];
+        Frame pushBuf[2 * maxBlockFrames];
+
+    private:
+        void resetAudioState();
+        // pull up to n frames from a ring; returns frames pulled
+        size_t pull(int ring, Frame *dst, size_t n);
+        void processChunk(const float *in, float *out, int numFrames);
+
+        //-- disk thread
+        void service();
+        // frames that can be fetched into a ring without getting a loop ahead of what has been consumed
+        size_t readAheadLimit(uint64_t consumed, uint64_t fetched) const;
+        void prime(int ring, size_t pos, size_t frames);
+        void fill(int ring, size_t maxFrames);
+        void drainWrites();
+        void finishClose();
+
+        static void diskLoop();
+        // from any thread
+        static void wakeDisk();
+        // from audio thread: never blocks
+        static void signalDisk();
+
+        static std::mutex diskMut;
+        static std::condition_variable diskCv;
+        static bool diskPending;
+        static bool diskShouldQuit;
+        static std::unique_ptr<std::thread> diskThread;
+        // registered voices; guarded by listMut, which is held while the disk thread services them
+        static std::mutex listMut;
+        static StreamVoice *voices[maxVoices];
+        static int numVoices;
+    };
+
+}
+
+#endif //CRONE_STREAMVOICE_H
@@ -2,48 +2,104 @@
 // Created by emb on 12/01/18.
 //
 
+/*
+ * Tape: stereo file record / playback, with the disk I/O on a thread per stream.
+ *
+ * each stream moves audio between the audio thread and its disk thread through a lock-free ring,
+ * sized in frames with setRingFrames() (several seconds by default), so a slow storage device
+ * can stall the disk thread for that long without losing audio.
+ * the audio thread never takes a lock: it posts a semaphore when the ring needs service,
+ * and the disk thread also wakes on a short timeout.
+ *
+ * recording goes to 24-bit WAV through TapeFile (preallocated, written in large aligned blocks):
+ * one stereo file, or several channels at once (stems) to one multichannel file or several aligned files.
+ * playback reads any format libsndfile supports; files at another rate than the engine's
+ * are resampled on the disk thread (see Resampler), so they play at the right pitch and speed.
+ *
+ * frames lost to a full ring (record) or an empty one (playback) are counted,
+ * and each disk thread reports its stats through the stats callback,
+ * twice a second while running and once when it finishes.
+ */
+
 #ifndef CRONE_TAPE_H
 #define CRONE_TAPE_H
 
 #include <atomic>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
+#include <cerrno>
+#include <chrono>
+#include <ctime>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 
 #include <jack/types.h>
 #include <jack/ringbuffer.h>
+#include <semaphore.h>
 #include <sndfile.h>
 #include <string.h>
 
+#include "Resampler.h"
+#include "TapeFile.h"
 #include "Window.h"
 
 namespace crone {
 
-    template<int NumChannels>
+    // NumChannels: playback channels, and recorded channels by default.
+    // MaxRecordChannels: most channels the writer can record at once (see Writer::openFiles())
+    template<int NumChannels, int MaxRecordChannels = NumChannels>
         class Tape {
+        static_assert(MaxRecordChannels >= NumChannels, "tape must be able to record its own width");
+
     private:
 
         typedef jack_default_audio_sample_t Sample;
         static constexpr size_t sampleSize = sizeof(Sample);
         static constexpr size_t frameSize = sampleSize * NumChannels;
-        static constexpr size_t ringBufFrames = 16384;
-        static constexpr size_t ringBufBytes = sampleSize * NumChannels * ringBufFrames;
-        
+        // largest block from the audio thread
+        static constexpr size_t maxProcessFrames = 16384;
+        // frames moved between ring and disk at a time
+        static constexpr size_t diskChunkFrames = 16384;
+
     public:
+        // 8 seconds at 48k
+        static constexpr size_t DefaultRingFrames = 8 * 48000;
+
+        typedef enum {
+            StreamRecord = 0, StreamPlay = 1
+        } StreamId;
+
+        struct Stats {
+            bool running;
+            // frames recorded / played, in seconds
+            double seconds;
+            // fraction of the ring in use (record: not yet on disk; playback: read ahead)
+            float fill;
+            // frames lost to a full (record) or empty (playback) ring since the file was opened
+            uint32_t dropped;
+        };
+
+        typedef std::function<void(StreamId, const Stats &)> StatsCallback;
+
         //-----------------------------------------------------------------------------------------------
         //-- base class for sound file access
 
         class SfStream {
         protected:
-            SNDFILE *file;
+            struct RingDeleter {
+                void operator()(jack_ringbuffer_t *rb) const { jack_ringbuffer_free(rb); }
+            };
+
             std::unique_ptr<std::thread> th;
-            std::mutex mut;
-            std::condition_variable cv;
-            std::unique_ptr<jack_ringbuffer_t> ringBuf;
+            std::unique_ptr<jack_ringbuffer_t, RingDeleter> ringBuf;
+            sem_t sem;
+            // set by the audio thread when it posts the semaphore, cleared by the disk thread
+            std::atomic<bool> wakePending;
             volatile int status;
-            
+            // true from start() until the disk thread has finished with the file
+            std::atomic<bool> diskActive;
+
             typedef enum {
                 Starting, Playing, Stopping, Stopped
             } EnvState;
@@ -51,25 +107,57 @@ namespace crone {
             std::atomic<EnvState> envState;
             std::atomic<int> envIdx;
 
+            std::atomic<uint32_t> dropped;
+            // rate of the frames counted in stats
+            int sampleRate;
+            // rate of the audio thread; set with Tape::setSampleRate()
+            int engineRate;
+            StreamId streamId;
+            StatsCallback statsCallback;
+            std::chrono::steady_clock::time_point lastReport;
+
+            enum { reportIntervalMs = 500, wakeTimeoutMs = 100 };
+
         public:
             std::atomic<bool> isRunning;
             std::atomic<bool> shouldStop;
 
         public:
-        SfStream():
-            file(nullptr),
+        explicit SfStream(StreamId id):
+                wakePending(false),
                 status(0),
+                diskActive(false),
+                dropped(0),
+                sampleRate(48000),
+                engineRate(48000),
+                streamId(id),
                 isRunning(false),
                 shouldStop(false)
                     {
-                        ringBuf = std::unique_ptr<jack_ringbuffer_t>(jack_ringbuffer_create(ringBufBytes));
+                        sem_init(&sem, 0, 0);
                         envIdx = 0;
                         envState = Stopped;
                     }
 
+            virtual ~SfStream() {
+                sem_destroy(&sem);
+            }
+
+            // (re)allocate the ring; not while running
+            void allocate(size_t bytes) {
+                ringBuf.reset(jack_ringbuffer_create(bytes));
+                // keep the audio thread from faulting pages in
+                jack_ringbuffer_mlock(ringBuf.get());
+                memset(ringBuf->buf, 0, ringBuf->size);
+            }
+
+            void setStatsCallback(StatsCallback cb) {
+                statsCallback = std::move(cb);
+            }
+
             virtual // from any thread
                 void start() {
-                if (isRunning) {
+                if (diskActive.exchange(true)) {
                     return;
                 } else {
                     envIdx = 0;
@@ -90,6 +178,42 @@ namespace crone {
         protected:
 
             virtual void diskLoop() = 0;
+            virtual Stats getStats() = 0;
+
+            // from audio thread: wake the disk thread, once until it next runs
+            void wake() {
+                if (!wakePending.exchange(true)) {
+                    sem_post(&sem);
+                }
+            }
+
+            // from disk thread
+            void waitForWake() {
+                struct timespec ts{};
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += wakeTimeoutMs * 1000000L;
+                if (ts.tv_nsec >= 1000000000L) {
+                    ts.tv_sec += 1;
+                    ts.tv_nsec -= 1000000000L;
+                }
+                while (sem_timedwait(&sem, &ts) != 0 && errno == EINTR) {}
+                wakePending = false;
+            }
+
+            // from disk thread; at most every reportIntervalMs, and once when done
+            void report(bool done) {
+                if (!statsCallback) { return; }
+                auto now = std::chrono::steady_clock::now();
+                if (!done && now - lastReport < std::chrono::milliseconds(reportIntervalMs)) { return; }
+                lastReport = now;
+                Stats stats = getStats();
+                if (done) { stats.running = false; }
+                statsCallback(streamId, stats);
+            }
+
+            float getFill(size_t bytes) const {
+                return static_cast<float>(bytes) / static_cast<float>(ringBuf->size);
+            }
 
             float getEnvSample() {
                 float y=0.f;
@@ -127,7 +251,8 @@ namespace crone {
                     envIdx = 0;
                     envState = Stopped;
                     shouldStop = true;
-                    std::cerr << "Tape: fade-out finished; stopping" << std::endl;
+                    // sem_post doesn't block, so is safe from the audio thread
+                    sem_post(&sem);
                 }
             }
 
@@ -137,63 +262,62 @@ namespace crone {
         //--------------------------------------------------------------------------------------------------------------
         //---- Writer class
 
+        // records NumChannels to one file by default, or up to MaxRecordChannels,
+        // as one multichannel file or as several sample-aligned files of equal width (see openFiles()).
+        // every channel goes through the same ring and disk thread, so files can't drift apart
         class Writer: public SfStream {
             friend class Tape;
 
         private:
-            static constexpr size_t maxFramesToWrite = ringBufFrames;
-            static constexpr size_t minBytesToWrite = 2048; // totally arbitrary
-            static constexpr size_t minFramesToWrite = minBytesToWrite * frameSize;
-            bool dataPending;
-            //  buffer for writing to soundfile (disk thread)
-            Sample diskOutBuf[maxFramesToWrite * NumChannels];
+            TapeFile files[MaxRecordChannels];
+            int numFiles{0};
+            int channelsPerFile{NumChannels};
+            // total channels in the ring
+            int numChannels{NumChannels};
+            size_t ringFrames{0};
+            int ringChannels{0};
+            //  buffer between ringbuf and file (disk thread)
+            Sample diskOutBuf[diskChunkFrames * MaxRecordChannels];
+            //  one file's channels, when recording to several files (disk thread)
+            Sample fileBuf[diskChunkFrames * MaxRecordChannels];
             //  buffer for interleaving before ringbuf (audio thread)
-            Sample pushBuf[maxFramesToWrite * NumChannels];
-            size_t numFramesCaptured;
-            size_t maxFrames;
+            Sample pushBuf[maxProcessFrames * MaxRecordChannels];
+
+            size_t getFrameSize() const { return sampleSize * numChannels; }
 
         public:
-            // call from audio thread
-            void process(const float *src[NumChannels], size_t numFrames) {
+            // call from audio thread, with one pointer per recorded channel
+            void process(const float *const *src, size_t numFrames) {
                 if (!SfStream::isRunning) { return; }
 
                 // push to ringbuffer
+                const size_t frameBytes = getFrameSize();
                 jack_ringbuffer_t *rb = this->ringBuf.get();
-                size_t bytesToPush = numFrames * frameSize;
+                size_t bytesToPush = numFrames * frameBytes;
                 const size_t bytesAvailable = jack_ringbuffer_write_space(rb);
-                
+
                 if (bytesToPush > bytesAvailable) {
-#if 0 
-                    std::cerr << "Tape: writer overrun: " 
-                              << bytesAvailable << " bytes available; " 
-                              << bytesToPush << " bytes to push; "
-                              << numFramesCaptured << " frames captured" 
-                              << std::endl;
-#endif
-                    // discard input if the ringbuffer is full;
-                    // this causes a dropout but hopefully nothing Really Bad
-                    numFrames = bytesAvailable / frameSize;
-                    bytesToPush = numFrames * frameSize;
-                }
-
-                /// libsndfile requires interleaved data. we do that here before pushing to ringbuf
+                    // the disk has fallen a whole ring behind; drop what doesn't fit, and count it
+                    const size_t framesAvailable = bytesAvailable / frameBytes;
+                    this->dropped += static_cast<uint32_t>(numFrames - framesAvailable);
+                    numFrames = framesAvailable;
+                    bytesToPush = numFrames * frameBytes;
+                }
+
+                /// interleave before pushing to ringbuf
                 float *dst = pushBuf;
                 for (size_t fr = 0; fr < numFrames; ++fr) {
                     // while we're interleaving, also apply envelope
                     float amp = SfStream::getEnvSample();
-                    for (int ch = 0; ch < NumChannels; ++ch) {
+                    for (int ch = 0; ch < numChannels; ++ch) {
 
                         *dst++ = src[ch][fr] * amp;
                    }
                 }
                 jack_ringbuffer_write(rb, (const char *) pushBuf, bytesToPush);
-                this->dataPending = true;
-                this->cv.notify_one();
 
-                if (this->mut.try_lock()) {
-                    this->dataPending = true;
-                    this->cv.notify_one();
-                    this->mut.unlock();
+                if (jack_ringbuffer_read_space(rb) >= rb->size / 8) {
+                    SfStream::wake();
                 }
             }
 
@@ -201,117 +325,151 @@ namespace crone {
             void diskLoop() override {
                 SfStream::isRunning = true;
                 SfStream::shouldStop = false;
-                numFramesCaptured = 0;
-                size_t bytesAvailable;
-                while (!SfStream::shouldStop) {
-                    {
-                        std::unique_lock<std::mutex> lock(this->mut);
-                        this->cv.wait(lock, [this] {
-                                return this->dataPending;
-                            });
-
-                        // check for spurious wakeup
-                        if (!dataPending) {
-                            continue;
-                        }
-                    }
-                     
-                    bytesAvailable = jack_ringbuffer_read_space(this->ringBuf.get());
-                    if (bytesAvailable < minBytesToWrite) { 
-                        {
-                            std::unique_lock<std::mutex> lock(this->mut);
-                            dataPending = false;
-                        }
-                        continue;
-                    }
-
-                    int framesToWrite = bytesAvailable / frameSize;
-                    
-                    if (framesToWrite > (int) maxFramesToWrite) {
-                        // _really_ shouldn't happen
-                        std::cerr << "warning: Tape::Writer has too many frames to write" << std::endl;
-                        framesToWrite = (int) maxFramesToWrite;
-                    }
-
-                    jack_ringbuffer_read(this->ringBuf.get(), (char *)diskOutBuf, framesToWrite * frameSize);
-                    // immediately signal audio thread that we're done with pending data
-                    {
-                        std::unique_lock<std::mutex> lock(this->mut);
-                        dataPending = false;
-                    }
-
-                    if (sf_writef_float(this->file, diskOutBuf, framesToWrite) != framesToWrite) {
-                        char errstr[256];
-                        sf_error_str(nullptr, errstr, sizeof(errstr) - 1);
-                        std::cerr << "error: Tape::writer failed to write (libsndfile: " << errstr << ")" << std::endl;
-                        this->status = EIO;
-                        break;
-                    }
-
-                    numFramesCaptured += framesToWrite;
-                    if (numFramesCaptured >= maxFrames) {
-                        std::cerr << "Tape: writer exceeded max frame count; aborting.";
-                        break;
-                    }
-
+                this->lastReport = std::chrono::steady_clock::now();
+                bool ok = true;
+                while (ok) {
+                    // sample this before draining, so that the last frames before the stop are written
+                    const bool stopping = SfStream::shouldStop;
+                    ok = drain();
+                    if (stopping) { break; }
+                    SfStream::report(false);
+                    SfStream::waitForWake();
                 }
 
                 std::cerr << "Tape::writer closing file...";
-                sf_close(this->file);
-                std::cerr << " done." << std::endl;
+                if (!closeFiles()) {
+                    this->status = EIO;
+                }
+                std::cerr << " done (" << files[0].getFramesWritten() << " frames, "
+                          << this->dropped << " dropped)" << std::endl;
                 SfStream::isRunning = false;
+                SfStream::report(true);
+                SfStream::diskActive = false;
             }
 
-            // from any thread
+            // from any thread, while stopped
+            // sampleRate: written to the file header; 0 for the engine rate
             bool open(const std::string &path,
                       size_t maxFrames = JACK_MAX_FRAMES, // <-- ridiculous big number
-                      int sampleRate = 48000,
-                      int bitDepth = 24) {
-                SF_INFO sf_info;
-                int short_mask;
-
-                sf_info.samplerate = sampleRate;
-                sf_info.channels = NumChannels;
+                      int sampleRate = 0) {
+                return openFiles(&path, 1, NumChannels, maxFrames, sampleRate);
+            }
 
-                switch (bitDepth) {
-                case 8:
-                    short_mask = SF_FORMAT_PCM_U8;
-                    break;
-                case 16:
-                    short_mask = SF_FORMAT_PCM_16;
-                    break;
-                case 24:
-                    short_mask = SF_FORMAT_PCM_24;
-                    break;
-                case 32:
-                    short_mask = SF_FORMAT_PCM_32;
-                    break;
-                default:
-                    short_mask = SF_FORMAT_PCM_24;
-                    break;
+            // from any thread, while stopped: record numPaths files of channelsPerFile channels each.
+            // process() then takes numPaths * channelsPerFile channels, in file order.
+            // the ring is resized to hold its usual length at the new width
+            bool openFiles(const std::string *paths, int numPaths, int fileChannels,
+                           size_t maxFrames = JACK_MAX_FRAMES,
+                           int sampleRate = 0) {
+                if (SfStream::diskActive) {
+                    std::cerr << "Tape::writer: can't open " << paths[0] << " while recording" << std::endl;
+                    return false;
                 }
-                sf_info.format = SF_FORMAT_WAV | short_mask;
-
-                if ((this->file = sf_open(path.c_str(), SFM_WRITE, &sf_info)) == NULL) {
-                    char errstr[256];
-                    sf_error_str(nullptr, errstr, sizeof(errstr) - 1);
-                    std::cerr << "cannot open sndfile" << path << " for output (" << errstr << ")" << std::endl;
+                if (numPaths < 1 || fileChannels < 1 || numPaths * fileChannels > MaxRecordChannels) {
+                    std::cerr << "Tape::writer: can't record " << numPaths << " x " << fileChannels
+                              << " channels" << std::endl;
                     return false;
                 }
+                closeFiles();
+                if (sampleRate < 1) { sampleRate = this->engineRate; }
+                for (int i = 0; i < numPaths; ++i) {
+                    if (!files[i].open(paths[i], fileChannels, sampleRate, maxFrames)) {
+                        numFiles = i;
+                        closeFiles();
+                        return false;
+                    }
+                    if (!files[i].isDirect()) {
+                        std::cerr << "Tape::writer: no direct I/O for " << paths[i] << "; using buffered writes"
+                                  << std::endl;
+                    }
+                }
+                numFiles = numPaths;
+                channelsPerFile = fileChannels;
+                numChannels = numPaths * fileChannels;
+                if (numChannels != ringChannels) {
+                    allocate(ringFrames);
+                }
+                this->sampleRate = sampleRate;
+                this->status = 0;
+                this->dropped = 0;
+                jack_ringbuffer_reset(this->ringBuf.get());
+                return true;
+            }
 
-                // enable clipping during float->int conversion
-                sf_command(this->file, SFC_SET_CLIPPING, NULL, SF_TRUE);
+            // from any thread
+            void start() override {
+                if (numFiles < 1) {
+                    std::cerr << "Tape::writer: no file open" << std::endl;
+                    return;
+                }
+                SfStream::start();
+            }
 
-                this->maxFrames = maxFrames;
-                jack_ringbuffer_reset(this->ringBuf.get());
-                dataPending = false;
+            int getNumChannels() const { return numChannels; }
+
+        Writer() : SfStream(StreamRecord) {}
+
+        private:
+            // size the ring for the current channel count
+            void allocate(size_t frames) {
+                ringFrames = frames;
+                ringChannels = numChannels;
+                SfStream::allocate(frames * getFrameSize());
+            }
+
+            bool closeFiles() {
+                bool ok = true;
+                for (int i = 0; i < numFiles; ++i) {
+                    ok = files[i].close() && ok;
+                }
+                numFiles = 0;
+                return ok;
+            }
+
+            // move everything in the ring to the files. returns false to stop recording
+            bool drain() {
+                const size_t frameBytes = getFrameSize();
+                jack_ringbuffer_t *rb = this->ringBuf.get();
+                size_t framesAvailable;
+                while ((framesAvailable = jack_ringbuffer_read_space(rb) / frameBytes) > 0) {
+                    const size_t frames = framesAvailable < diskChunkFrames ? framesAvailable : diskChunkFrames;
+                    jack_ringbuffer_read(rb, (char *) diskOutBuf, frames * frameBytes);
+                    for (int i = 0; i < numFiles; ++i) {
+                        const Sample *src = diskOutBuf;
+                        if (numFiles > 1) {
+                            // pick out this file's channels
+                            const Sample *in = diskOutBuf + i * channelsPerFile;
+                            Sample *out = fileBuf;
+                            for (size_t fr = 0; fr < frames; ++fr) {
+                                for (int ch = 0; ch < channelsPerFile; ++ch) {
+                                    *out++ = in[ch];
+                                }
+                                in += numChannels;
+                            }
+                            src = fileBuf;
+                        }
+                        if (!files[i].write(src, frames)) {
+                            if (files[i].getFramesWritten() >= files[i].getMaxFrames()) {
+                                std::cerr << "Tape: writer reached max frame count; stopping" << std::endl;
+                            } else {
+                                std::cerr << "error: Tape::writer failed to write" << std::endl;
+                                this->status = EIO;
+                            }
+                            return false;
+                        }
+                    }
+                }
                 return true;
             }
 
-        Writer() : SfStream(),
-                dataPending(false),
-                numFramesCaptured(0),
-                maxFrames(JACK_MAX_FRAMES) {}
+            Stats getStats() override {
+                return {
+                        SfStream::isRunning,
+                        static_cast<double>(files[0].getFramesWritten()) / this->sampleRate,
+                        SfStream::getFill(jack_ringbuffer_read_space(this->ringBuf.get())),
+                        this->dropped
+                };
+            }
         }; // Writer class
 
         //-----------------------------------------------------------------------------------------------------------------
@@ -319,38 +477,97 @@ namespace crone {
 
         class Reader : public SfStream {
             friend class Tape;
+            static_assert(NumChannels <= Resampler::MaxChannels, "too many channels to resample");
         private:
+            SNDFILE *file{};
             size_t frames{};
-            size_t framesProcessed = 0;
+            std::atomic<size_t> framesProcessed{0};
             uint8_t inChannels = 2;
-            static constexpr size_t maxFramesToRead = ringBufFrames;
+            static constexpr size_t maxFramesToRead = diskChunkFrames;
             // interleaved buffer from soundfile (disk thread)
-            Sample diskInBuf[frameSize * maxFramesToRead]{};
+            Sample diskInBuf[NumChannels * maxFramesToRead]{};
             //additional buffer for padding mono to stereo
-	    Sample conversionBuf[frameSize * maxFramesToRead]{};
+            Sample conversionBuf[maxFramesToRead]{};
             Sample * diskBufPtr{};
+            // resampler output (disk thread)
+            Sample resampleBuf[NumChannels * maxFramesToRead]{};
             // buffer for deinterleaving after ringbuf (audio thread)
-            Sample pullBuf[frameSize * maxFramesToRead]{};
+            Sample pullBuf[NumChannels * maxProcessFrames]{};
             std::atomic<bool> isPrimed{};
-            bool needsData{};
+            // set by the disk thread once the last frames of a non-looped file are in the ring
+            std::atomic<bool> atEof{};
             std::atomic<bool> loopFile{};
+
+            // conversion from the file's rate, when it isn't the engine's
+            Resampler resampler;
+            bool resampling{};
+            // the last input frame is in the resampler; only its tail remains
+            bool inputDone{};
+            // preset for the next open()
+            std::atomic<int> quality{Resampler::QualityMedium};
         private:
-            // prime the ringbuffer
-            void prime() {
-                jack_ringbuffer_t *rb = this->ringBuf.get();
-                size_t framesToRead = jack_ringbuffer_write_space(rb) / frameSize;
-                if (framesToRead > maxFramesToRead) { framesToRead = maxFramesToRead; };
-                auto framesRead = (size_t) sf_readf_float(this->file, diskBufPtr, framesToRead);
+            // read up to `count` frames from the file into diskInBuf, wrapping around looped files.
+            // returns 0 at the end of a non-looped file
+            size_t readFile(size_t count) {
+                auto framesRead = (size_t) sf_readf_float(this->file, diskBufPtr, count);
+                if (framesRead == 0 && loopFile) {
+                    // end of file: seek to start and keep reading
+                    sf_seek(this->file, 0, SEEK_SET);
+                    framesRead = (size_t) sf_readf_float(this->file, diskBufPtr, count);
+                    if (framesRead == 0) {
+                        //Shouldn't happen
+                        std::cerr << "Tape::Reader: unable to read file" << std::endl;
+                    }
+                }
                 if (inChannels == 1)
                     convertToStereo(framesRead);
-                jack_ringbuffer_write(rb, (char *) diskInBuf, frameSize * framesRead);
+                return framesRead;
+            }
 
-                // couldn't read enough, file is shorter than the buffer
-                if (framesRead < framesToRead) {
-                    std::cerr << "Tape::Reader: short file, disable loop" << std::endl;
-                    SfStream::shouldStop = false;
-               }
+            // next frames for the ring: straight from the file, or through the resampler.
+            // returns 0 once the file (and the resampler's tail) is used up
+            size_t produce(size_t count, Sample *&out) {
+                if (!resampling) {
+                    out = diskInBuf;
+                    return readFile(count);
+                }
+                out = resampleBuf;
+                while (true) {
+                    auto n = resampler.pull(resampleBuf, count);
+                    if (n > 0 || inputDone) { return n; }
+                    auto space = resampler.inputSpace();
+                    auto framesRead = readFile(space < maxFramesToRead ? space : maxFramesToRead);
+                    if (framesRead > 0) {
+                        resampler.push(diskInBuf, framesRead);
+                    } else {
+                        // flush the filter
+                        resampler.pushSilence(resampler.getTailFrames());
+                        inputDone = true;
+                    }
+                }
             }
+
+            // fill the ringbuffer
+            void fill() {
+                jack_ringbuffer_t *rb = this->ringBuf.get();
+                while (!atEof) {
+                    size_t framesToRead = jack_ringbuffer_write_space(rb) / frameSize;
+                    if (framesToRead < 1) { break; }
+                    if (framesToRead > maxFramesToRead) { framesToRead = maxFramesToRead; }
+                    Sample *src = nullptr;
+                    auto framesRead = produce(framesToRead, src);
+                    if (framesRead == 0) {
+                        if (!loopFile) {
+                            std::cerr << "Tape::Reader::diskloop() reached EOF" << std::endl;
+                        }
+                        atEof = true;
+                        SfStream::shouldStop = true;
+                        break;
+                    }
+                    jack_ringbuffer_write(rb, (char *) src, frameSize * framesRead);
+                }
+            }
+
             void convertToStereo(size_t frameCount)
             {
                     size_t fr = 0;
@@ -361,7 +578,7 @@ namespace crone {
                         fr++;
                     }
             }
- 
+
         public:
             // from audio thread
             void process(float *dst[NumChannels], size_t numFrames) {
@@ -374,59 +591,65 @@ namespace crone {
                     return;
                 }
 
-                jack_ringbuffer_t* rb = this->ringBuf.get();
-                auto framesInBuf = jack_ringbuffer_read_space(rb) / frameSize;
-
-                //  if ringbuf isn't full enough, probably EOF on a non-looped file
-                if(framesInBuf < numFrames) {
-                    // pull from ringbuffer
-                    jack_ringbuffer_read(rb, (char*)pullBuf, framesInBuf * frameSize);
-                    float* src = pullBuf;
-                    size_t fr = 0;
-                    // de-interleave, apply amp, copy to output
-                    while (fr < framesInBuf) {
-                        float amp = SfStream::getEnvSample();
-                        for (int ch = 0; ch < NumChannels; ++ch) {
-                            dst[ch][fr] = *src++ * amp;
-                        }
-                        fr++;
-                    }
-                    while(fr < numFrames) {
+                if (SfStream::shouldStop && this->envState == SfStream::Stopped) {
+                    // faded out: done, without waiting for the rest of the ring to drain
+                    for (size_t fr = 0; fr < numFrames; ++fr) {
                         for (int ch = 0; ch < NumChannels; ++ch) {
                             dst[ch][fr] = 0.f;
                         }
-                        fr++;
                     }
-                    jack_ringbuffer_reset(rb);
                     SfStream::isRunning = false;
-                } else {
-
-                    // pull from ringbuffer
-                    jack_ringbuffer_read(rb, (char *) pullBuf, numFrames * frameSize);
+                    return;
+                }
 
-                    if (this->mut.try_lock()) {
-                        this->needsData = true;
-                        this->cv.notify_one();
-                        this->mut.unlock();
+                jack_ringbuffer_t* rb = this->ringBuf.get();
+                auto framesInBuf = jack_ringbuffer_read_space(rb) / frameSize;
+                if (framesInBuf > numFrames) { framesInBuf = numFrames; }
+
+                // pull from ringbuffer
+                jack_ringbuffer_read(rb, (char *) pullBuf, framesInBuf * frameSize);
+                float *src = pullBuf;
+                size_t fr = 0;
+                // de-interleave, apply amp, copy to output
+                while (fr < framesInBuf) {
+                    float amp = SfStream::getEnvSample();
+                    for (int ch = 0; ch < NumChannels; ++ch) {
+                        dst[ch][fr] = *src++ * amp;
                     }
+                    fr++;
+                }
+                while (fr < numFrames) {
+                    for (int ch = 0; ch < NumChannels; ++ch) {
+                        dst[ch][fr] = 0.f;
+                    }
+                    fr++;
+                }
+                framesProcessed += framesInBuf;
 
-                    float *src = pullBuf;
-
-                    // de-interleave, apply amp, copy to output
-                    for (size_t fr = 0; fr < numFrames; ++fr) {
-                        float amp = SfStream::getEnvSample();
-                        for (int ch = 0; ch < NumChannels; ++ch) {
-                            dst[ch][fr] = *src++ * amp;
-                        }
+                if (framesInBuf < numFrames) {
+                    if (atEof || SfStream::shouldStop) {
+                        // end of a non-looped file, or stopped: done
+                        SfStream::isRunning = false;
+                        return;
                     }
-                    framesProcessed += numFrames;
+                    // disk thread has fallen behind
+                    this->dropped += static_cast<uint32_t>(numFrames - framesInBuf);
+                }
+
+                if (jack_ringbuffer_write_space(rb) >= rb->size / 8) {
+                    SfStream::wake();
                 }
             }
 
-            // from any thread
+            // from any thread, while stopped
             bool open(const std::string &path) {
                 SF_INFO sfInfo;
 
+                if (SfStream::diskActive) {
+                    std::cerr << "Tape Reader:: can't open " << path << " while playing" << std::endl;
+                    return false;
+                }
+
                 if ((this->file = sf_open(path.c_str(), SFM_READ, &sfInfo)) == NULL) {
                     char errstr[256];
                     sf_error_str(0, errstr, sizeof(errstr) - 1);
@@ -437,95 +660,89 @@ namespace crone {
                 if (sfInfo.frames < 1) {
 
                     std::cerr << "Tape Reader:: error reading file " << path << " (no frames available)" << std::endl;
+                    sf_close(this->file);
+                    this->file = nullptr;
                     return false;
                 }
                 this->frames = static_cast<size_t>(sfInfo.frames);
                 std::cerr << "Tape Reader:: file size " << this->frames << " samples" << std::endl;
                 inChannels = sfInfo.channels;
-                if (inChannels > NumChannels)
-                    return 0;//more than stereo is going to break things
+                if (inChannels > NumChannels) {
+                    //more than stereo is going to break things
+                    sf_close(this->file);
+                    this->file = nullptr;
+                    return false;
+                }
                 if (inChannels == 1)
                     diskBufPtr = conversionBuf;//conversion needed for mono
                 else
                     diskBufPtr = diskInBuf;
                 framesProcessed = 0;
+                // playback runs at the engine rate, whatever the file's
+                this->sampleRate = this->engineRate;
+                resampling = sfInfo.samplerate != this->engineRate;
+                inputDone = false;
+                if (resampling) {
+                    std::cerr << "Tape Reader:: resampling from " << sfInfo.samplerate << " to "
+                              << this->engineRate << std::endl;
+                    resampler.setup(NumChannels, sfInfo.samplerate, this->engineRate,
+                                    static_cast<Resampler::Quality>(quality.load()), maxFramesToRead);
+                }
+                this->dropped = 0;
 
                 jack_ringbuffer_reset(this->ringBuf.get());
                 isPrimed = false;
+                atEof = false;
                 loopFile = true;
                 if ( this->frames < 48000)
                     loopFile = false;
                 return this->frames > 0;
             }
 
+            // from any thread
+            void start() override {
+                if (this->file == nullptr) {
+                    std::cerr << "Tape Reader:: no file open" << std::endl;
+                    return;
+                }
+                SfStream::start();
+            }
+
+            // from any thread; takes effect at the next open()
+            void setQuality(Resampler::Quality q) {
+                quality = q;
+            }
+
+            Reader() : SfStream(StreamPlay) {}
+
         private:
             // from disk thread
             void diskLoop() override {
-                prime();
+                SfStream::shouldStop = false;
+                this->lastReport = std::chrono::steady_clock::now();
+                // prime the ringbuffer
+                fill();
                 isPrimed = true;
                 SfStream::isRunning = true;
-                SfStream::shouldStop = false;
                 while (!SfStream::shouldStop) {
-                    {
-                        std::unique_lock<std::mutex> lock(this->mut);
-                        this->cv.wait(lock, [this] {
-                                return this->needsData;
-                            });
-                        // check for spurious wakeup
-                        if (!needsData) { continue; }
-                    }
-
-                    jack_ringbuffer_t *rb = this->ringBuf.get();
-
-                    size_t framesToRead = jack_ringbuffer_write_space(rb) / frameSize;
-                    if (framesToRead < 1) {
-                        {
-                            std::unique_lock<std::mutex> lock(this->mut);
-                            needsData = false;
-                        }
-                        continue;
-                    }
-
-                    if (framesToRead > maxFramesToRead) { 
-                        // _really_ shouldn't happen
-                        framesToRead = maxFramesToRead;
-                    };
-                    auto framesRead = (size_t) sf_readf_float(this->file, diskBufPtr, framesToRead);
-                    if (inChannels == 1)
-                            convertToStereo(framesRead);
-                    jack_ringbuffer_write(rb, (char *) diskInBuf, frameSize * framesRead);
-
-                    if (loopFile) {
-                        // couldn't perform full read so must be end of file. Seek to start of file and keep reading
-                        while (framesRead < framesToRead) {
-                            sf_seek(this->file,0, SEEK_SET);
-                            auto nextRead = (size_t) sf_readf_float(this->file, diskBufPtr, framesToRead-framesRead);
-                            if (nextRead < 1)
-                            {
-                                  //Shouldn't happen
-                                  std::cerr << "Tape::Reader: unable to read file" << std::endl;
-                                  SfStream::shouldStop = true;
-                                  break;
-                            }
-                            if (inChannels == 1)
-                                convertToStereo(framesRead);
-                            jack_ringbuffer_write(rb, (char *) diskInBuf, frameSize * nextRead);
-                            framesRead += nextRead;
-                        }
-                    }
-                    else {
-                        std::cerr << "Tape::Reader::diskloop() reached EOF" << std::endl;
-                        SfStream::shouldStop = true;
-                    }
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->mut);
-                        needsData = false;
-                    }
-
+                    SfStream::waitForWake();
+                    fill();
+                    SfStream::report(false);
                 }
                 sf_close(this->file);
-                std::cerr << "Tape::reader closed file" << std::endl;
+                this->file = nullptr;
+                std::cerr << "Tape::reader closed file (" << this->dropped << " frames dropped)" << std::endl;
+                SfStream::report(true);
+                SfStream::diskActive = false;
+            }
+
+            Stats getStats() override {
+                return {
+                        SfStream::isRunning,
+                        static_cast<double>(framesProcessed) / this->sampleRate,
+                        SfStream::getFill(jack_ringbuffer_read_space(this->ringBuf.get())),
+                        this->dropped
+                };
             }
 
         }; // Reader class
@@ -534,6 +751,31 @@ namespace crone {
         Reader reader;
 
     public:
+        Tape() {
+            setRingFrames(DefaultRingFrames);
+        }
+
+        // ring size for both streams, in frames. returns false (and does nothing) while either is running
+        bool setRingFrames(size_t frames) {
+            if (isWriting() || isReading()) { return false; }
+            writer.allocate(frames);
+            reader.allocate(frames * frameSize);
+            return true;
+        }
+
+        // engine sample rate: recordings are written at it, and playback is resampled to it.
+        // from any thread, while neither stream is running
+        void setSampleRate(int sr) {
+            writer.engineRate = sr;
+            reader.engineRate = sr;
+        }
+
+        // from any thread, before starting either stream
+        void setStatsCallback(const StatsCallback &cb) {
+            writer.setStatsCallback(cb);
+            reader.setStatsCallback(cb);
+        }
+
         bool isWriting() { return writer.isRunning; }
         bool isReading() { return reader.isRunning; }
     };
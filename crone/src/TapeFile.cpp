@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "RawAudioFile.h"
+#include "TapeFile.h"
+
+using namespace crone;
+
+// alignment of O_DIRECT buffers, offsets and lengths; covers 512-byte and 4k sector devices
+static constexpr size_t directAlign = 4096;
+
+static_assert(TapeFile::BlockBytes % directAlign == 0, "tape blocks must be aligned for O_DIRECT");
+
+TapeFile::TapeFile() : fd(-1), direct(false), canPrealloc(false), channels(0), sampleRate(0),
+                       maxFrames(0), framesWritten(0), block(nullptr), blockFill(0), blockOffset(0),
+                       reservedEnd(0) {}
+
+TapeFile::~TapeFile() {
+    close();
+    free(block);
+}
+
+bool TapeFile::open(const std::string &path, int numChannels, int sr, size_t frames) {
+    close();
+    if (block == nullptr) {
+        void *p = nullptr;
+        if (posix_memalign(&p, directAlign, BlockBytes) != 0) {
+            std::cerr << "TapeFile: failed to allocate block buffer" << std::endl;
+            return false;
+        }
+        block = static_cast<unsigned char *>(p);
+    }
+
+    const int flags = O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC;
+    direct = true;
+    fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd < 0 && errno == EINVAL) {
+        // filesystem doesn't support direct I/O (tmpfs, some FUSE mounts)
+        direct = false;
+        fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (fd < 0) {
+        std::cerr << "TapeFile: cannot open " << path << " for output (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    channels = numChannels;
+    sampleRate = sr;
+    maxFrames = std::min(frames, RawAudioFile::maxWavFrames24(channels));
+    framesWritten = 0;
+    canPrealloc = true;
+    reservedEnd = 0;
+
+    // sizes are filled in on close
+    RawAudioFile::makeWavHeader24(block, channels, sampleRate, 0);
+    blockFill = RawAudioFile::wavHeaderSize24;
+    blockOffset = 0;
+    return true;
+}
+
+bool TapeFile::write(const float *src, size_t frames) {
+    if (fd < 0) { return false; }
+    bool atLimit = false;
+    if (frames >= maxFrames - framesWritten) {
+        frames = maxFrames - framesWritten;
+        atLimit = true;
+    }
+    size_t samples = frames * channels;
+    while (samples > 0) {
+        // whole samples that fit in the block
+        const size_t n = std::min(samples, (BlockBytes - blockFill) / 3);
+        unsigned char *dst = block + blockFill;
+        for (size_t i = 0; i < n; ++i) {
+            RawAudioFile::packPcm24(src[i], dst);
+            dst += 3;
+        }
+        src += n;
+        samples -= n;
+        blockFill += n * 3;
+        if (samples > 0 && blockFill + 3 > BlockBytes) {
+            // a sample straddles the block boundary
+            unsigned char tmp[3];
+            RawAudioFile::packPcm24(*src++, tmp);
+            --samples;
+            const size_t head = BlockBytes - blockFill;
+            memcpy(block + blockFill, tmp, head);
+            blockFill = BlockBytes;
+            if (!flushBlock()) { return false; }
+            memcpy(block, tmp + head, 3 - head);
+            blockFill = 3 - head;
+        } else if (blockFill == BlockBytes) {
+            if (!flushBlock()) { return false; }
+        }
+    }
+    framesWritten += frames;
+    return !atLimit;
+}
+
+bool TapeFile::flushBlock() {
+    if (!reserve(blockOffset + static_cast<off_t>(BlockBytes))) { return false; }
+    if (!RawAudioFile::writeAt(fd, block, BlockBytes, blockOffset)) {
+        std::cerr << "TapeFile: write failed (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    if (!direct) {
+        // start writeback now, without waiting for it
+        sync_file_range(fd, blockOffset, BlockBytes, SYNC_FILE_RANGE_WRITE);
+    }
+    blockOffset += BlockBytes;
+    blockFill = 0;
+    return true;
+}
+
+bool TapeFile::reserve(off_t end) {
+    while (canPrealloc && reservedEnd < end) {
+        if (fallocate(fd, 0, reservedEnd, PreallocBytes) != 0) {
+            if (errno == ENOSPC) {
+                std::cerr << "TapeFile: disk full" << std::endl;
+                return false;
+            }
+            // not supported here; fall back to allocating as we write
+            canPrealloc = false;
+            break;
+        }
+        reservedEnd += PreallocBytes;
+    }
+    return true;
+}
+
+bool TapeFile::close() {
+    if (fd < 0) { return true; }
+    bool ok = true;
+    const off_t dataOffset = RawAudioFile::wavHeaderSize24;
+    const off_t fileSize = RawAudioFile::wavFileSize24(dataOffset, channels, framesWritten);
+
+    // last partial block, zero-padded to the alignment; the padding is trimmed below
+    if (blockOffset == 0) {
+        RawAudioFile::makeWavHeader24(block, channels, sampleRate, framesWritten);
+    }
+    const size_t tail = (blockFill + directAlign - 1) & ~(directAlign - 1);
+    memset(block + blockFill, 0, tail - blockFill);
+    if (tail > 0 && !RawAudioFile::writeAt(fd, block, tail, blockOffset)) {
+        std::cerr << "TapeFile: write failed (" << strerror(errno) << ")" << std::endl;
+        ok = false;
+    }
+
+    // rewrite the header block with the final sizes
+    if (blockOffset > 0) {
+        if (RawAudioFile::readAt(fd, block, directAlign, 0)) {
+            RawAudioFile::makeWavHeader24(block, channels, sampleRate, framesWritten);
+            ok = RawAudioFile::writeAt(fd, block, directAlign, 0) && ok;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "TapeFile: failed to update header" << std::endl;
+        }
+    }
+
+    if (ftruncate(fd, fileSize) != 0) {
+        std::cerr << "TapeFile: failed to trim file (" << strerror(errno) << ")" << std::endl;
+        ok = false;
+    }
+    fdatasync(fd);
+    ::close(fd);
+    fd = -1;
+    return ok;
+}
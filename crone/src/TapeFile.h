@@ -0,0 +1,73 @@
+/*
+ * TapeFile: 24-bit WAV output for tape recording, written in large aligned blocks.
+ *
+ * samples are packed into a block buffer that mirrors the file from offset 0 (header included),
+ * and each full block goes to disk with a single pwrite() at a block-aligned offset.
+ * the file is opened with O_DIRECT where the filesystem allows it, so writes skip the page cache;
+ * otherwise writes are buffered, and writeback of each block is started right away
+ * so that dirty pages don't pile up into one long stall.
+ *
+ * disk space is reserved ahead of the write position with fallocate(),
+ * and the file is trimmed to its real length on close.
+ *
+ * not thread-safe: all calls come from the tape writer's disk thread (open / close may come from any thread
+ * while that thread is not running).
+ */
+
+#ifndef CRONE_TAPEFILE_H
+#define CRONE_TAPEFILE_H
+
+#include <cstddef>
+#include <string>
+
+#include <sys/types.h>
+
+namespace crone {
+
+    class TapeFile {
+    public:
+        // bytes per write; a multiple of any device's logical block size
+        static constexpr size_t BlockBytes = 1 << 20;
+        // disk space reserved at a time
+        static constexpr off_t PreallocBytes = 64 << 20;
+
+        TapeFile();
+        ~TapeFile();
+        TapeFile(const TapeFile &) = delete;
+        TapeFile &operator=(const TapeFile &) = delete;
+
+        // create (or truncate) the file. maxFrames is clamped to what a WAV file can hold
+        bool open(const std::string &path, int channels, int sampleRate, size_t maxFrames);
+        // append interleaved frames. returns false on a write error, or once maxFrames have been written
+        bool write(const float *src, size_t frames);
+        // write the last partial block, set the header sizes, trim preallocated space and close the file
+        bool close();
+
+        bool isOpen() const { return fd >= 0; }
+        bool isDirect() const { return direct; }
+        size_t getFramesWritten() const { return framesWritten; }
+        size_t getMaxFrames() const { return maxFrames; }
+
+    private:
+        bool flushBlock();
+        bool reserve(off_t end);
+
+        int fd;
+        bool direct;
+        bool canPrealloc;
+        int channels;
+        int sampleRate;
+        size_t maxFrames;
+        size_t framesWritten;
+
+        // file bytes [blockOffset, blockOffset + blockFill)
+        unsigned char *block;
+        size_t blockFill;
+        off_t blockOffset;
+        // end of the space reserved with fallocate()
+        off_t reservedEnd;
+    };
+
+}
+
+#endif //CRONE_TAPEFILE_H
@@ -9,6 +9,8 @@
 #include <math.h>
 #include <cmath>
 
+#include "Simd.h"
+
 namespace crone {
 
 #ifndef BUILD_SC_UGEN // supercollider headers define these themselves
@@ -185,6 +187,28 @@ namespace crone {
             return x0;
         }
 
+        // update output for a whole block, writing every intermediate value to dst.
+        // equivalent to calling update() numFrames times.
+        void updateBlock(float *dst, size_t numFrames) {
+            y0 = simd::logRamp(dst, y0, x0, b, numFrames);
+        }
+
+        // check if the output has converged on the target.
+        // if so, snap to it, so that callers can use a constant gain.
+        bool isSettled() {
+            if (fabsf(x0 - y0) > settledThreshold) { return false; }
+            y0 = x0;
+            return true;
+        }
+
+        // current output value, without updating
+        float getValue() const {
+            return y0;
+        }
+
+    private:
+        // ~ -120dB
+        static constexpr float settledThreshold = 1e-6f;
     };
 
     // a smoother with separate rise and fall times
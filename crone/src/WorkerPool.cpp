@@ -0,0 +1,157 @@
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#include <pthread.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "WorkerPool.h"
+
+using namespace crone;
+
+WorkerPool::WorkerPool() :
+        numThreads(0), fn(nullptr), ctx(nullptr), numTasks(0),
+        generation(0), numSleeping(0), claim(0), remaining(0), joinWaiting(0),
+        shouldQuit(false) {}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start(int n, int priority) {
+    if (numThreads > 0) { return; }
+    if (n > MaxThreads) { n = MaxThreads; }
+    if (n < 1) { return; }
+    shouldQuit = false;
+    // no job can be published until numThreads is set, so this is every worker's starting point
+    const int g0 = generation.load();
+    for (int i = 0; i < n; ++i) {
+        threads.push_back(std::make_unique<std::thread>([this, g0] { this->workLoop(g0); }));
+        if (priority > 0) {
+            sched_param param{};
+            param.sched_priority = priority;
+            int res = pthread_setschedparam(threads.back()->native_handle(), SCHED_FIFO, &param);
+            if (res != 0) {
+                std::cerr << "WorkerPool: failed to set SCHED_FIFO (" << strerror(res)
+                          << "); worker will run at normal priority" << std::endl;
+            }
+        }
+    }
+    numThreads = n;
+    std::cout << "WorkerPool: started " << n << " worker threads" << std::endl;
+}
+
+void WorkerPool::stop() {
+    if (numThreads == 0) { return; }
+    shouldQuit = true;
+    generation.fetch_add(1);
+    futexWake(generation, INT_MAX);
+    for (auto &th : threads) {
+        th->join();
+    }
+    threads.clear();
+    numThreads = 0;
+}
+
+void WorkerPool::run(TaskFn f, void *c, int n) {
+    const int nt = numThreads.load();
+    if (nt == 0 || n < 2) {
+        for (int i = 0; i < n; ++i) {
+            f(c, i);
+        }
+        return;
+    }
+
+    //--- fork
+    // only this thread (or stop(), never at the same time) moves the generation on
+    const int g = generation.load() + 1;
+    // a worker still looking at the last job fails its claim from here on,
+    // so it never runs a task with the job fields below half-written
+    claim.store(packClaim(g, ClaimClosed));
+    fn = f;
+    ctx = c;
+    numTasks = n;
+    remaining.store(n);
+    claim.store(packClaim(g, 0));
+    generation.fetch_add(1);
+    if (numSleeping.load() > 0) {
+        futexWake(generation, INT_MAX);
+    }
+
+    // help out
+    processTasks(g);
+
+    //--- join
+    for (int i = 0; i < spinCount; ++i) {
+        if (remaining.load() == 0) { return; }
+    }
+    joinWaiting.store(1);
+    int r;
+    while ((r = remaining.load()) != 0) {
+        futexWait(remaining, r);
+    }
+    joinWaiting.store(0);
+}
+
+void WorkerPool::processTasks(int gen) {
+    uint64_t c = claim.load();
+    // the job fields can't change while a task of this generation is unclaimed,
+    // and the claim fails if they have changed since it was loaded
+    while (c >> 32 == static_cast<uint32_t>(gen) && (c & 0xffffffffu) < static_cast<uint64_t>(numTasks)) {
+        if (!claim.compare_exchange_weak(c, c + 1)) { continue; }
+        fn(ctx, static_cast<int>(c & 0xffffffffu));
+        if (remaining.fetch_sub(1) == 1 && joinWaiting.load()) {
+            futexWake(remaining, 1);
+        }
+        c = claim.load();
+    }
+}
+
+void WorkerPool::workLoop(int initialGeneration) {
+    int seen = initialGeneration;
+    while (true) {
+        // wait for the next job: spin, then sleep
+        int g = generation.load();
+        for (int i = 0; i < spinCount && g == seen; ++i) {
+            g = generation.load();
+        }
+        while (g == seen) {
+            numSleeping.fetch_add(1);
+            futexWait(generation, seen);
+            numSleeping.fetch_sub(1);
+            g = generation.load();
+        }
+        seen = g;
+        if (shouldQuit) { break; }
+
+        processTasks(g);
+    }
+}
+
+#ifdef __linux__
+void WorkerPool::futexWait(std::atomic<int> &word, int val) {
+    // returns immediately if the word no longer holds val
+    syscall(SYS_futex, reinterpret_cast<int *>(&word), FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+}
+
+void WorkerPool::futexWake(std::atomic<int> &word, int count) {
+    syscall(SYS_futex, reinterpret_cast<int *>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+#else
+// no futex: fall back to yielding
+void WorkerPool::futexWait(std::atomic<int> &word, int val) {
+    if (word.load() == val) {
+        std::this_thread::yield();
+    }
+}
+
+void WorkerPool::futexWake(std::atomic<int> &word, int count) {
+    (void) word;
+    (void) count;
+}
+#endif
@@ -0,0 +1,93 @@
+/*
+ * WorkerPool: real-time fork/join helper for the audio thread.
+ *
+ * worker threads are spawned up front (SCHED_FIFO if permitted), and park between jobs.
+ * the audio thread forks a job of N independent tasks with run(),
+ * helps to process them, and returns once all tasks have finished.
+ *
+ * no locks or allocation on the audio thread:
+ * - tasks are claimed with an atomic counter, tagged with the job's generation,
+ *   so a worker that wakes late for a finished job can't claim a task of the next one
+ * - completion is tracked with an atomic countdown of tasks; run() never waits for idle workers
+ * - both sides spin briefly before sleeping on a futex, so a short join costs no syscalls
+ *
+ * a pool started at normal priority also serves as a plain fork/join helper for non-RT work (e.g. disk I/O).
+ */
+
+#ifndef CRONE_WORKERPOOL_H
+#define CRONE_WORKERPOOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace crone {
+
+    class WorkerPool {
+    public:
+        // task function: called once per task index, from the audio thread or any worker
+        typedef void(*TaskFn)(void *ctx, int taskIdx);
+
+        enum { MaxThreads = 8 };
+
+        WorkerPool();
+        ~WorkerPool();
+
+        // spawn worker threads.
+        // if priority > 0, try to use SCHED_FIFO with that priority (normally the JACK RT priority).
+        void start(int numThreads, int priority);
+        // stop and join all workers.
+        // must not be called while the audio thread may be inside run()
+        void stop();
+
+        int getNumThreads() const { return numThreads; }
+
+        // from audio thread: process tasks [0, numTasks) and wait for all of them to finish.
+        // if there are no workers, tasks are processed serially on the calling thread.
+        void run(TaskFn fn, void *ctx, int numTasks);
+
+    private:
+        void workLoop(int initialGeneration);
+        // claim and process tasks of job `gen` until none remain
+        void processTasks(int gen);
+
+        static uint64_t packClaim(int gen, uint32_t task) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(gen)) << 32) | task;
+        }
+
+        static void futexWait(std::atomic<int> &word, int val);
+        static void futexWake(std::atomic<int> &word, int count);
+
+    private:
+        // number of spins before sleeping on the futex
+        static constexpr int spinCount = 2000;
+        // task index that closes a job to further claims
+        static constexpr uint32_t ClaimClosed = 0xffffffffu;
+
+        std::vector<std::unique_ptr<std::thread>> threads;
+        std::atomic<int> numThreads;
+
+        // current job
+        TaskFn fn;
+        void *ctx;
+        int numTasks;
+
+        // fork: incremented to publish a new job (or to request quit)
+        alignas(64) std::atomic<int> generation;
+        // number of workers sleeping on the generation futex
+        std::atomic<int> numSleeping;
+        // job generation (high 32 bits) and next unclaimed task index (low 32 bits)
+        alignas(64) std::atomic<uint64_t> claim;
+        // join: tasks not yet finished
+        alignas(64) std::atomic<int> remaining;
+        // set when the caller is sleeping on the remaining futex
+        std::atomic<int> joinWaiting;
+
+        std::atomic<bool> shouldQuit;
+    };
+
+}
+
+#endif //CRONE_WORKERPOOL_H
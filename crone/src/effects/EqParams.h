@@ -0,0 +1,17 @@
+#pragma once
+
+namespace crone { 
+typedef enum { 
+EQ_TILT_SLOPE = 0,
+EQ_TILT_FC = 1,
+EQ_TILT_BW = 2,
+EQ_LF_GAIN = 3,
+EQ_LF_FC = 4,
+EQ_PEAK_GAIN = 5,
+EQ_PEAK_FREQ = 6,
+EQ_PEAK_Q = 7,
+EQ_HF_GAIN = 8,
+EQ_HF_FC = 9,
+EQ_NUM_PARAMS = 10,
+} EqParam;
+} // namespace crone
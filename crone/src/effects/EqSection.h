@@ -0,0 +1,380 @@
+/* ------------------------------------------------------------
+name: "EqSection"
+Hand translation of dsp/EqSection.dsp, in the shape of the code dsp/generate.sh
+produces from it (EqSection_dsp, wrapped as in dsp/crone-arch.cpp).
+Regenerating with dsp/generate.sh replaces this file.
+------------------------------------------------------------ */
+
+#ifndef  _EQ_SECTION_H_
+#define  _EQ_SECTION_H_
+
+#include <string.h>
+
+#include "faust/gui/APIUI.h"
+#include "faust/gui/meta.h"
+#include "faust/dsp/dsp.h"
+
+#ifndef FAUSTFLOAT
+#define FAUSTFLOAT float
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <math.h>
+
+// process = tilt : par_eq, per channel:
+//   fi.spectral_tilt(5, fc, bw, slope)
+//   : fi.low_shelf(lf_gain, lf_fc)        (third order)
+//   : fi.peak_eq(peak_gain, fp, fp / peak_q), fp = peak_freq : si.smooth(0.999) : ba.pianokey2hz
+//   : fi.high_shelf(hf_gain, hf_fc)       (third order)
+// tf1s/tf2s are the filters.lib bilinear transforms.
+class EqSection_dsp : public dsp {
+
+ private:
+
+	enum { NumChannels = 2, TiltOrder = 5 };
+
+	// normalized (a0 = 1) first- and second-order coefficients
+	struct Tf1 {
+		float b0, b1, a1;
+	};
+	struct Tf2 {
+		float b0, b1, b2, a1, a2;
+	};
+	// transposed direct form II state
+	struct State {
+		float z1, z2;
+	};
+
+	FAUSTFLOAT fHslider0; // tilt slope
+	FAUSTFLOAT fHslider1; // tilt fc
+	FAUSTFLOAT fHslider2; // tilt bw
+	FAUSTFLOAT fHslider3; // lf_gain
+	FAUSTFLOAT fHslider4; // lf_fc
+	FAUSTFLOAT fHslider5; // peak_gain
+	FAUSTFLOAT fHslider6; // peak_freq (piano key)
+	FAUSTFLOAT fHslider7; // peak_q
+	FAUSTFLOAT fHslider8; // hf gain
+	FAUSTFLOAT fHslider9; // hf fc
+	int fSamplingFreq;
+	double fConst0; // SR
+	double fConst1; // 1 / SR
+
+	// slider values the block coefficients were last computed from
+	float fTiltLast[3];
+	float fLfLast[2];
+	float fHfLast[2];
+	float fPeakLast[3];
+
+	Tf1 fTilt[TiltOrder];
+	float fLfGain;
+	Tf1 fLp1, fHp1;
+	Tf2 fLp2, fHp2;
+	float fHfGain;
+	Tf1 fLp1h, fHp1h;
+	Tf2 fLp2h, fHp2h;
+	Tf2 fPeak;
+	float fRec0[2]; // smoothed peak key
+
+	State fTiltState[NumChannels][TiltOrder];
+	State fLfState[NumChannels][4];
+	State fHfState[NumChannels][4];
+	State fPeakState[NumChannels];
+
+	// 1 / tan(w * T / 2)
+	double warp(double w) {
+		return 1.0 / std::tan(0.5 * w * fConst1);
+	}
+
+	// tf1s(b1, b0, a0, w1)
+	Tf1 tf1s(double b1, double b0, double a0, double w1) {
+		const double c = warp(w1);
+		const double d = a0 + c;
+		return Tf1{float((b0 + b1 * c) / d), float((b0 - b1 * c) / d), float((a0 - c) / d)};
+	}
+
+	// tf2s(b2, b1, b0, a1, a0, w1)
+	Tf2 tf2s(double b2, double b1, double b0, double a1, double a0, double w1) {
+		const double c = warp(w1);
+		const double csq = c * c;
+		const double d = a0 + a1 * c + csq;
+		return Tf2{float((b0 + b1 * c + b2 * csq) / d),
+				   float(2.0 * (b0 - b2 * csq) / d),
+				   float((b0 - b1 * c + b2 * csq) / d),
+				   float(2.0 * (a0 - csq) / d),
+				   float((a0 - a1 * c + csq) / d)};
+	}
+
+	static float tick(const Tf1& k, State& s, float x) {
+		const float y = k.b0 * x + s.z1;
+		s.z1 = k.b1 * x - k.a1 * y;
+		return y;
+	}
+
+	static float tick(const Tf2& k, State& s, float x) {
+		const float y = k.b0 * x + s.z1;
+		s.z1 = k.b1 * x - k.a1 * y + s.z2;
+		s.z2 = k.b2 * x - k.a2 * y;
+		return y;
+	}
+
+	// fi.spectral_tilt(5, f0, bw, alpha): g * tf1s(1, mzh(i), mph(i), 1) for each section
+	void updateTilt(double alpha, double f0, double bw) {
+		const double w0 = 2.0 * M_PI * f0;
+		const double w1 = 2.0 * M_PI * (f0 + bw);
+		const double r = std::pow(w1 / w0, 1.0 / double(TiltOrder - 1));
+		// keep prewarped frequencies below nyquist
+		const double wMax = 2.0 * M_PI * 0.49 * fConst0;
+		const double tw0 = std::tan(0.5 * w0 * fConst1);
+		for (int i = 0; i < TiltOrder; i = (i + 1)) {
+			const double mzh = w0 * std::tan(0.5 * std::min(w0 * std::pow(r, i - alpha), wMax) * fConst1) / tw0;
+			const double mph = w0 * std::tan(0.5 * std::min(w0 * std::pow(r, double(i)), wMax) * fConst1) / tw0;
+			const double g = mph / mzh;
+			Tf1 k = tf1s(1.0, mzh, mph, 1.0);
+			k.b0 = float(g * k.b0);
+			k.b1 = float(g * k.b1);
+			fTilt[i] = k;
+		}
+	}
+
+	// third-order butterworth lowpass and highpass at fc, as fi.lowpass(3) / fi.highpass(3)
+	void updateShelf(double fc, Tf1& lp1, Tf2& lp2, Tf1& hp1, Tf2& hp2) {
+		const double w = 2.0 * M_PI * std::min(fc, 0.49 * fConst0);
+		lp1 = tf1s(0.0, 1.0, 1.0, w);
+		lp2 = tf2s(0.0, 0.0, 1.0, 1.0, 1.0, w);
+		hp1 = tf1s(1.0, 0.0, 1.0, w);
+		hp2 = tf2s(1.0, 0.0, 0.0, 1.0, 1.0, w);
+	}
+
+	// fi.peak_eq(Lfx, fx, B)
+	void updatePeak(double Lfx, double fx, double B) {
+		const double wx = 2.0 * M_PI * std::min(fx, 0.49 * fConst0);
+		const double Bw = B * fConst1 / std::sin(wx * fConst1);
+		const double a1 = M_PI * Bw;
+		const double b1 = std::pow(10.0, 0.05 * std::fabs(Lfx)) * a1;
+		if (Lfx > 0.0) {
+			fPeak = tf2s(1.0, b1, 1.0, a1, 1.0, wx);
+		} else {
+			fPeak = tf2s(1.0, a1, 1.0, b1, 1.0, wx);
+		}
+	}
+
+	// fi.low_shelf / fi.high_shelf: highpass + lowpass with one of them scaled
+	static float shelf(State* s, const Tf1& lp1, const Tf2& lp2, const Tf1& hp1, const Tf2& hp2,
+					   float gLow, float gHigh, float x) {
+		const float lo = tick(lp2, s[1], tick(lp1, s[0], x));
+		const float hi = tick(hp2, s[3], tick(hp1, s[2], x));
+		return gLow * lo + gHigh * hi;
+	}
+
+ public:
+
+	void metadata(Meta* m) {
+		m->declare("filename", "EqSection");
+		m->declare("name", "EqSection");
+	}
+
+	virtual int getNumInputs() {
+		return 2;
+	}
+	virtual int getNumOutputs() {
+		return 2;
+	}
+	virtual int getInputRate(int channel) {
+		return (channel == 0 || channel == 1) ? 1 : -1;
+	}
+	virtual int getOutputRate(int channel) {
+		return (channel == 0 || channel == 1) ? 1 : -1;
+	}
+
+	static void classInit(int samplingFreq) {
+		(void)samplingFreq;
+	}
+
+	virtual void instanceConstants(int samplingFreq) {
+		fSamplingFreq = samplingFreq;
+		fConst0 = std::min(192000.0, std::max(1.0, double(fSamplingFreq)));
+		fConst1 = (1.0 / fConst0);
+		// force coefficients to be recomputed at the new rate
+		fTiltLast[0] = NAN;
+		fLfLast[0] = NAN;
+		fHfLast[0] = NAN;
+		fPeakLast[0] = NAN;
+	}
+
+	virtual void instanceResetUserInterface() {
+		fHslider0 = FAUSTFLOAT(-0.5f);
+		fHslider1 = FAUSTFLOAT(100.0f);
+		fHslider2 = FAUSTFLOAT(5000.0f);
+		fHslider3 = FAUSTFLOAT(0.0f);
+		fHslider4 = FAUSTFLOAT(200.0f);
+		fHslider5 = FAUSTFLOAT(0.0f);
+		fHslider6 = FAUSTFLOAT(49.0f);
+		fHslider7 = FAUSTFLOAT(40.0f);
+		fHslider8 = FAUSTFLOAT(0.0f);
+		fHslider9 = FAUSTFLOAT(8000.0f);
+	}
+
+	virtual void instanceClear() {
+		fRec0[0] = 0.0f;
+		fRec0[1] = 0.0f;
+		memset(fTiltState, 0, sizeof(fTiltState));
+		memset(fLfState, 0, sizeof(fLfState));
+		memset(fHfState, 0, sizeof(fHfState));
+		memset(fPeakState, 0, sizeof(fPeakState));
+	}
+
+	virtual void init(int samplingFreq) {
+		classInit(samplingFreq);
+		instanceInit(samplingFreq);
+	}
+	virtual void instanceInit(int samplingFreq) {
+		instanceConstants(samplingFreq);
+		instanceResetUserInterface();
+		instanceClear();
+	}
+
+	virtual EqSection_dsp* clone() {
+		return new EqSection_dsp();
+	}
+	virtual int getSampleRate() {
+		return fSamplingFreq;
+	}
+
+	virtual void buildUserInterface(UI* ui_interface) {
+		ui_interface->openVerticalBox("EqSection");
+		ui_interface->declare(0, "0", "");
+		ui_interface->openHorizontalBox("spectral tilt");
+		ui_interface->declare(&fHslider0, "1", "");
+		ui_interface->declare(&fHslider0, "tooltip", "slope of spectral tilt across band");
+		ui_interface->addHorizontalSlider("slope", &fHslider0, -0.5f, -1.0f, 1.0f, 0.00100000005f);
+		ui_interface->declare(&fHslider1, "2", "");
+		ui_interface->declare(&fHslider1, "tooltip", "band start frequency");
+		ui_interface->declare(&fHslider1, "unit", "Hz");
+		ui_interface->addHorizontalSlider("fc", &fHslider1, 100.0f, 20.0f, 10000.0f, 1.0f);
+		ui_interface->declare(&fHslider2, "3", "");
+		ui_interface->declare(&fHslider2, "tooltip", "band width");
+		ui_interface->declare(&fHslider2, "unit", "Hz");
+		ui_interface->addHorizontalSlider("bw", &fHslider2, 5000.0f, 100.0f, 10000.0f, 1.0f);
+		ui_interface->closeBox();
+		ui_interface->declare(0, "0", "");
+		ui_interface->openHorizontalBox("parametric EQ");
+		ui_interface->declare(0, "1", "");
+		ui_interface->openVerticalBox("low shelf");
+		ui_interface->declare(&fHslider3, "0", "");
+		ui_interface->declare(&fHslider3, "unit", "db");
+		ui_interface->addHorizontalSlider("lf_gain", &fHslider3, 0.0f, -40.0f, 40.0f, 0.100000001f);
+		ui_interface->declare(&fHslider4, "1", "");
+		ui_interface->declare(&fHslider4, "scale", "log");
+		ui_interface->declare(&fHslider4, "style", "knob");
+		ui_interface->declare(&fHslider4, "unit", "hz");
+		ui_interface->addHorizontalSlider("lf_fc", &fHslider4, 200.0f, 1.0f, 5000.0f, 1.0f);
+		ui_interface->closeBox();
+		ui_interface->declare(0, "2", "");
+		ui_interface->openVerticalBox("peaking EQ");
+		ui_interface->declare(&fHslider5, "0", "");
+		ui_interface->declare(&fHslider5, "unit", "db");
+		ui_interface->addHorizontalSlider("peak_gain", &fHslider5, 0.0f, -40.0f, 40.0f, 0.100000001f);
+		ui_interface->declare(&fHslider6, "1", "");
+		ui_interface->declare(&fHslider6, "scale", "log");
+		ui_interface->declare(&fHslider6, "unit", "hz");
+		ui_interface->addHorizontalSlider("peak_freq", &fHslider6, 49.0f, 1.0f, 100.0f, 1.0f);
+		ui_interface->declare(&fHslider7, "2", "");
+		ui_interface->declare(&fHslider7, "scale", "log");
+		ui_interface->addHorizontalSlider("peak_q", &fHslider7, 40.0f, 1.0f, 1000.0f, 0.100000001f);
+		ui_interface->closeBox();
+		ui_interface->declare(0, "3", "");
+		ui_interface->openVerticalBox("high shelf]");
+		ui_interface->declare(&fHslider8, "0", "");
+		ui_interface->declare(&fHslider8, "style", "knob");
+		ui_interface->declare(&fHslider8, "unit", "db");
+		ui_interface->addHorizontalSlider("high boost|cut", &fHslider8, 0.0f, -40.0f, 40.0f, 0.100000001f);
+		ui_interface->declare(&fHslider9, "1", "");
+		ui_interface->declare(&fHslider9, "scale", "log");
+		ui_interface->declare(&fHslider9, "style", "knob");
+		ui_interface->declare(&fHslider9, "unit", "hz");
+		ui_interface->addHorizontalSlider("transition frequency", &fHslider9, 8000.0f, 20.0f, 10000.0f, 1.0f);
+		ui_interface->closeBox();
+		ui_interface->closeBox();
+		ui_interface->closeBox();
+	}
+
+	virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) {
+		// block-rate coefficients, recomputed only when their sliders move
+		const float tilt[3] = {float(fHslider0), float(fHslider1), float(fHslider2)};
+		if (memcmp(tilt, fTiltLast, sizeof(tilt)) != 0) {
+			updateTilt(tilt[0], tilt[1], tilt[2]);
+			memcpy(fTiltLast, tilt, sizeof(tilt));
+		}
+		const float lf[2] = {float(fHslider3), float(fHslider4)};
+		if (memcmp(lf, fLfLast, sizeof(lf)) != 0) {
+			fLfGain = std::pow(10.0f, 0.0500000007f * lf[0]);
+			updateShelf(lf[1], fLp1, fLp2, fHp1, fHp2);
+			memcpy(fLfLast, lf, sizeof(lf));
+		}
+		const float hf[2] = {float(fHslider8), float(fHslider9)};
+		if (memcmp(hf, fHfLast, sizeof(hf)) != 0) {
+			fHfGain = std::pow(10.0f, 0.0500000007f * hf[0]);
+			updateShelf(hf[1], fLp1h, fLp2h, fHp1h, fHp2h);
+			memcpy(fHfLast, hf, sizeof(hf));
+		}
+		const float fSlow0 = 0.00100000005f * float(fHslider6);
+		const float fSlow1 = float(fHslider5);
+		const float fSlow2 = float(fHslider7);
+		for (int i = 0; (i < count); i = (i + 1)) {
+			// the peak frequency is smoothed per sample, so its section follows it
+			fRec0[0] = (fSlow0 + (0.999000013f * fRec0[1]));
+			if (fRec0[0] != fPeakLast[0] || fSlow1 != fPeakLast[1] || fSlow2 != fPeakLast[2]) {
+				const double fp = 440.0 * std::pow(2.0, (double(fRec0[0]) - 49.0) / 12.0);
+				updatePeak(fSlow1, fp, fp / fSlow2);
+				fPeakLast[0] = fRec0[0];
+				fPeakLast[1] = fSlow1;
+				fPeakLast[2] = fSlow2;
+			}
+			for (int ch = 0; ch < NumChannels; ch = (ch + 1)) {
+				float x = float(inputs[ch][i]);
+				for (int k = 0; k < TiltOrder; k = (k + 1)) {
+					x = tick(fTilt[k], fTiltState[ch][k], x);
+				}
+				x = shelf(fLfState[ch], fLp1, fLp2, fHp1, fHp2, fLfGain, 1.0f, x);
+				x = tick(fPeak, fPeakState[ch], x);
+				x = shelf(fHfState[ch], fLp1h, fLp2h, fHp1h, fHp2h, 1.0f, fHfGain, x);
+				outputs[ch][i] = FAUSTFLOAT(x);
+			}
+			fRec0[1] = fRec0[0];
+		}
+	}
+
+};
+
+class EqSection
+{
+  private:
+
+    EqSection_dsp _dsp;
+    APIUI ui;
+
+  public:
+    EqSection() {
+        _dsp.buildUserInterface(&ui);
+    }
+
+    void init(double sampleRate)
+    {
+        EqSection_dsp::classInit(int(sampleRate));
+        _dsp.instanceConstants(int(sampleRate));
+        _dsp.instanceClear();
+    }
+
+    void processBlock(float** in, float** out, int numSamples)
+    {
+      _dsp.compute(numSamples, in, out);
+    }
+
+    int getNumInputs() { return _dsp.getNumInputs(); }
+    int getNumOutputs() { return _dsp.getNumOutputs(); }
+
+    APIUI& getUi() { return ui; }
+};
+
+#endif
@@ -7,31 +7,117 @@
 #include <thread>
 #include <memory>
 
+#include <cstdlib>
+#include <getopt.h>
+
 #include "MixerClient.h"
 #include "SoftcutClient.h"
 #include "OscInterface.h"
 #include "BufDiskWorker.h"
+#include "StreamVoice.h"
 
 static inline void sleep(int ms) {
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 }
 
-int main() {
+using crone::SoftcutClient;
+using crone::MixerClient;
+
+static void printUsage(std::ostream &os) {
+    os << "usage: crone [options]" << std::endl
+       << "  -w, --workers <n>          number of worker threads for softcut voices (default 0)" << std::endl
+       << "  -v, --voices <n>           number of softcut voices (default "
+       << SoftcutClient::DefaultVoices << ", max " << SoftcutClient::MaxVoices << ")" << std::endl
+       << "  -f, --buffer-frames <n>    frames in each softcut buffer (default "
+       << SoftcutClient::DefaultBufFrames << ")" << std::endl
+       << "  -p, --persist <dir>        map softcut buffers from files in <dir>, keeping contents across restarts"
+       << std::endl
+       << "  -m, --mlock                lock softcut buffer memory up front (persistent buffers are always locked)"
+       << std::endl
+       << "  -t, --tape-ring <seconds>  length of the tape record / playback rings (default "
+       << MixerClient::DefaultTapeRingSeconds << ")" << std::endl
+       << "  -h, --help                 print this message" << std::endl;
+}
+
+int main(int argc, char **argv) {
     using namespace crone;
     using std::cout;
     using std::endl;
 
+    int numWorkers = 0;
+    int numVoices = SoftcutClient::DefaultVoices;
+    size_t bufFrames = SoftcutClient::DefaultBufFrames;
+    bool lockBuffers = false;
+    std::string persistDir;
+    float tapeRingSeconds = MixerClient::DefaultTapeRingSeconds;
+
+    static struct option longOptions[] = {
+            {"workers",       required_argument, nullptr, 'w'},
+            {"voices",        required_argument, nullptr, 'v'},
+            {"buffer-frames", required_argument, nullptr, 'f'},
+            {"mlock",         no_argument,       nullptr, 'm'},
+            {"persist",       required_argument, nullptr, 'p'},
+            {"tape-ring",     required_argument, nullptr, 't'},
+            {"help",          no_argument,       nullptr, 'h'},
+            {nullptr, 0,                         nullptr, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "w:v:f:mp:t:h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'w':
+                numWorkers = atoi(optarg);
+                break;
+            case 'v':
+                numVoices = atoi(optarg);
+                break;
+            case 'f':
+                bufFrames = strtoul(optarg, nullptr, 10);
+                if (bufFrames == 0) {
+                    std::cerr << "invalid buffer size: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'm':
+                lockBuffers = true;
+                break;
+            case 'p':
+                persistDir = optarg;
+                break;
+            case 't':
+                tapeRingSeconds = static_cast<float>(atof(optarg));
+                if (tapeRingSeconds < 1.f) {
+                    std::cerr << "invalid tape ring length: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'h':
+                printUsage(std::cout);
+                return 0;
+            default:
+                // getopt has already reported the bad option
+                printUsage(std::cerr);
+                return 1;
+        }
+    }
+
 #if 1
     std::unique_ptr<MixerClient> m = std::make_unique<MixerClient>();
-    std::unique_ptr<SoftcutClient> sc = std::make_unique<SoftcutClient>();
+    m->setTapeRingFrames(static_cast<size_t>(tapeRingSeconds * 48000));
+    std::unique_ptr<SoftcutClient> sc = std::make_unique<SoftcutClient>(numVoices, bufFrames, lockBuffers, persistDir);
 
     cout << "initializing buffer management worker.." << endl;
     BufDiskWorker::init(48000);
+    StreamVoice::startDiskThread();
 
     cout << "setting up jack clients.." << endl;
     m->setup();
     sc->setup();
 
+    if (numWorkers > 0) {
+        cout << "starting softcut worker threads.." << endl;
+        sc->startWorkers(numWorkers);
+    }
+
     cout << "starting jack clients.." << endl;
     m->start();
     sc->start();
@@ -55,6 +141,8 @@ int main() {
     cout << "stopping clients" << endl;
     m->stop();
     sc->stop();
+    sc->stopWorkers();
+    StreamVoice::stopDiskThread();
     cout << "cleaning up clients..." << endl;
     m->cleanup();
     sc->cleanup();
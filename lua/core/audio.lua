@@ -143,6 +143,41 @@ function Audio.comp_param(name, val)
    _norns.comp_param(name, val)
 end
 
+--- turn on eq.
+function Audio.eq_on()
+   _norns.eq_on()
+end
+
+--- turn off eq.
+function Audio.eq_off()
+   _norns.eq_off()
+end
+
+--- set eq parameter.
+-- names: tilt_slope, tilt_fc, tilt_bw, lf_gain, lf_fc, peak_gain, peak_freq, peak_q, hf_gain, hf_fc.
+-- gains in dB, frequencies in Hz, except peak_freq: a piano key (1-100, 49 = 440 Hz).
+-- tilt_slope is -1 to 1, flat at 0.
+-- @tparam string name
+-- @tparam number val
+function Audio.eq_param(name, val)
+   _norns.eq_param(name, val)
+end
+
+local insert_ids = { none = -1, comp = 0, eq = 1 }
+
+--- set the effect in an insert slot.
+-- slots run in order, from 1; the default chain is eq, then comp.
+-- @tparam integer slot : 1 or 2
+-- @tparam string name : "comp", "eq" or "none"
+function Audio.insert_slot(slot, name)
+   local id = insert_ids[name]
+   if id == nil then
+      print("audio.insert_slot: unknown effect "..tostring(name))
+      return
+   end
+   _norns.insert_slot(slot - 1, id)
+end
+
 
 
 --- Tape Functions
@@ -154,6 +189,20 @@ Audio.tape_play_open = function(file)
   _norns.tape_play_open(file)
 end
 
+local tape_play_qualities = { fast = 0, medium = 1, best = 2 }
+
+--- set the resampling quality for tape files at another sample rate than the engine.
+-- applies to files opened afterwards.
+-- @tparam string quality : "fast", "medium" (default) or "best"
+Audio.tape_play_quality = function(quality)
+  local q = tape_play_qualities[quality]
+  if q == nil then
+    print("audio.tape_play_quality: unknown quality "..tostring(quality))
+    return
+  end
+  _norns.tape_play_quality(q)
+end
+
 --- start tape playing.
 Audio.tape_play_start = function()
   _norns.tape_play_start()
@@ -170,6 +219,29 @@ Audio.tape_record_open = function(file)
   _norns.tape_record_open(file)
 end
 
+local tape_stem_bits = { dac = 1, adc = 2, cut = 4, eng = 8, ext = 8, aux = 16 }
+
+--- open tape files to record several busses at once, sample-aligned.
+-- with split, each bus goes to its own stereo file, named from file with the bus added
+-- ("take.wav" -> "take-dac.wav", "take-adc.wav" ...; the engine bus is "ext");
+-- otherwise all go to one multichannel file, in the order dac, adc, cut, eng, aux.
+-- start and stop with tape_record_start / tape_record_stop.
+-- @param file
+-- @tparam table stems : any of "dac", "adc", "cut", "eng" (or "ext"), "aux"
+-- @tparam boolean split
+Audio.tape_record_open_stems = function(file, stems, split)
+  local mask = 0
+  for _, name in ipairs(stems) do
+    local bit = tape_stem_bits[name]
+    if bit == nil then
+      print("audio.tape_record_open_stems: unknown bus "..tostring(name))
+      return
+    end
+    if mask & bit == 0 then mask = mask + bit end
+  end
+  _norns.tape_record_open_stems(file, mask, split and true or false)
+end
+
 --- start tape recording.
 Audio.tape_record_start = function()
   _norns.tape_record_start()
@@ -180,6 +252,27 @@ Audio.tape_record_stop = function()
   _norns.tape_record_stop()
 end
 
+--- latest stats for each tape stream, "record" and "play".
+-- fields: running, seconds, fill (fraction of the disk ring in use), dropped (frames lost)
+Audio.tape_stats = {}
+
+--- callback for tape stats, twice a second while a stream runs and once when it stops.
+-- @tparam string stream : "record" or "play"
+-- @tparam table stats
+Audio.tape_stats_event = function(stream, stats) end
+
+_norns.tape_stats = function(stream, running, seconds, fill, dropped)
+  -- counts restart with each file
+  local prev = Audio.tape_stats[stream]
+  local before = (prev and prev.running) and prev.dropped or 0
+  if dropped > before then
+    print("tape "..stream..": "..dropped.." frames dropped")
+  end
+  local stats = { running = running, seconds = seconds, fill = fill, dropped = dropped }
+  Audio.tape_stats[stream] = stats
+  Audio.tape_stats_event(stream, stats)
+end
+
 
 --- Softcut levels
 -- @section softcut
@@ -222,6 +315,26 @@ Audio.vu = function(in1, in2, out1, out2)
    -- print (in1 .. '\t' .. in2 .. '\t' .. out1 .. '\t' .. out2)
 end
 
+--- callback for peak / RMS meters.
+-- scripts should redefine this, and start the poll with audio.meters_start().
+-- levels are in [0, 64], audio taper. channels are in this order:
+-- input 1/2, output 1/2, engine 1/2, softcut 1/2, reverb 1/2, tape 1/2, then each softcut voice.
+-- @tparam table peak peak level per channel
+-- @tparam table rms RMS level per channel
+Audio.meters = function(peak, rms) end
+
+_norns.meters = function(peak, rms) Audio.meters(peak, rms) end
+
+--- start the peak / RMS meter poll.
+Audio.meters_start = function()
+  _norns.poll_start_meters()
+end
+
+--- stop the peak / RMS meter poll.
+Audio.meters_stop = function()
+  _norns.poll_stop_meters()
+end
+
 
 --- helpers
 -- @section helpers
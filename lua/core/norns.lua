@@ -81,8 +81,16 @@ end
 
 -- i/o level callback.
 _norns.vu = function(in1, in2, out1, out2) end
+-- peak / RMS meter callback (replaced by audio module)
+_norns.meters = function(peak, rms) end
 -- softcut phase
-_norns.softcut_phase = function(id, value) end
+_norns.softcut_phase = function(id, value, time) end
+-- softcut loop wrap / record start / record stop
+_norns.softcut_event = function(id, event, pos, time) end
+-- softcut buffer job report (replaced by softcut module)
+_norns.softcut_buffer_job = function(id, state, progress) end
+-- tape record / playback stats (replaced by audio module)
+_norns.tape_stats = function(stream, running, seconds, fill, dropped) end
 
 -- default readings for battery
 norns.battery_percent = 0
@@ -168,6 +176,65 @@ else
 end
 
 
+-- event queue statistics.
+-- returns a table: pool_size, pool_used, pool_high (most slots ever in use),
+-- queued, queue_high (most events ever waiting), waits (producers stalled on a full pool),
+-- overflows (events that fell back to the heap), coalesced (events merged into another).
+-- @tparam boolean reset : restart the high-water marks after reading
+norns.event_stats = function(reset)
+  local stats = _norns.event_stats()
+  if reset then _norns.event_stats_reset() end
+  return stats
+end
+
+-- crone command queue statistics, per client ("mixer", "softcut"), as last reported.
+-- each is a table: posted, coalesced (posts merged into a queued command), applied,
+-- overflows (posts that found the queue full), dropped, max_latency_us, mean_latency_us.
+norns.command_stats = {}
+
+-- callback for command queue statistics.
+-- @tparam string client : "mixer" or "softcut"
+-- @tparam table stats
+norns.command_stats_event = function(client, stats) end
+
+-- ask crone for its command queue statistics, counted since the last request.
+-- they arrive in norns.command_stats, and through norns.command_stats_event.
+norns.request_command_stats = function()
+  _norns.command_stats_request()
+end
+
+_norns.command_stats = function(client, stats)
+  norns.command_stats[client] = stats
+  norns.command_stats_event(client, stats)
+end
+
+-- set how bursts of queued events are merged before their handlers run.
+-- types and the modes they allow:
+-- "enc", "arc_delta" : "sum" (default) or "none";
+-- "poll_value", "io_levels", "meters", "tape_stats" : "last" (default) or "none";
+-- "softcut_phase" : "none" (default, every crossing) or "last".
+-- grid, midi, keys and all other events are always handled one by one, in order.
+-- @tparam string type
+-- @tparam string mode : "none", "sum" or "last"
+-- @treturn boolean : false if the type can't be merged that way
+norns.event_coalesce = function(type, mode)
+  return _norns.event_coalesce(type, mode)
+end
+
+-- post-to-handling latency of a priority lane.
+-- events are handled by lane: "timing" (metro, clock) first, then "input" (keys, encoders,
+-- grid, arc, hid, midi, crow), then "bulk" (osc, polls, everything else), except that a lane
+-- whose oldest event is past its deadline goes first.
+-- @tparam string lane : "timing", "input" or "bulk"
+-- @tparam boolean reset : clear all lanes' histograms after reading
+-- @treturn table : bucket counts; bucket 1 is under 1us, bucket i is [2^(i-2), 2^(i-1)) us
+-- @treturn number : longest latency, in us
+norns.event_latency = function(lane, reset)
+  local counts, max_us = _norns.event_latency(lane)
+  if reset then _norns.event_latency_reset() end
+  return counts, max_us
+end
+
 -- Util (system_cmd)
 local system_cmd_q = {}
 local system_cmd_busy = false
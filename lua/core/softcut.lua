@@ -17,11 +17,21 @@ local controlspec = require 'core/controlspec'
 -------------------------------
 -- @section constants
 
+-- crone sets these at startup (`--voices`, `--buffer-frames`);
+-- they are refreshed from crone on every `reset()`
+
 -- @field number of voices
 SC.VOICE_COUNT = 6
 -- @field length of buffer in seconds
 SC.BUFFER_SIZE = 16777216 / 48000
 
+local function update_info()
+  local voices, frames = _norns.cut_info()
+  SC.VOICE_COUNT = voices
+  SC.BUFFER_SIZE = frames / 48000
+end
+update_info()
+
 -------------------------------
 -- @section setters
 
@@ -267,6 +277,12 @@ SC.poll_start_phase = function() _norns.poll_start_cut_phase() end
 --- stop phase poll
 SC.poll_stop_phase = function() _norns.poll_stop_cut_phase() end
 
+--- start reporting voice events (loop wraps, record start / stop)
+SC.poll_start_events = function() _norns.poll_start_cut_events() end
+
+--- stop reporting voice events
+SC.poll_stop_events = function() _norns.poll_stop_cut_events() end
+
 --- set voice enable
 -- disabled voices have no effect and consume basically zero CPU
 -- @tparam int voice : voice number (1-?)
@@ -275,26 +291,65 @@ SC.enable = function(voice, state) _norns.cut_enable(voice, state) end
 
 -- - TODO: complete function doc comments below here!
 
+-- buffer operations run in the background.
+-- each returns a job id, and takes an optional `done` callback,
+-- called with `true` when the job completes, or `false` if it fails.
+
+-- per-job completion callbacks, by job id
+local job_done = {}
+-- user callback for all job reports
+local job_event = nil
+
+local function track_job(id, done)
+  if done then job_done[id] = done end
+  return id
+end
+
+_norns.softcut_buffer_job = function(id, state, progress)
+  if job_event then job_event(id, state, progress) end
+  if state ~= "progress" then
+    local done = job_done[id]
+    job_done[id] = nil
+    if done then done(state == "done") end
+  end
+end
+
 --- clear all buffers completely
-SC.buffer_clear = function() _norns.cut_buffer_clear() end
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_clear = function(done) return track_job(_norns.cut_buffer_clear(), done) end
+
+--- flush recorded regions to disk, when crone runs with persistent buffers (-p).
+-- only regions written since the last sync are saved; without persistent buffers, this does nothing.
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_sync = function(done) return track_job(_norns.cut_buffer_sync(), done) end
 
 --- clear one buffer completely
 -- @tparam int channel : buffer channel index (1-based)
-SC.buffer_clear_channel = function(channel) _norns.cut_buffer_clear_channel(channel) end
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_clear_channel = function(channel, done)
+  return track_job(_norns.cut_buffer_clear_channel(channel), done)
+end
 
 --- clear region (both channels)
 -- @tparam number start : start point in seconds
 -- @tparam number dur : duration in seconds
-SC.buffer_clear_region = function(start, dur)
-  _norns.cut_buffer_clear_region(start, dur)
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_clear_region = function(start, dur, done)
+  return track_job(_norns.cut_buffer_clear_region(start, dur), done)
 end
 
 --- clear region of single channel
 -- @tparam int ch : buffer channel index (1-based)
 -- @tparam number start : start point in seconds
 -- @tparam number dur : duration in seconds
-SC.buffer_clear_region_channel = function(ch, start, dur)
-  _norns.cut_buffer_clear_region_channel(ch, start, dur)
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_clear_region_channel = function(ch, start, dur, done)
+  return track_job(_norns.cut_buffer_clear_region_channel(ch, start, dur), done)
 end
 
 --- read mono soundfile to arbitrary region of single buffer
@@ -304,8 +359,10 @@ end
 -- @tparam number dur : duration in seconds. if -1, read as much as possible.
 -- @tparam int ch_src : soundfie channel to read
 -- @tparam int ch_dst : buffer channel to write
-SC.buffer_read_mono = function(file, start_src, start_dst, dur, ch_src, ch_dst)
-  _norns.cut_buffer_read_mono(file, start_src, start_dst, dur, ch_src, ch_dst)
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_read_mono = function(file, start_src, start_dst, dur, ch_src, ch_dst, done)
+  return track_job(_norns.cut_buffer_read_mono(file, start_src, start_dst, dur, ch_src, ch_dst), done)
 end
 
 --- read stereo soundfile to an arbitrary region in both buffers
@@ -313,8 +370,10 @@ end
 -- @tparam number start_src : start point in source, in seconds
 -- @tparam number start_dst : start point in destination, in seconds
 -- @tparam number dur : duration in seconds. if -1, read as much as possible
-SC.buffer_read_stereo = function(file, start_src, start_dst, dur)
-  _norns.cut_buffer_read_stereo(file, start_src, start_dst, dur)
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_read_stereo = function(file, start_src, start_dst, dur, done)
+  return track_job(_norns.cut_buffer_read_stereo(file, start_src, start_dst, dur), done)
 end
 
 --- write an arbitrary buffer region to soundfile (mono)
@@ -322,31 +381,64 @@ end
 -- @tparam number start : start point in seconds
 -- @tparam number dur : duration in seconds. if -1, read as much as possible
 -- @tparam int ch : buffer channel index (1-based)
-SC.buffer_write_mono = function(file, start, dur, ch)
-  _norns.cut_buffer_write_mono(file, start, dur, ch)
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_write_mono = function(file, start, dur, ch, done)
+  return track_job(_norns.cut_buffer_write_mono(file, start, dur, ch), done)
 end
 
 --- write an arbitrary region from both buffers to stereo soundfile
 -- @tparam string file : output file path
 -- @tparam number start : start point in seconds
 -- @tparam number dur : duration in seconds. if -1, read as much as possible
-SC.buffer_write_stereo = function(file, start, dur)
-  _norns.cut_buffer_write_stereo(file, start, dur)
+-- @tparam function done : (optional) completion callback
+-- @treturn int job id
+SC.buffer_write_stereo = function(file, start, dur, done)
+  return track_job(_norns.cut_buffer_write_stereo(file, start, dur), done)
 end
 
 --- set function for phase poll
--- @tparam function func : callback function. this function should take two parameters  (voice, phase)
+-- @tparam function func : callback function. this function should take two parameters  (voice, phase).
+-- an optional third parameter is the time of the phase change, on the same clock as util.time()
 SC.event_phase = function(func) _norns.softcut_phase = func end
 
+--- set function for voice events
+-- @tparam function func : callback function. this function should take four parameters (voice, event, position, time).
+-- event is "loop", "rec_start" or "rec_stop"; time is on the same clock as util.time()
+SC.event_voice = function(func) _norns.softcut_event = func end
+
+--- set function for buffer job reports
+-- @tparam function func : callback function. this function should take three parameters (id, state, progress).
+-- state is "progress", "done" or "failed"; progress is in [0, 1]
+SC.event_buffer_job = function(func) job_event = func end
+
 
 -------------------------------
 -- @section utilities
 
+--- stream a voice from a sound file instead of its buffer.
+-- the voice plays and records directly against the file, which can be much longer than a buffer.
+-- loop points, position, rec / play flags, rec / pre levels and fade time apply as usual; rate is fixed at 1.
+-- the file must be mono 32-bit float WAV / CAF, or headerless float32.
+-- @tparam int voice : voice number (1-based)
+-- @tparam string file : file path
+-- @tparam number min_dur : (optional) for headerless files: create or extend the file to this many seconds
+SC.stream_open = function(voice, file, min_dur) _norns.cut_stream_open(voice, file, min_dur or 0) end
+
+--- stop streaming a voice; it goes back to playing from its buffer.
+-- recorded material is flushed to the file.
+-- @tparam int voice : voice number (1-based)
+SC.stream_close = function(voice) _norns.cut_stream_close(voice) end
+
 --- reset state of softcut process on backend.
 -- this should correspond to the values returned by the `defaults()` function above.
 function SC.reset()
+  update_info()
    _norns.cut_reset()
   SC.event_phase(norns.none)
+  SC.event_voice(norns.none)
+  SC.event_buffer_job(nil)
+  job_done = {}
 end
 
 --- get the default state of the softcut system
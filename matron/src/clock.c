@@ -6,6 +6,7 @@
 #include <time.h>
 
 #include "clock.h"
+#include "clock_scheduler.h"
 #include "events.h"
 
 #include <lauxlib.h>
@@ -15,83 +16,27 @@ struct clock_reference_t {
     double beat;
     double beat_duration;
     double last_beat_time;
+    // the source changed since the last update, so its beat count is unrelated to the previous one
+    bool source_changed;
     pthread_mutex_t lock;
 };
 
-struct clock_thread_t {
-    pthread_t thread;
-    bool running;
-    int coro_id;
-};
-
 static struct clock_reference_t reference;
 static clock_source_t clock_source;
 
-#define NUM_THREADS 100
-static struct clock_thread_t clock_thread_pool[NUM_THREADS];
-
-struct clock_thread_arg {
-    int thread_index; // thread pool index
-    int coro_id;
-    double seconds;
-};
-
 void clock_init() {
-    for (int i = 0; i < NUM_THREADS; i++) {
-        clock_thread_pool[i].running = false;
-    }
-
     pthread_mutex_init(&reference.lock, NULL);
 
+    if (!clock_scheduler_init()) {
+        fprintf(stderr, "clock_init(): can't start clock scheduler\n");
+        exit(EXIT_FAILURE);
+    }
     clock_set_source(CLOCK_SOURCE_INTERNAL);
     clock_update_reference(0, 0.5);
 }
 
-static void *clock_schedule_resume_run(void *p) {
-    struct clock_thread_arg *arg = p;
-    int coro_id = arg->coro_id;
-    double seconds = arg->seconds;
-
-    struct timespec req = {
-        .tv_sec = (time_t)seconds,
-        .tv_nsec = (long)((seconds - req.tv_sec) * 1e+9),
-    };
-
-    clock_nanosleep(CLOCK_MONOTONIC, 0, &req, NULL);
-
-    union event_data *ev = event_data_new(EVENT_CLOCK_RESUME);
-    ev->clock_resume.thread_id = coro_id;
-    event_post(ev);
-
-    clock_thread_pool[arg->thread_index].coro_id = -1;
-    clock_thread_pool[arg->thread_index].running = false;
-    free(p);
-
-    return NULL;
-}
-
 bool clock_schedule_resume_sleep(int coro_id, double seconds) {
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-    pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-
-    for (int i = 0; i < NUM_THREADS; i++) {
-        if (!clock_thread_pool[i].running) {
-            struct clock_thread_arg *arg = malloc(sizeof(struct clock_thread_arg));
-            arg->thread_index = i;
-            arg->coro_id = coro_id;
-            arg->seconds = seconds;
-
-            clock_thread_pool[i].running = true;
-            clock_thread_pool[i].coro_id = coro_id;
-            pthread_create(&clock_thread_pool[i].thread, &attr, &clock_schedule_resume_run, arg);
-
-            return true;
-        }
-    }
-
-    return false;
+    return clock_scheduler_sleep(coro_id, seconds);
 }
 
 double clock_gettime_secondsf() {
@@ -143,9 +88,14 @@ bool clock_schedule_resume_sync(int coro_id, double beats) {
         next_beat_time = zero_beat_time + (next_beat * reference.beat_duration);
     } while (next_beat_time - current_time < reference.beat_duration * beats / 2000);
 
+    // wait in beats, so the wakeup follows later tempo changes.
+    // inserted under the reference lock, so a reference update (which may re-key all waiters)
+    // can't come between computing the beat and scheduling it
+    bool ok = clock_scheduler_sync(coro_id, next_beat, beats);
+
     pthread_mutex_unlock(&reference.lock);
 
-    return clock_schedule_resume_sleep(coro_id, next_beat_time - current_time);
+    return ok;
 }
 
 void clock_update_reference(double beats, double beat_duration) {
@@ -155,6 +105,9 @@ void clock_update_reference(double beats, double beat_duration) {
     reference.beat_duration = beat_duration;
     reference.last_beat_time = current_time;
     reference.beat = beats;
+    // under the lock, so concurrent updates reach the scheduler in order
+    clock_scheduler_set_reference(current_time - (beat_duration * beats), beat_duration, reference.source_changed);
+    reference.source_changed = false;
 
     pthread_mutex_unlock(&reference.lock);
 }
@@ -180,26 +133,18 @@ void clock_stop_from(clock_source_t source) {
 }
 
 void clock_set_source(clock_source_t source) {
+    pthread_mutex_lock(&reference.lock);
+    if (source != clock_source) {
+        reference.source_changed = true;
+    }
     clock_source = source;
+    pthread_mutex_unlock(&reference.lock);
 }
 
 void clock_cancel_coro(int coro_id) {
-    for (int i = 0; i < NUM_THREADS; i++) {
-        if (clock_thread_pool[i].coro_id == coro_id) {
-            clock_cancel(i);
-        }
-    }
-}
-
-void clock_cancel(int index) {
-    pthread_cancel(clock_thread_pool[index].thread);
-    pthread_join(clock_thread_pool[index].thread, NULL);
-    clock_thread_pool[index].running = false;
-    clock_thread_pool[index].coro_id = -1;
+    clock_scheduler_cancel(coro_id);
 }
 
 void clock_cancel_all() {
-    for (int i = 0; i < NUM_THREADS; i++) {
-        clock_cancel(i);
-    }
+    clock_scheduler_cancel_all();
 }
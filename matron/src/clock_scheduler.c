@@ -0,0 +1,541 @@
+/*
+ * clock_scheduler.c
+ *
+ * one thread wakes all sleeping clock coroutines.
+ *
+ * pending wakeups are kept in a binary min-heap ordered by deadline (CLOCK_MONOTONIC),
+ * which grows as needed, so any number of coroutines can wait at once.
+ * the thread sleeps until the earliest deadline, and is woken early when an earlier one is added.
+ *
+ * sync waiters (clock.sync) are kept in a second heap, ordered by the beat they wait for rather than by time.
+ * their deadlines are derived from the current beat reference (time of beat 0, beat duration), which
+ * clock.c passes on every clock_update_reference. beat -> time is increasing for any tempo, so a tempo change
+ * never reorders the heap: only the top's deadline is recomputed, and waiters stay on their beat through
+ * tempo ramps and external clock drift.
+ * the beat count itself can jump back (transport start or reset) or to an unrelated count (a new clock source).
+ * then every sync waiter is moved to the next multiple of its division on the new count, and the heap rebuilt,
+ * so a clock.sync(1) waits less than a beat after a reset rather than for the old beat to come round again.
+ *
+ * cancelling is O(1): each coroutine's live wakeup is recorded in a hash map (coroutine id -> generation),
+ * and cancelling just removes it from the map. heap entries whose generation no longer matches are
+ * dropped when they reach the top, or all at once when they make up most of the heaps.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clock_scheduler.h"
+#include "events.h"
+
+// most wakeups posted per pass, before taking the lock again
+#define SCHED_BATCH 64
+// stale heap entries tolerated before compacting (if they're also most of the heap)
+#define SCHED_COMPACT_MIN 64
+// a reference moving the current beat back by more than this re-keys the sync waiters.
+// smaller moves are external clocks correcting their estimate; they only delay waiters that much
+#define SCHED_REBASE_BEATS (1.0 / 16.0)
+
+#define MAP_EMPTY INT_MIN
+
+struct sched_entry {
+    double key; // sleepers: deadline (CLOCK_MONOTONIC, ns). syncers: target beat
+    double division; // syncers: the beat multiple waited for (see rebase_syncers())
+    uint32_t gen;
+    int coro_id;
+};
+
+struct sched_heap {
+    struct sched_entry *items;
+    size_t size;
+    size_t capacity;
+};
+
+// coroutine id -> generation of its pending wakeup. open addressing, linear probing
+struct waiter_map {
+    int *keys;
+    uint32_t *gens;
+    size_t capacity; // power of 2
+    size_t count;
+};
+
+static struct sched_heap sleepers;
+static struct sched_heap syncers;
+static struct waiter_map waiters;
+static uint32_t next_gen;
+// entries in either heap that were cancelled or replaced
+static size_t stale;
+
+// beat reference: time of beat 0 (CLOCK_MONOTONIC, ns) and ns per beat
+static double ref_zero_ns;
+static double ref_beat_ns;
+
+static pthread_t sched_thread;
+static pthread_mutex_t sched_lock;
+static pthread_cond_t sched_changed;
+
+//---------------------------
+//---- static declarations
+
+static void *sched_thread_loop(void *arg);
+
+//--- time
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline struct timespec ns_to_timespec(double deadline) {
+    // round up, so the deadline has passed on waking
+    uint64_t ns = (uint64_t)ceil(deadline);
+    struct timespec ts = {
+        .tv_sec = (time_t)(ns / 1000000000ull),
+        .tv_nsec = (long)(ns % 1000000000ull),
+    };
+    return ts;
+}
+
+//--- waiter map
+
+static inline size_t map_hash(int key, size_t capacity) {
+    return ((uint32_t)key * 2654435761u) & (capacity - 1);
+}
+
+static bool map_resize(struct waiter_map *m, size_t capacity) {
+    int *keys = malloc(capacity * sizeof(int));
+    uint32_t *gens = malloc(capacity * sizeof(uint32_t));
+    if (keys == NULL || gens == NULL) {
+        free(keys);
+        free(gens);
+        return false;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        keys[i] = MAP_EMPTY;
+    }
+    for (size_t i = 0; i < m->capacity; i++) {
+        if (m->keys[i] != MAP_EMPTY) {
+            size_t j = map_hash(m->keys[i], capacity);
+            while (keys[j] != MAP_EMPTY) {
+                j = (j + 1) & (capacity - 1);
+            }
+            keys[j] = m->keys[i];
+            gens[j] = m->gens[i];
+        }
+    }
+    free(m->keys);
+    free(m->gens);
+    m->keys = keys;
+    m->gens = gens;
+    m->capacity = capacity;
+    return true;
+}
+
+// slot holding key, or the empty slot where it would go
+static size_t map_find(const struct waiter_map *m, int key) {
+    size_t i = map_hash(key, m->capacity);
+    while (m->keys[i] != MAP_EMPTY && m->keys[i] != key) {
+        i = (i + 1) & (m->capacity - 1);
+    }
+    return i;
+}
+
+static bool map_get(const struct waiter_map *m, int key, uint32_t *gen) {
+    size_t i = map_find(m, key);
+    if (m->keys[i] == MAP_EMPTY) {
+        return false;
+    }
+    *gen = m->gens[i];
+    return true;
+}
+
+// returns false if out of memory
+static bool map_put(struct waiter_map *m, int key, uint32_t gen) {
+    // keep the load under 1/2
+    if ((m->count + 1) * 2 > m->capacity && !map_resize(m, m->capacity * 2)) {
+        return false;
+    }
+    size_t i = map_find(m, key);
+    if (m->keys[i] == MAP_EMPTY) {
+        m->keys[i] = key;
+        m->count++;
+    }
+    m->gens[i] = gen;
+    return true;
+}
+
+// returns false if key wasn't there
+static bool map_remove(struct waiter_map *m, int key) {
+    size_t i = map_find(m, key);
+    if (m->keys[i] == MAP_EMPTY) {
+        return false;
+    }
+    // shift later members of the probe run back, so lookups never stop short
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & (m->capacity - 1);
+        if (m->keys[j] == MAP_EMPTY) {
+            break;
+        }
+        size_t home = map_hash(m->keys[j], m->capacity);
+        // move j to i unless its home lies cyclically in (i, j]
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            m->keys[i] = m->keys[j];
+            m->gens[i] = m->gens[j];
+            i = j;
+        }
+    }
+    m->keys[i] = MAP_EMPTY;
+    m->count--;
+    return true;
+}
+
+static void map_clear(struct waiter_map *m) {
+    for (size_t i = 0; i < m->capacity; i++) {
+        m->keys[i] = MAP_EMPTY;
+    }
+    m->count = 0;
+}
+
+//--- heap
+
+static inline bool entry_before(const struct sched_entry *a, const struct sched_entry *b) {
+    // equal keys wake in the order they were scheduled
+    return a->key < b->key || (a->key == b->key && (int32_t)(a->gen - b->gen) < 0);
+}
+
+static void heap_sift_up(struct sched_heap *h, size_t i) {
+    struct sched_entry e = h->items[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!entry_before(&e, &h->items[parent])) {
+            break;
+        }
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i] = e;
+}
+
+static void heap_sift_down(struct sched_heap *h, size_t i) {
+    struct sched_entry e = h->items[i];
+    while (true) {
+        size_t child = 2 * i + 1;
+        if (child >= h->size) {
+            break;
+        }
+        if (child + 1 < h->size && entry_before(&h->items[child + 1], &h->items[child])) {
+            child++;
+        }
+        if (!entry_before(&h->items[child], &e)) {
+            break;
+        }
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = e;
+}
+
+// returns false if out of memory
+static bool heap_push(struct sched_heap *h, const struct sched_entry *e) {
+    if (h->size == h->capacity) {
+        size_t capacity = h->capacity > 0 ? h->capacity * 2 : 256;
+        struct sched_entry *items = realloc(h->items, capacity * sizeof(struct sched_entry));
+        if (items == NULL) {
+            return false;
+        }
+        h->items = items;
+        h->capacity = capacity;
+    }
+    h->items[h->size] = *e;
+    heap_sift_up(h, h->size++);
+    return true;
+}
+
+static void heap_pop(struct sched_heap *h) {
+    if (--h->size > 0) {
+        h->items[0] = h->items[h->size];
+        heap_sift_down(h, 0);
+    }
+}
+
+//--- entries
+
+static inline bool entry_live(const struct sched_entry *e) {
+    uint32_t gen;
+    return map_get(&waiters, e->coro_id, &gen) && gen == e->gen;
+}
+
+// CLOCK_MONOTONIC ns at which entry e of heap h is due; call with the lock held
+static inline double entry_deadline(const struct sched_heap *h, const struct sched_entry *e) {
+    if (h == &sleepers) {
+        return e->key;
+    }
+    if (ref_beat_ns <= 0) {
+        // no reference yet
+        return INFINITY;
+    }
+    return ref_zero_ns + e->key * ref_beat_ns;
+}
+
+// re-key every sync waiter to the next multiple of its division after the current beat of the
+// (new) reference, then restore heap order; call with the lock held
+static void rebase_syncers(void) {
+    const double now_beat = ((double)now_ns() - ref_zero_ns) / ref_beat_ns;
+    for (size_t i = 0; i < syncers.size; i++) {
+        struct sched_entry *e = &syncers.items[i];
+        double key = (floor(now_beat / e->division) + 1) * e->division;
+        // as in clock_schedule_resume_sync(): never a boundary that has (all but) passed
+        if (key - now_beat < e->division / 2000) {
+            key += e->division;
+        }
+        e->key = key;
+    }
+    for (size_t i = syncers.size / 2; i-- > 0;) {
+        heap_sift_down(&syncers, i);
+    }
+}
+
+static void heap_compact(struct sched_heap *h) {
+    size_t n = 0;
+    for (size_t i = 0; i < h->size; i++) {
+        if (entry_live(&h->items[i])) {
+            h->items[n++] = h->items[i];
+        }
+    }
+    h->size = n;
+    for (size_t i = n / 2; i-- > 0;) {
+        heap_sift_down(h, i);
+    }
+}
+
+// drop stale entries once they're most of the heap; O(n)
+static void maybe_compact(void) {
+    if (stale < SCHED_COMPACT_MIN || stale * 2 < sleepers.size + syncers.size) {
+        return;
+    }
+    heap_compact(&sleepers);
+    heap_compact(&syncers);
+    stale = 0;
+}
+
+// call with the lock held
+static bool schedule(struct sched_heap *h, int coro_id, double key, double division) {
+    uint32_t old;
+    bool replacing = map_get(&waiters, coro_id, &old);
+    struct sched_entry e = {key, division, ++next_gen, coro_id};
+    if (!heap_push(h, &e)) {
+        fprintf(stderr, "clock_scheduler: out of memory\n");
+        return false;
+    }
+    if (!map_put(&waiters, coro_id, e.gen)) {
+        fprintf(stderr, "clock_scheduler: out of memory\n");
+        // the new entry stays in the heap, unmatched
+        stale++;
+        return false;
+    }
+    if (replacing) {
+        stale++;
+        maybe_compact();
+    }
+    if (h->items[0].gen == e.gen) {
+        // new earliest deadline
+        pthread_cond_signal(&sched_changed);
+    }
+    return true;
+}
+
+//------------------------
+//---- extern definitions
+
+bool clock_scheduler_init(void) {
+    sleepers.capacity = 256;
+    sleepers.items = malloc(sleepers.capacity * sizeof(struct sched_entry));
+    sleepers.size = 0;
+    syncers.capacity = 256;
+    syncers.items = malloc(syncers.capacity * sizeof(struct sched_entry));
+    syncers.size = 0;
+    waiters.capacity = 0;
+    waiters.keys = NULL;
+    waiters.gens = NULL;
+    waiters.count = 0;
+    if (sleepers.items == NULL || syncers.items == NULL || !map_resize(&waiters, 512)) {
+        fprintf(stderr, "clock_scheduler: out of memory\n");
+        goto fail;
+    }
+    stale = 0;
+    next_gen = 0;
+    ref_zero_ns = 0;
+    ref_beat_ns = 0;
+
+    pthread_mutex_init(&sched_lock, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    // deadlines are on the monotonic clock
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sched_changed, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    int res = pthread_create(&sched_thread, NULL, &sched_thread_loop, NULL);
+    if (res != 0) {
+        fprintf(stderr, "clock_scheduler: failed to create thread (%s)\n", strerror(res));
+        pthread_cond_destroy(&sched_changed);
+        pthread_mutex_destroy(&sched_lock);
+        goto fail;
+    }
+    pthread_detach(sched_thread);
+    return true;
+
+fail:
+    free(sleepers.items);
+    free(syncers.items);
+    free(waiters.keys);
+    free(waiters.gens);
+    sleepers.items = syncers.items = NULL;
+    waiters.keys = NULL;
+    waiters.gens = NULL;
+    waiters.capacity = 0;
+    return false;
+}
+
+bool clock_scheduler_sleep(int coro_id, double seconds) {
+    double wake = (double)now_ns() + seconds * 1e9;
+    pthread_mutex_lock(&sched_lock);
+    bool ok = schedule(&sleepers, coro_id, wake, 0);
+    pthread_mutex_unlock(&sched_lock);
+    return ok;
+}
+
+bool clock_scheduler_sync(int coro_id, double beat, double division) {
+    if (division <= 0) {
+        return false;
+    }
+    pthread_mutex_lock(&sched_lock);
+    bool ok = schedule(&syncers, coro_id, beat, division);
+    pthread_mutex_unlock(&sched_lock);
+    return ok;
+}
+
+void clock_scheduler_set_reference(double zero_beat_time, double beat_duration, bool new_source) {
+    if (beat_duration <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&sched_lock);
+    bool rebase = new_source;
+    if (ref_beat_ns > 0 && !rebase) {
+        double now = (double)now_ns();
+        double old_beat = (now - ref_zero_ns) / ref_beat_ns;
+        double new_beat = (now - zero_beat_time * 1e9) / (beat_duration * 1e9);
+        rebase = new_beat < old_beat - SCHED_REBASE_BEATS;
+    }
+    ref_zero_ns = zero_beat_time * 1e9;
+    ref_beat_ns = beat_duration * 1e9;
+    if (rebase) {
+        rebase_syncers();
+    }
+    if (syncers.size > 0) {
+        // the earliest sync deadline moved
+        pthread_cond_signal(&sched_changed);
+    }
+    pthread_mutex_unlock(&sched_lock);
+}
+
+void clock_scheduler_cancel(int coro_id) {
+    pthread_mutex_lock(&sched_lock);
+    if (map_remove(&waiters, coro_id)) {
+        stale++;
+        maybe_compact();
+    }
+    pthread_mutex_unlock(&sched_lock);
+}
+
+void clock_scheduler_cancel_all(void) {
+    pthread_mutex_lock(&sched_lock);
+    sleepers.size = 0;
+    syncers.size = 0;
+    map_clear(&waiters);
+    stale = 0;
+    pthread_mutex_unlock(&sched_lock);
+}
+
+int clock_scheduler_pending(void) {
+    pthread_mutex_lock(&sched_lock);
+    int n = (int)waiters.count;
+    pthread_mutex_unlock(&sched_lock);
+    return n;
+}
+
+//------------------------
+//---- static definitions
+
+// move due live entries of h into due[] (from index n), dropping stale ones on the way; returns the new count
+static int collect_due(struct sched_heap *h, double now, int *due, int n) {
+    while (h->size > 0 && n < SCHED_BATCH) {
+        struct sched_entry top = h->items[0];
+        if (!entry_live(&top)) {
+            heap_pop(h);
+            stale--;
+            continue;
+        }
+        if (entry_deadline(h, &top) > now) {
+            break;
+        }
+        heap_pop(h);
+        map_remove(&waiters, top.coro_id);
+        due[n++] = top.coro_id;
+    }
+    return n;
+}
+
+static void *sched_thread_loop(void *arg) {
+    (void)arg;
+    int due[SCHED_BATCH];
+
+    pthread_mutex_lock(&sched_lock);
+    while (true) {
+        double now = (double)now_ns();
+        int n = collect_due(&sleepers, now, due, 0);
+        n = collect_due(&syncers, now, due, n);
+
+        if (n > 0) {
+            // post without the lock: event_data_new() can wait when the event pool is full
+            pthread_mutex_unlock(&sched_lock);
+            for (int i = 0; i < n; i++) {
+                union event_data *ev = event_data_new(EVENT_CLOCK_RESUME);
+                ev->clock_resume.thread_id = due[i];
+                event_post(ev);
+            }
+            pthread_mutex_lock(&sched_lock);
+            continue;
+        }
+
+        // sync deadlines are recomputed here, after every reference update
+        double wake = INFINITY;
+        if (sleepers.size > 0) {
+            wake = entry_deadline(&sleepers, &sleepers.items[0]);
+        }
+        if (syncers.size > 0) {
+            wake = fmin(wake, entry_deadline(&syncers, &syncers.items[0]));
+        }
+
+        if (isinf(wake)) {
+            pthread_cond_wait(&sched_changed, &sched_lock);
+        } else {
+            struct timespec ts = ns_to_timespec(wake);
+            int res = pthread_cond_timedwait(&sched_changed, &sched_lock, &ts);
+            if (res != 0 && res != ETIMEDOUT && res != EINTR) {
+                fprintf(stderr, "clock_scheduler: wait failed (%s)\n", strerror(res));
+            }
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+ * clock_scheduler.h
+ *
+ * wakes sleeping and syncing clock coroutines, from a single timer thread.
+ */
+
+#include <stdbool.h>
+
+// start the scheduler thread. returns false if it can't (out of memory, or no thread)
+bool clock_scheduler_init(void);
+
+// post EVENT_CLOCK_RESUME for coro_id after `seconds`.
+// replaces any wakeup already pending for coro_id. returns false if out of memory
+bool clock_scheduler_sleep(int coro_id, double seconds);
+// post EVENT_CLOCK_RESUME for coro_id when the clock reaches `beat`, a multiple of `division`,
+// following tempo changes. replaces any wakeup already pending for coro_id.
+// returns false if out of memory
+bool clock_scheduler_sync(int coro_id, double beat, double division);
+// beat reference for sync waiters: time of beat 0 (clock_gettime_secondsf) and seconds per beat.
+// if the beat count went back, or comes from a new source, waiters move to the next multiple of their division
+void clock_scheduler_set_reference(double zero_beat_time, double beat_duration, bool new_source);
+// drop coro_id's pending wakeup, if any
+void clock_scheduler_cancel(int coro_id);
+// drop all pending wakeups
+void clock_scheduler_cancel_all(void);
+// number of coroutines waiting
+int clock_scheduler_pending(void);
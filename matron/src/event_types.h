@@ -63,8 +63,18 @@ typedef enum {
     EVENT_POLL_WAVE,
     // polled i/o VU levels from crone
     EVENT_POLL_IO_LEVELS,
+    // polled peak / RMS meters for busses and softcut voices
+    EVENT_POLL_METERS,
     // polled softcut phase
     EVENT_POLL_SOFTCUT_PHASE,
+    // softcut buffer job progress / completion
+    EVENT_SOFTCUT_BUFFER_JOB,
+    // softcut loop wrap / record start / record stop
+    EVENT_SOFTCUT_EVENT,
+    // tape record / playback stats
+    EVENT_TAPE_STATS,
+    // crone command queue counters
+    EVENT_COMMAND_STATS,
     // crone startup ack event
     EVENT_STARTUP_READY_OK,
     // crone startup timeout event
@@ -80,7 +90,9 @@ typedef enum {
     // crow remove
     EVENT_CROW_REMOVE,
     // crow event
-    EVENT_CROW_EVENT
+    EVENT_CROW_EVENT,
+    // number of event types (keep last)
+    EVENT_NUM_TYPES
 } event_t;
 
 // a packed data structure for four volume levels
@@ -240,11 +252,63 @@ struct event_poll_io_levels {
     quad_levels_t value;
 }; // + 8
 
+// (peak, rms) byte pairs, one per metered channel
+struct event_poll_meters {
+    struct event_common common;
+    uint32_t size;
+    uint8_t *data;
+}; // + 8
+
 struct event_poll_softcut_phase {
     struct event_common common;
     uint32_t idx;
     float value;
-}; // + 8
+    // when the phase changed (seconds, system clock)
+    double time;
+}; // + 16
+
+struct event_softcut_event {
+    struct event_common common;
+    uint32_t voice;
+    // 0 = loop wrap, 1 = record start, 2 = record stop
+    uint32_t kind;
+    float pos;
+    double time;
+}; // + 20
+
+struct event_softcut_buffer_job {
+    struct event_common common;
+    uint32_t id;
+    // 0 = progress, 1 = done, 2 = failed
+    uint32_t state;
+    float progress;
+}; // + 12
+
+struct event_tape_stats {
+    struct event_common common;
+    // 0 = record, 1 = play
+    uint32_t stream;
+    uint32_t running;
+    float seconds;
+    // fraction of the stream's ring in use
+    float fill;
+    // frames lost to a full (record) or empty (play) ring
+    uint32_t dropped;
+}; // + 20
+
+struct event_command_stats {
+    struct event_common common;
+    // 0 = mixer, 1 = softcut
+    uint32_t client;
+    uint32_t posted;
+    uint32_t coalesced;
+    uint32_t applied;
+    uint32_t overflows;
+    uint32_t dropped;
+    // time from post to application, microseconds
+    float max_latency;
+    float mean_latency;
+}; // + 32
 
 struct event_poll_data {
     struct event_common common;
@@ -314,7 +378,12 @@ union event_data {
     struct event_poll_value poll_value;
     struct event_poll_data poll_data;
     struct event_poll_io_levels poll_io_levels;
+    struct event_poll_meters poll_meters;
     struct event_poll_softcut_phase softcut_phase;
+    struct event_softcut_buffer_job softcut_buffer_job;
+    struct event_softcut_event softcut_event;
+    struct event_tape_stats tape_stats;
+    struct event_command_stats command_stats;
     struct event_poll_wave poll_wave;
     struct event_startup_ready_ok startup_ready_ok;
     struct event_startup_ready_timeout startup_ready_timeout;
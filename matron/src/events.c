@@ -1,12 +1,14 @@
 #include <assert.h>
-#include <search.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <pthread.h>
+#include <semaphore.h>
 
 #include "battery.h"
 #include "device_monome.h"
@@ -21,23 +23,113 @@
 //----------------------------
 //--- types and variables
 
+// events come from a fixed pool, and are queued without further allocation.
+// any thread may post; only the main (lua) thread handles events.
+//
+// - free pool slots are kept on a lock-free stack of indices.
+//   the head carries a tag that changes with every pop, so a slot recycled while
+//   another producer was looking at it can't be mistaken for the old head (ABA).
+// - each priority lane is an intrusive multi-producer / single-consumer list (after D. Vyukov):
+//   a producer swaps itself in as the tail, then links the previous tail to itself.
+//   pushing never waits; the consumer may briefly see a producer between those two steps.
+// - a count of queued events (all lanes) tells the consumer whether to look again or sleep;
+//   the producer that makes it non-zero posts a semaphore to wake it.
+//
+// scheduling: the lua thread serves the highest-priority lane with events, taking at most
+// the lane's slice. a lower lane whose oldest event is past the lane's deadline, and which has
+// been passed over EVENT_LANE_MAX_SKIPS times in a row, goes first instead, so it can't starve
+// (unless a reset, quit or other lifecycle event is waiting: those always go first).
+// while handling a lower lane's batch, the loop checks the higher lanes between events and
+// sets the rest of the batch aside as soon as they have something: so a clock or metro resume
+// waits for at most one osc or poll handler, however much data is queued.
+// the time from post to handling is kept in a histogram per lane.
+//
+// backpressure: if the pool runs dry, producers wait (up to EVENT_POOL_WAIT_MS) for the
+// lua thread to catch up. after that, or on the lua thread itself, the event is taken
+// from the heap instead, so events are never lost. the stats record how often either happens.
+
+#define EV_NIL 0xffffffffu
+
 struct ev_node {
+    // first member: a node and its event data share an address
+    union event_data ev;
     struct ev_node *next;
-    struct ev_node *prev;
-    union event_data *ev;
+    // when the event was posted (CLOCK_MONOTONIC, ns)
+    uint64_t posted;
+    // next free slot, while on the free stack
+    uint32_t free_next;
 };
 
 struct ev_q {
+    // consumer end; only touched by the lua thread
     struct ev_node *head;
+    // producer end
     struct ev_node *tail;
-    ssize_t size;
-    pthread_cond_t nonempty;
-    pthread_mutex_t lock;
+    // placeholder node, so the queue is never structurally empty
+    struct ev_node stub;
 };
 
-struct ev_q evq;
+struct lane_config {
+    // an event waiting this long (and passed over too often) is served ahead of higher lanes
+    uint64_t deadline_ns;
+    // most events handled from the lane before choosing again
+    int slice;
+};
+
+static const struct lane_config lane_config[EVENT_NUM_LANES] = {
+    [EVENT_LANE_TIMING] = {EVENT_LANE_TIMING_DEADLINE_US * 1000ull, EVENT_BATCH_MAX},
+    [EVENT_LANE_INPUT] = {EVENT_LANE_INPUT_DEADLINE_US * 1000ull, EVENT_BATCH_MAX},
+    [EVENT_LANE_BULK] = {EVENT_LANE_BULK_DEADLINE_US * 1000ull, EVENT_LANE_BULK_SLICE},
+};
+
+// free slot stack head: tag in the high word, slot index in the low word
+static uint64_t pool_free;
+static struct ev_node pool[EVENT_POOL_SIZE];
+
+static struct ev_q lanes[EVENT_NUM_LANES];
+// events posted and not yet taken, in all lanes
+static uint32_t pending;
+static sem_t wake;
+static pthread_t consumer;
+static struct event_stats stats;
 bool quit;
 
+// configurable coalescing, for types whose bursts can be merged without losing meaning
+struct coalesce_entry {
+    const char *name;
+    event_t type;
+    // the rule that makes sense for the type, besides NONE
+    event_coalesce_t merge;
+    // the rule in force until lua changes it
+    event_coalesce_t initial;
+};
+
+// softcut phase events are exact crossings, reported only when the phase changes,
+// so they are all delivered unless lua asks for the latest only
+static const struct coalesce_entry coalesce_types[] = {
+    {"enc", EVENT_ENC, EVENT_COALESCE_SUM, EVENT_COALESCE_SUM},
+    {"arc_delta", EVENT_ARC_ENCODER_DELTA, EVENT_COALESCE_SUM, EVENT_COALESCE_SUM},
+    {"softcut_phase", EVENT_POLL_SOFTCUT_PHASE, EVENT_COALESCE_LAST, EVENT_COALESCE_NONE},
+    {"poll_value", EVENT_POLL_VALUE, EVENT_COALESCE_LAST, EVENT_COALESCE_LAST},
+    {"io_levels", EVENT_POLL_IO_LEVELS, EVENT_COALESCE_LAST, EVENT_COALESCE_LAST},
+    {"meters", EVENT_POLL_METERS, EVENT_COALESCE_LAST, EVENT_COALESCE_LAST},
+    {"tape_stats", EVENT_TAPE_STATS, EVENT_COALESCE_LAST, EVENT_COALESCE_LAST},
+};
+
+#define NUM_COALESCE_TYPES (sizeof(coalesce_types) / sizeof(coalesce_types[0]))
+
+// current rule per event type; lua thread only
+static event_coalesce_t coalesce_rule[EVENT_NUM_TYPES];
+
+// post-to-handling latency per lane; lua thread writes, any thread reads
+static struct event_latency latency[EVENT_NUM_LANES];
+
+// events taken from a lane but set aside for a higher one, oldest first; lua thread only
+static union event_data *carry[EVENT_NUM_LANES][EVENT_BATCH_MAX];
+static int carry_count[EVENT_NUM_LANES];
+// times each lane had events but another was chosen, in a row; lua thread only
+static int lane_skips[EVENT_NUM_LANES];
+
 //----------------------------
 //--- static function declarations
 
@@ -46,62 +138,152 @@ static void handle_event(union event_data *ev);
 
 /// helpers
 static void handle_engine_report(void);
+static bool is_lifecycle(uint32_t type);
+static event_lane_t lane_for(uint32_t type);
+static int evq_take(union event_data **batch, int max, event_lane_t *lane);
+static bool higher_lane_ready(event_lane_t lane);
+static void record_latency(event_lane_t lane, union event_data *ev);
+static int coalesce(union event_data **batch, int n);
 // static void handle_command_report(void);
 // static void handle_poll_report(void);
 
-// add an event data struct to the end of the event queue
-// *does* allocate queue node memory!
-// *does not* allocate event data memory!
-// call with the queue locked
-static void evq_push(union event_data *ev) {
-    struct ev_node *evn = calloc(1, sizeof(struct ev_node));
-    evn->ev = ev;
-    if (evq.size == 0) {
-        insque(evn, NULL);
-        evq.head = evn;
-    } else {
-        insque(evn, evq.tail);
+static inline void stat_max(uint32_t *high, uint32_t val) {
+    uint32_t old = __atomic_load_n(high, __ATOMIC_RELAXED);
+    while (val > old &&
+           !__atomic_compare_exchange_n(high, &old, val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
     }
-    evq.tail = evn;
-    evq.size += 1;
 }
 
-// remove and return the event data struct from the top of the event queue
-// call with the queue locked
-// *does* free queue node memory!
-// *does not* free the event data memory!
-static union event_data *evq_pop() {
-    struct ev_node *evn = evq.head;
-    if (evn == NULL) {
+static inline bool in_pool(struct ev_node *evn) {
+    return evn >= pool && evn < pool + EVENT_POOL_SIZE;
+}
+
+// take a slot from the free stack, or NULL if there are none
+static struct ev_node *pool_pop(void) {
+    uint64_t head = __atomic_load_n(&pool_free, __ATOMIC_ACQUIRE);
+    while (true) {
+        uint32_t idx = (uint32_t)head;
+        if (idx == EV_NIL) {
+            return NULL;
+        }
+        uint32_t next = __atomic_load_n(&pool[idx].free_next, __ATOMIC_RELAXED);
+        uint64_t tagged = ((head >> 32) + 1) << 32 | next;
+        if (__atomic_compare_exchange_n(&pool_free, &head, tagged, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            return &pool[idx];
+        }
+    }
+}
+
+// return a slot to the free stack
+static void pool_push(struct ev_node *evn) {
+    uint32_t idx = (uint32_t)(evn - pool);
+    uint64_t head = __atomic_load_n(&pool_free, __ATOMIC_RELAXED);
+    uint64_t tagged;
+    do {
+        __atomic_store_n(&evn->free_next, (uint32_t)head, __ATOMIC_RELAXED);
+        tagged = (head & 0xffffffff00000000ull) | idx;
+    } while (!__atomic_compare_exchange_n(&pool_free, &head, tagged, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// add a node to the end of a lane; from any thread, never blocks
+static void evq_push(struct ev_q *q, struct ev_node *evn) {
+    __atomic_store_n(&evn->next, NULL, __ATOMIC_RELAXED);
+    struct ev_node *prev = __atomic_exchange_n(&q->tail, evn, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, evn, __ATOMIC_RELEASE);
+}
+
+// the node at the front of a lane, without removing it; lua thread only.
+// NULL if the lane is empty, or its front is still being linked in
+static struct ev_node *evq_peek(struct ev_q *q) {
+    struct ev_node *head = q->head;
+    if (head == &q->stub) {
+        head = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    }
+    return head;
+}
+
+// remove and return the node at the front of a lane; lua thread only.
+// returns NULL if the lane is empty, or its front is still being linked in
+static struct ev_node *evq_pop(struct ev_q *q) {
+    struct ev_node *head = q->head;
+    struct ev_node *next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (head == &q->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        q->head = next;
+        head = next;
+        next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    }
+    if (next != NULL) {
+        q->head = next;
+        return head;
+    }
+    if (head != __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) {
+        // a producer is between its two steps
         return NULL;
     }
-    union event_data *ev = evn->ev;
-    evq.head = evn->next;
-    if (evn == evq.tail) {
-        assert(evq.size == 1);
-        evq.tail = NULL;
+    // head is the last node: put the stub behind it, so it can be taken
+    evq_push(q, &q->stub);
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        q->head = next;
+        return head;
     }
-    remque(evn);
-    free(evn);
-    evq.size -= 1;
-    return ev;
+    return NULL;
 }
 
 //-------------------------------
 //-- extern function definitions
 
 void events_init(void) {
-    evq.size = 0;
-    evq.head = NULL;
-    evq.tail = NULL;
-    pthread_cond_init(&evq.nonempty, NULL);
+    for (uint32_t i = 0; i < EVENT_POOL_SIZE; i++) {
+        pool[i].free_next = i + 1 < EVENT_POOL_SIZE ? i + 1 : EV_NIL;
+    }
+    pool_free = 0;
+    for (int i = 0; i < EVENT_NUM_LANES; i++) {
+        lanes[i].stub.next = NULL;
+        lanes[i].head = &lanes[i].stub;
+        lanes[i].tail = &lanes[i].stub;
+    }
+    pending = 0;
+    sem_init(&wake, 0, 0);
+    memset(&stats, 0, sizeof(stats));
+    memset(latency, 0, sizeof(latency));
+    stats.pool_size = EVENT_POOL_SIZE;
+    for (size_t i = 0; i < NUM_COALESCE_TYPES; i++) {
+        coalesce_rule[coalesce_types[i].type] = coalesce_types[i].initial;
+    }
+    // events are handled on the thread that sets them up
+    consumer = pthread_self();
 }
 
 union event_data *event_data_new(event_t type) {
-    // FIXME: better not to allocate here, use object pool
-    union event_data *ev = calloc(1, sizeof(union event_data));
-    ev->type = type;
-    return ev;
+    struct ev_node *evn = pool_pop();
+    if (evn == NULL && !pthread_equal(pthread_self(), consumer)) {
+        // pool exhausted: give the lua thread a chance to catch up
+        __atomic_add_fetch(&stats.waits, 1, __ATOMIC_RELAXED);
+        const struct timespec wait = {0, EVENT_POOL_WAIT_MS * 1000000L / 10};
+        for (int i = 0; i < 10 && evn == NULL; i++) {
+            nanosleep(&wait, NULL);
+            evn = pool_pop();
+        }
+    }
+    if (evn == NULL) {
+        __atomic_add_fetch(&stats.overflows, 1, __ATOMIC_RELAXED);
+        evn = malloc(sizeof(struct ev_node));
+    } else {
+        stat_max(&stats.pool_high, __atomic_add_fetch(&stats.pool_used, 1, __ATOMIC_RELAXED));
+    }
+    memset(&evn->ev, 0, sizeof(evn->ev));
+    evn->ev.type = type;
+    return &evn->ev;
 }
 
 void event_data_free(union event_data *ev) {
@@ -121,46 +303,116 @@ void event_data_free(union event_data *ev) {
     case EVENT_POLL_WAVE:
         free(ev->poll_wave.data);
         break;
+    case EVENT_POLL_METERS:
+        free(ev->poll_meters.data);
+        break;
     case EVENT_SYSTEM_CMD:
         free(ev->system_cmd.capture);
         break;
     }
-    free(ev);
+    struct ev_node *evn = (struct ev_node *)ev;
+    if (in_pool(evn)) {
+        __atomic_sub_fetch(&stats.pool_used, 1, __ATOMIC_RELAXED);
+        pool_push(evn);
+    } else {
+        free(evn);
+    }
 }
 
-// add an event to the q and signal if necessary
+// add an event to its lane and wake the lua thread if necessary
 void event_post(union event_data *ev) {
     assert(ev != NULL);
-    pthread_mutex_lock(&evq.lock);
-    if (evq.size == 0) {
-        // signal handler thread to wake up...
-        pthread_cond_signal(&evq.nonempty);
-    }
-    evq_push(ev);
-    // ...handler actually wakes up once we release the lock
-    pthread_mutex_unlock(&evq.lock);
+    struct ev_node *evn = (struct ev_node *)ev;
+    evn->posted = now_ns();
+    stat_max(&stats.queue_high, __atomic_add_fetch(&stats.queued, 1, __ATOMIC_RELAXED));
+    // counted before the push, so the consumer never sleeps on a half-linked event
+    uint32_t was = __atomic_fetch_add(&pending, 1, __ATOMIC_ACQ_REL);
+    evq_push(&lanes[lane_for(ev->type)], evn);
+    if (was == 0) {
+        sem_post(&wake);
+    }
+}
+
+void events_get_stats(struct event_stats *out) {
+    out->pool_size = stats.pool_size;
+    out->pool_used = __atomic_load_n(&stats.pool_used, __ATOMIC_RELAXED);
+    out->pool_high = __atomic_load_n(&stats.pool_high, __ATOMIC_RELAXED);
+    out->queued = __atomic_load_n(&stats.queued, __ATOMIC_RELAXED);
+    out->queue_high = __atomic_load_n(&stats.queue_high, __ATOMIC_RELAXED);
+    out->waits = __atomic_load_n(&stats.waits, __ATOMIC_RELAXED);
+    out->overflows = __atomic_load_n(&stats.overflows, __ATOMIC_RELAXED);
+    out->coalesced = __atomic_load_n(&stats.coalesced, __ATOMIC_RELAXED);
+}
+
+void events_get_latency(event_lane_t lane, struct event_latency *out) {
+    for (int i = 0; i < EVENT_LATENCY_BUCKETS; i++) {
+        out->counts[i] = __atomic_load_n(&latency[lane].counts[i], __ATOMIC_RELAXED);
+    }
+    out->max_us = __atomic_load_n(&latency[lane].max_us, __ATOMIC_RELAXED);
+}
+
+void events_reset_latency(void) {
+    for (int lane = 0; lane < EVENT_NUM_LANES; lane++) {
+        for (int i = 0; i < EVENT_LATENCY_BUCKETS; i++) {
+            __atomic_store_n(&latency[lane].counts[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&latency[lane].max_us, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void events_reset_high_water(void) {
+    __atomic_store_n(&stats.pool_high, __atomic_load_n(&stats.pool_used, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_store_n(&stats.queue_high, __atomic_load_n(&stats.queued, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+bool events_set_coalesce(const char *name, event_coalesce_t rule) {
+    for (size_t i = 0; i < NUM_COALESCE_TYPES; i++) {
+        if (strcmp(name, coalesce_types[i].name) == 0) {
+            if (rule != EVENT_COALESCE_NONE && rule != coalesce_types[i].merge) {
+                return false;
+            }
+            coalesce_rule[coalesce_types[i].type] = rule;
+            return true;
+        }
+    }
+    return false;
 }
 
 // main loop to read events!
+// takes a batch from one lane at a time (see evq_take()), merges what the coalescing rules allow,
+// and handles the rest in order
 void event_loop(void) {
-    union event_data *ev;
+    union event_data *batch[EVENT_BATCH_MAX];
+    event_lane_t lane;
     while (!quit) {
-        pthread_mutex_lock(&evq.lock);
-        // while() because contention may produce spurious wakeup
-        while (evq.size == 0) {
+        int n = evq_take(batch, EVENT_BATCH_MAX, &lane);
+        if (n == 0) {
+            if (__atomic_load_n(&pending, __ATOMIC_ACQUIRE) > 0) {
+                // an event is being linked in
+                sched_yield();
+                continue;
+            }
             //// FIXME: if we have an input device thread running,
             //// then we get segfaults here on SIGINT
             //// need to set an explicit sigint handler
-            // atomically unlocks the mutex, sleeps on condvar, locks again on
-            // wakeup
-            pthread_cond_wait(&evq.nonempty, &evq.lock);
+            // (a post may already be waiting, from events taken since; that just means another look)
+            sem_wait(&wake);
+            continue;
         }
-        // fprintf(stderr, "evq.size : %d\n", (int) evq.size);
-        assert(evq.size > 0);
-        ev = evq_pop();
-        pthread_mutex_unlock(&evq.lock);
-        if (ev != NULL) {
-            handle_event(ev);
+        n = coalesce(batch, n);
+        for (int i = 0; i < n; i++) {
+            if (quit) {
+                event_data_free(batch[i]);
+                continue;
+            }
+            if (i > 0 && higher_lane_ready(lane)) {
+                // let the higher lane in; the rest of this batch goes first next time round
+                memcpy(carry[lane], batch + i, (size_t)(n - i) * sizeof(batch[0]));
+                carry_count[lane] = n - i;
+                break;
+            }
+            record_latency(lane, batch[i]);
+            handle_event(batch[i]);
         }
     }
 }
@@ -257,8 +509,28 @@ static void handle_event(union event_data *ev) {
     case EVENT_POLL_IO_LEVELS:
         w_handle_poll_io_levels(ev->poll_io_levels.value.bytes);
         break;
+    case EVENT_POLL_METERS:
+        w_handle_poll_meters(ev->poll_meters.size, ev->poll_meters.data);
+        break;
     case EVENT_POLL_SOFTCUT_PHASE:
-        w_handle_poll_softcut_phase(ev->softcut_phase.idx, ev->softcut_phase.value);
+        w_handle_poll_softcut_phase(ev->softcut_phase.idx, ev->softcut_phase.value, ev->softcut_phase.time);
+        break;
+    case EVENT_SOFTCUT_EVENT:
+        w_handle_softcut_event(ev->softcut_event.voice, ev->softcut_event.kind, ev->softcut_event.pos,
+                               ev->softcut_event.time);
+        break;
+    case EVENT_TAPE_STATS:
+        w_handle_tape_stats(ev->tape_stats.stream, ev->tape_stats.running, ev->tape_stats.seconds,
+                            ev->tape_stats.fill, ev->tape_stats.dropped);
+        break;
+    case EVENT_SOFTCUT_BUFFER_JOB:
+        w_handle_softcut_buffer_job(ev->softcut_buffer_job.id, ev->softcut_buffer_job.state,
+                                    ev->softcut_buffer_job.progress);
+        break;
+    case EVENT_COMMAND_STATS:
+        w_handle_command_stats(ev->command_stats.client, ev->command_stats.posted, ev->command_stats.coalesced,
+                               ev->command_stats.applied, ev->command_stats.overflows, ev->command_stats.dropped,
+                               ev->command_stats.max_latency, ev->command_stats.mean_latency);
         break;
     case EVENT_STARTUP_READY_OK:
         w_handle_startup_ready_ok();
@@ -292,6 +564,222 @@ static void handle_event(union event_data *ev) {
 //---------------------------------
 //---- helpers
 
+// events that restart or stop the lua vm (or tell it the engine is ready).
+// nothing posted after one of these may be handled before it
+static bool is_lifecycle(uint32_t type) {
+    switch (type) {
+    case EVENT_RESET_LVM:
+    case EVENT_QUIT:
+    case EVENT_STARTUP_READY_OK:
+    case EVENT_STARTUP_READY_TIMEOUT:
+    case EVENT_ENGINE_LOADED:
+    case EVENT_ENGINE_REPORT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// which lane an event type goes in. devices' add / remove events share a lane
+// with their input, so a device is always added before its first event is handled.
+// lifecycle events go in the top lane, so key, grid or clock events posted after a reset
+// are never handled by the old vm
+static event_lane_t lane_for(uint32_t type) {
+    if (is_lifecycle(type)) {
+        return EVENT_LANE_TIMING;
+    }
+    switch (type) {
+    case EVENT_METRO:
+    case EVENT_CLOCK_RESUME:
+    case EVENT_CLOCK_START:
+    case EVENT_CLOCK_STOP:
+        return EVENT_LANE_TIMING;
+    case EVENT_EXEC_CODE_LINE:
+    case EVENT_KEY:
+    case EVENT_ENC:
+    case EVENT_MONOME_ADD:
+    case EVENT_MONOME_REMOVE:
+    case EVENT_GRID_KEY:
+    case EVENT_ARC_ENCODER_DELTA:
+    case EVENT_ARC_ENCODER_KEY:
+    case EVENT_HID_ADD:
+    case EVENT_HID_REMOVE:
+    case EVENT_HID_EVENT:
+    case EVENT_MIDI_ADD:
+    case EVENT_MIDI_REMOVE:
+    case EVENT_MIDI_EVENT:
+    case EVENT_CROW_ADD:
+    case EVENT_CROW_REMOVE:
+    case EVENT_CROW_EVENT:
+        return EVENT_LANE_INPUT;
+    default:
+        return EVENT_LANE_BULK;
+    }
+}
+
+// the oldest event waiting in a lane, or NULL
+static union event_data *lane_front(int lane) {
+    if (carry_count[lane] > 0) {
+        return carry[lane][0];
+    }
+    struct ev_node *head = evq_peek(&lanes[lane]);
+    return head == NULL ? NULL : &head->ev;
+}
+
+static bool higher_lane_ready(event_lane_t lane) {
+    for (int i = 0; i < (int)lane; i++) {
+        if (lane_front(i) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// choose a lane and take up to its slice of events (at most max), oldest first
+static int evq_take(union event_data **batch, int max, event_lane_t *lane) {
+    const uint64_t now = now_ns();
+    int chosen = -1;
+    bool waiting[EVENT_NUM_LANES];
+    for (int i = 0; i < EVENT_NUM_LANES; i++) {
+        union event_data *front = lane_front(i);
+        waiting[i] = front != NULL;
+        if (front == NULL) {
+            continue;
+        }
+        if (chosen < 0) {
+            chosen = i;
+        } else if (lane_skips[i] >= EVENT_LANE_MAX_SKIPS && !is_lifecycle(lane_front(chosen)->type) &&
+                   now - ((struct ev_node *)front)->posted > lane_config[i].deadline_ns) {
+            // starving: serve it now
+            chosen = i;
+            break;
+        }
+    }
+    for (int i = 0; i < EVENT_NUM_LANES; i++) {
+        lane_skips[i] = waiting[i] && i != chosen ? lane_skips[i] + 1 : 0;
+    }
+    if (chosen < 0) {
+        return 0;
+    }
+    if (max > lane_config[chosen].slice) {
+        max = lane_config[chosen].slice;
+    }
+    // set-aside events first, then fresh ones
+    int n = carry_count[chosen];
+    memcpy(batch, carry[chosen], (size_t)n * sizeof(batch[0]));
+    carry_count[chosen] = 0;
+    int taken = 0;
+    struct ev_node *evn;
+    while (n < max && (evn = evq_pop(&lanes[chosen])) != NULL) {
+        batch[n++] = &evn->ev;
+        taken++;
+    }
+    __atomic_sub_fetch(&pending, taken, __ATOMIC_ACQ_REL);
+    __atomic_sub_fetch(&stats.queued, taken, __ATOMIC_RELAXED);
+    *lane = (event_lane_t)chosen;
+    return n;
+}
+
+// log2 buckets of microseconds: 0 is under 1us, i is [2^(i-1), 2^i) us, the last is anything longer
+static void record_latency(event_lane_t lane, union event_data *ev) {
+    struct event_latency *lat = &latency[lane];
+    uint64_t us = (now_ns() - ((struct ev_node *)ev)->posted) / 1000;
+    int bucket = 0;
+    while (us >> bucket && bucket < EVENT_LATENCY_BUCKETS - 1) {
+        bucket++;
+    }
+    __atomic_add_fetch(&lat->counts[bucket], 1, __ATOMIC_RELAXED);
+    uint32_t us32 = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    if (us32 > lat->max_us) {
+        __atomic_store_n(&lat->max_us, us32, __ATOMIC_RELAXED);
+    }
+}
+
+// true if a and b (of the same type) address the same encoder / poll / stream
+static bool same_target(const union event_data *a, const union event_data *b) {
+    switch (a->type) {
+    case EVENT_ENC:
+        return a->enc.n == b->enc.n;
+    case EVENT_ARC_ENCODER_DELTA:
+        return a->arc_encoder_delta.id == b->arc_encoder_delta.id &&
+               a->arc_encoder_delta.number == b->arc_encoder_delta.number;
+    case EVENT_POLL_SOFTCUT_PHASE:
+        return a->softcut_phase.idx == b->softcut_phase.idx;
+    case EVENT_POLL_VALUE:
+        return a->poll_value.idx == b->poll_value.idx;
+    case EVENT_TAPE_STATS:
+        return a->tape_stats.stream == b->tape_stats.stream;
+    default:
+        return true;
+    }
+}
+
+// add src's delta to dst; false if the sum doesn't fit
+static bool sum_into(union event_data *dst, const union event_data *src) {
+    int8_t *d;
+    int sum;
+    switch (dst->type) {
+    case EVENT_ENC:
+        d = &dst->enc.delta;
+        sum = *d + src->enc.delta;
+        break;
+    case EVENT_ARC_ENCODER_DELTA:
+        d = &dst->arc_encoder_delta.delta;
+        sum = *d + src->arc_encoder_delta.delta;
+        break;
+    default:
+        return false;
+    }
+    if (sum < INT8_MIN || sum > INT8_MAX) {
+        return false;
+    }
+    *d = (int8_t)sum;
+    return true;
+}
+
+// merge events in place; returns the new count.
+// an event is merged into the latest earlier one of the same type and target,
+// as long as no unmergeable event lies between them, so the order relative to
+// key presses, grid and midi events (&c) is kept
+static int coalesce(union event_data **batch, int n) {
+    int out = 0;
+    // batch[barrier, out) holds only mergeable events
+    int barrier = 0;
+    for (int i = 0; i < n; i++) {
+        union event_data *ev = batch[i];
+        event_coalesce_t rule = coalesce_rule[ev->type];
+        bool merged = false;
+        if (rule != EVENT_COALESCE_NONE) {
+            for (int j = out - 1; j >= barrier; j--) {
+                union event_data *prev = batch[j];
+                if (prev->type != ev->type || !same_target(prev, ev)) {
+                    continue;
+                }
+                if (rule == EVENT_COALESCE_SUM) {
+                    merged = sum_into(prev, ev);
+                } else {
+                    // take the newer data; the older (and any payload it owns) is freed below
+                    union event_data tmp = *prev;
+                    *prev = *ev;
+                    *ev = tmp;
+                    merged = true;
+                }
+                break;
+            }
+        }
+        if (merged) {
+            event_data_free(ev);
+            __atomic_add_fetch(&stats.coalesced, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        batch[out++] = ev;
+        if (rule == EVENT_COALESCE_NONE) {
+            barrier = out;
+        }
+    }
+    return out;
+}
+
 //--- reports
 void handle_engine_report(void) {
     o_lock_descriptors();
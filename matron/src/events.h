@@ -1,12 +1,90 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "event_types.h"
 
 // number of bytes in waveform data blob
 #define EVENT_WAVE_DISPLAY_BYTES 128
 
+// events that can be pending or in handling at once, without touching the heap
+#define EVENT_POOL_SIZE 4096
+// longest a producer waits for a free slot before falling back to the heap
+#define EVENT_POOL_WAIT_MS 10
+
+// most events taken from the queue at once
+#define EVENT_BATCH_MAX 256
+
+// priority lanes, highest first
+typedef enum {
+    // metro and clock resumes
+    EVENT_LANE_TIMING = 0,
+    // keys, encoders, grid, arc, hid, midi, crow, REPL input (and their devices coming and going)
+    EVENT_LANE_INPUT,
+    // osc, polls, stats and everything else
+    EVENT_LANE_BULK,
+    EVENT_NUM_LANES
+} event_lane_t;
+
+// how long an event may wait before its lane can be served ahead of higher ones
+#define EVENT_LANE_TIMING_DEADLINE_US 1000
+#define EVENT_LANE_INPUT_DEADLINE_US 5000
+#define EVENT_LANE_BULK_DEADLINE_US 50000
+// most bulk events taken at once
+#define EVENT_LANE_BULK_SLICE 16
+// times an overdue lane can be passed over for higher ones before it goes first
+#define EVENT_LANE_MAX_SKIPS 4
+
+// post-to-handling latency histogram: log2 buckets of microseconds.
+// bucket 0 is under 1us, bucket i is [2^(i-1), 2^i) us, the last holds anything longer (> ~1s)
+#define EVENT_LATENCY_BUCKETS 22
+
+struct event_latency {
+    uint32_t counts[EVENT_LATENCY_BUCKETS];
+    uint32_t max_us;
+};
+
+// how queued events of one type are combined before dispatch
+typedef enum {
+    // each event is handled
+    EVENT_COALESCE_NONE = 0,
+    // events with the same target are summed (relative deltas)
+    EVENT_COALESCE_SUM,
+    // only the latest event for each target is handled (values, levels)
+    EVENT_COALESCE_LAST,
+} event_coalesce_t;
+
+struct event_stats {
+    uint32_t pool_size;
+    // slots in use now, and the most ever in use
+    uint32_t pool_used;
+    uint32_t pool_high;
+    // events waiting for the lua thread now, and the most ever waiting
+    uint32_t queued;
+    uint32_t queue_high;
+    // times a producer found the pool empty and waited
+    uint32_t waits;
+    // events allocated from the heap because the pool stayed empty
+    uint32_t overflows;
+    // events merged into a later or earlier one of the same batch
+    uint32_t coalesced;
+};
+
 extern void events_init(void);
 extern void event_loop(void);
 extern union event_data *event_data_new(event_t evcode);
 extern void event_data_free(union event_data *ev);
 extern void event_post(union event_data *ev);
+// snapshot of queue statistics, from any thread
+extern void events_get_stats(struct event_stats *stats);
+// restart the high-water marks from the current levels
+extern void events_reset_high_water(void);
+// snapshot of one lane's latency histogram, from any thread
+extern void events_get_latency(event_lane_t lane, struct event_latency *lat);
+// clear all latency histograms
+extern void events_reset_latency(void);
+// set the coalescing rule for a type, by name: "enc", "arc_delta", "softcut_phase",
+// "poll_value", "io_levels", "meters", "tape_stats". returns false for an unknown name,
+// or a rule the type doesn't support. other types (grid keys, midi, ...) are never merged.
+// lua thread only
+extern bool events_set_coalesce(const char *name, event_coalesce_t rule);
@@ -0,0 +1,347 @@
+/*
+ * ipc.c
+ *
+ * shared-memory transport to crone.
+ *
+ * matron is the single producer on the command ring (serialized by a mutex, since commands are sent from
+ * several threads), and the single consumer of the poll ring, read by a dedicated thread.
+ *
+ * a full command ring is waited on rather than bypassed: a command sent over OSC instead could be
+ * overtaken by the next one through the ring, and two sets of a parameter would apply out of order.
+ * for the same reason, a command that has to go over OSC (string arguments, say) is sent only once
+ * crone has taken everything already in the ring (ipc_fence()).
+ * waits are short (a few audio periods), since the sender may be the lua thread. if crone doesn't
+ * drain the ring in time, commands move to OSC, and then all of them do, until crone announces
+ * fresh shared memory.
+ */
+
+// std
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// posix / linux
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+// norns
+#include "crone_ipc.h"
+#include "events.h"
+#include "ipc.h"
+
+// open-addressed path -> method index table; twice the directory size keeps probes short
+#define METHOD_TABLE_SIZE (CRONE_IPC_MAX_METHODS * 2)
+#define METHOD_TABLE_MASK (METHOD_TABLE_SIZE - 1)
+
+// longest wait for crone to drain the command ring before giving up on it, and the poll interval meanwhile
+#define CMD_RING_WAIT_US 5000
+#define CMD_RING_POLL_US 100
+
+static crone_ipc_t *shm = NULL;
+// method index + 1 for each slot, 0 if empty
+static uint16_t method_table[METHOD_TABLE_SIZE];
+
+// serializes command producers, and attach / detach
+static pthread_mutex_t ipc_lock = PTHREAD_MUTEX_INITIALIZER;
+// set when crone stopped draining the command ring; commands go over OSC until the next attach
+static bool cmd_ring_stalled = false;
+
+static pthread_t reader_tid;
+static bool reader_running = false;
+static volatile int reader_quit = 0;
+
+static void *reader_loop(void *arg);
+static void detach(void);
+
+//--- futex helpers (the words live in memory shared between processes, so these can't be private)
+
+static void futex_wait(uint32_t *word, uint32_t val, const struct timespec *timeout) {
+    syscall(SYS_futex, word, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word) {
+    __atomic_add_fetch(word, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// FNV-1a
+static uint32_t path_hash(const char *path) {
+    uint32_t h = 2166136261u;
+    while (*path) {
+        h ^= (uint8_t)*path++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void build_method_table(void) {
+    memset(method_table, 0, sizeof(method_table));
+    uint32_t n = __atomic_load_n(&shm->num_methods, __ATOMIC_ACQUIRE);
+    if (n > CRONE_IPC_MAX_METHODS) {
+        n = CRONE_IPC_MAX_METHODS;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t slot = path_hash(shm->methods[i].path) & METHOD_TABLE_MASK;
+        while (method_table[slot] != 0) {
+            slot = (slot + 1) & METHOD_TABLE_MASK;
+        }
+        method_table[slot] = (uint16_t)(i + 1);
+    }
+}
+
+static int find_method(const char *path) {
+    uint32_t slot = path_hash(path) & METHOD_TABLE_MASK;
+    while (method_table[slot] != 0) {
+        int idx = method_table[slot] - 1;
+        if (strncmp(shm->methods[idx].path, path, CRONE_IPC_PATH_LEN) == 0) {
+            return idx;
+        }
+        slot = (slot + 1) & METHOD_TABLE_MASK;
+    }
+    return -1;
+}
+
+//--- command ring; called with ipc_lock held
+
+// wait until fewer than `pending` commands before `head` are left in the command ring:
+// CRONE_IPC_CMD_RING for a free slot, 1 for all of them taken.
+// returns false (and stops using the ring) if crone goes away or doesn't drain it in time
+static bool wait_for_ring(crone_ipc_ring_t *ring, uint64_t head, uint64_t pending) {
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) < pending) {
+        return true;
+    }
+    const struct timespec poll = {0, CMD_RING_POLL_US * 1000};
+    for (int waited = 0; waited < CMD_RING_WAIT_US; waited += CMD_RING_POLL_US) {
+        nanosleep(&poll, NULL);
+        if (!__atomic_load_n(&shm->alive, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) < pending) {
+            return true;
+        }
+    }
+    fprintf(stderr, "ipc: crone isn't draining commands; using OSC until it reconnects\n");
+    cmd_ring_stalled = true;
+    return false;
+}
+
+//--- attach / detach; called with ipc_lock held
+
+static void detach(void) {
+    if (shm == NULL) {
+        return;
+    }
+    if (reader_running) {
+        reader_quit = 1;
+        futex_wake(&shm->poll_ring.futex);
+        pthread_join(reader_tid, NULL);
+        reader_running = false;
+    }
+    __atomic_store_n(&shm->client_attached, 0, __ATOMIC_RELEASE);
+    munmap(shm, sizeof(crone_ipc_t));
+    shm = NULL;
+}
+
+static void attach(void) {
+    detach();
+
+    int fd = shm_open(CRONE_IPC_SHM_NAME, O_RDWR, 0);
+    if (fd < 0) {
+        // crone isn't running, or is too old; stay on OSC
+        return;
+    }
+    void *p = mmap(NULL, sizeof(crone_ipc_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "ipc: failed to map crone shared memory: %s\n", strerror(errno));
+        return;
+    }
+    crone_ipc_t *s = (crone_ipc_t *)p;
+    if (s->magic != CRONE_IPC_MAGIC || s->version != CRONE_IPC_VERSION ||
+        !__atomic_load_n(&s->alive, __ATOMIC_ACQUIRE)) {
+        fprintf(stderr, "ipc: crone shared memory not usable; using OSC\n");
+        munmap(p, sizeof(crone_ipc_t));
+        return;
+    }
+    shm = s;
+    cmd_ring_stalled = false;
+    build_method_table();
+
+    // drop polls left over from a previous matron
+    uint64_t head = __atomic_load_n(&shm->poll_ring.head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&shm->poll_ring.tail, head, __ATOMIC_RELEASE);
+
+    reader_quit = 0;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    int res = pthread_create(&reader_tid, &attr, &reader_loop, NULL);
+    pthread_attr_destroy(&attr);
+    if (res) {
+        fprintf(stderr, "ipc: error in pthread_create(): %d\n", res);
+        munmap(p, sizeof(crone_ipc_t));
+        shm = NULL;
+        return;
+    }
+    reader_running = true;
+    __atomic_store_n(&shm->client_attached, 1, __ATOMIC_RELEASE);
+    fprintf(stderr, "ipc: attached to crone (%u methods)\n", shm->num_methods);
+}
+
+//--- extern functions
+
+void ipc_init(void) {
+    pthread_mutex_lock(&ipc_lock);
+    attach();
+    pthread_mutex_unlock(&ipc_lock);
+}
+
+void ipc_deinit(void) {
+    pthread_mutex_lock(&ipc_lock);
+    detach();
+    pthread_mutex_unlock(&ipc_lock);
+}
+
+void ipc_attach(void) {
+    ipc_init();
+}
+
+int ipc_sendv(const char *path, const char *types, va_list ap) {
+    if (types == NULL) {
+        types = "";
+    }
+    size_t argc = strlen(types);
+    if (argc > CRONE_IPC_MAX_ARGS) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&ipc_lock);
+    if (shm == NULL || cmd_ring_stalled || !__atomic_load_n(&shm->alive, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&ipc_lock);
+        return -1;
+    }
+    int idx = find_method(path);
+    if (idx < 0 || strncmp(shm->methods[idx].types, types, CRONE_IPC_TYPES_LEN) != 0) {
+        pthread_mutex_unlock(&ipc_lock);
+        return -1;
+    }
+
+    crone_ipc_ring_t *ring = &shm->cmd_ring;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    if (!wait_for_ring(ring, head, CRONE_IPC_CMD_RING)) {
+        pthread_mutex_unlock(&ipc_lock);
+        return -1;
+    }
+
+    crone_ipc_cmd_t *cmd = &shm->cmd[head & (CRONE_IPC_CMD_RING - 1)];
+    cmd->method = (uint16_t)idx;
+    cmd->argc = (uint16_t)argc;
+    va_list aq;
+    va_copy(aq, ap);
+    for (size_t i = 0; i < argc; i++) {
+        if (types[i] == 'i') {
+            cmd->argv[i].i = va_arg(aq, int32_t);
+        } else {
+            // floats are promoted to double through varargs, as for lo_send()
+            cmd->argv[i].f = (float)va_arg(aq, double);
+        }
+    }
+    va_end(aq);
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    // pairs with the fence on the consumer side between setting `sleeping` and re-reading `head`
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->sleeping, __ATOMIC_RELAXED)) {
+        futex_wake(&ring->futex);
+    }
+    pthread_mutex_unlock(&ipc_lock);
+    return 0;
+}
+
+void ipc_fence(void) {
+    pthread_mutex_lock(&ipc_lock);
+    if (shm != NULL && !cmd_ring_stalled && __atomic_load_n(&shm->alive, __ATOMIC_ACQUIRE)) {
+        crone_ipc_ring_t *ring = &shm->cmd_ring;
+        wait_for_ring(ring, __atomic_load_n(&ring->head, __ATOMIC_RELAXED), 1);
+    }
+    pthread_mutex_unlock(&ipc_lock);
+}
+
+//--- poll reader
+
+static void post_poll(const crone_ipc_poll_t *p) {
+    union event_data *ev;
+    switch (p->kind) {
+    case CRONE_IPC_POLL_VU:
+        if (p->size != sizeof(quad_levels_t)) {
+            return;
+        }
+        ev = event_data_new(EVENT_POLL_IO_LEVELS);
+        memcpy(&ev->poll_io_levels.value.uint, p->data, sizeof(uint32_t));
+        break;
+    case CRONE_IPC_POLL_METERS:
+        if (p->size == 0 || p->size > CRONE_IPC_POLL_DATA) {
+            return;
+        }
+        ev = event_data_new(EVENT_POLL_METERS);
+        ev->poll_meters.size = p->size;
+        ev->poll_meters.data = calloc(1, p->size);
+        memcpy(ev->poll_meters.data, p->data, p->size);
+        break;
+    case CRONE_IPC_POLL_CUT_PHASE:
+        ev = event_data_new(EVENT_POLL_SOFTCUT_PHASE);
+        ev->softcut_phase.idx = p->idx;
+        ev->softcut_phase.value = p->value;
+        ev->softcut_phase.time = p->time;
+        break;
+    case CRONE_IPC_POLL_CUT_EVENT:
+        ev = event_data_new(EVENT_SOFTCUT_EVENT);
+        ev->softcut_event.voice = p->idx;
+        ev->softcut_event.kind = p->data[0];
+        ev->softcut_event.pos = p->value;
+        ev->softcut_event.time = p->time;
+        break;
+    default:
+        return;
+    }
+    event_post(ev);
+}
+
+static void *reader_loop(void *arg) {
+    (void)arg;
+    crone_ipc_ring_t *ring = &shm->poll_ring;
+    // wake now and then to notice crone going away without saying so
+    const struct timespec timeout = {.tv_sec = 0, .tv_nsec = 500000000};
+
+    while (!reader_quit) {
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail != head) {
+            while (tail != head) {
+                post_poll(&shm->poll[tail & (CRONE_IPC_POLL_RING - 1)]);
+                tail++;
+            }
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+        if (!__atomic_load_n(&shm->alive, __ATOMIC_ACQUIRE)) {
+            // crone has shut down; commands fall back to OSC until it says it's ready again
+            break;
+        }
+        uint32_t val = __atomic_load_n(&ring->futex, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&ring->sleeping, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->head, __ATOMIC_RELAXED) == head && !reader_quit) {
+            futex_wait(&ring->futex, val, &timeout);
+        }
+        __atomic_store_n(&ring->sleeping, 0, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
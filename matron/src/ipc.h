@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+ * ipc.h
+ *
+ * shared-memory transport to crone (see crone/ipc/crone_ipc.h).
+ *
+ * commands with only int / float arguments go through the shared command ring when crone is attached;
+ * polls from crone come back through the poll ring and are posted as the same events as their OSC versions.
+ * everything else (and everything, when crone isn't attached) uses OSC.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+
+// attach to crone's shared memory, if it exists, and start reading polls
+extern void ipc_init(void);
+extern void ipc_deinit(void);
+// (re)attach, e.g. after crone has restarted
+extern void ipc_attach(void);
+
+// send a command to crone through the command ring.
+// `ap` holds arguments as for lo_send(); it is not consumed.
+// returns 0 on success, or -1 if the method can't be sent this way (use OSC instead)
+extern int ipc_sendv(const char *path, const char *types, va_list ap);
+// wait (briefly) until crone has taken every command sent through the ring.
+// call before sending crone anything over OSC, so it can't overtake them
+extern void ipc_fence(void);
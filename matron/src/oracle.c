@@ -11,15 +11,18 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include "lo/lo.h"
 
 #include "args.h"
 #include "events.h"
 #include "hello.h"
+#include "ipc.h"
 #include "oracle.h"
 
 // address of external DSP environment (e.g. supercollider)
@@ -29,6 +32,10 @@ static lo_address crone_addr;
 
 static lo_server_thread st;
 
+// send to crone: through shared memory when attached and the method allows it, otherwise OSC
+#define crone_send(path, types, ...) o_crone_send(path, types, ##__VA_ARGS__, LO_ARGS_END)
+static void o_crone_send(const char *path, const char *types, ...);
+
 //-------------------
 //--- audio engine descriptor management
 
@@ -41,6 +48,10 @@ int num_commands = 0;
 // count of poll descriptors
 int num_polls = 0;
 
+// softcut voice count and buffer length, as reported by crone (defaults until it does)
+static int cut_voice_count = 6;
+static int cut_buffer_frames = 16777216;
+
 // state flags for receiving command/poll/param reports
 bool needCommandReport;
 bool needPollReport;
@@ -79,6 +90,8 @@ static void o_set_num_desc(int *dst, int num);
 
 static int handle_crone_ready(const char *path, const char *types, lo_arg **argv, int argc, void *data,
                               void *user_data);
+static int handle_crone_ipc_ready(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                                  void *user_data);
 static int handle_engine_report_start(const char *path, const char *types, lo_arg **argv, int argc, void *data,
                                       void *user_data);
 static int handle_engine_report_entry(const char *path, const char *types, lo_arg **argv, int argc, void *data,
@@ -104,13 +117,76 @@ static int handle_poll_data(const char *path, const char *types, lo_arg **argv,
 /*                              void *data, void *user_data); */
 static int handle_poll_io_levels(const char *path, const char *types, lo_arg **argv, int argc, void *data,
                                  void *user_data);
+static int handle_poll_meters(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                              void *user_data);
 
 static int handle_poll_softcut_phase(const char *path, const char *types, lo_arg **argv, int argc, void *data,
                                      void *user_data);
 
-static int handle_tape_play_state(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+static int handle_softcut_buffer_job(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                                     void *user_data);
+static int handle_softcut_event(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                                void *user_data);
+static int handle_softcut_info(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                               void *user_data);
+
+// time of a message in seconds (system clock): its bundle timetag if it has one, otherwise now
+static double message_time(lo_message msg) {
+    // seconds from the OSC epoch (1900) to the unix epoch (1970)
+    static const double ntp_unix_offset = 2208988800.0;
+    lo_timetag tt = lo_message_get_timestamp(msg);
+    if (tt.sec == LO_TT_IMMEDIATE.sec && tt.frac == LO_TT_IMMEDIATE.frac) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+    }
+    return (double)tt.sec - ntp_unix_offset + (double)tt.frac / 4294967296.0;
+}
+
+static int handle_softcut_buffer_job(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                              void *user_data) {
+    assert(argc > 2);
+    union event_data *ev = event_data_new(EVENT_SOFTCUT_BUFFER_JOB);
+    ev->softcut_buffer_job.id = argv[0]->i;
+    ev->softcut_buffer_job.state = argv[1]->i;
+    ev->softcut_buffer_job.progress = argv[2]->f;
+    event_post(ev);
+    return 0;
+}
+
+int handle_tape_play_state(const char *path, const char *types, lo_arg **argv, int argc, void *data,
                                   void *user_data);
 
+static int handle_tape_stats(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                             void *user_data) {
+    assert(argc > 4);
+    union event_data *ev = event_data_new(EVENT_TAPE_STATS);
+    ev->tape_stats.stream = argv[0]->i;
+    ev->tape_stats.running = argv[1]->i;
+    ev->tape_stats.seconds = argv[2]->f;
+    ev->tape_stats.fill = argv[3]->f;
+    ev->tape_stats.dropped = argv[4]->i;
+    event_post(ev);
+    return 0;
+}
+
+// reply to /crone/stats/commands: client name, posted, coalesced, applied, overflows, dropped, max / mean latency (us)
+static int handle_command_stats(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                                void *user_data) {
+    assert(argc > 7);
+    union event_data *ev = event_data_new(EVENT_COMMAND_STATS);
+    ev->command_stats.client = strcmp(&argv[0]->s, "softcut") == 0 ? 1 : 0;
+    ev->command_stats.posted = argv[1]->i;
+    ev->command_stats.coalesced = argv[2]->i;
+    ev->command_stats.applied = argv[3]->i;
+    ev->command_stats.overflows = argv[4]->i;
+    ev->command_stats.dropped = argv[5]->i;
+    ev->command_stats.max_latency = argv[6]->f;
+    ev->command_stats.mean_latency = argv[7]->f;
+    event_post(ev);
+    return 0;
+}
+
 static void lo_error_handler(int num, const char *m, const char *path);
 
 static void set_need_reports() {
@@ -128,6 +204,22 @@ static void test_engine_load_done();
 //-----------------------------------
 //---- extern function definitions
 
+static void o_crone_send(const char *path, const char *types, ...) {
+    va_list ap;
+    va_start(ap, types);
+    if (ipc_sendv(path, types, ap) != 0) {
+        ipc_fence();
+        lo_message msg = lo_message_new();
+        if (lo_message_add_varargs(msg, types == NULL ? "" : types, ap) == 0) {
+            lo_send_message(crone_addr, path, msg);
+        } else {
+            fprintf(stderr, "oracle: bad arguments for %s\n", path);
+        }
+        lo_message_free(msg);
+    }
+    va_end(ap);
+}
+
 void o_query_startup(void) {
     // fprintf(stderr, "sending /ready: %d", rem_port);
     lo_send(ext_addr, "/ready", "");
@@ -148,6 +240,8 @@ void o_init(void) {
 
     // crone ready
     lo_server_thread_add_method(st, "/crone/ready", "", handle_crone_ready, NULL);
+    // crone shared memory created (or re-created)
+    lo_server_thread_add_method(st, "/crone/ipc/ready", "", handle_crone_ipc_ready, NULL);
     // engine report sequence
     lo_server_thread_add_method(st, "/report/engines/start", "i", handle_engine_report_start, NULL);
     lo_server_thread_add_method(st, "/report/engines/entry", "is", handle_engine_report_entry, NULL);
@@ -169,12 +263,27 @@ void o_init(void) {
     lo_server_thread_add_method(st, "/poll/data", "ib", handle_poll_data, NULL);
     // dedicated path for audio I/O levels
     lo_server_thread_add_method(st, "/poll/vu", "b", handle_poll_io_levels, NULL);
+    // peak / RMS for all metered busses and softcut voices
+    lo_server_thread_add_method(st, "/poll/meters", "b", handle_poll_meters, NULL);
     // softcut polls
     lo_server_thread_add_method(st, "/poll/softcut/phase", "if", handle_poll_softcut_phase, NULL);
+    // softcut buffer jobs
+    lo_server_thread_add_method(st, "/softcut/buffer/job", "iif", handle_softcut_buffer_job, NULL);
+    // softcut voice events
+    lo_server_thread_add_method(st, "/softcut/event", "iif", handle_softcut_event, NULL);
+    // softcut configuration
+    lo_server_thread_add_method(st, "/softcut/info", "ii", handle_softcut_info, NULL);
     // tape reports
     lo_server_thread_add_method(st, "/tape/play/state", "s", handle_tape_play_state, NULL);
+    lo_server_thread_add_method(st, "/tape/stats", "iiffi", handle_tape_stats, NULL);
+    // command queue counters
+    lo_server_thread_add_method(st, "/crone/stats/commands", "siiiiiff", handle_command_stats, NULL);
 
     lo_server_thread_start(st);
+
+    // crone may already be running
+    lo_send(crone_addr, "/softcut/info", "");
+    ipc_init();
 }
 
 void o_deinit(void) {
@@ -182,6 +291,7 @@ void o_deinit(void) {
     lo_send(ext_addr, "/engine/kill", "");
     fprintf(stderr, "stopping OSC server\n");
     lo_server_thread_free(st);
+    ipc_deinit();
     lo_address_free(ext_addr);
     lo_address_free(crone_addr);
 }
@@ -394,50 +504,71 @@ void o_request_poll_value(int idx) {
 
 //---- audio context control
 
+// ask crone for its command queue counters (which it then resets); each client replies with /crone/stats/commands
+void o_request_command_stats() {
+    crone_send("/crone/stats/commands", NULL);
+}
+
 void o_poll_start_vu() {
-    lo_send(crone_addr, "/poll/start/vu", NULL);
+    crone_send("/poll/start/vu", NULL);
 }
 
 void o_poll_stop_vu() {
-    lo_send(crone_addr, "/poll/stop/vu", NULL);
+    crone_send("/poll/stop/vu", NULL);
+}
+
+void o_poll_start_meters() {
+    crone_send("/poll/start/meters", NULL);
+}
+
+void o_poll_stop_meters() {
+    crone_send("/poll/stop/meters", NULL);
 }
 
 void o_poll_start_cut_phase() {
-    lo_send(crone_addr, "/poll/start/cut/phase", NULL);
+    crone_send("/poll/start/cut/phase", NULL);
 }
 
 void o_poll_stop_cut_phase() {
-    lo_send(crone_addr, "/poll/stop/cut/phase", NULL);
+    crone_send("/poll/stop/cut/phase", NULL);
+}
+
+void o_poll_start_cut_events() {
+    crone_send("/poll/start/cut/events", NULL);
+}
+
+void o_poll_stop_cut_events() {
+    crone_send("/poll/stop/cut/events", NULL);
 }
 
 void o_set_level_adc(float level) {
-    lo_send(crone_addr, "/set/level/adc", "f", level);
+    crone_send("/set/level/adc", "f", level);
 }
 
 void o_set_level_dac(float level) {
-    lo_send(crone_addr, "/set/level/dac", "f", level);
+    crone_send("/set/level/dac", "f", level);
 }
 
 void o_set_level_ext(float level) {
-    lo_send(crone_addr, "/set/level/ext", "f", level);
+    crone_send("/set/level/ext", "f", level);
 }
 
 void o_set_level_monitor(float level) {
-    lo_send(crone_addr, "/set/level/monitor", "f", level);
+    crone_send("/set/level/monitor", "f", level);
 }
 
 void o_set_monitor_mix_mono() {
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 0, 0.5);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 1, 0.5);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 2, 0.5);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 3, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 0, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 1, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 2, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 3, 0.5);
 }
 
 void o_set_monitor_mix_stereo() {
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 0, 1.0);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 1, 0.0);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 2, 0.0);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 3, 1.0);
+    crone_send("/set/level/monitor_mix", "if", 0, 1.0);
+    crone_send("/set/level/monitor_mix", "if", 1, 0.0);
+    crone_send("/set/level/monitor_mix", "if", 2, 0.0);
+    crone_send("/set/level/monitor_mix", "if", 3, 1.0);
 }
 
 void o_set_audio_pitch_on() {
@@ -454,180 +585,250 @@ void o_restart_audio() {
 
 //---- tape controls
 void o_set_level_tape(float level) {
-    lo_send(crone_addr, "/set/level/tape", "f", level);
+    crone_send("/set/level/tape", "f", level);
 }
 
 void o_set_level_tape_rev(float level) {
-    lo_send(crone_addr, "/set/level/tape_rev", "f", level);
+    crone_send("/set/level/tape_rev", "f", level);
 }
 
 void o_tape_rec_open(char *file) {
-    lo_send(crone_addr, "/tape/record/open", "s", file);
+    crone_send("/tape/record/open", "s", file);
+}
+
+void o_tape_rec_open_stems(char *file, int stems, int split) {
+    crone_send("/tape/record/open_stems", "sii", file, stems, split);
 }
 
 void o_tape_rec_start() {
-    lo_send(crone_addr, "/tape/record/start", NULL);
+    crone_send("/tape/record/start", NULL);
 }
 
 void o_tape_rec_stop() {
-    lo_send(crone_addr, "/tape/record/stop", NULL);
+    crone_send("/tape/record/stop", NULL);
 }
 
 void o_tape_play_open(char *file) {
-    lo_send(crone_addr, "/tape/play/open", "s", file);
+    crone_send("/tape/play/open", "s", file);
+}
+
+void o_tape_play_quality(int quality) {
+    crone_send("/tape/play/quality", "i", quality);
 }
 
 void o_tape_play_start() {
-    lo_send(crone_addr, "/tape/play/start", NULL);
+    crone_send("/tape/play/start", NULL);
 }
 
 void o_tape_play_stop() {
-    lo_send(crone_addr, "/tape/play/stop", NULL);
+    crone_send("/tape/play/stop", NULL);
 }
 
 //--- cut
 void o_cut_enable(int i, float value) {
-    lo_send(crone_addr, "/set/enabled/cut", "if", i, value);
+    crone_send("/set/enabled/cut", "if", i, value);
 }
 
 void o_set_level_adc_cut(float value) {
-    lo_send(crone_addr, "/set/level/adc_cut", "f", value);
+    crone_send("/set/level/adc_cut", "f", value);
 }
 
 void o_set_level_ext_cut(float value) {
-    lo_send(crone_addr, "/set/level/ext_cut", "f", value);
+    crone_send("/set/level/ext_cut", "f", value);
 }
 
 void o_set_level_tape_cut(float value) {
-    lo_send(crone_addr, "/set/level/tape_cut", "f", value);
+    crone_send("/set/level/tape_cut", "f", value);
 }
 
 void o_set_level_cut_rev(float value) {
-    lo_send(crone_addr, "/set/level/cut_rev", "f", value);
+    crone_send("/set/level/cut_rev", "f", value);
 }
 
 void o_set_level_cut_master(float value) {
-    lo_send(crone_addr, "/set/level/cut_master", "f", value);
+    crone_send("/set/level/cut_master", "f", value);
 }
 
 void o_set_level_cut(int index, float value) {
-    lo_send(crone_addr, "/set/level/cut", "if", index, value);
+    crone_send("/set/level/cut", "if", index, value);
 }
 
 void o_set_level_cut_cut(int src, int dest, float value) {
-    lo_send(crone_addr, "/set/level/cut_cut", "iif", src, dest, value);
+    crone_send("/set/level/cut_cut", "iif", src, dest, value);
 }
 
 void o_set_pan_cut(int index, float value) {
-    lo_send(crone_addr, "/set/pan/cut", "if", index, value);
+    crone_send("/set/pan/cut", "if", index, value);
 }
 
 void o_set_cut_param(const char *name, int voice, float value) {
     static char buf[128];
     sprintf(buf, "/set/param/cut/%s", name);
-    lo_send(crone_addr, buf, "if", voice, value);
+    crone_send(buf, "if", voice, value);
 }
 
 void o_set_cut_param_ii(const char *name, int voice, int value) {
     static char buf[128];
     sprintf(buf, "/set/param/cut/%s", name);
-    lo_send(crone_addr, buf, "ii", voice, value);
+    crone_send(buf, "ii", voice, value);
 }
 
 void o_set_cut_param_iif(const char *name, int a, int b, float v) {
     static char buf[128];
     sprintf(buf, "/set/param/cut/%s", name);
-    lo_send(crone_addr, buf, "iif", a, b, v);
+    crone_send(buf, "iif", a, b, v);
 }
 
 void o_set_level_input_cut(int src, int dst, float level) {
-    lo_send(crone_addr, "/set/level/in_cut", "iif", src, dst, level);
+    crone_send("/set/level/in_cut", "iif", src, dst, level);
+}
+
+// job IDs for softcut buffer requests; only used from the lua thread
+static int cut_buffer_job_id = 0;
+
+static int next_cut_buffer_job_id() {
+    // stay non-negative; crone treats negative IDs as untracked
+    cut_buffer_job_id = (cut_buffer_job_id + 1) & 0x7fffffff;
+    return cut_buffer_job_id;
+}
+
+int o_cut_buffer_clear() {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/clear", "i", id);
+    return id;
+}
+
+int o_cut_buffer_sync() {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/sync", "i", id);
+    return id;
+}
+
+int o_cut_buffer_clear_channel(int ch) {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/clear_channel", "ii", ch, id);
+    return id;
 }
 
-void o_cut_buffer_clear() {
-    lo_send(crone_addr, "/softcut/buffer/clear", "");
+int o_cut_buffer_clear_region(float start, float end) {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/clear_region", "ffi", start, end, id);
+    return id;
 }
 
-void o_cut_buffer_clear_channel(int ch) {
-    lo_send(crone_addr, "/softcut/buffer/clear_channel", "i", ch);
+int o_cut_buffer_clear_region_channel(int ch, float start, float end) {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/clear_region_channel", "iffi", ch, start, end, id);
+    return id;
 }
 
-void o_cut_buffer_clear_region(float start, float end) {
-    lo_send(crone_addr, "/softcut/buffer/clear_region", "ff", start, end);
+int o_cut_buffer_read_mono(char *file, float start_src, float start_dst, float dur, int ch_src, int ch_dst) {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/read_mono", "sfffiii", file, start_src, start_dst, dur, ch_src, ch_dst, id);
+    return id;
 }
 
-void o_cut_buffer_clear_region_channel(int ch, float start, float end) {
-    lo_send(crone_addr, "/softcut/buffer/clear_region_channel", "iff", ch, start, end);
+int o_cut_buffer_read_stereo(char *file, float start_src, float start_dst, float dur) {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/read_stereo", "sfffi", file, start_src, start_dst, dur, id);
+    return id;
 }
 
-void o_cut_buffer_read_mono(char *file, float start_src, float start_dst, float dur, int ch_src, int ch_dst) {
-    lo_send(crone_addr, "/softcut/buffer/read_mono", "sfffii", file, start_src, start_dst, dur, ch_src, ch_dst);
+int o_cut_buffer_write_mono(char *file, float start, float dur, int ch) {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/write_mono", "sffii", file, start, dur, ch, id);
+    return id;
 }
 
-void o_cut_buffer_read_stereo(char *file, float start_src, float start_dst, float dur) {
-    lo_send(crone_addr, "/softcut/buffer/read_stereo", "sfff", file, start_src, start_dst, dur);
+int o_cut_buffer_write_stereo(char *file, float start, float dur) {
+    int id = next_cut_buffer_job_id();
+    crone_send("/softcut/buffer/write_stereo", "sffi", file, start, dur, id);
+    return id;
 }
 
-void o_cut_buffer_write_mono(char *file, float start, float dur, int ch) {
-    lo_send(crone_addr, "/softcut/buffer/write_mono", "sffi", file, start, dur, ch);
+void o_cut_stream_open(int voice, char *file, float min_dur) {
+    crone_send("/softcut/stream/open", "isf", voice, file, min_dur);
 }
 
-void o_cut_buffer_write_stereo(char *file, float start, float dur) {
-    lo_send(crone_addr, "/softcut/buffer/write_stereo", "sff", file, start, dur);
+void o_cut_stream_close(int voice) {
+    crone_send("/softcut/stream/close", "i", voice);
 }
 
 void o_cut_reset() {
-    lo_send(crone_addr, "/softcut/reset", "");
+    crone_send("/softcut/reset", "");
+}
+
+void o_get_cut_info(int *voices, int *frames) {
+    *voices = __atomic_load_n(&cut_voice_count, __ATOMIC_RELAXED);
+    *frames = __atomic_load_n(&cut_buffer_frames, __ATOMIC_RELAXED);
 }
 
 //--- rev effects controls
 // enable / disable rev fx processing
 void o_set_rev_on() {
-    lo_send(crone_addr, "/set/enabled/reverb", "f", 1.0);
+    crone_send("/set/enabled/reverb", "f", 1.0);
 }
 
 void o_set_rev_off() {
-    lo_send(crone_addr, "/set/enabled/reverb", "f", 0.0);
+    crone_send("/set/enabled/reverb", "f", 0.0);
 }
 
 //--- comp effects controls
 void o_set_comp_on() {
-    lo_send(crone_addr, "/set/enabled/compressor", "f", 1.0);
+    crone_send("/set/enabled/compressor", "f", 1.0);
 }
 
 void o_set_comp_off() {
-    lo_send(crone_addr, "/set/enabled/compressor", "f", 0.0);
+    crone_send("/set/enabled/compressor", "f", 0.0);
 }
 
 void o_set_comp_mix(float value) {
-    lo_send(crone_addr, "/set/level/compressor_mix", "f", value);
+    crone_send("/set/level/compressor_mix", "f", value);
 }
 
 // stereo output -> rev
 void o_set_level_ext_rev(float value) {
-    lo_send(crone_addr, "/set/level/ext_rev", "f", value);
+    crone_send("/set/level/ext_rev", "f", value);
 }
 
 // rev return -> dac
 void o_set_level_rev_dac(float value) {
-    lo_send(crone_addr, "/set/level/rev_dac", "f", value);
+    crone_send("/set/level/rev_dac", "f", value);
 }
 
 // monitor mix -> rev level
 void o_set_level_monitor_rev(float value) {
-    lo_send(crone_addr, "/set/level/monitor_rev", "f", value);
+    crone_send("/set/level/monitor_rev", "f", value);
 }
 
 void o_set_rev_param(const char *name, float value) {
     static char buf[128];
     sprintf(buf, "/set/param/reverb/%s", name);
-    lo_send(crone_addr, buf, "f", value);
+    crone_send(buf, "f", value);
 }
 
 void o_set_comp_param(const char *name, float value) {
     static char buf[128];
     sprintf(buf, "/set/param/compressor/%s", name);
-    lo_send(crone_addr, buf, "f", value);
+    crone_send(buf, "f", value);
+}
+
+void o_set_eq_on() {
+    crone_send("/set/enabled/eq", "f", 1.0);
+}
+
+void o_set_eq_off() {
+    crone_send("/set/enabled/eq", "f", 0.0);
+}
+
+void o_set_eq_param(const char *name, float value) {
+    static char buf[128];
+    sprintf(buf, "/set/param/eq/%s", name);
+    crone_send(buf, "f", value);
+}
+
+void o_set_insert_slot(int slot, int fx) {
+    crone_send("/set/insert/slot", "ii", slot, fx);
 }
 
 /////////////////////
@@ -645,6 +846,12 @@ int handle_crone_ready(const char *path, const char *types, lo_arg **argv, int a
     return 0;
 }
 
+int handle_crone_ipc_ready(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                           void *user_data) {
+    ipc_attach();
+    return 0;
+}
+
 int handle_engine_report_start(const char *path, const char *types, lo_arg **argv, int argc, void *data,
                                void *user_data) {
     assert(argc > 0);
@@ -762,6 +969,21 @@ int handle_poll_io_levels(const char *path, const char *types, lo_arg **argv, in
     return 0;
 }
 
+int handle_poll_meters(const char *path, const char *types, lo_arg **argv, int argc, void *data, void *user_data) {
+    assert(argc > 0);
+    uint8_t *blobdata = (uint8_t *)lo_blob_dataptr((lo_blob)argv[0]);
+    int sz = lo_blob_datasize((lo_blob)argv[0]);
+    if (sz <= 0) {
+        return 0;
+    }
+    union event_data *ev = event_data_new(EVENT_POLL_METERS);
+    ev->poll_meters.size = sz;
+    ev->poll_meters.data = calloc(1, sz);
+    memcpy(ev->poll_meters.data, blobdata, sz);
+    event_post(ev);
+    return 0;
+}
+
 int handle_poll_softcut_phase(const char *path, const char *types, lo_arg **argv, int argc, void *data,
                               void *user_data) {
 
@@ -769,11 +991,32 @@ int handle_poll_softcut_phase(const char *path, const char *types, lo_arg **argv
     union event_data *ev = event_data_new(EVENT_POLL_SOFTCUT_PHASE);
     ev->softcut_phase.idx = argv[0]->i;
     ev->softcut_phase.value = argv[1]->f;
+    ev->softcut_phase.time = message_time((lo_message)data);
     fflush(stdout);
     event_post(ev);
     return 0;
 }
 
+int handle_softcut_event(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                         void *user_data) {
+    assert(argc > 2);
+    union event_data *ev = event_data_new(EVENT_SOFTCUT_EVENT);
+    ev->softcut_event.voice = argv[0]->i;
+    ev->softcut_event.kind = argv[1]->i;
+    ev->softcut_event.pos = argv[2]->f;
+    ev->softcut_event.time = message_time((lo_message)data);
+    event_post(ev);
+    return 0;
+}
+
+int handle_softcut_info(const char *path, const char *types, lo_arg **argv, int argc, void *data,
+                        void *user_data) {
+    assert(argc > 1);
+    __atomic_store_n(&cut_voice_count, argv[0]->i, __ATOMIC_RELAXED);
+    __atomic_store_n(&cut_buffer_frames, argv[1]->i, __ATOMIC_RELAXED);
+    return 0;
+}
+
 int handle_tape_play_state(const char *path, const char *types, lo_arg **argv, int argc, void *data, void *user_data) {
 
     // assert(argc > 0);
@@ -99,10 +99,17 @@ extern void o_request_poll_value(int idx);
 
 //--- audio context controls
 
+// crone command queue counters, reported as EVENT_COMMAND_STATS
+extern void o_request_command_stats();
+
 extern void o_poll_start_vu();
 extern void o_poll_stop_vu();
+extern void o_poll_start_meters();
+extern void o_poll_stop_meters();
 extern void o_poll_start_cut_phase();
 extern void o_poll_stop_cut_phase();
+extern void o_poll_start_cut_events();
+extern void o_poll_stop_cut_events();
 
 extern void o_set_level_adc(float level);
 extern void o_set_level_dac(float level);
@@ -116,9 +123,13 @@ extern void o_set_audio_pitch_off();
 
 //--- tape control
 extern void o_tape_rec_open(char *file);
+// stems: mask of busses (1 = dac, 2 = adc, 4 = cut, 8 = ext, 16 = aux); split: a file per stem
+extern void o_tape_rec_open_stems(char *file, int stems, int split);
 extern void o_tape_rec_start();
 extern void o_tape_rec_stop();
 extern void o_tape_play_open(char *file);
+// resampling quality for files not at the engine rate (0 = fast, 1 = medium, 2 = best)
+extern void o_tape_play_quality(int quality);
 extern void o_tape_play_start();
 extern void o_tape_play_stop();
 
@@ -133,15 +144,22 @@ extern void o_set_level_cut_cut(int src, int dest, float value);
 extern void o_set_level_input_cut(int src, int dst, float level);
 extern void o_set_pan_cut(int index, float value);
 extern void o_cut_enable(int i, float value);
-extern void o_cut_buffer_clear();
-extern void o_cut_buffer_clear_channel(int ch);
-extern void o_cut_buffer_clear_region(float start, float end);
-extern void o_cut_buffer_clear_region_channel(int ch, float start, float end);
-extern void o_cut_buffer_read_mono(char *file, float start_src, float start_dst, float dur, int ch_src, int ch_dst);
-extern void o_cut_buffer_read_stereo(char *file, float start_src, float start_dst, float dur);
-extern void o_cut_buffer_write_mono(char *file, float start, float dur, int ch);
-extern void o_cut_buffer_write_stereo(char *file, float start, float dur);
+// each buffer request returns a job ID;
+// crone reports progress and completion for it with /softcut/buffer/job
+extern int o_cut_buffer_clear();
+extern int o_cut_buffer_clear_channel(int ch);
+extern int o_cut_buffer_sync();
+extern int o_cut_buffer_clear_region(float start, float end);
+extern int o_cut_buffer_clear_region_channel(int ch, float start, float end);
+extern int o_cut_buffer_read_mono(char *file, float start_src, float start_dst, float dur, int ch_src, int ch_dst);
+extern int o_cut_buffer_read_stereo(char *file, float start_src, float start_dst, float dur);
+extern int o_cut_buffer_write_mono(char *file, float start, float dur, int ch);
+extern int o_cut_buffer_write_stereo(char *file, float start, float dur);
+extern void o_cut_stream_open(int voice, char *file, float min_dur);
+extern void o_cut_stream_close(int voice);
 extern void o_cut_reset();
+// voice count and buffer length (frames) that crone was started with
+extern void o_get_cut_info(int *voices, int *frames);
 // most softcut parameter changs take single voice index...
 extern void o_set_cut_param(const char *name, int voice, float value);
 extern void o_set_cut_param_ii(const char *name, int voice, int value);
@@ -162,4 +180,12 @@ extern void o_set_comp_off();
 extern void o_set_comp_mix(float level);
 extern void o_set_comp_param(const char *name, float value);
 
+//--- eq controls
+extern void o_set_eq_on();
+extern void o_set_eq_off();
+extern void o_set_eq_param(const char *name, float value);
+
+//--- insert chain: put effect `fx` in `slot` (fx < 0 empties the slot)
+extern void o_set_insert_slot(int slot, int fx);
+
 extern void o_restart_audio();
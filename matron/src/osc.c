@@ -16,6 +16,7 @@
 
 #include "args.h"
 #include "events.h"
+#include "ipc.h"
 #include "oracle.h"
 
 #define OSC_CRONE_HOST "127.0.0.1"
@@ -57,6 +58,7 @@ void osc_send(const char *host, const char *port, const char *path, lo_message m
 }
 
 void osc_send_crone(const char *path, lo_message msg) {
+    ipc_fence();
     lo_send_message(crone_addr, path, msg);
 }
 
@@ -154,14 +154,20 @@ static int _set_audio_pitch_off(lua_State *l);
 
 static int _poll_start_vu(lua_State *l);
 static int _poll_stop_vu(lua_State *l);
+static int _poll_start_meters(lua_State *l);
+static int _poll_stop_meters(lua_State *l);
 static int _poll_start_cut_phase(lua_State *l);
 static int _poll_stop_cut_phase(lua_State *l);
+static int _poll_start_cut_events(lua_State *l);
+static int _poll_stop_cut_events(lua_State *l);
 
 // tape control
 static int _tape_rec_open(lua_State *l);
+static int _tape_rec_open_stems(lua_State *l);
 static int _tape_rec_start(lua_State *l);
 static int _tape_rec_stop(lua_State *l);
 static int _tape_play_open(lua_State *l);
+static int _tape_play_quality(lua_State *l);
 static int _tape_play_start(lua_State *l);
 static int _tape_play_stop(lua_State *l);
 
@@ -177,13 +183,17 @@ static int _set_pan_cut(lua_State *l);
 static int _cut_enable(lua_State *l);
 static int _cut_buffer_clear(lua_State *l);
 static int _cut_buffer_clear_channel(lua_State *l);
+static int _cut_buffer_sync(lua_State *l);
 static int _cut_buffer_clear_region(lua_State *l);
 static int _cut_buffer_clear_region_channel(lua_State *l);
 static int _cut_buffer_read_mono(lua_State *l);
 static int _cut_buffer_read_stereo(lua_State *l);
 static int _cut_buffer_write_mono(lua_State *l);
 static int _cut_buffer_write_stereo(lua_State *l);
+static int _cut_stream_open(lua_State *l);
+static int _cut_stream_close(lua_State *l);
 static int _cut_reset(lua_State *l);
+static int _cut_info(lua_State *l);
 static int _set_cut_param(lua_State *l);
 static int _set_cut_param_ii(lua_State *l);
 static int _set_cut_param_iif(lua_State *l);
@@ -203,6 +213,10 @@ static int _set_comp_on(lua_State *l);
 static int _set_comp_off(lua_State *l);
 static int _set_comp_mix(lua_State *l);
 static int _set_comp_param(lua_State *l);
+static int _set_eq_on(lua_State *l);
+static int _set_eq_off(lua_State *l);
+static int _set_eq_param(lua_State *l);
+static int _set_insert_slot(lua_State *l);
 
 // start audio (sync with sclang startup)
 static int _start_audio(lua_State *l);
@@ -217,6 +231,16 @@ static int _system_cmd(lua_State *l);
 
 // reset LVM
 static int _reset_lvm(lua_State *l);
+
+// event queue statistics
+static int _event_stats(lua_State *l);
+static int _event_stats_reset(lua_State *l);
+static int _event_coalesce(lua_State *l);
+static int _event_latency(lua_State *l);
+static int _event_latency_reset(lua_State *l);
+
+// crone command queue statistics
+static int _command_stats_request(lua_State *l);
 static int _clock_schedule_sleep(lua_State *l);
 static int _clock_schedule_sync(lua_State *l);
 static int _clock_cancel(lua_State *l);
@@ -284,20 +308,30 @@ void w_init(void) {
     lua_register_norns("comp_off", &_set_comp_off);
     lua_register_norns("comp_param", &_set_comp_param);
     lua_register_norns("comp_mix", &_set_comp_mix);
+    lua_register_norns("eq_on", &_set_eq_on);
+    lua_register_norns("eq_off", &_set_eq_off);
+    lua_register_norns("eq_param", &_set_eq_param);
+    lua_register_norns("insert_slot", &_set_insert_slot);
 
     // tape controls
     lua_register_norns("tape_record_open", &_tape_rec_open);
+    lua_register_norns("tape_record_open_stems", &_tape_rec_open_stems);
     lua_register_norns("tape_record_start", &_tape_rec_start);
     lua_register_norns("tape_record_stop", &_tape_rec_stop);
     lua_register_norns("tape_play_open", &_tape_play_open);
+    lua_register_norns("tape_play_quality", &_tape_play_quality);
     lua_register_norns("tape_play_start", &_tape_play_start);
     lua_register_norns("tape_play_stop", &_tape_play_stop);
 
     // polls
     lua_register_norns("poll_start_vu", &_poll_start_vu);
     lua_register_norns("poll_stop_vu", &_poll_stop_vu);
+    lua_register_norns("poll_start_meters", &_poll_start_meters);
+    lua_register_norns("poll_stop_meters", &_poll_stop_meters);
     lua_register_norns("poll_start_cut_phase", &_poll_start_cut_phase);
     lua_register_norns("poll_stop_cut_phase", &_poll_stop_cut_phase);
+    lua_register_norns("poll_start_cut_events", &_poll_start_cut_events);
+    lua_register_norns("poll_stop_cut_events", &_poll_stop_cut_events);
 
     // cut
     lua_register_norns("level_adc_cut", &_set_level_adc_cut);
@@ -311,13 +345,17 @@ void w_init(void) {
     lua_register_norns("cut_enable", &_cut_enable);
     lua_register_norns("cut_buffer_clear", &_cut_buffer_clear);
     lua_register_norns("cut_buffer_clear_channel", &_cut_buffer_clear_channel);
+    lua_register_norns("cut_buffer_sync", &_cut_buffer_sync);
     lua_register_norns("cut_buffer_clear_region", &_cut_buffer_clear_region);
     lua_register_norns("cut_buffer_clear_region_channel", &_cut_buffer_clear_region_channel);
     lua_register_norns("cut_buffer_read_mono", &_cut_buffer_read_mono);
     lua_register_norns("cut_buffer_read_stereo", &_cut_buffer_read_stereo);
     lua_register_norns("cut_buffer_write_mono", &_cut_buffer_write_mono);
     lua_register_norns("cut_buffer_write_stereo", &_cut_buffer_write_stereo);
+    lua_register_norns("cut_stream_open", &_cut_stream_open);
+    lua_register_norns("cut_stream_close", &_cut_stream_close);
     lua_register_norns("cut_reset", &_cut_reset);
+    lua_register_norns("cut_info", &_cut_info);
     lua_register_norns("cut_param", &_set_cut_param);
     lua_register_norns("cut_param_ii", &_set_cut_param_ii);
     lua_register_norns("cut_param_iif", &_set_cut_param_iif);
@@ -420,6 +458,16 @@ void w_init(void) {
     // reset LVM
     lua_register_norns("reset_lvm", &_reset_lvm);
 
+    // event queue statistics
+    lua_register_norns("event_stats", &_event_stats);
+    lua_register_norns("event_stats_reset", &_event_stats_reset);
+    lua_register_norns("event_coalesce", &_event_coalesce);
+    lua_register_norns("event_latency", &_event_latency);
+    lua_register_norns("event_latency_reset", &_event_latency_reset);
+
+    // crone command queue statistics
+    lua_register_norns("command_stats_request", &_command_stats_request);
+
     // clock
     lua_register_norns("clock_schedule_sleep", &_clock_schedule_sleep);
     lua_register_norns("clock_schedule_sync", &_clock_schedule_sync);
@@ -1910,13 +1958,106 @@ void w_handle_poll_io_levels(uint8_t *levels) {
     l_report(lvm, l_docall(lvm, 4, 0));
 }
 
-void w_handle_poll_softcut_phase(int idx, float val) {
+// argument is an array of (peak, rms) byte pairs
+void w_handle_poll_meters(int size, uint8_t *data) {
+    const int n = size / 2;
+    lua_getglobal(lvm, "_norns");
+    lua_getfield(lvm, -1, "meters");
+    lua_remove(lvm, -2);
+    lua_createtable(lvm, n, 0);
+    for (int i = 0; i < n; ++i) {
+        lua_pushinteger(lvm, data[2 * i]);
+        lua_rawseti(lvm, -2, i + 1);
+    }
+    lua_createtable(lvm, n, 0);
+    for (int i = 0; i < n; ++i) {
+        lua_pushinteger(lvm, data[2 * i + 1]);
+        lua_rawseti(lvm, -2, i + 1);
+    }
+    l_report(lvm, l_docall(lvm, 2, 0));
+}
+
+void w_handle_softcut_buffer_job(int id, int state, float progress) {
+    static const char *state_names[] = {"progress", "done", "failed"};
+    if (state < 0 || state > 2) {
+        return;
+    }
+    lua_getglobal(lvm, "_norns");
+    lua_getfield(lvm, -1, "softcut_buffer_job");
+    lua_remove(lvm, -2);
+    lua_pushinteger(lvm, id);
+    lua_pushstring(lvm, state_names[state]);
+    lua_pushnumber(lvm, progress);
+    l_report(lvm, l_docall(lvm, 3, 0));
+}
+
+void w_handle_poll_softcut_phase(int idx, float val, double time) {
     // fprintf(stderr, "_handle_poll_softcut_phase: %d, %f\n", idx, val);
     lua_getglobal(lvm, "_norns");
     lua_getfield(lvm, -1, "softcut_phase");
     lua_remove(lvm, -2);
     lua_pushinteger(lvm, idx + 1);
     lua_pushnumber(lvm, val);
+    lua_pushnumber(lvm, time);
+    l_report(lvm, l_docall(lvm, 3, 0));
+}
+
+void w_handle_tape_stats(int stream, int running, float seconds, float fill, int dropped) {
+    static const char *stream_names[] = {"record", "play"};
+    if (stream < 0 || stream > 1) {
+        return;
+    }
+    lua_getglobal(lvm, "_norns");
+    lua_getfield(lvm, -1, "tape_stats");
+    lua_remove(lvm, -2);
+    lua_pushstring(lvm, stream_names[stream]);
+    lua_pushboolean(lvm, running);
+    lua_pushnumber(lvm, seconds);
+    lua_pushnumber(lvm, fill);
+    lua_pushinteger(lvm, dropped);
+    l_report(lvm, l_docall(lvm, 5, 0));
+}
+
+void w_handle_softcut_event(int voice, int kind, float pos, double time) {
+    static const char *kind_names[] = {"loop", "rec_start", "rec_stop"};
+    if (kind < 0 || kind > 2) {
+        return;
+    }
+    lua_getglobal(lvm, "_norns");
+    lua_getfield(lvm, -1, "softcut_event");
+    lua_remove(lvm, -2);
+    lua_pushinteger(lvm, voice + 1);
+    lua_pushstring(lvm, kind_names[kind]);
+    lua_pushnumber(lvm, pos);
+    lua_pushnumber(lvm, time);
+    l_report(lvm, l_docall(lvm, 4, 0));
+}
+
+void w_handle_command_stats(int client, int posted, int coalesced, int applied, int overflows, int dropped,
+                            float max_latency, float mean_latency) {
+    static const char *client_names[] = {"mixer", "softcut"};
+    if (client < 0 || client > 1) {
+        return;
+    }
+    lua_getglobal(lvm, "_norns");
+    lua_getfield(lvm, -1, "command_stats");
+    lua_remove(lvm, -2);
+    lua_pushstring(lvm, client_names[client]);
+    lua_createtable(lvm, 0, 7);
+    lua_pushinteger(lvm, posted);
+    lua_setfield(lvm, -2, "posted");
+    lua_pushinteger(lvm, coalesced);
+    lua_setfield(lvm, -2, "coalesced");
+    lua_pushinteger(lvm, applied);
+    lua_setfield(lvm, -2, "applied");
+    lua_pushinteger(lvm, overflows);
+    lua_setfield(lvm, -2, "overflows");
+    lua_pushinteger(lvm, dropped);
+    lua_setfield(lvm, -2, "dropped");
+    lua_pushnumber(lvm, max_latency);
+    lua_setfield(lvm, -2, "max_latency_us");
+    lua_pushnumber(lvm, mean_latency);
+    lua_setfield(lvm, -2, "mean_latency_us");
     l_report(lvm, l_docall(lvm, 2, 0));
 }
 
@@ -2032,6 +2173,16 @@ int _tape_rec_open(lua_State *l) {
     return 0;
 }
 
+int _tape_rec_open_stems(lua_State *l) {
+    lua_check_num_args(3);
+    const char *s = luaL_checkstring(l, 1);
+    int stems = (int)luaL_checkinteger(l, 2);
+    int split = lua_toboolean(l, 3);
+    o_tape_rec_open_stems((char *)s, stems, split);
+    lua_settop(l, 0);
+    return 0;
+}
+
 int _tape_rec_start(lua_State *l) {
     o_tape_rec_start();
     return 0;
@@ -2050,6 +2201,14 @@ int _tape_play_open(lua_State *l) {
     return 0;
 }
 
+int _tape_play_quality(lua_State *l) {
+    lua_check_num_args(1);
+    int quality = (int)luaL_checkinteger(l, 1);
+    o_tape_play_quality(quality);
+    lua_settop(l, 0);
+    return 0;
+}
+
 int _tape_play_start(lua_State *l) {
     o_tape_play_start();
     return 0;
@@ -2070,6 +2229,16 @@ int _poll_stop_vu(lua_State *l) {
     return 0;
 }
 
+int _poll_start_meters(lua_State *l) {
+    o_poll_start_meters();
+    return 0;
+}
+
+int _poll_stop_meters(lua_State *l) {
+    o_poll_stop_meters();
+    return 0;
+}
+
 int _poll_start_cut_phase(lua_State *l) {
     o_poll_start_cut_phase();
     return 0;
@@ -2080,6 +2249,16 @@ int _poll_stop_cut_phase(lua_State *l) {
     return 0;
 }
 
+int _poll_start_cut_events(lua_State *l) {
+    o_poll_start_cut_events();
+    return 0;
+}
+
+int _poll_stop_cut_events(lua_State *l) {
+    o_poll_stop_cut_events();
+    return 0;
+}
+
 int _cut_enable(lua_State *l) {
     lua_check_num_args(2);
     int idx = (int)luaL_checkinteger(l, 1) - 1;
@@ -2149,23 +2328,28 @@ int _set_pan_cut(lua_State *l) {
 }
 
 int _cut_buffer_clear(lua_State *l) {
-    o_cut_buffer_clear();
-    return 0;
+    lua_pushinteger(l, o_cut_buffer_clear());
+    return 1;
+}
+
+int _cut_buffer_sync(lua_State *l) {
+    lua_pushinteger(l, o_cut_buffer_sync());
+    return 1;
 }
 
 int _cut_buffer_clear_channel(lua_State *l) {
     lua_check_num_args(1);
     int ch = (int)luaL_checkinteger(l, 1) - 1;
-    o_cut_buffer_clear_channel(ch);
-    return 0;
+    lua_pushinteger(l, o_cut_buffer_clear_channel(ch));
+    return 1;
 }
 
 int _cut_buffer_clear_region(lua_State *l) {
     lua_check_num_args(2);
     float start = (float)luaL_checknumber(l, 1);
     float dur = (float)luaL_checknumber(l, 2);
-    o_cut_buffer_clear_region(start, dur);
-    return 0;
+    lua_pushinteger(l, o_cut_buffer_clear_region(start, dur));
+    return 1;
 }
 
 int _cut_buffer_clear_region_channel(lua_State *l) {
@@ -2173,8 +2357,8 @@ int _cut_buffer_clear_region_channel(lua_State *l) {
     int ch = (int)luaL_checkinteger(l, 1) - 1;
     float start = (float)luaL_checknumber(l, 2);
     float dur = (float)luaL_checknumber(l, 3);
-    o_cut_buffer_clear_region_channel(ch, start, dur);
-    return 0;
+    lua_pushinteger(l, o_cut_buffer_clear_region_channel(ch, start, dur));
+    return 1;
 }
 
 int _cut_buffer_read_mono(lua_State *l) {
@@ -2185,8 +2369,8 @@ int _cut_buffer_read_mono(lua_State *l) {
     float dur = (float)luaL_checknumber(l, 4);
     int ch_src = (int)luaL_checkinteger(l, 5) - 1;
     int ch_dst = (int)luaL_checkinteger(l, 6) - 1;
-    o_cut_buffer_read_mono((char *)s, start_src, start_dst, dur, ch_src, ch_dst);
-    return 0;
+    lua_pushinteger(l, o_cut_buffer_read_mono((char *)s, start_src, start_dst, dur, ch_src, ch_dst));
+    return 1;
 }
 
 int _cut_buffer_read_stereo(lua_State *l) {
@@ -2195,8 +2379,8 @@ int _cut_buffer_read_stereo(lua_State *l) {
     float start_src = (float)luaL_checknumber(l, 2);
     float start_dst = (float)luaL_checknumber(l, 3);
     float dur = (float)luaL_checknumber(l, 4);
-    o_cut_buffer_read_stereo((char *)s, start_src, start_dst, dur);
-    return 0;
+    lua_pushinteger(l, o_cut_buffer_read_stereo((char *)s, start_src, start_dst, dur));
+    return 1;
 }
 
 int _cut_buffer_write_mono(lua_State *l) {
@@ -2205,8 +2389,8 @@ int _cut_buffer_write_mono(lua_State *l) {
     float start = (float)luaL_checknumber(l, 2);
     float dur = (float)luaL_checknumber(l, 3);
     int ch = (int)luaL_checkinteger(l, 4) - 1;
-    o_cut_buffer_write_mono((char *)s, start, dur, ch);
-    return 0;
+    lua_pushinteger(l, o_cut_buffer_write_mono((char *)s, start, dur, ch));
+    return 1;
 }
 
 int _cut_buffer_write_stereo(lua_State *l) {
@@ -2214,7 +2398,23 @@ int _cut_buffer_write_stereo(lua_State *l) {
     const char *s = luaL_checkstring(l, 1);
     float start = (float)luaL_checknumber(l, 2);
     float dur = (float)luaL_checknumber(l, 3);
-    o_cut_buffer_write_stereo((char *)s, start, dur);
+    lua_pushinteger(l, o_cut_buffer_write_stereo((char *)s, start, dur));
+    return 1;
+}
+
+int _cut_stream_open(lua_State *l) {
+    lua_check_num_args(3);
+    int voice = (int)luaL_checkinteger(l, 1) - 1;
+    const char *s = luaL_checkstring(l, 2);
+    float min_dur = (float)luaL_checknumber(l, 3);
+    o_cut_stream_open(voice, (char *)s, min_dur);
+    return 0;
+}
+
+int _cut_stream_close(lua_State *l) {
+    lua_check_num_args(1);
+    int voice = (int)luaL_checkinteger(l, 1) - 1;
+    o_cut_stream_close(voice);
     return 0;
 }
 
@@ -2223,6 +2423,16 @@ int _cut_reset(lua_State *l) {
     return 0;
 }
 
+// returns voice count, buffer length in frames
+int _cut_info(lua_State *l) {
+    lua_check_num_args(0);
+    int voices, frames;
+    o_get_cut_info(&voices, &frames);
+    lua_pushinteger(l, voices);
+    lua_pushinteger(l, frames);
+    return 2;
+}
+
 int _set_cut_param(lua_State *l) {
     lua_check_num_args(3);
     const char *s = luaL_checkstring(l, 1);
@@ -2333,6 +2543,34 @@ int _set_comp_param(lua_State *l) {
     return 0;
 }
 
+// eq effects controls
+int _set_eq_on(lua_State *l) {
+    o_set_eq_on();
+    return 0;
+}
+
+int _set_eq_off(lua_State *l) {
+    o_set_eq_off();
+    return 0;
+}
+
+int _set_eq_param(lua_State *l) {
+    lua_check_num_args(2);
+    const char *s = luaL_checkstring(l, 1);
+    float val = (float)luaL_checknumber(l, 2);
+    o_set_eq_param(s, val);
+    return 0;
+}
+
+// insert chain order
+int _set_insert_slot(lua_State *l) {
+    lua_check_num_args(2);
+    int slot = (int)luaL_checkinteger(l, 1);
+    int fx = (int)luaL_checkinteger(l, 2);
+    o_set_insert_slot(slot, fx);
+    return 0;
+}
+
 int _start_audio(lua_State *l) {
     norns_hello_start();
     return 0;
@@ -2361,4 +2599,80 @@ int _system_cmd(lua_State *l) {
     return 0;
 }
 
+// returns a table of event pool / queue levels and high-water marks
+int _event_stats(lua_State *l) {
+    lua_check_num_args(0);
+    struct event_stats s;
+    events_get_stats(&s);
+    lua_createtable(l, 0, 8);
+    lua_pushinteger(l, s.pool_size);
+    lua_setfield(l, -2, "pool_size");
+    lua_pushinteger(l, s.pool_used);
+    lua_setfield(l, -2, "pool_used");
+    lua_pushinteger(l, s.pool_high);
+    lua_setfield(l, -2, "pool_high");
+    lua_pushinteger(l, s.queued);
+    lua_setfield(l, -2, "queued");
+    lua_pushinteger(l, s.queue_high);
+    lua_setfield(l, -2, "queue_high");
+    lua_pushinteger(l, s.waits);
+    lua_setfield(l, -2, "waits");
+    lua_pushinteger(l, s.overflows);
+    lua_setfield(l, -2, "overflows");
+    lua_pushinteger(l, s.coalesced);
+    lua_setfield(l, -2, "coalesced");
+    return 1;
+}
+
+int _event_stats_reset(lua_State *l) {
+    lua_check_num_args(0);
+    events_reset_high_water();
+    return 0;
+}
+
+// set how bursts of an event type are merged: (type name, "none" | "sum" | "last").
+// returns false if the type can't be merged that way
+int _event_coalesce(lua_State *l) {
+    static const char *const rules[] = {"none", "sum", "last", NULL};
+    lua_check_num_args(2);
+    const char *name = luaL_checkstring(l, 1);
+    int rule = luaL_checkoption(l, 2, NULL, rules);
+    bool ok = events_set_coalesce(name, (event_coalesce_t)rule);
+    lua_settop(l, 0);
+    lua_pushboolean(l, ok);
+    return 1;
+}
+
+// latency histogram of a lane ("timing" | "input" | "bulk"):
+// returns an array of bucket counts (bucket 1 is under 1us, bucket i is [2^(i-2), 2^(i-1)) us)
+// and the longest latency seen, in us
+int _event_latency(lua_State *l) {
+    static const char *const lane_names[] = {"timing", "input", "bulk", NULL};
+    lua_check_num_args(1);
+    int lane = luaL_checkoption(l, 1, NULL, lane_names);
+    struct event_latency lat;
+    events_get_latency((event_lane_t)lane, &lat);
+    lua_settop(l, 0);
+    lua_createtable(l, EVENT_LATENCY_BUCKETS, 0);
+    for (int i = 0; i < EVENT_LATENCY_BUCKETS; i++) {
+        lua_pushinteger(l, lat.counts[i]);
+        lua_rawseti(l, -2, i + 1);
+    }
+    lua_pushinteger(l, lat.max_us);
+    return 2;
+}
+
+int _event_latency_reset(lua_State *l) {
+    lua_check_num_args(0);
+    events_reset_latency();
+    return 0;
+}
+
+// ask crone for its command queue counters; they arrive through _norns.command_stats
+int _command_stats_request(lua_State *l) {
+    lua_check_num_args(0);
+    o_request_command_stats();
+    return 0;
+}
+
 #pragma GCC diagnostic pop
@@ -80,7 +80,13 @@ extern void w_handle_poll_value(int idx, float val);
 extern void w_handle_poll_data(int idx, int size, uint8_t *data);
 extern void w_handle_poll_wave(int idx, uint8_t *data);
 extern void w_handle_poll_io_levels(uint8_t *levels);
-extern void w_handle_poll_softcut_phase(int idx, float val);
+extern void w_handle_poll_meters(int size, uint8_t *data);
+extern void w_handle_poll_softcut_phase(int idx, float val, double time);
+extern void w_handle_softcut_event(int voice, int kind, float pos, double time);
+extern void w_handle_softcut_buffer_job(int id, int state, float progress);
+extern void w_handle_tape_stats(int stream, int running, float seconds, float fill, int dropped);
+extern void w_handle_command_stats(int client, int posted, int coalesced, int applied, int overflows, int dropped,
+                                   float max_latency, float mean_latency);
 
 extern void w_handle_engine_loaded();
 